@@ -0,0 +1,382 @@
+// access_pipeline.c
+
+#include "access_pipeline.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "config.h"
+#include "core.h"
+#include "app_config.h"
+#include "mqtt_manager.h"
+#include "conn_supervisor.h"
+#include "payload_codec.h"
+#include "recent_set.h"
+#include "qr_ticket.h"
+#include "allowlist.h"
+#include "journal.h"
+#include "commands.h"
+#include "dlog.h"
+#include "params.h"
+#include "task_manifest.h"
+#include "mem_place.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+static const char *TAG = "CRED_PIPE";
+
+static QueueHandle_t s_cred_queue = NULL;
+
+// Credenciales vistas recientemente, todos los lectores en la misma tabla
+static recent_entry_t s_recent_slots[CRED_RECENT_SLOTS];
+static recent_set_t   s_recent;
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t queue_full;     // cola del pipeline llena (lector más rápido que la task)
+    uint32_t no_mqtt;        // descartadas sin broker y sin decisión offline
+    uint32_t local;          // decididas con la allowlist
+    uint32_t lane_full;      // carril con ACCESS_TRACKER_SLOTS_PER_LANE en vuelo
+    uint32_t pub_fail;       // getAccessTorn no encolado (sin memoria o cola de salida llena)
+    uint32_t published;
+    uint32_t lat_max_us;
+    uint64_t lat_sum_us[CRED_SRC_COUNT];
+    uint32_t lat_count[CRED_SRC_COUNT];
+} pipeline_stats_t;
+
+static pipeline_stats_t s_stats = {0};
+static portMUX_TYPE     s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_src_names[CRED_SRC_COUNT] = { "RFID", "QR" };
+
+_Static_assert((int)ALLOW_SRC_RFID == (int)CRED_SRC_RFID && (int)ALLOW_SRC_QR == (int)CRED_SRC_QR,
+               "allow_src_t debe seguir a cred_source_t");
+
+// ================== ETAPAS ==================
+
+static void note_latency(const credential_t *c)
+{
+    uint32_t lat = (uint32_t)(esp_timer_get_time() - c->t_detect_us);
+
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.published++;
+    if (lat > s_stats.lat_max_us) s_stats.lat_max_us = lat;
+    s_stats.lat_sum_us[c->source] += lat;
+    s_stats.lat_count[c->source]++;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+// Dedup: mismo código en el mismo carril dentro de su TTL
+static void dedup_key(const credential_t *c, uint64_t *hash, int64_t *ttl_us)
+{
+    int64_t ttl_ms;
+    if (c->source == CRED_SRC_RFID)       ttl_ms = params_get(PARAM_DEBOUNCE_RFID_MS);
+    else if (qr_ticket_is_ticket(c->id))  ttl_ms = params_get(PARAM_DEBOUNCE_TICKET_MS);
+    else                                  ttl_ms = params_get(PARAM_DEBOUNCE_QR_MS);
+
+    // El carril entra en el hash: la misma tarjeta en IN y en OUT son dos pasos
+    *hash = recent_set_hash(c->id) ^
+            ((uint64_t)(c->lane * CRED_SRC_COUNT + c->source + 1) * 0x9E3779B97F4A7C15ULL);
+    *ttl_us = ttl_ms * 1000;
+}
+
+static bool is_duplicate(const credential_t *c)
+{
+    uint64_t h;
+    int64_t ttl_us;
+    dedup_key(c, &h, &ttl_us);
+    return recent_set_check(&s_recent, h, c->t_detect_us, ttl_us);
+}
+
+// Sólo cuando la credencial ya ha dado algo (decisión local o petición
+// encolada): una descartada sin broker o con el carril lleno tiene que
+// poder pasar otra vez en cuanto el usuario la repita
+static void dedup_mark(const credential_t *c)
+{
+    uint64_t h;
+    int64_t ttl_us;
+    dedup_key(c, &h, &ttl_us);
+    recent_set_insert(&s_recent, h, c->t_detect_us, ttl_us);
+}
+
+// Informe asíncrono de una decisión local: si MQTT está caído se queda en
+// mqtt_out_queue hasta la reconexión
+static void publish_ticket_event(const qr_ticket_t *t, qr_ticket_result_t r,
+                                 const char *nonce_hex, uint32_t now)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+
+    cJSON_AddStringToObject(root, "action",    "ticketAccess");
+    cJSON_AddBoolToObject  (root, "ok",        r == QT_OK);
+    cJSON_AddStringToObject(root, "reason",    qr_ticket_result_name(r));
+    cJSON_AddNumberToObject(root, "bookingId", t->booking_id);
+    cJSON_AddNumberToObject(root, "court",     t->court);
+    cJSON_AddNumberToObject(root, "keyId",     t->key_id);
+    cJSON_AddStringToObject(root, "nonce",     nonce_hex);
+    cJSON_AddNumberToObject(root, "ts",        now);
+    cJSON_AddStringToObject(root, "name",      device_id);
+    cJSON_AddStringToObject(root, "idTorno",   id_torno);
+
+    if (!mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0)) {
+        ESP_LOGW(TAG, "No se pudo encolar ticketAccess");
+    }
+    cJSON_Delete(root);
+}
+
+// Ticket firmado: se decide aquí mismo sin esperar al broker. Devuelve false
+// si no se puede decidir offline (sin clave, sin hora, tabla llena) y hay
+// que seguir por getAccessTorn.
+static bool decide_offline(const credential_t *c)
+{
+    if (!qr_ticket_is_ticket(c->id)) return false;
+
+    qr_ticket_t t = {0};
+    uint32_t now = (uint32_t)time(NULL);
+
+    qr_ticket_result_t r = qr_ticket_check(c->id, now, (uint16_t)g_app_config.ticket_court, &t);
+    if (!qr_ticket_decided_offline(r)) {
+        DLOGW(DLOG_PIPE, "Ticket sin decision offline (%s), consulta online",
+              qr_ticket_result_name(r));
+        return false;
+    }
+
+    char nonce_hex[2 * sizeof(t.nonce) + 1];
+    for (size_t i = 0; i < sizeof(t.nonce); i++) {
+        snprintf(&nonce_hex[2 * i], 3, "%02x", t.nonce[i]);
+    }
+
+    DLOGI(DLOG_PIPE, "Ticket booking=%lu court=%u -> %s",
+          (unsigned long)t.booking_id, t.court, qr_ticket_result_name(r));
+
+    // Torno primero; el informe y la persistencia del nonce van después
+    journal_log(JR_DECISION, c->lane, JO_TICKET, r == QT_OK, t.booking_id, c->id, NULL);
+    if (!commands_post_local_access(r == QT_OK, "IN", nonce_hex)) {
+        DLOGW(DLOG_PIPE, "cmd_queue llena, ticket sin actuar");
+    }
+    publish_ticket_event(&t, r, nonce_hex, now);
+    if (r == QT_OK) app_config_schedule_commit();   // NVS fuera del camino de acceso
+    return true;
+}
+
+static void publish_local_event(const credential_t *c, allow_result_t r,
+                                const allow_rec_t *rec, uint32_t now)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+
+    cJSON_AddStringToObject(root, "action",  "localAccess");
+    cJSON_AddBoolToObject  (root, "ok",      r == ALLOW_GRANTED);
+    cJSON_AddStringToObject(root, "reason",  allowlist_result_name(r));
+    cJSON_AddStringToObject(root, "type",    access_lane_name(c->lane));
+    cJSON_AddStringToObject(root, "cardId",  c->id);
+    cJSON_AddStringToObject(root, "user",    c->user);
+    if (rec && rec->valid_to) cJSON_AddNumberToObject(root, "validTo", rec->valid_to);
+    cJSON_AddNumberToObject(root, "ts",      now);
+    cJSON_AddStringToObject(root, "name",    device_id);
+    cJSON_AddStringToObject(root, "idTorno", id_torno);
+
+    if (!mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0)) {
+        DLOGW(DLOG_PIPE, "No se pudo encolar localAccess");
+    }
+    cJSON_Delete(root);
+}
+
+// Allowlist en flash: en modo grant sólo se abre en local (lo demás sigue a
+// getAccessTorn); en modo authoritative también se deniega. "unavailable"
+// (sin lista o sin hora para una ventana) siempre va al servidor.
+static bool decide_allowlist(const credential_t *c)
+{
+    int mode = g_app_config.allowlist_mode;
+    if (mode == ALLOW_MODE_OFF) return false;
+
+    allow_rec_t rec;
+    uint32_t now = (uint32_t)time(NULL);
+    allow_result_t r = allowlist_check((allow_src_t)c->source, c->id, c->lane, now, &rec);
+
+    if (r == ALLOW_UNAVAILABLE) return false;
+    if (r != ALLOW_GRANTED && mode != ALLOW_MODE_AUTHORITATIVE) return false;
+
+    DLOGI(DLOG_PIPE, "%s -> allowlist: %s", access_lane_name(c->lane), allowlist_result_name(r));
+
+    // El QR abre la entrada, igual que los tickets
+    const char *door = c->lane == ACCESS_LANE_OUT ? "OUT" : "IN";
+    journal_log(JR_DECISION, c->lane, JO_ALLOWLIST, r == ALLOW_GRANTED, r, c->id, NULL);
+    if (!commands_post_local_access(r == ALLOW_GRANTED, door, NULL)) {
+        DLOGW(DLOG_PIPE, "cmd_queue llena, allowlist sin actuar");
+    }
+    publish_local_event(c, r, r == ALLOW_NOT_FOUND ? NULL : &rec, now);
+
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.local++;
+    portEXIT_CRITICAL(&s_stats_mux);
+    return true;
+}
+
+// Único serializador de getAccessTorn (CBOR si está negociado, si no JSON)
+static bool publish_access_request(const credential_t *c, const char *id_peticion)
+{
+    const char *type = access_lane_name(c->lane);
+
+    if (g_app_config.payload_enc == PAYLOAD_ENC_CBOR) {
+        uint8_t buf[CRED_ID_MAX + 96];
+        size_t n = payload_cbor_access_request(buf, sizeof(buf), type, c->id, c->user,
+                                               device_id, id_torno, id_peticion);
+        if (n > 0) {
+            return mqtt_enqueue_bin(TOPIC_RESP_FIXED PAYLOAD_CBOR_TOPIC_SUFFIX, buf, n, 1, 0);
+        }
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return false;
+
+    cJSON_AddStringToObject(root, "action",     "getAccessTorn");
+    cJSON_AddStringToObject(root, "type",       type);
+    cJSON_AddStringToObject(root, "cardId",     c->id);
+    cJSON_AddStringToObject(root, "user",       c->user);
+    cJSON_AddStringToObject(root, "name",       device_id);
+    cJSON_AddStringToObject(root, "idTorno",    id_torno);
+    cJSON_AddStringToObject(root, "idPeticion", id_peticion);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json) return false;
+
+    bool ok = mqtt_enqueue(TOPIC_RESP_FIXED, json, 1, 0);
+    cJSON_free(json);
+    return ok;
+}
+
+static void process_credential(const credential_t *c)
+{
+    const char *lane = access_lane_name(c->lane);
+
+    if (is_duplicate(c)) {
+        DLOGD(DLOG_PIPE, "%s -> '%s' repetida, ignorada", lane, c->id);
+        return;
+    }
+
+    DLOGI(DLOG_PIPE, "%s -> %s '%s' user='%s'", lane, s_src_names[c->source], c->id, c->user);
+    journal_log(JR_CRED, c->lane, c->source, 0, 0, c->id, NULL);
+
+    if (decide_offline(c) || decide_allowlist(c)) {
+        dedup_mark(c);
+        note_latency(c);
+        return;
+    }
+
+    // Sin broker no tiene sentido pedir acceso: el usuario no va a esperar
+    // a la reconexión y la petición caducaría en el tracker
+    if (!conn_sup_mqtt_up()) {
+        DLOGW(DLOG_PIPE, "%s -> MQTT no conectado, credencial descartada", lane);
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.no_mqtt++;
+        portEXIT_CRITICAL(&s_stats_mux);
+        return;
+    }
+
+    char id_pet[16];
+    if (!access_tracker_begin(c->lane, id_pet, sizeof(id_pet))) {
+        DLOGW(DLOG_PIPE, "%s -> ignorada, carril lleno esperando hasAccess", lane);
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.lane_full++;
+        portEXIT_CRITICAL(&s_stats_mux);
+        return;
+    }
+
+    if (!publish_access_request(c, id_pet)) {
+        DLOGW(DLOG_PIPE, "%s -> no se pudo encolar getAccessTorn", lane);
+        access_tracker_cancel(id_pet);
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.pub_fail++;
+        portEXIT_CRITICAL(&s_stats_mux);
+        return;
+    }
+    dedup_mark(c);
+    DLOGI(DLOG_PIPE, "%s -> getAccessTorn idPeticion=%s", lane, id_pet);
+    journal_log(JR_REQUEST, c->lane, c->source, 0, 0, c->id, id_pet);
+    note_latency(c);
+}
+
+// ================== TASK ==================
+
+static void access_pipeline_task(void *pv)
+{
+    (void)pv;
+    credential_t c;
+
+    while (1) {
+        if (xQueueReceive(s_cred_queue, &c, portMAX_DELAY) == pdTRUE) {
+            process_credential(&c);
+        }
+    }
+}
+
+bool access_pipeline_submit(const credential_t *cred)
+{
+    if (!s_cred_queue || !cred || cred->lane >= ACCESS_LANE_COUNT ||
+        cred->source >= CRED_SRC_COUNT) {
+        return false;
+    }
+
+    bool ok = xQueueSend(s_cred_queue, cred, 0) == pdTRUE;
+
+    portENTER_CRITICAL(&s_stats_mux);
+    if (ok) s_stats.submitted++;
+    else    s_stats.queue_full++;
+    portEXIT_CRITICAL(&s_stats_mux);
+
+    if (!ok) DLOGW(DLOG_PIPE, "Cola de credenciales llena, lectura descartada");
+    return ok;
+}
+
+esp_err_t access_pipeline_init(void)
+{
+    if (s_cred_queue) return ESP_OK;
+
+    recent_set_init(&s_recent, s_recent_slots, CRED_RECENT_SLOTS);
+
+    s_cred_queue = mem_place_queue("cred", CRED_QUEUE_LEN, sizeof(credential_t), MEM_HOT);
+    if (!s_cred_queue) return ESP_ERR_NO_MEM;
+
+    // Prioridad entre el GM861S (8) y el RC522 (6), ver task_manifest.c: las
+    // lecturas no esperan al sondeo del RC522, a los comandos ni al status
+    if (task_manifest_create(TASK_CRED_PIPE, access_pipeline_task, NULL, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void access_pipeline_add_to_json(cJSON *root)
+{
+    pipeline_stats_t st;
+    portENTER_CRITICAL(&s_stats_mux);
+    st = s_stats;
+    portEXIT_CRITICAL(&s_stats_mux);
+
+    cJSON *o = cJSON_CreateObject();
+    if (!o) return;
+
+    cJSON_AddNumberToObject(o, "submitted", st.submitted);
+    cJSON_AddNumberToObject(o, "published", st.published);
+    cJSON_AddNumberToObject(o, "dup",       s_recent.stats.suppressed);
+    cJSON_AddNumberToObject(o, "dupEvict",  s_recent.stats.evicted);
+    cJSON_AddNumberToObject(o, "noMqtt",    st.no_mqtt);
+    cJSON_AddNumberToObject(o, "local",     st.local);
+    cJSON_AddNumberToObject(o, "laneFull",  st.lane_full);
+    cJSON_AddNumberToObject(o, "pubFail",   st.pub_fail);
+    cJSON_AddNumberToObject(o, "qFull",     st.queue_full);
+    cJSON_AddNumberToObject(o, "latRfidUs",
+                            st.lat_count[CRED_SRC_RFID] ?
+                            (double)(st.lat_sum_us[CRED_SRC_RFID] / st.lat_count[CRED_SRC_RFID]) : 0);
+    cJSON_AddNumberToObject(o, "latQrUs",
+                            st.lat_count[CRED_SRC_QR] ?
+                            (double)(st.lat_sum_us[CRED_SRC_QR] / st.lat_count[CRED_SRC_QR]) : 0);
+    cJSON_AddNumberToObject(o, "latMaxUs",  st.lat_max_us);
+    cJSON_AddItemToObject(root, "cred", o);
+}
@@ -0,0 +1,43 @@
+// access_pipeline.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "cJSON.h"
+#include "access_tracker.h"
+
+// Pipeline único de credenciales: todos los lectores (RC522, GM861S, los que
+// vengan) entregan aquí lo que leen y una sola task hace, en este orden:
+//
+//   dedup (recent_set) -> decisión offline (tickets QR, allowlist) -> gating MQTT ->
+//   correlación (access_tracker) -> serialización getAccessTorn -> mqtt_out_queue
+//
+// Los drivers sólo leen hardware; no saben de MQTT, JSON ni debounce.
+
+#define CRED_ID_MAX    256    // incluye el '\0' (texto QR completo)
+#define CRED_USER_MAX  32
+
+typedef enum {
+    CRED_SRC_RFID = 0,
+    CRED_SRC_QR,
+    CRED_SRC_COUNT
+} cred_source_t;
+
+typedef struct {
+    access_lane_t lane;             // carril: IN / OUT / QR
+    cred_source_t source;
+    int64_t       t_detect_us;      // instante de lectura (latencia hasta la cola)
+    char          id[CRED_ID_MAX];  // cardId: UID hex o texto del QR
+    char          user[CRED_USER_MAX];
+} credential_t;
+
+esp_err_t access_pipeline_init(void);
+
+// No bloqueante: se puede llamar desde cualquier task de lector.
+// false si la cola del pipeline está llena (se cuenta como queueFull).
+bool access_pipeline_submit(const credential_t *cred);
+
+// Objeto "cred" para status
+void access_pipeline_add_to_json(cJSON *root);
@@ -0,0 +1,289 @@
+// access_tracker.c
+
+#include "access_tracker.h"
+#include "config.h"
+#include "journal.h"
+#include "params.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <strings.h>
+
+static const char *TAG = "ACCESS_TRK";
+
+#define ACCESS_ID_LEN 16
+
+typedef struct {
+    bool    used;
+    char    id[ACCESS_ID_LEN];
+    int64_t deadline_us;
+    int64_t sent_us;
+} access_slot_t;
+
+static access_slot_t s_slots[ACCESS_LANE_COUNT][ACCESS_TRACKER_SLOTS_PER_LANE];
+static access_tracker_stats_t s_stats = {0};
+
+static portMUX_TYPE s_trk_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Un único timer para todos los plazos: siempre armado al más próximo
+static esp_timer_handle_t s_deadline_timer = NULL;
+// Serializa stop + start del timer entre el callback y access_tracker_begin
+static SemaphoreHandle_t  s_arm_mutex = NULL;
+
+static uint32_t s_boot_nonce = 0;
+static uint32_t s_seq = 0;
+
+static const char *const s_lane_names[ACCESS_LANE_COUNT] = { "IN", "OUT", "QR" };
+
+const char *access_lane_name(access_lane_t lane)
+{
+    return (lane < ACCESS_LANE_COUNT) ? s_lane_names[lane] : "?";
+}
+
+bool access_lane_from_name(const char *type, access_lane_t *lane)
+{
+    if (!type) return false;
+    for (int i = 0; i < ACCESS_LANE_COUNT; i++) {
+        if (strcasecmp(type, s_lane_names[i]) == 0) {
+            *lane = (access_lane_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Llamar con s_trk_mux tomado. Devuelve el deadline más próximo (0 = ninguno).
+static int64_t next_deadline_locked(void)
+{
+    int64_t next = 0;
+    for (int l = 0; l < ACCESS_LANE_COUNT; l++) {
+        for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+            access_slot_t *s = &s_slots[l][i];
+            if (s->used && (next == 0 || s->deadline_us < next)) {
+                next = s->deadline_us;
+            }
+        }
+    }
+    return next;
+}
+
+// El plazo se lee otra vez con el mutex tomado: si el callback y
+// access_tracker_begin rearman a la vez, el último en pasar arma el plazo
+// más próximo que hay ahora, no el que vio cada uno antes
+static void rearm_timer(void)
+{
+    if (!s_deadline_timer || !s_arm_mutex) return;
+
+    xSemaphoreTake(s_arm_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&s_trk_mux);
+    int64_t next_us = next_deadline_locked();
+    portEXIT_CRITICAL(&s_trk_mux);
+
+    esp_timer_stop(s_deadline_timer);
+    if (next_us != 0) {
+        int64_t wait = next_us - esp_timer_get_time();
+        if (wait < 1000) wait = 1000;
+        esp_timer_start_once(s_deadline_timer, (uint64_t)wait);
+    }
+    xSemaphoreGive(s_arm_mutex);
+}
+
+static void deadline_timer_cb(void *arg)
+{
+    (void)arg;
+    int64_t now = esp_timer_get_time();
+    int expired = 0;
+    struct { int lane; char id[ACCESS_ID_LEN]; } gone[ACCESS_LANE_COUNT * ACCESS_TRACKER_SLOTS_PER_LANE];
+
+    portENTER_CRITICAL(&s_trk_mux);
+    for (int l = 0; l < ACCESS_LANE_COUNT; l++) {
+        for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+            access_slot_t *s = &s_slots[l][i];
+            if (s->used && s->deadline_us <= now) {
+                s->used = false;
+                s_stats.expired++;
+                gone[expired].lane = l;
+                memcpy(gone[expired].id, s->id, sizeof(gone[expired].id));
+                expired++;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_trk_mux);
+
+    // Fuera de la sección crítica: journal_log encola
+    int32_t timeout_ms = params_get(PARAM_ACCESS_TIMEOUT_MS);
+    for (int i = 0; i < expired; i++) {
+        journal_log(JR_DECISION, gone[i].lane, JO_TIMEOUT, 0,
+                    (uint32_t)timeout_ms, NULL, gone[i].id);
+    }
+
+    if (expired) {
+        ESP_LOGW(TAG, "%d peticion(es) getAccessTorn sin respuesta en %ld ms",
+                 expired, (long)timeout_ms);
+    }
+    rearm_timer();
+}
+
+esp_err_t access_tracker_init(void)
+{
+    if (s_deadline_timer) return ESP_OK;
+
+    s_boot_nonce = esp_random() & 0xFFFFFF;
+
+    if (!s_arm_mutex) s_arm_mutex = xSemaphoreCreateMutex();
+    if (!s_arm_mutex) return ESP_ERR_NO_MEM;
+
+    const esp_timer_create_args_t args = {
+        .callback = deadline_timer_cb,
+        .name     = "access_trk",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_deadline_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_timer_create: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+bool access_tracker_begin(access_lane_t lane, char *id_out, size_t id_out_sz)
+{
+    if (lane >= ACCESS_LANE_COUNT || !id_out || id_out_sz < ACCESS_ID_LEN) return false;
+
+    int64_t now = esp_timer_get_time();
+    int64_t timeout_us = (int64_t)params_get(PARAM_ACCESS_TIMEOUT_MS) * 1000;
+    bool ok = false;
+    bool rearm = false;
+
+    // <nonce de arranque><secuencia>: único entre reinicios del equipo. Se
+    // formatea fuera del spinlock; si no hay hueco la secuencia se pierde.
+    char id[ACCESS_ID_LEN];
+    uint32_t seq = __atomic_add_fetch(&s_seq, 1, __ATOMIC_RELAXED);
+    snprintf(id, sizeof(id), "%06lX%06lX",
+             (unsigned long)s_boot_nonce, (unsigned long)(seq & 0xFFFFFF));
+
+    portENTER_CRITICAL(&s_trk_mux);
+    for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+        access_slot_t *s = &s_slots[lane][i];
+        if (s->used) continue;
+
+        memcpy(s->id, id, sizeof(s->id));
+        s->used        = true;
+        s->sent_us     = now;
+        s->deadline_us = now + timeout_us;
+
+        s_stats.sent++;
+        rearm = (next_deadline_locked() == s->deadline_us);
+        ok = true;
+        break;
+    }
+    if (!ok) s_stats.rejected++;
+    portEXIT_CRITICAL(&s_trk_mux);
+
+    if (ok) {
+        strncpy(id_out, id, id_out_sz - 1);
+        id_out[id_out_sz - 1] = '\0';
+    }
+    if (rearm) rearm_timer();
+    return ok;
+}
+
+bool access_tracker_complete(const char *id_peticion, const char *type)
+{
+    access_lane_t lane = ACCESS_LANE_COUNT;
+    access_slot_t *hit = NULL;
+    bool by_id = false;
+
+    portENTER_CRITICAL(&s_trk_mux);
+    if (id_peticion && id_peticion[0] && strcmp(id_peticion, "-") != 0) {
+        for (int l = 0; l < ACCESS_LANE_COUNT && !hit; l++) {
+            for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+                access_slot_t *s = &s_slots[l][i];
+                if (s->used && strcmp(s->id, id_peticion) == 0) {
+                    hit = s;
+                    lane = (access_lane_t)l;
+                    by_id = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!hit && access_lane_from_name(type, &lane)) {
+        // Servidor legacy sin eco de idPeticion: FIFO dentro del carril
+        for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+            access_slot_t *s = &s_slots[lane][i];
+            if (s->used && (!hit || s->sent_us < hit->sent_us)) hit = s;
+        }
+    }
+
+    int64_t rtt_us = 0;
+    if (hit) {
+        hit->used = false;
+        rtt_us = esp_timer_get_time() - hit->sent_us;
+        if (by_id) s_stats.matched++; else s_stats.fallback++;
+    } else {
+        s_stats.late++;
+    }
+    portEXIT_CRITICAL(&s_trk_mux);
+
+    if (hit) {
+        ESP_LOGI(TAG, "hasAccess %s casado (%s) en %lld ms",
+                 access_lane_name(lane), by_id ? "id" : "carril",
+                 (long long)(rtt_us / 1000));
+    } else {
+        ESP_LOGW(TAG, "hasAccess sin peticion pendiente (idPeticion=%s type=%s)",
+                 id_peticion ? id_peticion : "-", type ? type : "-");
+    }
+
+    // El timer se recoloca solo al disparar; no hace falta adelantarlo aquí
+    return hit != NULL;
+}
+
+bool access_tracker_cancel(const char *id_peticion)
+{
+    bool found = false;
+    if (!id_peticion || !id_peticion[0]) return false;
+
+    portENTER_CRITICAL(&s_trk_mux);
+    for (int l = 0; l < ACCESS_LANE_COUNT && !found; l++) {
+        for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+            access_slot_t *s = &s_slots[l][i];
+            if (s->used && strcmp(s->id, id_peticion) == 0) {
+                s->used = false;
+                s_stats.cancelled++;
+                found = true;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_trk_mux);
+
+    // Como en complete: si era el plazo armado, el timer dispara sin nada
+    // que expirar y se recoloca al siguiente
+    return found;
+}
+
+void access_tracker_get_stats(access_tracker_stats_t *out)
+{
+    portENTER_CRITICAL(&s_trk_mux);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_trk_mux);
+}
+
+int access_tracker_pending(access_lane_t lane)
+{
+    int n = 0;
+    if (lane >= ACCESS_LANE_COUNT) return 0;
+
+    portENTER_CRITICAL(&s_trk_mux);
+    for (int i = 0; i < ACCESS_TRACKER_SLOTS_PER_LANE; i++) {
+        if (s_slots[lane][i].used) n++;
+    }
+    portEXIT_CRITICAL(&s_trk_mux);
+    return n;
+}
@@ -0,0 +1,47 @@
+// access_tracker.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Carriles de acceso independientes: cada uno tiene su propia tabla de
+// peticiones getAccessTorn pendientes, así un OUT no espera a un IN.
+typedef enum {
+    ACCESS_LANE_IN = 0,
+    ACCESS_LANE_OUT,
+    ACCESS_LANE_QR,
+    ACCESS_LANE_COUNT
+} access_lane_t;
+
+typedef struct {
+    uint32_t sent;       // peticiones registradas
+    uint32_t matched;    // respuestas casadas por idPeticion
+    uint32_t fallback;   // respuestas sin id conocido casadas por carril
+    uint32_t expired;    // peticiones sin respuesta dentro del plazo
+    uint32_t rejected;   // carril lleno, petición no enviada
+    uint32_t late;       // respuestas que llegan tras expirar
+    uint32_t cancelled;  // registradas pero nunca publicadas
+} access_tracker_stats_t;
+
+esp_err_t access_tracker_init(void);
+
+// Reserva un hueco en el carril y genera el idPeticion de correlación.
+// false si el carril ya tiene ACCESS_TRACKER_SLOTS_PER_LANE en vuelo.
+bool access_tracker_begin(access_lane_t lane, char *id_out, size_t id_out_sz);
+
+// Casa una respuesta hasAccess. Busca primero por idPeticion; si el servidor
+// no lo devuelve (legacy), cae a la petición más antigua del carril 'type'.
+// Devuelve true si había una petición pendiente.
+bool access_tracker_complete(const char *id_peticion, const char *type);
+
+// Libera el hueco de una petición que no llegó a publicarse, para que no
+// ocupe el carril hasta el timeout. false si el id ya no estaba pendiente.
+bool access_tracker_cancel(const char *id_peticion);
+
+const char *access_lane_name(access_lane_t lane);
+bool        access_lane_from_name(const char *type, access_lane_t *lane);
+
+void access_tracker_get_stats(access_tracker_stats_t *out);
+int  access_tracker_pending(access_lane_t lane);
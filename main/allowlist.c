@@ -0,0 +1,770 @@
+// allowlist.c
+
+#include "allowlist.h"
+#include "config.h"
+#include "core.h"
+#include "app_config.h"
+#include "mqtt_manager.h"
+#include "mqtt_reasm.h"
+#include "recent_set.h"
+#include "mem_place.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include <string.h>
+#include <stdio.h>
+
+static const char *TAG = "ALLOWLIST";
+
+#define SECTOR_SZ       4096u
+#define LOG_ENT_SZ      sizeof(allow_log_ent_t)
+#define REC_AREA_MAX    (ALLOWLIST_BANK_SZ - ALLOW_HDR_SECTOR - ALLOWLIST_DELTA_SZ)
+#define REC_MAX         (REC_AREA_MAX / sizeof(allow_rec_t))
+#define LANE_MASK(k)    ((uint8_t)((k) & 0xFF))
+#define KEY_H56(k)      ((k) >> 8)
+
+_Static_assert(sizeof(allow_rec_t) == 16, "allow_rec_t debe ocupar 16 bytes");
+_Static_assert(sizeof(allow_hdr_t) == 32, "allow_hdr_t debe ocupar 32 bytes");
+_Static_assert(sizeof(allow_delta_op_t) == 24, "allow_delta_op_t debe ocupar 24 bytes");
+_Static_assert(sizeof(allow_log_ent_t) == 32, "allow_log_ent_t debe ocupar 32 bytes");
+
+static const esp_partition_t *s_part = NULL;
+static SemaphoreHandle_t      s_mutex = NULL;
+
+// ================== BANCO ACTIVO ==================
+
+typedef struct {
+    int                         bank;      // -1 = sin lista
+    allow_hdr_t                 hdr;
+    const allow_rec_t          *recs;      // flash mapeada
+    esp_partition_mmap_handle_t map;
+    bool                        mapped;
+    uint32_t                    log_pos;   // siguiente entrada libre del log
+    uint32_t                    seq;       // hdr.seq + deltas aplicados
+} active_bank_t;
+
+static active_bank_t s_act = { .bank = -1 };
+
+// Deltas aplicados sobre el snapshot: array ordenado por hash, en RAM
+typedef struct {
+    allow_rec_t rec;
+    bool        deleted;
+} overlay_ent_t;
+
+// En PSRAM si la hay (allowlist_init): una búsqueda binaria por lectura
+static overlay_ent_t *s_ov = NULL;
+static uint32_t      s_ov_n = 0;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t miss;
+    uint32_t snapshots;
+    uint32_t deltas;
+    uint32_t rejected;
+} allow_stats_t;
+
+static allow_stats_t s_stats = {0};
+
+static char s_snap_topic[128]  = {0};
+static char s_delta_topic[128] = {0};
+
+static inline uint32_t bank_base(int bank)
+{
+    return (uint32_t)bank * ALLOWLIST_BANK_SZ;
+}
+
+static inline uint32_t log_base(int bank)
+{
+    return bank_base(bank) + ALLOWLIST_BANK_SZ - ALLOWLIST_DELTA_SZ;
+}
+
+// ================== BÚSQUEDA ==================
+
+uint64_t allowlist_hash56(const char *id)
+{
+    return recent_set_hash(id) >> 8;
+}
+
+static const char *const s_src_prefix[ALLOW_SRC_COUNT] = { "R:", "Q:" };
+
+static uint64_t fnv1a_update(uint64_t h, const char *s)
+{
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t allowlist_key56(allow_src_t src, const char *id)
+{
+    // Prefijo e id seguidos, sin copiar el texto del QR a un buffer
+    uint64_t h = fnv1a_update(0xcbf29ce484222325ULL, s_src_prefix[src]);
+    return fnv1a_update(h, id) >> 8;
+}
+
+const allow_rec_t *allowlist_bsearch(const allow_rec_t *recs, uint32_t n, uint64_t h56)
+{
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint64_t k = KEY_H56(recs[mid].key);
+        if (k == h56) return &recs[mid];
+        if (k < h56) lo = mid + 1;
+        else         hi = mid;
+    }
+    return NULL;
+}
+
+// Posición del hash en el overlay (o donde insertarlo)
+static uint32_t overlay_lower_bound(uint64_t h56)
+{
+    uint32_t lo = 0, hi = s_ov_n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (KEY_H56(s_ov[mid].rec.key) < h56) lo = mid + 1;
+        else                                  hi = mid;
+    }
+    return lo;
+}
+
+static bool overlay_apply(uint8_t op, const allow_rec_t *rec)
+{
+    uint64_t h = KEY_H56(rec->key);
+    uint32_t i = overlay_lower_bound(h);
+
+    if (i >= s_ov_n || KEY_H56(s_ov[i].rec.key) != h) {
+        if (s_ov_n >= ALLOWLIST_OVERLAY_MAX) return false;
+        memmove(&s_ov[i + 1], &s_ov[i], (s_ov_n - i) * sizeof(s_ov[0]));
+        s_ov_n++;
+    }
+    s_ov[i].rec     = *rec;
+    s_ov[i].deleted = (op == ALLOW_OP_DEL);
+    return true;
+}
+
+// Entradas nuevas que necesitaría un delta (para rechazarlo antes de escribir)
+static uint32_t overlay_new_keys(const allow_delta_op_t *ops, uint32_t count)
+{
+    uint32_t n = 0;
+    for (uint32_t j = 0; j < count; j++) {
+        uint64_t h = KEY_H56(ops[j].rec.key);
+        uint32_t i = overlay_lower_bound(h);
+        if (i < s_ov_n && KEY_H56(s_ov[i].rec.key) == h) continue;
+        // Repetidos dentro del mismo delta cuentan de más: margen conservador
+        n++;
+    }
+    return n;
+}
+
+allow_result_t allowlist_check(allow_src_t src, const char *id, access_lane_t lane,
+                               uint32_t now, allow_rec_t *out)
+{
+    if (!s_mutex || !id || src >= ALLOW_SRC_COUNT || lane >= ACCESS_LANE_COUNT) {
+        return ALLOW_UNAVAILABLE;
+    }
+
+    uint64_t h = allowlist_key56(src, id);
+    allow_rec_t rec;
+    bool found = false;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_act.bank < 0) {
+        xSemaphoreGive(s_mutex);
+        return ALLOW_UNAVAILABLE;
+    }
+
+    uint32_t i = overlay_lower_bound(h);
+    if (i < s_ov_n && KEY_H56(s_ov[i].rec.key) == h) {
+        found = !s_ov[i].deleted;
+        rec   = s_ov[i].rec;
+    } else {
+        const allow_rec_t *r = allowlist_bsearch(s_act.recs, s_act.hdr.count, h);
+        if (r) {
+            rec   = *r;
+            found = true;
+        }
+    }
+
+    if (found) s_stats.hits++;
+    else       s_stats.miss++;
+    xSemaphoreGive(s_mutex);
+
+    if (!found) return ALLOW_NOT_FOUND;
+    if (out) *out = rec;
+
+    if (!(LANE_MASK(rec.key) & ALLOW_LANE_BIT(lane))) return ALLOW_DENIED_LANE;
+
+    if (rec.valid_from || rec.valid_to) {
+        // Ventana sin hora fiable: que decida el servidor
+        if (now < QR_TICKET_MIN_EPOCH) return ALLOW_UNAVAILABLE;
+        if (rec.valid_from && now < rec.valid_from) return ALLOW_DENIED_WINDOW;
+        if (rec.valid_to   && now > rec.valid_to)   return ALLOW_DENIED_WINDOW;
+    }
+    return ALLOW_GRANTED;
+}
+
+const char *allowlist_result_name(allow_result_t r)
+{
+    switch (r) {
+        case ALLOW_GRANTED:       return "granted";
+        case ALLOW_NOT_FOUND:     return "notFound";
+        case ALLOW_DENIED_LANE:   return "lane";
+        case ALLOW_DENIED_WINDOW: return "window";
+        case ALLOW_UNAVAILABLE:   return "unavailable";
+    }
+    return "?";
+}
+
+static const char *const s_mode_names[ALLOW_MODE_COUNT] = { "grant", "authoritative", "off" };
+
+const char *allowlist_mode_name(int mode)
+{
+    if (mode < 0 || mode >= ALLOW_MODE_COUNT) return "off";
+    return s_mode_names[mode];
+}
+
+bool allowlist_mode_from_name(const char *name, int *mode)
+{
+    for (int i = 0; i < ALLOW_MODE_COUNT; i++) {
+        if (strcmp(name, s_mode_names[i]) == 0) {
+            *mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ================== RESPUESTAS ==================
+
+static void publish_result(const char *kind, bool ok, const char *reason)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uint32_t seq   = s_act.seq;
+    uint32_t count = s_act.bank >= 0 ? s_act.hdr.count : 0;
+    uint32_t ov    = s_ov_n;
+    xSemaphoreGive(s_mutex);
+
+    cJSON_AddStringToObject(root, "action",  "retornoAllowlist");
+    cJSON_AddStringToObject(root, "kind",    kind);
+    cJSON_AddBoolToObject  (root, "ok",      ok);
+    cJSON_AddStringToObject(root, "reason",  reason);
+    cJSON_AddNumberToObject(root, "seq",     seq);
+    cJSON_AddNumberToObject(root, "count",   count);
+    cJSON_AddNumberToObject(root, "overlay", ov);
+    cJSON_AddStringToObject(root, "name",    device_id);
+    cJSON_AddStringToObject(root, "idTorno", id_torno);
+
+    if (!mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0)) {
+        ESP_LOGW(TAG, "No se pudo encolar retornoAllowlist");
+    }
+    cJSON_Delete(root);
+}
+
+// ================== CARGA DE BANCOS ==================
+
+static bool hdr_valid(const allow_hdr_t *h)
+{
+    return h->magic == ALLOW_MAGIC &&
+           h->version == ALLOW_VERSION &&
+           h->rec_size == sizeof(allow_rec_t) &&
+           h->count <= REC_MAX;
+}
+
+// Mapea los registros del banco y comprueba su CRC sobre la propia flash
+static esp_err_t map_bank(int bank, const allow_hdr_t *h,
+                          const allow_rec_t **recs, esp_partition_mmap_handle_t *map)
+{
+    // mmap no admite tamaño 0: una lista vacía mapea un sector igualmente
+    size_t len = h->count ? h->count * sizeof(allow_rec_t) : SECTOR_SZ;
+    const void *ptr = NULL;
+
+    esp_err_t err = esp_partition_mmap(s_part, bank_base(bank) + ALLOW_HDR_SECTOR, len,
+                                       ESP_PARTITION_MMAP_DATA, &ptr, map);
+    if (err != ESP_OK) return err;
+
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)ptr, h->count * sizeof(allow_rec_t));
+    if (crc != h->crc32) {
+        esp_partition_munmap(*map);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    *recs = (const allow_rec_t *)ptr;
+    return ESP_OK;
+}
+
+static uint32_t log_ent_crc(const allow_log_ent_t *e)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)e, offsetof(allow_log_ent_t, crc));
+}
+
+// Reaplica los deltas confirmados (COMMIT) del log del banco activo.
+// Un delta a medias por un corte de luz se ignora entero.
+static void replay_log(void)
+{
+    uint32_t base = log_base(s_act.bank);
+    uint32_t pos = 0, group = 0;
+    uint32_t applied = 0;
+    allow_log_ent_t e;
+
+    for (; pos + LOG_ENT_SZ <= ALLOWLIST_DELTA_SZ; pos += LOG_ENT_SZ) {
+        if (esp_partition_read(s_part, base + pos, &e, sizeof(e)) != ESP_OK) break;
+        if (e.seq == 0xFFFFFFFFu) break;                  // flash borrada: fin del log
+
+        if (log_ent_crc(&e) != e.crc) {                   // escritura cortada
+            group = pos + LOG_ENT_SZ;
+            continue;
+        }
+        if (e.op != ALLOW_OP_COMMIT) continue;
+
+        for (uint32_t p = group; p < pos; p += LOG_ENT_SZ) {
+            allow_log_ent_t g;
+            if (esp_partition_read(s_part, base + p, &g, sizeof(g)) != ESP_OK) continue;
+            if (g.seq != e.seq || log_ent_crc(&g) != g.crc) continue;
+            if (!overlay_apply(g.op, &g.rec)) {
+                ESP_LOGW(TAG, "Overlay lleno reaplicando el log");
+            }
+        }
+        s_act.seq = e.seq;
+        group = pos + LOG_ENT_SZ;
+        applied++;
+    }
+
+    s_act.log_pos = pos;
+    if (applied) {
+        ESP_LOGI(TAG, "Log: %lu deltas reaplicados, overlay=%lu, seq=%lu",
+                 (unsigned long)applied, (unsigned long)s_ov_n, (unsigned long)s_act.seq);
+    }
+}
+
+static void load_active_bank(void)
+{
+    allow_hdr_t hdr[2];
+    bool ok[2] = { false, false };
+
+    for (int b = 0; b < 2; b++) {
+        ok[b] = esp_partition_read(s_part, bank_base(b), &hdr[b], sizeof(hdr[b])) == ESP_OK &&
+                hdr_valid(&hdr[b]);
+    }
+
+    // Primero el de generación más alta; si su CRC falla, el otro
+    int order[2] = { 0, 1 };
+    if (ok[0] && ok[1] && hdr[1].gen > hdr[0].gen) { order[0] = 1; order[1] = 0; }
+
+    for (int i = 0; i < 2; i++) {
+        int b = order[i];
+        if (!ok[b]) continue;
+
+        esp_err_t err = map_bank(b, &hdr[b], &s_act.recs, &s_act.map);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Banco %d descartado: %s", b, esp_err_to_name(err));
+            continue;
+        }
+
+        s_act.bank   = b;
+        s_act.hdr    = hdr[b];
+        s_act.mapped = true;
+        s_act.seq    = hdr[b].seq;
+        replay_log();
+
+        ESP_LOGI(TAG, "Banco %d activo: %lu registros, seq=%lu, gen=%lu",
+                 b, (unsigned long)hdr[b].count, (unsigned long)s_act.seq,
+                 (unsigned long)hdr[b].gen);
+        return;
+    }
+
+    ESP_LOGW(TAG, "Sin allowlist en flash, todas las credenciales van al servidor");
+}
+
+// ================== SNAPSHOT (streaming al banco inactivo) ==================
+//
+// El cuerpo llega en orden: cabecera (32 B, se guarda en RAM) y registros
+// (directos a flash, borrando sector a sector según hace falta). La cabecera
+// se escribe en flash la última: un snapshot cortado nunca queda válido.
+
+static struct {
+    bool        active;
+    int         bank;
+    size_t      total;
+    size_t      next;      // siguiente offset esperado
+    uint32_t    erased;    // bytes de registros ya borrados
+    uint32_t    crc;
+    allow_hdr_t hdr;
+} s_snap = {0};
+
+static esp_err_t snap_begin(size_t total_len, void *ctx)
+{
+    (void)ctx;
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+
+    if (total_len < sizeof(allow_hdr_t) ||
+        (total_len - sizeof(allow_hdr_t)) % sizeof(allow_rec_t) != 0 ||
+        total_len - sizeof(allow_hdr_t) > REC_AREA_MAX) {
+        ESP_LOGW(TAG, "Snapshot de %u bytes no valido", (unsigned)total_len);
+        s_stats.rejected++;
+        publish_result("snapshot", false, "size");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int bank = s_act.bank < 0 ? 0 : 1 - s_act.bank;
+
+    // Cabecera y log del destino fuera antes de tocar nada más
+    esp_err_t err = esp_partition_erase_range(s_part, bank_base(bank), ALLOW_HDR_SECTOR);
+    if (err == ESP_OK) {
+        err = esp_partition_erase_range(s_part, log_base(bank), ALLOWLIST_DELTA_SZ);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error borrando banco %d: %s", bank, esp_err_to_name(err));
+        publish_result("snapshot", false, "flash");
+        return err;
+    }
+
+    memset(&s_snap, 0, sizeof(s_snap));
+    s_snap.active = true;
+    s_snap.bank   = bank;
+    s_snap.total  = total_len;
+
+    ESP_LOGI(TAG, "Snapshot: %u bytes -> banco %d", (unsigned)total_len, bank);
+    return ESP_OK;
+}
+
+static esp_err_t snap_write(const void *data, size_t len, size_t offset, void *ctx)
+{
+    (void)ctx;
+    if (!s_snap.active || offset != s_snap.next || offset + len > s_snap.total) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint8_t *p = (const uint8_t *)data;
+
+    // Cabecera: a RAM
+    if (offset < sizeof(allow_hdr_t)) {
+        size_t n = sizeof(allow_hdr_t) - offset;
+        if (n > len) n = len;
+        memcpy((uint8_t *)&s_snap.hdr + offset, p, n);
+        p += n; len -= n; offset += n;
+        s_snap.next = offset;
+    }
+    if (len == 0) return ESP_OK;
+
+    // Registros: a flash
+    uint32_t rel = (uint32_t)(offset - sizeof(allow_hdr_t));
+    uint32_t end = rel + (uint32_t)len;
+    uint32_t rec_base = bank_base(s_snap.bank) + ALLOW_HDR_SECTOR;
+
+    if (end > s_snap.erased) {
+        uint32_t upto = (end + SECTOR_SZ - 1) & ~(SECTOR_SZ - 1);
+        esp_err_t err = esp_partition_erase_range(s_part, rec_base + s_snap.erased,
+                                                  upto - s_snap.erased);
+        if (err != ESP_OK) return err;
+        s_snap.erased = upto;
+    }
+
+    esp_err_t err = esp_partition_write(s_part, rec_base + rel, p, len);
+    if (err != ESP_OK) return err;
+
+    s_snap.crc  = esp_rom_crc32_le(s_snap.crc, p, (uint32_t)len);
+    s_snap.next = offset + len;
+    return ESP_OK;
+}
+
+// Activa el banco recién escrito (ya con cabecera en flash)
+static void swap_to_bank(int bank, const allow_hdr_t *hdr,
+                         const allow_rec_t *recs, esp_partition_mmap_handle_t map)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    bool                        old_mapped = s_act.mapped;
+    esp_partition_mmap_handle_t old_map    = s_act.map;
+
+    s_act.bank    = bank;
+    s_act.hdr     = *hdr;
+    s_act.recs    = recs;
+    s_act.map     = map;
+    s_act.mapped  = true;
+    s_act.seq     = hdr->seq;
+    s_act.log_pos = 0;
+    s_ov_n        = 0;
+    xSemaphoreGive(s_mutex);
+
+    // Nadie lee el banco viejo: el check se hace con el mutex tomado
+    if (old_mapped) esp_partition_munmap(old_map);
+}
+
+static esp_err_t snap_end(bool complete, void *ctx)
+{
+    (void)ctx;
+    if (!s_snap.active) return ESP_ERR_INVALID_STATE;
+    s_snap.active = false;
+
+    const char *reason = NULL;
+    allow_hdr_t h = s_snap.hdr;
+
+    if (!complete || s_snap.next != s_snap.total)                 reason = "incomplete";
+    else if (!hdr_valid(&h) ||
+             h.count * sizeof(allow_rec_t) != s_snap.total - sizeof(allow_hdr_t)) reason = "header";
+    else if (h.crc32 != s_snap.crc)                               reason = "crc";
+
+    const allow_rec_t *recs = NULL;
+    esp_partition_mmap_handle_t map = 0;
+
+    if (!reason) {
+        // Releer desde la caché de flash: valida también lo escrito
+        if (map_bank(s_snap.bank, &h, &recs, &map) != ESP_OK) reason = "flash";
+    }
+    if (!reason) {
+        for (uint32_t i = 1; i < h.count; i++) {
+            if (KEY_H56(recs[i - 1].key) >= KEY_H56(recs[i].key)) {
+                reason = "order";
+                esp_partition_munmap(map);
+                break;
+            }
+        }
+    }
+
+    if (!reason) {
+        h.gen = (s_act.bank >= 0 ? s_act.hdr.gen : 0) + 1;
+        if (esp_partition_write(s_part, bank_base(s_snap.bank), &h, sizeof(h)) != ESP_OK) {
+            esp_partition_munmap(map);
+            reason = "flash";
+        }
+    }
+
+    if (reason) {
+        ESP_LOGW(TAG, "Snapshot rechazado: %s", reason);
+        s_stats.rejected++;
+        publish_result("snapshot", false, reason);
+        return ESP_FAIL;
+    }
+
+    swap_to_bank(s_snap.bank, &h, recs, map);
+    s_stats.snapshots++;
+
+    ESP_LOGI(TAG, "Snapshot activo en banco %d: %lu registros, seq=%lu",
+             s_snap.bank, (unsigned long)h.count, (unsigned long)h.seq);
+    publish_result("snapshot", true, "ok");
+    return ESP_OK;
+}
+
+static const mqtt_stream_sink_t s_snap_sink = {
+    .begin = snap_begin,
+    .write = snap_write,
+    .end   = snap_end,
+};
+
+// ================== DELTAS ==================
+
+static void handle_delta(const void *data, int len)
+{
+    const char *reason = NULL;
+    allow_delta_hdr_t dh;
+
+    if (len < (int)sizeof(dh)) {
+        reason = "size";
+    } else {
+        // count viene de fuera: se compara con lo que cabe en len, sin
+        // multiplicarlo (en 32 bits count * 24 da la vuelta)
+        size_t body = (size_t)len - sizeof(dh);
+        memcpy(&dh, data, sizeof(dh));
+        if (dh.magic != ALLOW_DELTA_MAGIC ||
+            body % sizeof(allow_delta_op_t) != 0 ||
+            dh.count != body / sizeof(allow_delta_op_t)) {
+            reason = "format";
+        }
+    }
+
+    // El log sólo lo escribe esta task (MQTT): el mutex protege el overlay
+    if (!reason && s_act.bank < 0)                          reason = "needSnapshot";
+    if (!reason && dh.base_seq != s_act.seq)                reason = "needSnapshot";
+
+    const allow_delta_op_t *ops = (const allow_delta_op_t *)((const uint8_t *)data + sizeof(dh));
+    uint32_t need = 0;
+
+    if (!reason) {
+        for (uint32_t i = 0; i < dh.count; i++) {
+            if (ops[i].op != ALLOW_OP_PUT && ops[i].op != ALLOW_OP_DEL) {
+                reason = "format";
+                break;
+            }
+        }
+    }
+    if (!reason) {
+        // Sin compactación en el dispositivo: log u overlay llenos -> que el
+        // servidor mande un snapshot nuevo. El tope va antes de multiplicar.
+        if (dh.count >= ALLOWLIST_DELTA_SZ / LOG_ENT_SZ) {
+            reason = "needSnapshot";
+        }
+    }
+    if (!reason) {
+        need = (dh.count + 1) * LOG_ENT_SZ;
+        if (s_act.log_pos + need > ALLOWLIST_DELTA_SZ ||
+            s_ov_n + overlay_new_keys(ops, dh.count) > ALLOWLIST_OVERLAY_MAX) {
+            reason = "needSnapshot";
+        }
+    }
+
+    if (reason) {
+        ESP_LOGW(TAG, "Delta %lu->%lu rechazado: %s (seq actual %lu)",
+                 (unsigned long)(len >= (int)sizeof(dh) ? dh.base_seq : 0),
+                 (unsigned long)(len >= (int)sizeof(dh) ? dh.new_seq : 0),
+                 reason, (unsigned long)s_act.seq);
+        s_stats.rejected++;
+        publish_result("delta", false, reason);
+        return;
+    }
+
+    // Log primero (con COMMIT al final), overlay después
+    uint32_t base = log_base(s_act.bank) + s_act.log_pos;
+    allow_log_ent_t e;
+
+    for (uint32_t i = 0; i <= dh.count; i++) {
+        memset(&e, 0, sizeof(e));
+        e.seq = dh.new_seq;
+        if (i < dh.count) {
+            e.op  = ops[i].op;
+            memcpy(&e.rec, &ops[i].rec, sizeof(e.rec));
+        } else {
+            e.op = ALLOW_OP_COMMIT;
+        }
+        e.crc = log_ent_crc(&e);
+
+        if (esp_partition_write(s_part, base + i * LOG_ENT_SZ, &e, sizeof(e)) != ESP_OK) {
+            // Lo escrito sin COMMIT se ignora al arrancar; el hueco se salta
+            s_act.log_pos += (i + 1) * LOG_ENT_SZ;
+            s_stats.rejected++;
+            publish_result("delta", false, "flash");
+            return;
+        }
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < dh.count; i++) {
+        allow_rec_t rec;
+        memcpy(&rec, &ops[i].rec, sizeof(rec));
+        overlay_apply(ops[i].op, &rec);
+    }
+    s_act.seq      = dh.new_seq;
+    s_act.log_pos += need;
+    xSemaphoreGive(s_mutex);
+
+    s_stats.deltas++;
+    ESP_LOGI(TAG, "Delta %lu->%lu: %lu cambios, overlay=%lu",
+             (unsigned long)dh.base_seq, (unsigned long)dh.new_seq,
+             (unsigned long)dh.count, (unsigned long)s_ov_n);
+    publish_result("delta", true, "ok");
+}
+
+// Un delta que no cabe en el arena tampoco cabría en el overlay
+static esp_err_t delta_begin(size_t total_len, void *ctx)
+{
+    (void)ctx;
+    ESP_LOGW(TAG, "Delta de %u bytes demasiado grande", (unsigned)total_len);
+    s_stats.rejected++;
+    publish_result("delta", false, "needSnapshot");
+    return ESP_ERR_INVALID_SIZE;
+}
+
+static esp_err_t delta_write(const void *data, size_t len, size_t offset, void *ctx)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+static const mqtt_stream_sink_t s_delta_sink = {
+    .begin = delta_begin,
+    .write = delta_write,
+};
+
+// ================== MQTT ==================
+
+static bool topic_is(const char *topic, int topic_len, const char *want)
+{
+    return want[0] && topic_len == (int)strlen(want) && memcmp(topic, want, topic_len) == 0;
+}
+
+bool allowlist_handle_message(const char *topic, int topic_len,
+                              const void *data, int len)
+{
+    if (topic_is(topic, topic_len, s_delta_topic)) {
+        handle_delta(data, len);
+        return true;
+    }
+
+    if (topic_is(topic, topic_len, s_snap_topic)) {
+        // Snapshot pequeño (cabe en el arena): mismo camino que el streaming
+        if (snap_begin((size_t)len, NULL) == ESP_OK) {
+            if (snap_write(data, (size_t)len, 0, NULL) != ESP_OK) {
+                snap_end(false, NULL);
+            } else {
+                snap_end(true, NULL);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static void allowlist_register_mqtt(void)
+{
+    snprintf(s_snap_topic,  sizeof(s_snap_topic),  "%s/allow/snap",  topic_cmd);
+    snprintf(s_delta_topic, sizeof(s_delta_topic), "%s/allow/delta", topic_cmd);
+
+    // Con sink registrado el topic queda suscrito al conectar
+    mqtt_reasm_register_sink(s_snap_topic,  &s_snap_sink);
+    mqtt_reasm_register_sink(s_delta_topic, &s_delta_sink);
+}
+
+// ================== INIT / STATUS ==================
+
+esp_err_t allowlist_init(void)
+{
+    if (s_mutex) return ESP_OK;
+
+    if (!s_ov) {
+        s_ov = mem_place_alloc("allow_overlay", ALLOWLIST_OVERLAY_MAX * sizeof(overlay_ent_t),
+                               MEM_COLD);
+        if (!s_ov) return ESP_ERR_NO_MEM;
+    }
+
+    s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex) return ESP_ERR_NO_MEM;
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      STORAGE_PARTITION_LABEL);
+    if (!s_part || s_part->size < 2 * ALLOWLIST_BANK_SZ) {
+        ESP_LOGE(TAG, "Particion '%s' no encontrada o pequeña", STORAGE_PARTITION_LABEL);
+        s_part = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    load_active_bank();
+    allowlist_register_mqtt();
+    return ESP_OK;
+}
+
+void allowlist_add_to_json(cJSON *root)
+{
+    if (!s_mutex) return;
+
+    cJSON *o = cJSON_CreateObject();
+    if (!o) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    cJSON_AddNumberToObject(o, "seq",     s_act.seq);
+    cJSON_AddNumberToObject(o, "count",   s_act.bank >= 0 ? s_act.hdr.count : 0);
+    cJSON_AddNumberToObject(o, "overlay", s_ov_n);
+    cJSON_AddNumberToObject(o, "hits",    s_stats.hits);
+    cJSON_AddNumberToObject(o, "miss",    s_stats.miss);
+    cJSON_AddNumberToObject(o, "snaps",   s_stats.snapshots);
+    cJSON_AddNumberToObject(o, "deltas",  s_stats.deltas);
+    cJSON_AddNumberToObject(o, "rejected", s_stats.rejected);
+    xSemaphoreGive(s_mutex);
+
+    cJSON_AddStringToObject(o, "mode", allowlist_mode_name(g_app_config.allowlist_mode));
+    cJSON_AddItemToObject(root, "allow", o);
+}
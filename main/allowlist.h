@@ -0,0 +1,137 @@
+// allowlist.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "cJSON.h"
+#include "access_tracker.h"
+
+// Lista local de credenciales autorizadas en la partición "storage".
+//
+// Dos bancos A/B de ALLOWLIST_BANK_SZ. Cada banco:
+//
+//   [0, 4K)                     cabecera allow_hdr_t (se escribe la última)
+//   [4K, 4K + count*16)         registros allow_rec_t ordenados por clave
+//   [BANK_SZ - DELTA_SZ, BANK)  log de deltas (allow_log_ent_t, append-only)
+//
+// Los registros se leen con esp_partition_mmap: la búsqueda binaria va
+// directa a la caché de flash, sin copias. Los deltas se aplican sobre un
+// overlay en RAM que se reconstruye desde el log al arrancar.
+//
+// La clave de cada registro es allowlist_key56(): el hash lleva el origen de
+// la credencial ("R:" tarjeta, "Q:" QR), así un QR que contenga el UID de
+// una tarjeta no hereda su permiso.
+//
+// Por MQTT (ver tools/allowlist_build.py):
+//   <topic_cmd>/allow/snap   fichero snapshot: allow_hdr_t + registros
+//   <topic_cmd>/allow/delta  allow_delta_hdr_t + allow_delta_op_t[count]
+//
+// Todo little endian. CRC-32 = esp_rom_crc32_le(0, ...) (el de zlib).
+
+#define ALLOW_MAGIC        0x31574C41u   // "ALW1"
+#define ALLOW_DELTA_MAGIC  0x31444C41u   // "ALD1"
+#define ALLOW_VERSION      2             // 2: origen dentro del hash
+#define ALLOW_HDR_SECTOR   4096
+
+// Permisos por carril (bit = access_lane_t)
+#define ALLOW_LANE_BIT(l)  (1u << (l))
+
+typedef struct __attribute__((packed)) {
+    uint64_t key;          // (key56 << 8) | máscara de carriles
+    uint32_t valid_from;   // Unix UTC, 0 = sin inicio
+    uint32_t valid_to;     // Unix UTC, 0 = sin fin
+} allow_rec_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rec_size;     // sizeof(allow_rec_t)
+    uint32_t count;
+    uint32_t seq;          // versión de la lista en el servidor
+    uint32_t crc32;        // de los registros
+    uint32_t gen;          // generación del banco (la pone el dispositivo)
+    uint32_t reserved[2];
+} allow_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t base_seq;     // seq sobre el que aplica
+    uint32_t new_seq;
+    uint32_t count;
+} allow_delta_hdr_t;
+
+typedef enum {
+    ALLOW_OP_PUT    = 1,
+    ALLOW_OP_DEL    = 2,
+    ALLOW_OP_COMMIT = 3,   // sólo en el log: cierra un delta completo
+} allow_op_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t     op;
+    uint8_t     pad[7];
+    allow_rec_t rec;
+} allow_delta_op_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t    seq;       // new_seq del delta; 0xFFFFFFFF = flash borrada
+    uint8_t     op;
+    uint8_t     pad[3];
+    allow_rec_t rec;
+    uint32_t    reserved;
+    uint32_t    crc;       // de los 28 bytes anteriores
+} allow_log_ent_t;
+
+typedef enum {
+    ALLOW_GRANTED = 0,
+    ALLOW_NOT_FOUND,
+    ALLOW_DENIED_LANE,
+    ALLOW_DENIED_WINDOW,
+    ALLOW_UNAVAILABLE,     // sin lista cargada o sin hora para la ventana
+} allow_result_t;
+
+// Modo de uso en el pipeline (app_config.allowlist_mode). GRANT es 0: una
+// config guardada antes de existir el campo lo lee así.
+typedef enum {
+    ALLOW_MODE_GRANT = 0,      // en lista -> abre; el resto consulta online
+    ALLOW_MODE_AUTHORITATIVE,  // también deniega en local lo que no está
+    ALLOW_MODE_OFF,
+    ALLOW_MODE_COUNT
+} allow_mode_t;
+
+// Origen de la credencial, mismo orden que cred_source_t
+typedef enum {
+    ALLOW_SRC_RFID = 0,
+    ALLOW_SRC_QR,
+    ALLOW_SRC_COUNT
+} allow_src_t;
+
+// Hash del cardId sin origen (índice del journal): FNV-1a 64 >> 8
+uint64_t allowlist_hash56(const char *id);
+
+// Clave de la allowlist: FNV-1a 64 de "R:" o "Q:" + id, >> 8
+uint64_t allowlist_key56(allow_src_t src, const char *id);
+
+// Búsqueda binaria en un array ordenado (flash mapeada o RAM)
+const allow_rec_t *allowlist_bsearch(const allow_rec_t *recs, uint32_t n, uint64_t h56);
+
+// Mapea el banco válido más reciente, reaplica su log de deltas y registra
+// los sinks de snapshot/delta (necesita topic_cmd)
+esp_err_t allowlist_init(void);
+
+// Mensajes completos que caben en el arena de reensamblado. true si era
+// un topic de la allowlist (consumido).
+bool allowlist_handle_message(const char *topic, int topic_len,
+                              const void *data, int len);
+
+allow_result_t allowlist_check(allow_src_t src, const char *id, access_lane_t lane,
+                               uint32_t now, allow_rec_t *out);
+
+const char *allowlist_result_name(allow_result_t r);
+const char *allowlist_mode_name(int mode);
+bool        allowlist_mode_from_name(const char *name, int *mode);
+
+// Objeto "allow" para status
+void allowlist_add_to_json(cJSON *root);
@@ -1,70 +1,426 @@
 // app_config.c
 
 #include "app_config.h"
+#include "config.h"
+#include "task_manifest.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include <stddef.h>
+#include <string.h>
 
 static const char *TAG = "APP_CFG";
 static const char *NVS_NAMESPACE = "app_cfg";
-static const int   CFG_VERSION   = 1;
+
+// Esquema en NVS:
+//   1  blob "cfg" con el app_config_t entero
+//   2  una clave por grupo de campos + "schema"
+static const int   CFG_VERSION   = 2;
+
+#define CFG_KEY_SCHEMA     "schema"
+#define CFG_KEY_V1_BLOB    "cfg"
+#define CFG_GROUP_MAX      16      // campos por grupo
+#define CFG_MAX_FLUSH_FNS  4
 
 app_config_t g_app_config = {0};
 
-void app_config_set_defaults(void)
+// ================== GRUPOS ==================
+
+// Cada grupo es una clave NVS con sus campos como int32 en orden. Los
+// campos nuevos van al final de su grupo: un blob más corto (firmware
+// anterior) deja los que faltan con su default, y de uno más largo
+// (firmware posterior tras un downgrade) se lee lo que se conoce.
+typedef struct {
+    size_t  off;
+    uint8_t size;      // bool, o int / uint32_t (4 bytes)
+} cfg_field_t;
+
+typedef struct {
+    const char        *key;
+    const cfg_field_t *fields;
+    int                n;
+} cfg_group_t;
+
+#define CFG_FIELD(m)    { offsetof(app_config_t, m), sizeof(((app_config_t *)0)->m) }
+#define CFG_GROUP(k, f) { k, f, (int)(sizeof(f) / sizeof(f[0])) }
+
+static const cfg_field_t s_readers_fields[] = {
+    CFG_FIELD(enable_cards), CFG_FIELD(enable_qr), CFG_FIELD(qr_baud),
+};
+static const cfg_field_t s_proto_fields[] = {
+    CFG_FIELD(payload_enc),
+};
+static const cfg_field_t s_access_fields[] = {
+    CFG_FIELD(ticket_court), CFG_FIELD(allowlist_mode),
+};
+
+static const cfg_field_t s_net_fields[] = {
+    CFG_FIELD(static_ip), CFG_FIELD(static_mask), CFG_FIELD(static_gw), CFG_FIELD(static_dns),
+};
+
+static const cfg_group_t s_groups[] = {
+    CFG_GROUP("readers", s_readers_fields),
+    CFG_GROUP("proto",   s_proto_fields),
+    CFG_GROUP("access",  s_access_fields),
+    CFG_GROUP("net",     s_net_fields),
+};
+#define CFG_N_GROUPS  (int)(sizeof(s_groups) / sizeof(s_groups[0]))
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "los campos int se guardan como int32");
+
+static int32_t field_get(const app_config_t *c, const cfg_field_t *f)
 {
-    g_app_config.version      = CFG_VERSION;
-    g_app_config.enable_cards = false;  // por defecto: tarjetas activas
-    g_app_config.enable_qr = true;
-    // otros defaults...
+    const uint8_t *p = (const uint8_t *)c + f->off;
+    if (f->size == sizeof(bool)) return *(const bool *)p ? 1 : 0;
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
 }
 
-esp_err_t app_config_load(void)
+static void field_set(app_config_t *c, const cfg_field_t *f, int32_t v)
 {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    uint8_t *p = (uint8_t *)c + f->off;
+    if (f->size == sizeof(bool)) *(bool *)p = (v != 0);
+    else memcpy(p, &v, sizeof(v));
+}
+
+static void group_pack(const app_config_t *c, const cfg_group_t *g, int32_t *out)
+{
+    for (int i = 0; i < g->n; i++) out[i] = field_get(c, &g->fields[i]);
+}
+
+static void group_load(nvs_handle_t h, const cfg_group_t *g, app_config_t *c)
+{
+    int32_t v[CFG_GROUP_MAX];
+    size_t len = sizeof(v);
+    esp_err_t err = nvs_get_blob(h, g->key, v, &len);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "No hay config en NVS, usando defaults");
-        app_config_set_defaults();
-        return ESP_OK;
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Grupo '%s' ilegible (%s), defaults", g->key, esp_err_to_name(err));
+        }
+        return;
     }
+    int n = (int)(len / sizeof(int32_t));
+    if (n > g->n) n = g->n;
+    for (int i = 0; i < n; i++) field_set(c, &g->fields[i], v[i]);
+}
 
-    size_t len = sizeof(g_app_config);
-    err = nvs_get_blob(h, "cfg", &g_app_config, &len);
-    nvs_close(h);
+static esp_err_t group_store_all(nvs_handle_t h, const app_config_t *c)
+{
+    for (int gi = 0; gi < CFG_N_GROUPS; gi++) {
+        int32_t v[CFG_GROUP_MAX];
+        group_pack(c, &s_groups[gi], v);
+        esp_err_t err = nvs_set_blob(h, s_groups[gi].key, v, s_groups[gi].n * sizeof(int32_t));
+        if (err != ESP_OK) return err;
+    }
+    return ESP_OK;
+}
+
+// ================== MIGRACIONES ==================
+
+// Formato del esquema 1. Los equipos más antiguos guardaron un prefijo
+// (campos añadidos después sin subir la versión): lo que no esté en el
+// blob se queda con su default.
+typedef struct {
+    bool enable_cards;
+    int  version;
+    bool enable_qr;
+    int  payload_enc;
+    int  qr_baud;
+    int  ticket_court;
+    int  allowlist_mode;
+} app_config_v1_t;
 
-    if (err == ESP_OK && g_app_config.version == CFG_VERSION) {
-        ESP_LOGI(TAG, "Config cargada de NVS (version %d)", g_app_config.version);
-        return ESP_OK;
+// El blob v1 sigue en NVS mientras un rollback pueda volver a un firmware
+// que sólo lee ese formato: se mantiene al día y se borra al validar la
+// imagen (app_config_drop_v1)
+static bool s_v1_kept = false;
+
+static void v1_pack(const app_config_t *c, app_config_v1_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->enable_cards   = c->enable_cards;
+    out->version        = 1;
+    out->enable_qr      = c->enable_qr;
+    out->payload_enc    = c->payload_enc;
+    out->qr_baud        = c->qr_baud;
+    out->ticket_court   = c->ticket_court;
+    out->allowlist_mode = c->allowlist_mode;
+}
+
+static esp_err_t migrate_v1_to_v2(nvs_handle_t h)
+{
+    app_config_v1_t old = {0};
+    size_t len = sizeof(old);
+    esp_err_t err = nvs_get_blob(h, CFG_KEY_V1_BLOB, &old, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_OK;
+    if (err != ESP_OK) return err;
+
+    if (old.version == 1) {
+        #define V1_HAS(m) (len >= offsetof(app_config_v1_t, m) + sizeof(old.m))
+        if (V1_HAS(enable_cards))   g_app_config.enable_cards   = old.enable_cards;
+        if (V1_HAS(enable_qr))      g_app_config.enable_qr      = old.enable_qr;
+        if (V1_HAS(payload_enc))    g_app_config.payload_enc    = old.payload_enc;
+        if (V1_HAS(qr_baud))        g_app_config.qr_baud        = old.qr_baud;
+        if (V1_HAS(ticket_court))   g_app_config.ticket_court   = old.ticket_court;
+        if (V1_HAS(allowlist_mode)) g_app_config.allowlist_mode = old.allowlist_mode;
+        #undef V1_HAS
+        ESP_LOGI(TAG, "Config v1 (%u bytes) migrada a grupos", (unsigned)len);
+    } else {
+        ESP_LOGW(TAG, "Blob v1 con version %d, se descarta", old.version);
     }
 
-    ESP_LOGW(TAG, "Config inexistente o version distinta, usando defaults");
-    app_config_set_defaults();
-    // guardamos defaults para que la próxima vez ya exista
-    app_config_save();
+    err = group_store_all(h, &g_app_config);
+    if (err != ESP_OK) return err;
+    s_v1_kept = true;
     return ESP_OK;
 }
 
-esp_err_t app_config_save(void)
+// s_migrations[v] pasa del esquema v al v + 1
+typedef esp_err_t (*cfg_migration_fn_t)(nvs_handle_t h);
+
+static const cfg_migration_fn_t s_migrations[] = {
+    [1] = migrate_v1_to_v2,
+};
+
+// ================== ESCRITURA DIFERIDA ==================
+
+static app_config_t          s_committed;     // lo que hay en NVS
+static SemaphoreHandle_t     s_flush_mutex = NULL;
+static TaskHandle_t          s_commit_task = NULL;
+static app_config_flush_fn_t s_flush_fns[CFG_MAX_FLUSH_FNS];
+static int                   s_n_flush_fns = 0;
+static uint32_t              s_requests = 0;  // peticiones desde el último commit
+
+// Sólo los grupos que difieren de lo guardado
+static esp_err_t flush_groups(void)
 {
+    app_config_t cur = g_app_config;   // la task de comandos puede seguir escribiendo
+    int32_t a[CFG_GROUP_MAX], b[CFG_GROUP_MAX];
+    bool dirty[CFG_N_GROUPS];
+    int n_dirty = 0;
+
+    for (int gi = 0; gi < CFG_N_GROUPS; gi++) {
+        group_pack(&cur, &s_groups[gi], a);
+        group_pack(&s_committed, &s_groups[gi], b);
+        dirty[gi] = memcmp(a, b, s_groups[gi].n * sizeof(int32_t)) != 0;
+        if (dirty[gi]) n_dirty++;
+    }
+    if (n_dirty == 0) return ESP_OK;
+
+    app_config_v1_t v1_cur, v1_old;
+    v1_pack(&cur, &v1_cur);
+    v1_pack(&s_committed, &v1_old);
+    bool v1_dirty = s_v1_kept && memcmp(&v1_cur, &v1_old, sizeof(v1_cur)) != 0;
+
     nvs_handle_t h;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "nvs_open error: %s", esp_err_to_name(err));
-        return err;
+    if (err != ESP_OK) return err;
+
+    // Antes que los grupos: si falla, no se escribe ninguno, s_committed
+    // no avanza y el siguiente commit lo reintenta todo
+    if (v1_dirty) err = nvs_set_blob(h, CFG_KEY_V1_BLOB, &v1_cur, sizeof(v1_cur));
+
+    for (int gi = 0; gi < CFG_N_GROUPS && err == ESP_OK; gi++) {
+        if (!dirty[gi]) continue;
+        group_pack(&cur, &s_groups[gi], a);
+        err = nvs_set_blob(h, s_groups[gi].key, a, s_groups[gi].n * sizeof(int32_t));
+        if (err == ESP_OK) {
+            // Se copia sólo este grupo: si falla otro, se reintenta él solo
+            for (int i = 0; i < s_groups[gi].n; i++) {
+                field_set(&s_committed, &s_groups[gi].fields[i], a[i]);
+            }
+        }
     }
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
 
-    g_app_config.version = CFG_VERSION;
-    err = nvs_set_blob(h, "cfg", &g_app_config, sizeof(g_app_config));
     if (err == ESP_OK) {
-        err = nvs_commit(h);
+        ESP_LOGI(TAG, "Config guardada: %d grupo(s)", n_dirty);
     }
-    nvs_close(h);
+    return err;
+}
+
+static esp_err_t flush_all(void)
+{
+    if (s_flush_mutex) xSemaphoreTake(s_flush_mutex, portMAX_DELAY);
+
+    uint32_t requests = s_requests;
+    s_requests = 0;
+
+    esp_err_t err = flush_groups();
+    for (int i = 0; i < s_n_flush_fns; i++) {
+        esp_err_t e = s_flush_fns[i]();
+        if (err == ESP_OK) err = e;
+    }
+
+    if (s_flush_mutex) xSemaphoreGive(s_flush_mutex);
 
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error guardando config: %s", esp_err_to_name(err));
+    } else if (requests > 1) {
+        ESP_LOGI(TAG, "%lu peticiones de guardado en un commit", (unsigned long)requests);
+    }
+    return err;
+}
+
+static void commit_task(void *pv)
+{
+    (void)pv;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Cada petición nueva alarga la espera, con tope desde la primera
+        int64_t first = esp_timer_get_time();
+        while (esp_timer_get_time() - first < (int64_t)APP_CFG_COMMIT_MAX_MS * 1000 &&
+               ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(APP_CFG_COMMIT_DELAY_MS)) > 0) {
+        }
+
+        flush_all();
+    }
+}
+
+void app_config_register_flush(app_config_flush_fn_t fn)
+{
+    if (fn && s_n_flush_fns < CFG_MAX_FLUSH_FNS) s_flush_fns[s_n_flush_fns++] = fn;
+}
+
+void app_config_schedule_commit(void)
+{
+    s_requests++;
+    if (s_commit_task) {
+        xTaskNotifyGive(s_commit_task);
     } else {
-        ESP_LOGI(TAG, "Config guardada en NVS");
+        // Antes de arrancar la task (o si no se pudo crear): directo
+        flush_all();
     }
+}
+
+esp_err_t app_config_flush_now(void)
+{
+    return flush_all();
+}
+
+// ================== API ==================
+
+void app_config_set_defaults(void)
+{
+    g_app_config.version      = CFG_VERSION;
+    g_app_config.enable_cards = false;  // por defecto: tarjetas activas
+    g_app_config.enable_qr = true;
+    g_app_config.payload_enc = 0;       // JSON hasta que el servidor negocie CBOR
+    g_app_config.qr_baud = GM861S_BAUD_FAST;
+    g_app_config.ticket_court = 0;
+    g_app_config.allowlist_mode = 0;    // ALLOW_MODE_GRANT: sólo abre en local
+    g_app_config.static_ip = 0;         // DHCP
+    g_app_config.static_mask = 0;
+    g_app_config.static_gw = 0;
+    g_app_config.static_dns = 0;
+    // otros defaults...
+}
+
+static void load_from_nvs(void)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "nvs_open: %s, usando defaults", esp_err_to_name(err));
+        return;
+    }
+
+    uint32_t schema = 0;
+    if (nvs_get_u32(h, CFG_KEY_SCHEMA, &schema) != ESP_OK) {
+        // Sin clave de esquema: o es la v1 (blob único) o un equipo nuevo
+        size_t len = 0;
+        schema = (nvs_get_blob(h, CFG_KEY_V1_BLOB, NULL, &len) == ESP_OK) ? 1 : CFG_VERSION;
+        if (schema == CFG_VERSION) {
+            ESP_LOGI(TAG, "Sin config en NVS, usando defaults");
+            nvs_set_u32(h, CFG_KEY_SCHEMA, schema);
+            nvs_commit(h);
+        }
+    }
+
+    // Migraciones paso a paso. Si una falla se arranca con lo que haya en
+    // RAM y se reintenta en el próximo arranque: no se pierde nada.
+    while (schema < (uint32_t)CFG_VERSION) {
+        cfg_migration_fn_t fn = schema < sizeof(s_migrations) / sizeof(s_migrations[0])
+                                ? s_migrations[schema] : NULL;
+        err = fn ? fn(h) : ESP_ERR_NOT_SUPPORTED;
+        if (err == ESP_OK) err = nvs_set_u32(h, CFG_KEY_SCHEMA, schema + 1);
+        if (err == ESP_OK) err = nvs_commit(h);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Migracion v%lu -> v%lu fallida: %s", (unsigned long)schema,
+                     (unsigned long)schema + 1, esp_err_to_name(err));
+            break;
+        }
+        schema++;
+    }
+
+    if (schema > (uint32_t)CFG_VERSION) {
+        ESP_LOGW(TAG, "Esquema %lu mas nuevo que el firmware (%d): se lee lo conocido",
+                 (unsigned long)schema, CFG_VERSION);
+    }
+    if (schema >= (uint32_t)CFG_VERSION) {
+        // Migrada en un arranque anterior que aún no se ha validado
+        size_t len = 0;
+        s_v1_kept = nvs_get_blob(h, CFG_KEY_V1_BLOB, NULL, &len) == ESP_OK;
+
+        for (int gi = 0; gi < CFG_N_GROUPS; gi++) group_load(h, &s_groups[gi], &g_app_config);
+        ESP_LOGI(TAG, "Config cargada de NVS (esquema %lu)", (unsigned long)schema);
+    }
+    nvs_close(h);
+}
+
+esp_err_t app_config_load(void)
+{
+    app_config_set_defaults();
+    load_from_nvs();
+    g_app_config.version = CFG_VERSION;
+    s_committed = g_app_config;
+
+    if (!s_flush_mutex) s_flush_mutex = xSemaphoreCreateMutex();
+    if (!s_commit_task &&
+        task_manifest_create(TASK_CFG_COMMIT, commit_task, NULL, &s_commit_task) != pdPASS) {
+        s_commit_task = NULL;
+        ESP_LOGW(TAG, "Sin task de commit: la config se guardara al momento");
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_config_drop_v1(void)
+{
+    if (s_flush_mutex) xSemaphoreTake(s_flush_mutex, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    if (s_v1_kept) {
+        nvs_handle_t h;
+        err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+        if (err == ESP_OK) {
+            err = nvs_erase_key(h, CFG_KEY_V1_BLOB);
+            if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+            if (err == ESP_OK) err = nvs_commit(h);
+            nvs_close(h);
+        }
+        if (err == ESP_OK) {
+            s_v1_kept = false;
+            ESP_LOGI(TAG, "Imagen validada: copia v1 de la config borrada");
+        } else {
+            ESP_LOGW(TAG, "No se pudo borrar la copia v1: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (s_flush_mutex) xSemaphoreGive(s_flush_mutex);
     return err;
 }
+
+esp_err_t app_config_save(void)
+{
+    g_app_config.version = CFG_VERSION;
+    app_config_schedule_commit();
+    return ESP_OK;
+}
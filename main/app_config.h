@@ -2,19 +2,53 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 typedef struct {
     bool enable_cards;      // habilitar lector RC522
-    int  version;           // para futuras migraciones de config
+    int  version;           // versión del esquema en NVS (CFG_VERSION)
     bool enable_qr;
-    // aquí puedes ir añadiendo cosas por dispositivo:
+    int  payload_enc;       // payload_enc_t: 0 = JSON (legacy), 1 = CBOR
+    int  qr_baud;           // baud del enlace con el GM861S (verificado)
+    int  ticket_court;      // pista aceptada en tickets QR offline (0 = todas)
+    int  allowlist_mode;    // allow_mode_t: 0 = grant, 1 = authoritative, 2 = off
+    // IP fija (orden de red, esp_ip4_addr_t.addr); static_ip = 0 -> DHCP
+    uint32_t static_ip;
+    uint32_t static_mask;
+    uint32_t static_gw;
+    uint32_t static_dns;
+    // aquí puedes ir añadiendo cosas por dispositivo (y en un grupo de
+    // app_config.c para que se guarde):
     // int  sitio_id;
     // char zona[32];
 } app_config_t;
 
 extern app_config_t g_app_config;
 
+// Carga la config por grupos, migra formatos antiguos y arranca la task
+// que escribe en diferido. Va justo después de nvs_flash_init.
 esp_err_t app_config_load(void);
+
+// Pide guardar g_app_config. No toca la flash: los grupos que hayan
+// cambiado se escriben juntos APP_CFG_COMMIT_DELAY_MS después de la
+// última petición (una ráfaga de setConfig = una escritura).
 esp_err_t app_config_save(void);
+
+// Escribe ya todo lo pendiente (antes de esp_restart)
+esp_err_t app_config_flush_now(void);
+
 void      app_config_set_defaults(void);
+
+// La config migrada del esquema 1 conserva también su blob v1 (al día con
+// cada guardado) por si el bootloader vuelve al firmware anterior. Se borra
+// cuando la imagen ya no puede volver atrás: tras
+// esp_ota_mark_app_valid_cancel_rollback o en un arranque ya validado.
+esp_err_t app_config_drop_v1(void);
+
+// Otros módulos con estado en NVS se enganchan a la misma escritura
+// diferida: su flush se llama en cada commit, y piden uno con
+// app_config_schedule_commit()
+typedef esp_err_t (*app_config_flush_fn_t)(void);
+void app_config_register_flush(app_config_flush_fn_t fn);
+void app_config_schedule_commit(void);
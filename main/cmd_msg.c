@@ -0,0 +1,59 @@
+// cmd_msg.c
+
+#include "cmd_msg.h"
+#include "mem_place.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// "12" o 12: el servidor manda ambos
+static int json_int(const cJSON *it)
+{
+    if (cJSON_IsString(it) && it->valuestring) return atoi(it->valuestring);
+    if (cJSON_IsNumber(it)) return it->valueint;
+    return 0;
+}
+
+static void json_str(const cJSON *it, char *out, size_t sz)
+{
+    if (cJSON_IsString(it) && it->valuestring) {
+        strncpy(out, it->valuestring, sz - 1);
+        out[sz - 1] = '\0';
+    }
+}
+
+bool cmd_msg_from_json(const cJSON *root, const char *data, size_t len, command_t *cmd)
+{
+    memset(cmd, 0, sizeof(*cmd));
+
+    json_str(cJSON_GetObjectItem(root, "action"), cmd->action, sizeof(cmd->action));
+    cmd->pin      = json_int(cJSON_GetObjectItem(root, "pin"));
+    cmd->estat    = json_int(cJSON_GetObjectItem(root, "estat"));
+    cmd->id_pista = json_int(cJSON_GetObjectItem(root, "idPista"));
+
+    strcpy(cmd->id_peticion, "-");
+    json_str(cJSON_GetObjectItem(root, "idPeticion"), cmd->id_peticion, sizeof(cmd->id_peticion));
+    json_str(cJSON_GetObjectItem(root, "result"), cmd->result, sizeof(cmd->result));
+    json_str(cJSON_GetObjectItem(root, "type"), cmd->type, sizeof(cmd->type));
+
+    // Mensaje entero, sin recortar: writeCard con varias tarjetas o un
+    // setConfig con qrZones pasan de sobra de cualquier tamaño fijo
+    cmd->payload = mem_cold_calloc(1, len + 1);
+    if (!cmd->payload) return false;
+    memcpy(cmd->payload, data, len);
+    cmd->payload_len = len;
+    return true;
+}
+
+cJSON *cmd_msg_parse(const command_t *cmd)
+{
+    if (!cmd->payload) return NULL;
+    return cJSON_ParseWithLength(cmd->payload, cmd->payload_len);
+}
+
+void cmd_msg_free(command_t *cmd)
+{
+    free(cmd->payload);
+    cmd->payload = NULL;
+    cmd->payload_len = 0;
+}
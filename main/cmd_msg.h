@@ -0,0 +1,21 @@
+// cmd_msg.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cJSON.h"
+#include "core.h"
+
+// Comando JSON recibido por MQTT -> command_t para cmd_queue. Los campos
+// planos se copian al struct; el mensaje entero va en cmd->payload (bloque
+// del heap terminado en '\0') para los comandos que leen más campos
+// (setConfig, writeCard, getJournal). false si no hay memoria.
+bool cmd_msg_from_json(const cJSON *root, const char *data, size_t len, command_t *cmd);
+
+// JSON del payload; NULL si el comando no lo trae (CBOR, acciones internas)
+cJSON *cmd_msg_parse(const command_t *cmd);
+
+// Lo llama quien saca el comando de cmd_queue, tras atenderlo (o quien no
+// llega a encolarlo)
+void cmd_msg_free(command_t *cmd);
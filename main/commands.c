@@ -1,6 +1,7 @@
 // commands.c
 
 #include "commands.h"
+#include "cmd_msg.h"
 #include "config.h"
 #include "core.h"
 #include "mqtt_manager.h"
@@ -11,7 +12,20 @@
 #include "esp_log.h"
 #include "cJSON.h"
 #include "rc522_reader.h"
+#include "gm861s_reader.h"
+#include "qr_ticket.h"
+#include "allowlist.h"
+#include "journal.h"
+#include "dlog.h"
+#include "params.h"
+#include "wifi_manager.h"
+#include "wifi_select.h"
 #include "app_config.h"
+#include "payload_codec.h"
+#include "access_tracker.h"
+#include "task_manifest.h"
+#include "sysmon.h"
+#include "esp_timer.h"
 
 #include <string.h>
 #include <stdbool.h>
@@ -41,16 +55,86 @@ static void gpio_init_if_needed(int gpio_num)
     initialized[gpio_num] = true;
 }
 
+// Toda salida a relé queda en el journal: gpio y duración (0 = nivel fijo)
+static void journal_relay(int gpio, int ms, int level)
+{
+    journal_log(JR_ACTUATION, -1, 0, (uint8_t)level,
+                ((uint32_t)gpio << 16) | ((uint32_t)ms & 0xFFFF), NULL, NULL);
+}
+
 static void pulsar_gpio_blocking(int gpio, int ms, bool invertido)
 {
+    journal_relay(gpio, ms, 1);
     gpio_init_if_needed(gpio);
     gpio_set_level(gpio, invertido ? 0 : 1);
     vTaskDelay(pdMS_TO_TICKS(ms));
     gpio_set_level(gpio, invertido ? 1 : 0);
 }
 
+// Pulso sin bloquear la tarea de comandos: el flanco de bajada lo pone un
+// esp_timer, así un hasAccess de OUT no espera los 2 s del torno IN.
+#define ASYNC_PULSE_SLOTS 4
+
+typedef struct {
+    int  gpio;
+    bool invertido;
+    esp_timer_handle_t timer;
+} async_pulse_t;
+
+static async_pulse_t s_async_pulses[ASYNC_PULSE_SLOTS];
+
+static void async_pulse_off_cb(void *arg)
+{
+    async_pulse_t *p = (async_pulse_t *)arg;
+    gpio_set_level(p->gpio, p->invertido ? 1 : 0);
+}
+
+static void pulsar_gpio_async(int gpio, int ms, bool invertido)
+{
+    async_pulse_t *slot = NULL;
+
+    for (int i = 0; i < ASYNC_PULSE_SLOTS; i++) {
+        if (s_async_pulses[i].timer && s_async_pulses[i].gpio == gpio) {
+            slot = &s_async_pulses[i];
+            break;
+        }
+        if (!slot && !s_async_pulses[i].timer) {
+            slot = &s_async_pulses[i];
+        }
+    }
+
+    if (!slot) {
+        ESP_LOGW(TAG, "Sin hueco de pulso async para GPIO %d, pulso bloqueante", gpio);
+        pulsar_gpio_blocking(gpio, ms, invertido);
+        return;
+    }
+
+    if (!slot->timer) {
+        slot->gpio = gpio;
+        const esp_timer_create_args_t args = {
+            .callback = async_pulse_off_cb,
+            .arg      = slot,
+            .name     = "pulse_off",
+        };
+        if (esp_timer_create(&args, &slot->timer) != ESP_OK) {
+            slot->timer = NULL;
+            pulsar_gpio_blocking(gpio, ms, invertido);
+            return;
+        }
+    }
+
+    // Un nuevo acceso en el mismo torno alarga el pulso en curso
+    esp_timer_stop(slot->timer);
+    slot->invertido = invertido;
+    gpio_init_if_needed(gpio);
+    gpio_set_level(gpio, invertido ? 0 : 1);
+    esp_timer_start_once(slot->timer, (uint64_t)ms * 1000);
+    journal_relay(gpio, ms, 1);
+}
+
 static void interruptor_gpio_set(int gpio, int estado, bool inverso)
 {
+    journal_relay(gpio, 0, estado);
     gpio_init_if_needed(gpio);
     int enc = inverso ? 0 : 1;
     int off = inverso ? 1 : 0;
@@ -87,6 +171,83 @@ static void publish_resp(const command_t *cmd,
     (void) mqtt_enqueue(TOPIC_RESP_FIXED, payload, 0, 0);
 }
 
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Hex exacto de n bytes -> out. false si la longitud o algún dígito no cuadra.
+static bool hex_decode(const char *hex, uint8_t *out, size_t n)
+{
+    if (!hex || strlen(hex) != n * 2) return false;
+    for (size_t i = 0; i < n; i++) {
+        int hi = hex_nibble(hex[2 * i]), lo = hex_nibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
+// Abre el torno del carril o pita si se deniega. La usan hasAccess (decisión
+// del servidor) y accessLocal (decisión offline de un ticket QR).
+static void apply_access_decision(bool access_ok, const char *type)
+{
+    if (access_ok) {
+        // ✅ Acceso concedido → abrir torno
+        if (strcmp(type, "IN") == 0) {
+            ESP_LOGI(TAG, "Acceso OK (IN), abriendo entrada");
+            pulsar_gpio_async(TORN_IN_PIN, params_get(PARAM_TURNSTILE_MS),
+                              params_get_bool(PARAM_INV_ENTRY));
+        } else if (strcmp(type, "OUT") == 0) {
+            ESP_LOGI(TAG, "Acceso OK (OUT), abriendo salida");
+            pulsar_gpio_async(TORN_OUT_PIN, params_get(PARAM_TURNSTILE_MS),
+                              params_get_bool(PARAM_INV_ENTRY));
+        } else {
+            ESP_LOGW(TAG, "Acceso con type desconocido: %s", type);
+        }
+    } else {
+        // ❌ Acceso denegado → activar pito en GPIO 21
+        ESP_LOGI(TAG, "Acceso denegado, activando pito en GPIO 21");
+
+        // Un pitido doble cortito, por ejemplo
+        int beep_ms = params_get(PARAM_BEEP_MS);
+        pulsar_gpio_blocking(PITO_DENEGADO_PIN, beep_ms, false);
+        vTaskDelay(pdMS_TO_TICKS(100));
+        pulsar_gpio_blocking(PITO_DENEGADO_PIN, beep_ms, false);
+    }
+}
+
+bool commands_post_local_access(bool access_ok, const char *type, const char *ref)
+{
+    if (!cmd_queue) return false;
+
+    command_t cmd = {0};
+    strncpy(cmd.action, COMMANDS_LOCAL_ACCESS, sizeof(cmd.action) - 1);
+    strncpy(cmd.type, type, sizeof(cmd.type) - 1);
+    strncpy(cmd.result, access_ok ? "true" : "false", sizeof(cmd.result) - 1);
+    if (ref) strncpy(cmd.id_peticion, ref, sizeof(cmd.id_peticion) - 1);
+
+    // Al frente de la cola: el usuario está delante del torno esperando
+    return xQueueSendToFront(cmd_queue, &cmd, pdMS_TO_TICKS(50)) == pdTRUE;
+}
+
+// retornoParams con el esquema completo: [nombre, valor, min, max, default,
+// unidad]. Para getParams y detrás de retornoConfig en getConfig.
+static void publish_params(const char *id_peticion)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+    cJSON_AddStringToObject(root, "action", "retornoParams");
+    params_add_schema_to_json(root);
+    cJSON_AddStringToObject(root, "id", device_id);
+    cJSON_AddStringToObject(root, "idPeticion", id_peticion);
+    mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+    cJSON_Delete(root);
+}
+
 static void publish_status_now(const char *id_peticion)
 {
     char payload[256];
@@ -99,45 +260,86 @@ static void publish_status_now(const char *id_peticion)
     mqtt_enqueue(TOPIC_RESP_FIXED, payload, 0, 0);
 }
 
+// ================== LECTORES EN CALIENTE ==================
+
+// Arranca o para un lector para que coincida con *enable. Si no arranca se
+// deja *enable como está de verdad: guardar un "true" que no funciona
+// haría fallar el arranque siguiente.
+static bool reader_apply(bool *enable, bool running, const char *name,
+                         esp_err_t (*init)(void), void (*start_task)(void),
+                         esp_err_t (*stop)(void))
+{
+    if (*enable == running) return true;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err;
+    if (*enable) {
+        err = init();
+        if (err == ESP_OK) start_task();
+    } else {
+        err = stop();
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "setConfig: no se pudo %s %s: %s",
+                 *enable ? "arrancar" : "parar", name, esp_err_to_name(err));
+        *enable = running;
+        return false;
+    }
+    ESP_LOGI(TAG, "%s %s en %lld ms", name, *enable ? "arrancado" : "parado",
+             (long long)((esp_timer_get_time() - t0) / 1000));
+    return true;
+}
+
+static bool apply_reader_enables(void)
+{
+    bool ok = true;
+    ok &= reader_apply(&g_app_config.enable_cards, pn532_reader_running(), "RC522",
+                       pn532_reader_init, pn532_reader_start_task, pn532_reader_stop);
+    ok &= reader_apply(&g_app_config.enable_qr, gm861s_reader_running(), "GM861S",
+                       gm861s_reader_init, gm861s_reader_start_task, gm861s_reader_stop);
+    return ok;
+}
+
 // ================== LÓGICA DE COMANDOS ==================
 
 static void handle_command(const command_t *cmd)
 {
     if (strcmp(cmd->action, "pulsadorLuz") == 0) {
-        // usa TEMPS_PULSADOR_MS
-        pulsar_gpio_blocking(cmd->pin, TEMPS_PULSADOR_MS, false);
+        pulsar_gpio_blocking(cmd->pin, params_get(PARAM_PULSE_MS), false);
         publish_resp(cmd, "retornoLuz", cmd->estat, true);
 
     } else if (strcmp(cmd->action, "interruptorLuz") == 0) {
         int estat = cmd->estat;
         if (estat == 2) estat = 1;
-        interruptor_gpio_set(cmd->pin, estat, INTERRUPTOR_INVERSO);
+        interruptor_gpio_set(cmd->pin, estat, params_get_bool(PARAM_INV_SWITCH));
         publish_resp(cmd, "retornoLuz", estat, true);
 
     } else if (strcmp(cmd->action, "pulsador") == 0) {
-        pulsar_gpio_blocking(cmd->pin, TEMPS_PULSADOR_MS, false);
+        pulsar_gpio_blocking(cmd->pin, params_get(PARAM_PULSE_MS), false);
         publish_resp(cmd, "retornoPulsador", 0, false);
 
     } else if (strcmp(cmd->action, "pulsadorInverso") == 0) {
-        pulsar_gpio_blocking(cmd->pin, 500 /*0.5s*/, BOCINA_INVERSA);
+        pulsar_gpio_blocking(cmd->pin, params_get(PARAM_DOOR_MS), params_get_bool(PARAM_INV_HORN));
         publish_resp(cmd, "retornoPulsador", 0, false);
 
     } else if (strcmp(cmd->action, "interruptor") == 0) {
         int estat = cmd->estat;
         if (estat == 2) estat = 1;
-        interruptor_gpio_set(cmd->pin, estat, INTERRUPTOR_INVERSO);
+        interruptor_gpio_set(cmd->pin, estat, params_get_bool(PARAM_INV_SWITCH));
         publish_resp(cmd, "retornoInterruptor", estat, false);
 
     } else if (strcmp(cmd->action, "obrirPorta") == 0) {
-        pulsar_gpio_blocking(cmd->pin, 500 /*0.5s*/, ENTRADA_INVERSO);
+        pulsar_gpio_blocking(cmd->pin, params_get(PARAM_DOOR_MS), params_get_bool(PARAM_INV_ENTRY));
         publish_resp(cmd, "retornoObrirPorta", 0, false);
 
     } else if (strcmp(cmd->action, "obrirPortaMaterial") == 0) {
-        pulsar_gpio_blocking(cmd->pin, TEMPS_MATERIAL_MS, MATERIAL_INVERSO);
+        pulsar_gpio_blocking(cmd->pin, params_get(PARAM_MATERIAL_MS),
+                             params_get_bool(PARAM_INV_MATERIAL));
         publish_resp(cmd, "retornoObrirPortaMaterial", 0, false);
 
     } else if (strcmp(cmd->action, "obrirPortaVenta") == 0) {
-        pulsar_gpio_blocking(cmd->pin, 500 /*0.5s*/, false);
+        pulsar_gpio_blocking(cmd->pin, params_get(PARAM_DOOR_MS), false);
         publish_resp(cmd, "retornoObrirPortaVenta", 0, false);
 
     } else if (strcmp(cmd->action, "getConfig") == 0) {
@@ -147,6 +349,19 @@ static void handle_command(const command_t *cmd)
 
         cJSON_AddStringToObject(root, "action", "retornoConfig");
         cJSON_AddBoolToObject  (root, "enableCards", g_app_config.enable_cards);
+        cJSON_AddBoolToObject  (root, "enableQr", g_app_config.enable_qr);
+        cJSON_AddStringToObject(root, "encoding",
+                                g_app_config.payload_enc == PAYLOAD_ENC_CBOR ? "cbor" : "json");
+        cJSON_AddNumberToObject(root, "cborSchema", PAYLOAD_CBOR_SCHEMA_VERSION);
+        cJSON_AddNumberToObject(root, "qrBaud", gm861s_reader_baud());
+        cJSON_AddNumberToObject(root, "ticketCourt", g_app_config.ticket_court);
+        qr_ticket_add_to_json(root);
+        cJSON_AddStringToObject(root, "allowlistMode",
+                                allowlist_mode_name(g_app_config.allowlist_mode));
+        allowlist_add_to_json(root);
+        journal_add_to_json(root);
+        dlog_add_to_json(root);
+        wifi_add_to_json(root);
         cJSON_AddStringToObject(root, "id", device_id);
         cJSON_AddStringToObject(root, "idPeticion", cmd->id_peticion);
 
@@ -156,10 +371,14 @@ static void handle_command(const command_t *cmd)
             cJSON_free(json);
         }
         cJSON_Delete(root);
+
+        // Los parámetros no caben en el mismo mensaje: van detrás en un
+        // retornoParams con el mismo idPeticion
+        publish_params(cmd->id_peticion);
     } else if (strcmp(cmd->action, "setConfig") == 0) {
 
-        // El payload completo del mensaje MQTT está en cmd->payload
-        cJSON *root = cJSON_Parse(cmd->payload);
+        // Mensaje MQTT entero, tal cual llegó (cmd_msg.c)
+        cJSON *root = cmd_msg_parse(cmd);
         if (!root) {
             ESP_LOGW(TAG, "setConfig: JSON invalido");
             return;
@@ -169,12 +388,116 @@ static void handle_command(const command_t *cmd)
         cJSON *idPetItem = cJSON_GetObjectItem(root, "idPeticion");
 
         const char *id_pet = (cJSON_IsString(idPetItem) ? idPetItem->valuestring : "-");
+        bool ok = true;
 
         if (cJSON_IsObject(cfg)) {
+            // Lectores: se arrancan o paran al momento, sin reiniciar
             cJSON *enableCardsItem = cJSON_GetObjectItem(cfg, "enableCards");
             if (cJSON_IsBool(enableCardsItem)) {
                 g_app_config.enable_cards = cJSON_IsTrue(enableCardsItem);
             }
+            cJSON *enableQrItem = cJSON_GetObjectItem(cfg, "enableQr");
+            if (cJSON_IsBool(enableQrItem)) {
+                g_app_config.enable_qr = cJSON_IsTrue(enableQrItem);
+            }
+            if (!apply_reader_enables()) {
+                ok = false;
+            }
+
+            // Negociación de codificación: "json" (legacy) o "cbor"
+            cJSON *encItem = cJSON_GetObjectItem(cfg, "encoding");
+            if (cJSON_IsString(encItem) && encItem->valuestring) {
+                if (strcasecmp(encItem->valuestring, "cbor") == 0) {
+                    g_app_config.payload_enc = PAYLOAD_ENC_CBOR;
+                } else if (strcasecmp(encItem->valuestring, "json") == 0) {
+                    g_app_config.payload_enc = PAYLOAD_ENC_JSON;
+                } else {
+                    ESP_LOGW(TAG, "setConfig: encoding '%s' no soportado",
+                             encItem->valuestring);
+                }
+            }
+            // Lector QR: "qrBaud": 115200, "qrZones": [{"addr":0x0000,"value":0xD6}, ...]
+            gm861s_cfg_req_t qreq = {0};
+            cJSON *baudItem = cJSON_GetObjectItem(cfg, "qrBaud");
+            if (cJSON_IsNumber(baudItem)) {
+                qreq.baud = (uint32_t)baudItem->valuedouble;
+            }
+            cJSON *zonesItem = cJSON_GetObjectItem(cfg, "qrZones");
+            cJSON *z = NULL;
+            cJSON_ArrayForEach(z, zonesItem) {
+                cJSON *a = cJSON_GetObjectItem(z, "addr");
+                cJSON *v = cJSON_GetObjectItem(z, "value");
+                if (!cJSON_IsNumber(a) || !cJSON_IsNumber(v)) continue;
+                if (qreq.n_zones >= GM861S_CFG_MAX_ZONES) {
+                    ESP_LOGW(TAG, "setConfig: demasiadas qrZones, max %d", GM861S_CFG_MAX_ZONES);
+                    ok = false;
+                    break;
+                }
+                qreq.zones[qreq.n_zones].addr  = (uint16_t)a->valueint;
+                qreq.zones[qreq.n_zones].value = (uint8_t)v->valueint;
+                qreq.n_zones++;
+            }
+            if (qreq.baud || qreq.n_zones) {
+                gm861s_cfg_result_t qres = {0};
+                esp_err_t qerr = gm861s_reader_configure(&qreq, &qres, 10000);
+                if (qerr != ESP_OK) {
+                    ESP_LOGW(TAG, "setConfig: config lector QR fallida: %s (%u zonas ok)",
+                             esp_err_to_name(qerr), qres.zones_ok);
+                    ok = false;
+                }
+            }
+
+            // Tickets QR offline: "ticketKey": {"id": 1, "key": "<130 hex>"} con la
+            // clave pública P-256 (04||X||Y), "ticketCourt": n (0 = todas).
+            cJSON *tkItem = cJSON_GetObjectItem(cfg, "ticketKey");
+            if (cJSON_IsObject(tkItem)) {
+                cJSON *kid = cJSON_GetObjectItem(tkItem, "id");
+                cJSON *khex = cJSON_GetObjectItem(tkItem, "key");
+                uint8_t key[QR_TICKET_KEY_LEN];
+                if (cJSON_IsNumber(kid) && kid->valueint >= 0 && kid->valueint <= 255 &&
+                    cJSON_IsString(khex) && hex_decode(khex->valuestring, key, sizeof(key))) {
+                    if (qr_ticket_set_key((uint8_t)kid->valueint, key) != ESP_OK) ok = false;
+                } else {
+                    ESP_LOGW(TAG, "setConfig: ticketKey invalida");
+                    ok = false;
+                }
+            }
+            cJSON *courtItem = cJSON_GetObjectItem(cfg, "ticketCourt");
+            if (cJSON_IsNumber(courtItem) && courtItem->valueint >= 0 &&
+                courtItem->valueint <= 0xFFFF) {
+                g_app_config.ticket_court = courtItem->valueint;
+            }
+
+            // Allowlist local: "allowlistMode": "grant" | "authoritative" | "off"
+            cJSON *amItem = cJSON_GetObjectItem(cfg, "allowlistMode");
+            if (cJSON_IsString(amItem)) {
+                int mode;
+                if (allowlist_mode_from_name(amItem->valuestring, &mode)) {
+                    g_app_config.allowlist_mode = mode;
+                } else {
+                    ESP_LOGW(TAG, "setConfig: allowlistMode desconocido '%s'", amItem->valuestring);
+                    ok = false;
+                }
+            }
+
+            // Niveles de log por módulo: "logLevels": {"rc522": "debug", "*": "warn"}.
+            // Se aplican al momento y no se guardan: tras reiniciar vuelven a info.
+            cJSON *llItem = cJSON_GetObjectItem(cfg, "logLevels");
+            if (cJSON_IsObject(llItem) && !dlog_set_levels_json(llItem)) {
+                ok = false;
+            }
+
+            // Tiempos y flags en caliente: "params": {"turnstileMs": 1500, ...}
+            cJSON *paramsItem = cJSON_GetObjectItem(cfg, "params");
+            if (cJSON_IsObject(paramsItem) && !params_set_json(paramsItem)) {
+                ok = false;
+            }
+            // Red: "staticIp": {"ip", "mask", "gw", "dns"} o false (DHCP)
+            cJSON *sipItem = cJSON_GetObjectItem(cfg, "staticIp");
+            if (sipItem && !wifi_static_ip_from_json(sipItem)) {
+                ESP_LOGW(TAG, "setConfig: staticIp invalida");
+                ok = false;
+            }
             // aquí podrías leer más campos de config...
 
             app_config_save();
@@ -186,8 +509,12 @@ static void handle_command(const command_t *cmd)
         cJSON *resp = cJSON_CreateObject();
         if (resp) {
             cJSON_AddStringToObject(resp, "action", "retornoSetConfig");
-            cJSON_AddBoolToObject  (resp, "ok", true);
+            cJSON_AddBoolToObject  (resp, "ok", ok);
             cJSON_AddBoolToObject  (resp, "enableCards", g_app_config.enable_cards);
+            cJSON_AddBoolToObject  (resp, "enableQr", g_app_config.enable_qr);
+            cJSON_AddStringToObject(resp, "encoding",
+                                    g_app_config.payload_enc == PAYLOAD_ENC_CBOR ? "cbor" : "json");
+            cJSON_AddNumberToObject(resp, "qrBaud", gm861s_reader_baud());
             cJSON_AddStringToObject(resp, "idPeticion", id_pet);
             cJSON_AddStringToObject(resp, "id", device_id);
 
@@ -200,13 +527,53 @@ static void handle_command(const command_t *cmd)
         }
 
         cJSON_Delete(root);
+    } else if (strcmp(cmd->action, "getJournal") == 0) {
+        // La consulta corre en la task del journal y responde en trozos
+        if (!journal_request_query(cmd->payload)) {
+            ESP_LOGW(TAG, "getJournal: consulta no valida o cola llena");
+            char payload[160];
+            snprintf(payload, sizeof(payload),
+                     "{\"action\":\"retornoJournal\",\"ok\":false,"
+                     "\"idPeticion\":\"%s\",\"name\":\"%s\"}",
+                     cmd->id_peticion, device_id);
+            mqtt_enqueue(TOPIC_RESP_FIXED, payload, 1, 0);
+        }
+
+    } else if (strcmp(cmd->action, "getParams") == 0) {
+        publish_params(cmd->id_peticion);
+
+    } else if (strcmp(cmd->action, "getWifi") == 0) {
+        // Tabla de APs del selector y sus últimas decisiones
+        cJSON *root = cJSON_CreateObject();
+        if (!root) return;
+        cJSON_AddStringToObject(root, "action", "retornoWifi");
+        wifi_sel_add_detail_to_json(root);
+        cJSON_AddStringToObject(root, "id", device_id);
+        cJSON_AddStringToObject(root, "idPeticion", cmd->id_peticion);
+        mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+        cJSON_Delete(root);
+
+    } else if (strcmp(cmd->action, "getTasks") == 0) {
+        // Plan de tasks y stack mínimo libre de cada una
+        cJSON *root = cJSON_CreateObject();
+        if (!root) return;
+        cJSON_AddStringToObject(root, "action", "retornoTasks");
+        task_manifest_add_to_json(root);
+        cJSON_AddStringToObject(root, "id", device_id);
+        cJSON_AddStringToObject(root, "idPeticion", cmd->id_peticion);
+        mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+        cJSON_Delete(root);
+
+    } else if (strcmp(cmd->action, "getSysStats") == 0) {
+        // CPU por task, heap por capacidad y colas (varios mensajes)
+        sysmon_publish_full(cmd->id_peticion);
+
     } else if (strcmp(cmd->action, "status_now") == 0) {
         publish_status_now(cmd->id_peticion);
 
     } else if (strcmp(cmd->action, "writeCard") == 0) {
         // 1) Parsear JSON del comando
-        //    Cambia cmd->payload por el campo real que tenga el JSON
-        cJSON *root = cJSON_Parse(cmd->payload);
+        cJSON *root = cmd_msg_parse(cmd);
         if (!root) {
             ESP_LOGW(TAG, "writeCard: JSON invalido en payload");
             return;
@@ -267,7 +634,7 @@ static void handle_command(const command_t *cmd)
         ESP_LOGI(TAG, "hasAccess: result=%s type=%s idPeticion=%s",
                  cmd->result, cmd->type, cmd->id_peticion);
 
-                 rc522_access_gate_release();
+        access_tracker_complete(cmd->id_peticion, cmd->type);
 
         // Normalizamos: consideramos acceso OK si result es "true" (o "1"/"OK" si quieres)
         bool access_ok = false;
@@ -279,26 +646,11 @@ static void handle_command(const command_t *cmd)
             }
         }
 
-        if (access_ok) {
-            // ✅ Acceso concedido → abrir torno
-            if (strcmp(cmd->type, "IN") == 0) {
-                ESP_LOGI(TAG, "Acceso OK (IN), abriendo entrada");
-                pulsar_gpio_blocking(TORN_IN_PIN, 2000, ENTRADA_INVERSO);
-            } else if (strcmp(cmd->type, "OUT") == 0) {
-                ESP_LOGI(TAG, "Acceso OK (OUT), abriendo salida");
-                pulsar_gpio_blocking(TORN_OUT_PIN, 2000, ENTRADA_INVERSO);
-            } else {
-                ESP_LOGW(TAG, "hasAccess con type desconocido: %s", cmd->type);
-            }
-        } else {
-            // ❌ Acceso denegado → activar pito en GPIO 21
-            ESP_LOGI(TAG, "Acceso denegado, activando pito en GPIO 21");
+        access_lane_t lane;
+        journal_log(JR_DECISION, access_lane_from_name(cmd->type, &lane) ? (int)lane : -1,
+                    JO_SERVER, access_ok, 0, NULL, cmd->id_peticion);
 
-            // Un pitido doble cortito, por ejemplo
-            pulsar_gpio_blocking(PITO_DENEGADO_PIN, 150, false);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            pulsar_gpio_blocking(PITO_DENEGADO_PIN, 150, false);
-        }
+        apply_access_decision(access_ok, cmd->type);
 
         // Enviar confirmación a la web: retornoAccessTorn (siempre)
         cJSON *resp = cJSON_CreateObject();
@@ -312,20 +664,20 @@ static void handle_command(const command_t *cmd)
         cJSON_AddBoolToObject  (resp, "ok",         access_ok);
         cJSON_AddStringToObject(resp, "type",       cmd->type);
 
-        char *json_str = cJSON_PrintUnformatted(resp);
-        if (json_str) {
-            bool enq_ok = mqtt_enqueue(TOPIC_RESP_FIXED, json_str, 1, 0);
-            if (!enq_ok) {
-                ESP_LOGW(TAG, "hasAccess: no se pudo encolar retornoAccessTorn");
-            }
-            cJSON_free(json_str);
-        } else {
-            ESP_LOGW(TAG, "hasAccess: cJSON_PrintUnformatted fallo");
+        if (!mqtt_enqueue_json(TOPIC_RESP_FIXED, resp, 1, 0)) {
+            ESP_LOGW(TAG, "hasAccess: no se pudo encolar retornoAccessTorn");
         }
 
         cJSON_Delete(resp);
 
     }
+    else if (strcmp(cmd->action, COMMANDS_LOCAL_ACCESS) == 0) {
+        // Decisión tomada en el propio dispositivo: sólo actuar, el informe
+        // al servidor ya lo ha encolado quien decidió
+        ESP_LOGI(TAG, "accessLocal: result=%s type=%s ref=%s",
+                 cmd->result, cmd->type, cmd->id_peticion);
+        apply_access_decision(strcmp(cmd->result, "true") == 0, cmd->type);
+    }
     else {
         ESP_LOGW(TAG, "Accion desconocida: %s", cmd->action);
     }
@@ -339,11 +691,12 @@ static void gpio_command_task(void *pv)
     while (1) {
         if (xQueueReceive(cmd_queue, &cmd, portMAX_DELAY) == pdTRUE) {
             handle_command(&cmd);
+            cmd_msg_free(&cmd);
         }
     }
 }
 
 void commands_start_task(void)
 {
-    xTaskCreate(gpio_command_task, "gpio_command_task", 4096, NULL, 5, NULL);
+    task_manifest_create(TASK_GPIO_CMD, gpio_command_task, NULL, NULL);
 }
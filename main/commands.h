@@ -1,6 +1,14 @@
 // commands.h
 #pragma once
 
+#include <stdbool.h>
+
 #include "core.h"
 
 void commands_start_task(void);
+
+// Acción interna para decisiones de acceso tomadas en local (tickets QR
+// offline). No se acepta por MQTT: sólo la encolan los lectores.
+#define COMMANDS_LOCAL_ACCESS "accessLocal"
+
+bool commands_post_local_access(bool access_ok, const char *type, const char *ref);
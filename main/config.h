@@ -19,7 +19,24 @@ typedef struct {
 extern const wifi_net_t WIFI_NETS[];
 extern const int WIFI_NETS_COUNT;
 
-#define MAX_RETRY_PER_AP   5
+// Selección de AP (wifi_select.c): se barre, se ordenan los APs de
+// WIFI_NETS por RSSI e historial, y cada BSSID que falla queda en backoff
+// propio (el primer fallo se reintenta al momento)
+#define WIFI_SCAN_MAX_RECORDS    20
+#define WIFI_SEL_MAX_APS         16
+#define WIFI_SEL_HISTORY         16
+#define WIFI_SEL_STALE_MS        300000   // un AP no visto en este tiempo no se elige
+#define WIFI_AP_BACKOFF_BASE_MS  2000
+#define WIFI_AP_BACKOFF_MAX_MS   30000
+#define WIFI_SCAN_RETRY_MS       5000     // sin ningún AP conocido a la vista
+
+// Roaming: con el AP actual por debajo de WIFI_ROAM_RSSI se barre y se
+// cambia si otro es WIFI_ROAM_DELTA_DB mejor (como mucho un barrido por
+// WIFI_ROAM_SCAN_MIN_MS). 802.11k/v va activado: si el AP lo soporta, él
+// mismo puede mandarnos a otro (BTM).
+#define WIFI_ROAM_RSSI           -72
+#define WIFI_ROAM_DELTA_DB       8
+#define WIFI_ROAM_SCAN_MIN_MS    60000
 
 // MQTT
 //#define MQTT_HOST "77.37.125.73"
@@ -29,11 +46,96 @@ extern const int WIFI_NETS_COUNT;
 #define MQTT_USER "admin"
 #define MQTT_PASS "Abc_0123456789"
 
-// Tempos
+// Mensajes entrantes fragmentados (> buffer del cliente) se reensamblan aquí;
+// los más grandes sólo se aceptan si hay un sink de streaming para su topic.
+#define MQTT_REASM_ARENA_SZ  8192
+
+// Cola de salida: cada mensaje ocupa lo que mide (heap frío), con un tope
+// total para cuando el broker no está y la cola se llena de status
+#define MQTT_OUT_QUEUE_LEN    64
+#define MQTT_OUT_BUDGET_BYTES (24 * 1024)
+
+// Sonda loopback al broker para medir RTT (ver net_metrics.c)
+#define NET_PROBE_PERIOD_MS  10000
+
+// Reconexión al broker (conn_supervisor.c): backoff exponencial con jitter
+#define MQTT_BACKOFF_BASE_MS  500
+#define MQTT_BACKOFF_MAX_MS   30000
+
+// Config en NVS (app_config.c): escritura diferida tras la última petición,
+// con un tope para que una ráfaga continua acabe guardándose
+#define APP_CFG_COMMIT_DELAY_MS  2000
+#define APP_CFG_COMMIT_MAX_MS    10000
+
+// OTA (ota_manager.c): tras un corte la descarga sigue con Range desde el
+// último byte; se aborta tras OTA_MAX_RETRIES cortes seguidos sin avanzar
+#define OTA_HTTP_TIMEOUT_MS     15000
+#define OTA_HTTP_BUF_SZ         4096
+#define OTA_MAX_RETRIES         6
+#define OTA_RETRY_BASE_MS       1000
+#define OTA_RETRY_MAX_MS        30000
+#define OTA_PROGRESS_PERIOD_MS  5000     // progresoOta por MQTT
+
+// Validación tras OTA (ota_health.c): la imagen nueva se marca como válida
+// cuando todas las comprobaciones aguantan OTA_HEALTH_STABLE_MS seguidos
+// dentro de la ventana (param otaHealthMs); si no, vuelve a la anterior
+#define OTA_HEALTH_WINDOW_MS    120000
+#define OTA_HEALTH_STABLE_MS    10000
+#define OTA_HEALTH_CHECK_MS     500
+#define OTA_HEALTH_MIN_HEAP     (40 * 1024)
+
+// Tasks (task_manifest.c): aviso en getTasks si a una le queda menos stack
+#define TASK_STACK_MIN_FREE     512
+
+// Introspección (sysmon.c): sysStats compacto con el status como mucho
+// cada SYSMON_PERIOD_MS; uxTaskGetSystemState en un buffer de tantas tasks
+#define SYSMON_PERIOD_MS        30000
+#define SYSMON_MAX_TASKS        40
+
+// Tempos (defaults: se ajustan en caliente con setConfig "params", ver params.h)
 #define TEMPS_PULSADOR_MS   500
 #define TEMPS_MATERIAL_MS   3000
-
-// Flags inversos
+#define TEMPS_TORNO_MS      2000
+#define TEMPS_PITO_MS       150
+#define TEMPS_PORTA_MS      500
+#define RC522_POLL_MS       60
+#define STATUS_PERIOD_MS    30000
+
+// Peticiones getAccessTorn: plazo por petición y huecos en vuelo por carril
+#define ACCESS_REQUEST_TIMEOUT_MS      3000
+#define ACCESS_TRACKER_SLOTS_PER_LANE  4
+
+// Pipeline de credenciales (RC522 + QR): cola, filtro de repetidos y TTLs
+#define CRED_QUEUE_LEN           8
+#define CRED_RECENT_SLOTS        32     // potencia de 2
+#define CRED_DEBOUNCE_RFID_MS    900
+#define CRED_DEBOUNCE_QR_MS      1200
+#define CRED_DEBOUNCE_TICKET_MS  5000   // un ticket repetido daría "replay" y pitaría
+
+// Tickets QR firmados (validación offline)
+#define QR_TICKET_CLOCK_SKEW_S   120          // tolerancia de reloj en la ventana
+#define QR_TICKET_REPLAY_SLOTS   128          // nonces usados que se recuerdan
+#define QR_TICKET_MIN_EPOCH      1704067200u  // 2024-01-01: por debajo, reloj sin SNTP
+#define SNTP_SERVER              "pool.ntp.org"
+
+// Partición "storage" (raw, sin sistema de ficheros):
+//   [0, 6M)  allowlist, bancos A/B de ALLOWLIST_BANK_SZ (ver allowlist.h)
+//   [6M, 8M) journal de accesos (ver journal.h)
+#define STORAGE_PARTITION_LABEL  "storage"
+#define ALLOWLIST_BANK_SZ        0x300000     // cabecera + registros + log de deltas
+#define ALLOWLIST_DELTA_SZ       0x10000      // log de deltas al final de cada banco
+#define ALLOWLIST_OVERLAY_MAX    256          // altas/bajas en RAM hasta el próximo snapshot
+
+#define JOURNAL_OFFSET           0x600000
+#define JOURNAL_SIZE             0x200000
+#define JOURNAL_SEG_SZ           0x10000      // 32 segmentos de ~1000 eventos
+#define JOURNAL_QUEUE_LEN        32
+#define JOURNAL_CHUNK_RECS       8            // registros por retornoJournal
+#define JOURNAL_QUERY_MAX        500          // tope por consulta (se sigue con fromId)
+#define JOURNAL_OUTQ_RESERVE     16           // huecos de mqtt_out_queue que el streaming no toca
+#define JOURNAL_OUTQ_RESERVE_B   (4 * 1024)   // y bytes de MQTT_OUT_BUDGET_BYTES
+
+// Flags inversos (defaults, ver params.h)
 #define INTERRUPTOR_INVERSO   false
 #define BOCINA_INVERSA        false
 #define MATERIAL_INVERSO      false
@@ -66,7 +168,8 @@ extern const int WIFI_NETS_COUNT;
 
 // ===== GM861S (QR) UART =====
 #define GM861S_UART_PORT UART_NUM_1
-#define GM861S_BAUD      9600
+#define GM861S_BAUD      9600     // baud de fábrica del lector
+#define GM861S_BAUD_FAST 115200   // baud objetivo tras la negociación
 
 // Elige pines libres (ejemplo)
 #define GM861S_UART_TX   GPIO_NUM_17   // ESP32 -> RXD del GM861S
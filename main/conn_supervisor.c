@@ -0,0 +1,306 @@
+// conn_supervisor.c
+
+#include "conn_supervisor.h"
+#include "config.h"
+#include "core.h"
+#include "mqtt_manager.h"
+#include "wifi_manager.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "mqtt_client.h"
+#include <string.h>
+
+static const char *TAG = "CONN_SUP";
+
+static const char *const s_state_names[] = { "wifiDown", "connecting", "backoff", "online" };
+
+static portMUX_TYPE s_sup_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static conn_state_t s_state = CONN_WIFI_DOWN;
+static bool s_wifi_error = false;       // último intento de config WiFi falló
+static uint32_t s_attempt = 0;          // fallos consecutivos de broker
+static esp_timer_handle_t s_retry_timer = NULL;
+
+// Tiempo hasta el primer comando tras recuperar IP
+static int64_t  s_ip_gained_us = 0;
+static bool     s_waiting_first_cmd = false;
+static uint32_t s_ttfc_last_ms = 0;
+static uint32_t s_ttfc_max_ms = 0;
+
+// Arranque hasta el primer MQTT conectado (0 = aún no)
+static uint32_t s_boot_mqtt_ms = 0;
+
+#define CONN_MAX_SUBS  6
+
+static EventGroupHandle_t s_conn_eg = NULL;
+static conn_sup_cb_t s_subs[CONN_MAX_SUBS];
+static int s_n_subs = 0;
+
+// ================== ESTADO ==================
+
+static void bits_apply(conn_state_t st)
+{
+    EventBits_t set = (st == CONN_ONLINE) ? CONN_BIT_MQTT : CONN_BIT_OFFLINE;
+    if (st != CONN_WIFI_DOWN) set |= CONN_BIT_WIFI;
+    xEventGroupClearBits(s_conn_eg, (CONN_BIT_WIFI | CONN_BIT_MQTT | CONN_BIT_OFFLINE) & ~set);
+    xEventGroupSetBits(s_conn_eg, set);
+}
+
+// Única escritura de s_state: bits del event group y suscriptores
+static void transition(conn_state_t to)
+{
+    conn_sup_cb_t subs[CONN_MAX_SUBS];
+
+    portENTER_CRITICAL(&s_sup_mux);
+    conn_state_t from = s_state;
+    s_state = to;
+    if (from != to) s_wifi_error = false;
+    int n = s_n_subs;
+    memcpy(subs, s_subs, sizeof(subs[0]) * n);
+    portEXIT_CRITICAL(&s_sup_mux);
+    if (from == to) return;
+
+    // Los bits se ponen fuera del spinlock: otra transición (desde la task
+    // de WiFi, la de MQTT o el timer) puede adelantarse y poner los suyos
+    // antes. Se vuelve a mirar s_state y se repite hasta que los últimos
+    // bits puestos son los del estado que queda.
+    conn_state_t st = to;
+    while (1) {
+        bits_apply(st);
+        conn_state_t now = conn_sup_state();
+        if (now == st) break;
+        st = now;
+    }
+
+    ESP_LOGI(TAG, "%s -> %s", s_state_names[from], s_state_names[to]);
+    for (int i = 0; i < n; i++) subs[i](from, to);
+}
+
+conn_state_t conn_sup_state(void)
+{
+    portENTER_CRITICAL(&s_sup_mux);
+    conn_state_t st = s_state;
+    portEXIT_CRITICAL(&s_sup_mux);
+    return st;
+}
+
+bool conn_sup_wifi_up(void)
+{
+    return conn_sup_state() != CONN_WIFI_DOWN;
+}
+
+bool conn_sup_mqtt_up(void)
+{
+    return conn_sup_state() == CONN_ONLINE;
+}
+
+bool conn_sup_wait(EventBits_t bits, TickType_t timeout)
+{
+    EventBits_t got = xEventGroupWaitBits(s_conn_eg, bits, pdFALSE, pdTRUE, timeout);
+    return (got & bits) == bits;
+}
+
+void conn_sup_subscribe(conn_sup_cb_t cb)
+{
+    portENTER_CRITICAL(&s_sup_mux);
+    if (cb && s_n_subs < CONN_MAX_SUBS) s_subs[s_n_subs++] = cb;
+    portEXIT_CRITICAL(&s_sup_mux);
+}
+
+led_mode_t conn_sup_led_mode(void)
+{
+    portENTER_CRITICAL(&s_sup_mux);
+    conn_state_t st = s_state;
+    bool err = s_wifi_error;
+    portEXIT_CRITICAL(&s_sup_mux);
+
+    if (err) return LED_MODE_ERROR;
+    switch (st) {
+        case CONN_ONLINE:    return LED_MODE_MQTT_OK;
+        case CONN_WIFI_DOWN: return LED_MODE_WIFI_CONNECTING;
+        default:             return LED_MODE_WIFI_OK_NO_MQTT;
+    }
+}
+
+// ================== RECONEXIÓN ==================
+
+static void request_reconnect(const char *why)
+{
+    if (!mqtt_client) return;
+
+    ESP_LOGI(TAG, "Reconectando MQTT (%s, intento %lu)", why, (unsigned long)s_attempt);
+    transition(CONN_MQTT_CONNECTING);
+
+    esp_err_t err = esp_mqtt_client_reconnect(mqtt_client);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_mqtt_client_reconnect: %s", esp_err_to_name(err));
+    }
+}
+
+static void retry_timer_cb(void *arg)
+{
+    (void)arg;
+    if (!conn_sup_wifi_up()) return;   // al volver la IP se reintenta al momento
+    request_reconnect("backoff");
+}
+
+// Backoff exponencial con "full jitter": espera aleatoria en [0, min(cap, base*2^n)],
+// con un suelo de base/2 para no martillear el broker.
+static uint32_t backoff_ms(uint32_t attempt)
+{
+    uint32_t exp = (attempt > 10) ? 10 : attempt;
+    uint32_t ceil_ms = MQTT_BACKOFF_BASE_MS << exp;
+    if (ceil_ms > MQTT_BACKOFF_MAX_MS) ceil_ms = MQTT_BACKOFF_MAX_MS;
+
+    uint32_t floor_ms = MQTT_BACKOFF_BASE_MS / 2;
+    return floor_ms + esp_random() % (ceil_ms - floor_ms + 1);
+}
+
+esp_err_t conn_sup_init(void)
+{
+    if (s_retry_timer) return ESP_OK;
+
+    s_conn_eg = xEventGroupCreate();
+    if (!s_conn_eg) return ESP_ERR_NO_MEM;
+    xEventGroupSetBits(s_conn_eg, CONN_BIT_OFFLINE);
+
+    const esp_timer_create_args_t args = {
+        .callback = retry_timer_cb,
+        .name     = "mqtt_retry",
+    };
+    return esp_timer_create(&args, &s_retry_timer);
+}
+
+void conn_sup_on_wifi_got_ip(void)
+{
+    portENTER_CRITICAL(&s_sup_mux);
+    s_attempt = 0;
+    s_ip_gained_us = esp_timer_get_time();
+    s_waiting_first_cmd = true;
+    portEXIT_CRITICAL(&s_sup_mux);
+
+    if (s_retry_timer) esp_timer_stop(s_retry_timer);
+
+    // Aunque el cliente MQTT aún no exista (el WiFi arranca antes)
+    transition(CONN_MQTT_CONNECTING);
+
+    // IP recién obtenida: no esperamos al reconnect_timeout del cliente
+    request_reconnect("IP obtenida");
+}
+
+void conn_sup_on_wifi_lost(void)
+{
+    transition(CONN_WIFI_DOWN);   // si no hay wifi, tampoco mqtt
+
+    if (s_retry_timer) esp_timer_stop(s_retry_timer);
+
+    // Cortar ya la sesión TCP muerta (no bloquea: sólo marca DISCONNECT_BIT)
+    // para que al volver la IP el cliente esté listo para reconnect.
+    if (mqtt_client) esp_mqtt_client_disconnect(mqtt_client);
+}
+
+void conn_sup_on_wifi_error(void)
+{
+    portENTER_CRITICAL(&s_sup_mux);
+    s_wifi_error = true;
+    portEXIT_CRITICAL(&s_sup_mux);
+}
+
+// Una vez por arranque: cuánto tardó cada fase hasta tener MQTT
+static void publish_boot_timing(void)
+{
+    wifi_boot_times_t bt;
+    wifi_get_boot_times(&bt);
+    s_boot_mqtt_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    ESP_LOGI(TAG, "Arranque: wifi %lu, asociado %lu, IP %lu, MQTT %lu ms (%s%s)",
+             (unsigned long)bt.start_ms, (unsigned long)bt.assoc_ms,
+             (unsigned long)bt.ip_ms, (unsigned long)s_boot_mqtt_ms,
+             bt.fast ? "conexion rapida" : "escaneo", bt.static_ip ? ", IP fija" : "");
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+    cJSON_AddStringToObject(root, "action",   "bootTiming");
+    cJSON_AddStringToObject(root, "id",       device_id);
+    cJSON_AddNumberToObject(root, "wifiMs",   bt.start_ms);
+    cJSON_AddNumberToObject(root, "assocMs",  bt.assoc_ms);
+    cJSON_AddNumberToObject(root, "ipMs",     bt.ip_ms);
+    cJSON_AddNumberToObject(root, "mqttMs",   s_boot_mqtt_ms);
+    cJSON_AddBoolToObject  (root, "fast",     bt.fast);
+    cJSON_AddBoolToObject  (root, "staticIp", bt.static_ip);
+    cJSON_AddNumberToObject(root, "channel",  bt.channel);
+    mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+    cJSON_Delete(root);
+}
+
+void conn_sup_on_mqtt_connected(void)
+{
+    portENTER_CRITICAL(&s_sup_mux);
+    s_attempt = 0;
+    portEXIT_CRITICAL(&s_sup_mux);
+
+    if (s_retry_timer) esp_timer_stop(s_retry_timer);
+
+    // CONN_BIT_MQTT despierta a mqtt_out_task con el backlog
+    transition(CONN_ONLINE);
+
+    if (s_boot_mqtt_ms == 0) publish_boot_timing();
+}
+
+void conn_sup_on_mqtt_disconnected(void)
+{
+    uint32_t delay;
+
+    portENTER_CRITICAL(&s_sup_mux);
+    if (s_state == CONN_WIFI_DOWN) {
+        portEXIT_CRITICAL(&s_sup_mux);
+        return;   // lo relanza conn_sup_on_wifi_got_ip()
+    }
+    delay = backoff_ms(s_attempt);
+    s_attempt++;
+    portEXIT_CRITICAL(&s_sup_mux);
+    transition(CONN_MQTT_BACKOFF);
+
+    ESP_LOGW(TAG, "Broker no disponible, reintento en %lu ms", (unsigned long)delay);
+    if (s_retry_timer) {
+        esp_timer_stop(s_retry_timer);
+        esp_timer_start_once(s_retry_timer, (uint64_t)delay * 1000);
+    }
+}
+
+void conn_sup_on_command_received(void)
+{
+    if (!s_waiting_first_cmd) return;
+
+    uint32_t ms;
+    portENTER_CRITICAL(&s_sup_mux);
+    s_waiting_first_cmd = false;
+    ms = (uint32_t)((esp_timer_get_time() - s_ip_gained_us) / 1000);
+    s_ttfc_last_ms = ms;
+    if (ms > s_ttfc_max_ms) s_ttfc_max_ms = ms;
+    portEXIT_CRITICAL(&s_sup_mux);
+
+    ESP_LOGI(TAG, "Primer comando tras recuperar IP en %lu ms", (unsigned long)ms);
+}
+
+void conn_sup_add_to_json(cJSON *root)
+{
+    cJSON *conn = cJSON_CreateObject();
+    if (!conn) return;
+
+    portENTER_CRITICAL(&s_sup_mux);
+    conn_state_t st  = s_state;
+    uint32_t attempt = s_attempt;
+    uint32_t last    = s_ttfc_last_ms;
+    uint32_t max     = s_ttfc_max_ms;
+    portEXIT_CRITICAL(&s_sup_mux);
+
+    cJSON_AddStringToObject(conn, "state",   s_state_names[st]);
+    cJSON_AddNumberToObject(conn, "attempt", attempt);
+    cJSON_AddNumberToObject(conn, "ttfcMs",  last);
+    cJSON_AddNumberToObject(conn, "ttfcMax", max);
+    cJSON_AddItemToObject(root, "conn", conn);
+}
@@ -0,0 +1,58 @@
+// conn_supervisor.h
+#pragma once
+
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_err.h"
+#include "cJSON.h"
+#include "core.h"
+
+// Supervisor de conexión: une el estado WiFi y MQTT y es el único que decide
+// cuándo reconectar el cliente MQTT (el auto-reconnect del cliente va off).
+// También es el único que escribe el estado de conectividad: los demás lo
+// leen, esperan bits del event group o se suscriben a las transiciones.
+
+typedef enum {
+    CONN_WIFI_DOWN = 0,     // esperando IP
+    CONN_MQTT_CONNECTING,   // IP ok, intento en curso
+    CONN_MQTT_BACKOFF,      // IP ok, esperando para reintentar broker
+    CONN_ONLINE,
+} conn_state_t;
+
+// Bits del event group (se actualizan en cada transición)
+#define CONN_BIT_WIFI       (1 << 0)   // con IP
+#define CONN_BIT_MQTT       (1 << 1)   // broker conectado
+#define CONN_BIT_OFFLINE    (1 << 2)   // sin broker (CONN_BIT_MQTT negado)
+
+// Antes del WiFi y de cualquier task que espere bits
+esp_err_t conn_sup_init(void);
+
+conn_state_t conn_sup_state(void);
+bool conn_sup_wifi_up(void);
+bool conn_sup_mqtt_up(void);
+
+// Bloquea hasta que estén todos los bits. true si llegaron antes del timeout.
+bool conn_sup_wait(EventBits_t bits, TickType_t timeout);
+
+// Callback en cada cambio de estado, desde el contexto de quien lo provoca
+// (event loop, task MQTT o timer): corto y sin bloquear
+typedef void (*conn_sup_cb_t)(conn_state_t from, conn_state_t to);
+void conn_sup_subscribe(conn_sup_cb_t cb);
+
+// Modo del LED según el estado (y el último error de WiFi)
+led_mode_t conn_sup_led_mode(void);
+
+// Ganchos desde wifi_manager (default event loop)
+void conn_sup_on_wifi_got_ip(void);
+void conn_sup_on_wifi_lost(void);
+void conn_sup_on_wifi_error(void);     // config WiFi no aplicable (LED rojo)
+
+// Ganchos desde mqtt_manager (tarea del cliente MQTT)
+void conn_sup_on_mqtt_connected(void);
+void conn_sup_on_mqtt_disconnected(void);
+void conn_sup_on_command_received(void);
+
+// Objeto "conn" para status
+void conn_sup_add_to_json(cJSON *root);
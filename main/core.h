@@ -13,16 +13,27 @@ typedef struct {
     int   id_pista;
     char  id_peticion[32];
 
-    char payload[256];
     char result[8];      // "OK" / "KO"
     char type[8];        // "IN" / "OUT"
+
+    // Mensaje JSON entero (cmd_msg.c) o NULL. Es del comando: lo libera
+    // con cmd_msg_free quien lo saca de cmd_queue
+    char  *payload;
+    size_t payload_len;
 } command_t;
 
+// Máximos por mensaje de salida: status con telemetría de red/accesos/QR/
+// tickets ya no cabe en 512
+#define MQTT_OUT_PAYLOAD_SZ 1024
+#define MQTT_OUT_TOPIC_SZ   128
+
+// Elemento de mqtt_out_queue. data es un bloque del heap con el topic
+// terminado en '\0' y detrás el payload; lo libera mqtt_out_task al publicar.
 typedef struct {
-    char topic[128];
-    char payload[256];
-    int  qos;
-    int  retain;
+    char    *data;
+    uint16_t len;        // bytes del payload (texto o CBOR)
+    uint8_t  qos;
+    uint8_t  retain;
 } mqtt_out_msg_t;
 
 // LED
@@ -40,9 +51,7 @@ extern QueueHandle_t mqtt_out_queue;
 
 extern esp_mqtt_client_handle_t mqtt_client;
 
-extern bool s_wifi_connected;
-extern bool s_mqtt_connected;
-extern led_mode_t s_led_mode;
+// El estado WiFi/MQTT y el modo del LED los lleva conn_supervisor.h
 
 extern char device_id[32];
 extern char topic_cmd[128];
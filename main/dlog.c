@@ -0,0 +1,337 @@
+// dlog.c
+
+#include "dlog.h"
+#include "task_manifest.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// La task va a prioridad mínima (task_manifest.c): sólo formatea cuando no
+// hay nada más que hacer
+#define DLOG_LINE_MAX    256
+
+// ================== MÓDULOS ==================
+
+// tag = el TAG de ESP_LOG del módulo, para que las líneas diferidas salgan
+// igual que las síncronas y esp_log_level_set afecte a las dos
+static const struct {
+    const char *name;
+    const char *tag;
+} s_mods[DLOG_MOD_COUNT] = {
+    [DLOG_MQTT]   = { "mqtt",   "MQTT" },
+    [DLOG_RC522]  = { "rc522",  "RC522_READER" },
+    [DLOG_GM861S] = { "gm861s", "GM861S" },
+    [DLOG_PIPE]   = { "pipe",   "CRED_PIPE" },
+    [DLOG_CMD]    = { "cmd",    "CMD" },
+};
+
+static const char *s_level_names[] = {
+    [ESP_LOG_NONE]    = "none",
+    [ESP_LOG_ERROR]   = "error",
+    [ESP_LOG_WARN]    = "warn",
+    [ESP_LOG_INFO]    = "info",
+    [ESP_LOG_DEBUG]   = "debug",
+    [ESP_LOG_VERBOSE] = "verbose",
+};
+
+static const char s_level_letter[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+
+uint8_t dlog_levels[DLOG_MOD_COUNT] = {
+    [DLOG_MQTT]   = ESP_LOG_INFO,
+    [DLOG_RC522]  = ESP_LOG_INFO,
+    [DLOG_GM861S] = ESP_LOG_INFO,
+    [DLOG_PIPE]   = ESP_LOG_INFO,
+    [DLOG_CMD]    = ESP_LOG_INFO,
+};
+
+// ================== RING ==================
+
+// Una entrada = 96 bytes (con punteros de 32 bits). Los textos de los %s
+// van seguidos en str[] como [len][bytes]; args[i] de un %s guarda su
+// offset en str[].
+typedef struct {
+    const char *fmt;
+    uint32_t    ts_ms;
+    uint8_t     mod;
+    uint8_t     lvl;
+    uint8_t     nargs;
+    uint8_t     str_len;
+    uint8_t     kinds[DLOG_MAX_ARGS];
+    uint8_t     pad[2];
+    uint32_t    args[DLOG_MAX_ARGS];
+    uint8_t     str[DLOG_STR_SZ];
+} dlog_ent_t;
+
+static dlog_ent_t   s_ring[DLOG_RING_LEN];
+static uint32_t     s_head = 0;    // siguiente a escribir
+static uint32_t     s_tail = 0;    // siguiente a formatear
+static uint32_t     s_drops = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task = NULL;
+
+void dlog_write(dlog_mod_t mod, esp_log_level_t lvl, const char *fmt,
+                int nargs, const dlog_arg_t *args)
+{
+    dlog_ent_t e;
+    e.fmt     = fmt;
+    e.ts_ms   = esp_log_timestamp();
+    e.mod     = (uint8_t)mod;
+    e.lvl     = (uint8_t)lvl;
+    e.nargs   = (uint8_t)(nargs > DLOG_MAX_ARGS ? DLOG_MAX_ARGS : nargs);
+    e.str_len = 0;
+
+    for (int i = 0; i < e.nargs; i++) {
+        const dlog_arg_t *a = &args[i];
+        e.kinds[i] = a->kind;
+        if (a->kind == DLOG_K_INT) {
+            e.args[i] = a->v;
+            continue;
+        }
+
+        // Texto: [len][bytes]. Si no cabe entero, se corta (flag 0x80 en len)
+        size_t n = (a->kind == DLOG_K_STR) ? strnlen(a->s, DLOG_STR_SZ) : a->v;
+        size_t room = (e.str_len < DLOG_STR_SZ) ? DLOG_STR_SZ - e.str_len - 1 : 0;
+        uint8_t flag = 0;
+        if (n > room) {
+            n = room;
+            flag = 0x80;
+        }
+        e.args[i] = e.str_len;
+        if (e.str_len < DLOG_STR_SZ) {
+            e.str[e.str_len] = (uint8_t)n | flag;
+            memcpy(&e.str[e.str_len + 1], a->s, n);
+            e.str_len += (uint8_t)(n + 1);
+        } else {
+            e.args[i] = DLOG_STR_SZ;   // sin sitio ni para la longitud
+        }
+    }
+
+    bool wake = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_head - s_tail >= DLOG_RING_LEN) {
+        s_drops++;
+    } else {
+        // Sólo se copia lo usado de str[]
+        memcpy(&s_ring[s_head % DLOG_RING_LEN], &e,
+               offsetof(dlog_ent_t, str) + e.str_len);
+        wake = (s_head == s_tail);
+        s_head++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (wake && s_task) xTaskNotifyGive(s_task);
+}
+
+// ================== FORMATEO ==================
+
+static size_t put_str(char *out, size_t pos, const char *s)
+{
+    while (*s && pos < DLOG_LINE_MAX - 1) out[pos++] = *s++;
+    return pos;
+}
+
+// Texto de un %s de la entrada, ya listo para snprintf
+static void arg_text(const dlog_ent_t *e, int i, char *buf, size_t sz)
+{
+    uint32_t off = e->args[i];
+    if (off >= e->str_len) {
+        snprintf(buf, sz, "~");
+        return;
+    }
+    uint8_t hdr = e->str[off];
+    size_t n = hdr & 0x7F;
+    const uint8_t *p = &e->str[off + 1];
+    size_t pos = 0;
+
+    if (e->kinds[i] == DLOG_K_HEX) {
+        static const char hx[] = "0123456789ABCDEF";
+        for (size_t k = 0; k < n && pos + 3 < sz; k++) {
+            if (k) buf[pos++] = ' ';
+            buf[pos++] = hx[p[k] >> 4];
+            buf[pos++] = hx[p[k] & 0x0F];
+        }
+    } else {
+        for (size_t k = 0; k < n && pos + 1 < sz; k++) buf[pos++] = (char)p[k];
+    }
+    if ((hdr & 0x80) && pos + 1 < sz) buf[pos++] = '~';
+    buf[pos] = '\0';
+}
+
+// Recorre el formato especificador a especificador: el texto literal se
+// copia y cada especificador se formatea con un snprintf de un solo valor
+// ('*' se sustituye antes por el número consumido).
+static void format_entry(const dlog_ent_t *e, char *out)
+{
+    size_t pos = 0;
+    int ai = 0;
+    const char *p = e->fmt;
+
+    while (*p && pos < DLOG_LINE_MAX - 1) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+
+        char spec[24];
+        size_t sl = 0;
+        char len_mod = 0;
+        spec[sl++] = *p++;
+        while (*p && !strchr("diouxXcsp", *p) && sl < sizeof(spec) - 12) {
+            if (*p == '*') {
+                int w = (ai < e->nargs) ? (int)e->args[ai++] : 0;
+                sl += (size_t)snprintf(&spec[sl], sizeof(spec) - sl, "%d", w);
+            } else if (*p == 'l' || *p == 'z' || *p == 'h') {
+                len_mod = (len_mod == 'l' && *p == 'l') ? 'L' : *p;
+            } else {
+                spec[sl++] = *p;
+            }
+            p++;
+        }
+        if (!*p) break;
+        char conv = *p++;
+        spec[sl++] = conv;
+        spec[sl] = '\0';
+
+        char val[DLOG_LINE_MAX];
+        if (ai >= e->nargs || len_mod == 'L') {
+            snprintf(val, sizeof(val), "?");
+        } else if (conv == 's') {
+            char txt[DLOG_STR_SZ * 3];
+            if (e->kinds[ai] == DLOG_K_INT) snprintf(txt, sizeof(txt), "?");
+            else arg_text(e, ai, txt, sizeof(txt));
+            snprintf(val, sizeof(val), spec, txt);
+            ai++;
+        } else if (conv == 'p') {
+            snprintf(val, sizeof(val), spec, (void *)(uintptr_t)e->args[ai++]);
+        } else if (conv == 'd' || conv == 'i' || conv == 'c') {
+            // Los enteros se guardan en 32 bits: el signo se recupera aquí
+            snprintf(val, sizeof(val), spec, (int)(int32_t)e->args[ai++]);
+        } else {
+            snprintf(val, sizeof(val), spec, (unsigned)e->args[ai++]);
+        }
+        pos = put_str(out, pos, val);
+    }
+    out[pos] = '\0';
+}
+
+static void dlog_task(void *pv)
+{
+    (void)pv;
+    static char line[DLOG_LINE_MAX];
+    uint32_t drops_seen = 0;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (1) {
+            dlog_ent_t e;
+            uint32_t drops;
+            portENTER_CRITICAL(&s_lock);
+            bool empty = (s_head == s_tail);
+            if (!empty) {
+                memcpy(&e, &s_ring[s_tail % DLOG_RING_LEN], sizeof(e));
+                s_tail++;
+            }
+            drops = s_drops;
+            portEXIT_CRITICAL(&s_lock);
+
+            if (drops != drops_seen) {
+                ESP_LOGW("DLOG", "%lu entradas de log perdidas (ring lleno)",
+                         (unsigned long)(drops - drops_seen));
+                drops_seen = drops;
+            }
+            if (empty) break;
+
+            format_entry(&e, line);
+            const char *tag = s_mods[e.mod].tag;
+            // Mismo formato que ESP_LOGx, con la hora de captura
+            esp_log_write((esp_log_level_t)e.lvl, tag, "%c (%lu) %s: %s\n",
+                          s_level_letter[e.lvl], (unsigned long)e.ts_ms, tag, line);
+        }
+    }
+}
+
+esp_err_t dlog_init(void)
+{
+    if (s_task) return ESP_OK;
+    if (task_manifest_create(TASK_DLOG, dlog_task, NULL, &s_task) != pdPASS) {
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    // Lo encolado antes de tener task
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+// ================== NIVELES ==================
+
+static int level_from_name(const char *name)
+{
+    for (int i = 0; i < (int)(sizeof(s_level_names) / sizeof(s_level_names[0])); i++) {
+        if (strcasecmp(name, s_level_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+bool dlog_set_level(const char *mod, const char *level)
+{
+    if (!mod || !level) return false;
+    int lvl = level_from_name(level);
+    if (lvl < 0) return false;
+
+    bool all = (strcmp(mod, "*") == 0);
+    bool found = false;
+    for (int m = 0; m < DLOG_MOD_COUNT; m++) {
+        if (!all && strcasecmp(mod, s_mods[m].name) != 0) continue;
+        dlog_levels[m] = (uint8_t)lvl;
+        esp_log_level_set(s_mods[m].tag, (esp_log_level_t)lvl);
+        found = true;
+    }
+    return found;
+}
+
+bool dlog_set_levels_json(const cJSON *obj)
+{
+    bool ok = true;
+    const cJSON *it = NULL;
+    cJSON_ArrayForEach(it, obj) {
+        if (!cJSON_IsString(it) || !dlog_set_level(it->string, it->valuestring)) {
+            ESP_LOGW("DLOG", "logLevels: entrada invalida '%s'",
+                     it->string ? it->string : "?");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void dlog_add_to_json(cJSON *root)
+{
+    cJSON *lv = cJSON_AddObjectToObject(root, "logLevels");
+    if (lv) {
+        for (int m = 0; m < DLOG_MOD_COUNT; m++) {
+            cJSON_AddStringToObject(lv, s_mods[m].name, s_level_names[dlog_levels[m]]);
+        }
+    }
+
+    uint32_t pending, drops;
+    portENTER_CRITICAL(&s_lock);
+    pending = s_head - s_tail;
+    drops = s_drops;
+    portEXIT_CRITICAL(&s_lock);
+
+    cJSON *d = cJSON_AddObjectToObject(root, "dlog");
+    if (!d) return;
+    cJSON_AddNumberToObject(d, "pending", pending);
+    cJSON_AddNumberToObject(d, "drops", drops);
+}
@@ -0,0 +1,119 @@
+// dlog.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "cJSON.h"
+
+// Log diferido para los caminos calientes (lectores, MQTT, pipeline).
+//
+// DLOG() no formatea: guarda el puntero al formato (su "id", vive en flash),
+// la hora y los argumentos en crudo en un ring en RAM, y la task "dlog"
+// (prioridad mínima) los formatea y los saca por ESP_LOG más tarde. En la
+// task que loguea sólo queda copiar ~100 bytes; el printf y la espera a la
+// UART pasan a la task de log.
+//
+// Argumentos soportados (máx. DLOG_MAX_ARGS, sin float ni %ll):
+//   enteros de hasta 32 bits       %d %i %u %x %X %o %c %p, con l/z/h y '*'
+//   char * / const char *          %s (se copia el texto, truncado)
+//   DLOG_STRN(p, n)                %s con longitud (topic/payload MQTT)
+//   DLOG_HEX(p, n)                 %s, se imprime en hex
+// El texto de todos los %s comparte DLOG_STR_SZ bytes por entrada; lo que
+// no cabe se corta y se marca con "~".
+//
+// Nivel por módulo en tiempo de ejecución (setConfig "logLevels"), que se
+// aplica también a los ESP_LOGx síncronos del módulo vía esp_log_level_set.
+
+typedef enum {
+    DLOG_MQTT = 0,
+    DLOG_RC522,
+    DLOG_GM861S,
+    DLOG_PIPE,
+    DLOG_CMD,
+    DLOG_MOD_COUNT
+} dlog_mod_t;
+
+#define DLOG_MAX_ARGS  6
+#define DLOG_STR_SZ    56
+#define DLOG_RING_LEN  64
+
+typedef struct {
+    const char *s;       // NULL = entero
+    uint32_t    v;       // valor, o longitud si s != NULL
+    uint8_t     kind;    // DLOG_K_*
+} dlog_arg_t;
+
+enum { DLOG_K_INT = 0, DLOG_K_STR, DLOG_K_STRN, DLOG_K_HEX };
+
+extern uint8_t dlog_levels[DLOG_MOD_COUNT];
+
+static inline bool dlog_enabled(dlog_mod_t mod, esp_log_level_t lvl)
+{
+    return (uint8_t)lvl <= dlog_levels[mod];
+}
+
+static inline dlog_arg_t dlog_arg_int(uint32_t v)      { return (dlog_arg_t){ .v = v }; }
+static inline dlog_arg_t dlog_arg_str(const char *s)   { return (dlog_arg_t){ .s = s ? s : "(null)", .kind = DLOG_K_STR }; }
+static inline dlog_arg_t dlog_arg_pass(dlog_arg_t a)   { return a; }
+
+#define DLOG_STRN(p, n) ((dlog_arg_t){ .s = (const char *)(p), .v = (uint32_t)(n), .kind = DLOG_K_STRN })
+#define DLOG_HEX(p, n)  ((dlog_arg_t){ .s = (const char *)(p), .v = (uint32_t)(n), .kind = DLOG_K_HEX })
+
+#define DLOG_ARG(x) _Generic((x),                  \
+        char *:       dlog_arg_str,                \
+        const char *: dlog_arg_str,                \
+        dlog_arg_t:   dlog_arg_pass,               \
+        default:      dlog_arg_int)(x)
+
+// Cuenta y empaqueta formato + hasta DLOG_MAX_ARGS argumentos
+#define DLOG_NARGS_(_f, _1, _2, _3, _4, _5, _6, N, ...) N
+#define DLOG_NARGS(...) DLOG_NARGS_(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0, _)
+#define DLOG_FMT_(f, ...) f
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+
+#define DLOG_PACK_0(f)                   ((const dlog_arg_t *)0)
+#define DLOG_PACK_1(f, a)                ((const dlog_arg_t[]){ DLOG_ARG(a) })
+#define DLOG_PACK_2(f, a, b)             ((const dlog_arg_t[]){ DLOG_ARG(a), DLOG_ARG(b) })
+#define DLOG_PACK_3(f, a, b, c)          ((const dlog_arg_t[]){ DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c) })
+#define DLOG_PACK_4(f, a, b, c, d)       ((const dlog_arg_t[]){ DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c), DLOG_ARG(d) })
+#define DLOG_PACK_5(f, a, b, c, d, e)    ((const dlog_arg_t[]){ DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c), DLOG_ARG(d), DLOG_ARG(e) })
+#define DLOG_PACK_6(f, a, b, c, d, e, g) ((const dlog_arg_t[]){ DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c), DLOG_ARG(d), DLOG_ARG(e), DLOG_ARG(g) })
+
+// DLOG(DLOG_RC522, ESP_LOG_INFO, "UID=%s block8='%s'", uid, user);
+// Los argumentos sólo se evalúan si el nivel del módulo lo deja pasar.
+#define DLOG(mod, lvl, ...) do {                                               \
+        if (dlog_enabled((mod), (lvl))) {                                      \
+            dlog_write((mod), (lvl), DLOG_FMT_(__VA_ARGS__, _),                \
+                       DLOG_NARGS(__VA_ARGS__),                                \
+                       DLOG_CAT(DLOG_PACK_, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__)); \
+        }                                                                      \
+    } while (0)
+
+#define DLOGE(mod, ...) DLOG(mod, ESP_LOG_ERROR,   __VA_ARGS__)
+#define DLOGW(mod, ...) DLOG(mod, ESP_LOG_WARN,    __VA_ARGS__)
+#define DLOGI(mod, ...) DLOG(mod, ESP_LOG_INFO,    __VA_ARGS__)
+#define DLOGD(mod, ...) DLOG(mod, ESP_LOG_DEBUG,   __VA_ARGS__)
+#define DLOGV(mod, ...) DLOG(mod, ESP_LOG_VERBOSE, __VA_ARGS__)
+
+// Encola una entrada (cualquier task o callback de esp_timer, no ISR).
+// Con el ring lleno se descarta y se cuenta.
+void dlog_write(dlog_mod_t mod, esp_log_level_t lvl, const char *fmt,
+                int nargs, const dlog_arg_t *args);
+
+// Crea la task de formateo. Lo que se loguee antes queda en el ring.
+esp_err_t dlog_init(void);
+
+// Nivel por nombre de módulo ("mqtt", "rc522", "gm861s", "pipe", "cmd" o
+// "*" para todos) y nivel ("none".."verbose"). false si alguno no existe.
+bool dlog_set_level(const char *mod, const char *level);
+
+// Aplica un objeto {"rc522":"debug", ...}. false si alguna entrada no vale
+// (las válidas se aplican igual).
+bool dlog_set_levels_json(const cJSON *obj);
+
+// Objetos "logLevels" y "dlog" (pending, drops) para getConfig
+void dlog_add_to_json(cJSON *root);
@@ -0,0 +1,304 @@
+// gm861s_config.c
+#include "gm861s_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "config.h"
+
+#include <string.h>
+
+static const char *TAG = "GM861S_CFG";
+
+#define CMD_HEAD0          0x7E
+#define CMD_HEAD1          0x00
+#define CMD_TYPE_READ      0x07
+#define CMD_TYPE_WRITE     0x08
+#define CMD_TYPE_SAVE      0x09
+
+#define RSP_HEAD0          0x02
+#define RSP_HEAD1          0x00
+#define RSP_STATUS_OK      0x00
+
+#define RSP_TIMEOUT_MS     300
+#define SAVE_TIMEOUT_MS    800    // escribir flash en el lector tarda más
+#define BAUD_SETTLE_MS     50     // el lector cambia de velocidad tras el ACK
+
+// Divisor que espera el lector en la zona 0x002A/0x002B (~3 MHz / baud)
+typedef struct {
+    uint32_t baud;
+    uint16_t code;
+} baud_code_t;
+
+static const baud_code_t s_baud_codes[] = {
+    {   9600, 0x0139 },
+    {  19200, 0x009C },
+    {  38400, 0x004E },
+    {  57600, 0x0034 },
+    { 115200, 0x001A },
+};
+
+#define BAUD_CODES_N  (sizeof(s_baud_codes) / sizeof(s_baud_codes[0]))
+
+// ================== CRC / TRAMAS ==================
+
+uint16_t gm861s_cfg_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void send_frame(uint8_t type, uint16_t addr, const uint8_t *data, uint8_t len)
+{
+    uint8_t f[6 + GM861S_CFG_MAX_ZONE_LEN + 2];
+    size_t n = 0;
+
+    f[n++] = CMD_HEAD0;
+    f[n++] = CMD_HEAD1;
+    f[n++] = type;
+    f[n++] = len;
+    f[n++] = (uint8_t)(addr >> 8);
+    f[n++] = (uint8_t)(addr & 0xFF);
+    memcpy(&f[n], data, len);
+    n += len;
+
+    uint16_t crc = gm861s_cfg_crc16(&f[2], n - 2);
+    f[n++] = (uint8_t)(crc >> 8);
+    f[n++] = (uint8_t)(crc & 0xFF);
+
+    // Lo que hubiera pendiente (QR a medias, respuestas viejas) estorba al ACK
+    uart_flush_input(GM861S_UART_PORT);
+    uart_write_bytes(GM861S_UART_PORT, f, n);
+    uart_wait_tx_done(GM861S_UART_PORT, pdMS_TO_TICKS(RSP_TIMEOUT_MS));
+}
+
+// Espera una respuesta 02 00 <estado> <len> <datos> <crc>. Se salta cualquier
+// byte previo (p.ej. un QR leído justo en ese momento). Devuelve la longitud
+// de datos, o -1 si no llega una respuesta válida a tiempo.
+static int recv_response(uint8_t *out, size_t cap, uint32_t timeout_ms)
+{
+    enum { H0, H1, ST, LEN, DATA, CRC_H, CRC_L } st = H0;
+    uint8_t hdr[2] = {0};
+    uint8_t data[GM861S_CFG_MAX_ZONE_LEN];
+    uint8_t len = 0, got = 0;
+    uint16_t crc_rx = 0;
+
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+
+    while (1) {
+        int64_t left_us = deadline - esp_timer_get_time();
+        if (left_us <= 0) return -1;
+
+        uint8_t b;
+        TickType_t t = pdMS_TO_TICKS(left_us / 1000);
+        if (uart_read_bytes(GM861S_UART_PORT, &b, 1, t ? t : 1) != 1) continue;
+
+        switch (st) {
+            case H0:    if (b == RSP_HEAD0) st = H1; break;
+            case H1:    st = (b == RSP_HEAD1) ? ST : (b == RSP_HEAD0 ? H1 : H0); break;
+            case ST:    hdr[0] = b; st = LEN; break;
+            case LEN:
+                hdr[1] = len = b;
+                got = 0;
+                if (len > sizeof(data)) { st = H0; break; }
+                st = len ? DATA : CRC_H;
+                break;
+            case DATA:
+                data[got++] = b;
+                if (got == len) st = CRC_H;
+                break;
+            case CRC_H: crc_rx = (uint16_t)b << 8; st = CRC_L; break;
+            case CRC_L: {
+                crc_rx |= b;
+                uint8_t tmp[2 + GM861S_CFG_MAX_ZONE_LEN];
+                memcpy(tmp, hdr, 2);
+                memcpy(tmp + 2, data, len);
+                if (gm861s_cfg_crc16(tmp, 2u + len) != crc_rx) {
+                    ESP_LOGW(TAG, "Respuesta con CRC erroneo, descartada");
+                    st = H0;
+                    break;
+                }
+                if (hdr[0] != RSP_STATUS_OK) {
+                    ESP_LOGW(TAG, "Respuesta con estado 0x%02X", hdr[0]);
+                    return -1;
+                }
+                size_t n = len < cap ? len : cap;
+                if (out && n) memcpy(out, data, n);
+                return len;
+            }
+        }
+    }
+}
+
+// ================== ZONAS ==================
+
+esp_err_t gm861s_cfg_read_zone(uint16_t addr, uint8_t *out, size_t len)
+{
+    if (len == 0 || len > GM861S_CFG_MAX_ZONE_LEN) return ESP_ERR_INVALID_ARG;
+
+    // En lectura el byte de datos es el número de bytes a leer
+    uint8_t n = (uint8_t)len;
+    send_frame(CMD_TYPE_READ, addr, &n, 1);
+
+    int r = recv_response(out, len, RSP_TIMEOUT_MS);
+    if (r < 0) return ESP_ERR_TIMEOUT;
+    if ((size_t)r != len) return ESP_ERR_INVALID_RESPONSE;
+    return ESP_OK;
+}
+
+esp_err_t gm861s_cfg_write_zone(uint16_t addr, const uint8_t *data, size_t len)
+{
+    if (len == 0 || len > GM861S_CFG_MAX_ZONE_LEN) return ESP_ERR_INVALID_ARG;
+
+    send_frame(CMD_TYPE_WRITE, addr, data, (uint8_t)len);
+
+    // ACK de escritura: 02 00 00 01 00 33 31
+    uint8_t ack = 0xFF;
+    int r = recv_response(&ack, 1, RSP_TIMEOUT_MS);
+    if (r != 1 || ack != 0x00) {
+        ESP_LOGW(TAG, "Zona 0x%04X: sin ACK", addr);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint8_t rb[GM861S_CFG_MAX_ZONE_LEN];
+    esp_err_t err = gm861s_cfg_read_zone(addr, rb, len);
+    if (err != ESP_OK) return err;
+    if (memcmp(rb, data, len) != 0) {
+        ESP_LOGW(TAG, "Zona 0x%04X: verificacion fallida", addr);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "Zona 0x%04X escrita y verificada (%u bytes)", addr, (unsigned)len);
+    return ESP_OK;
+}
+
+esp_err_t gm861s_cfg_ensure_zone(uint16_t addr, uint8_t value, bool *changed)
+{
+    if (changed) *changed = false;
+
+    uint8_t cur;
+    esp_err_t err = gm861s_cfg_read_zone(addr, &cur, 1);
+    if (err == ESP_OK && cur == value) return ESP_OK;
+
+    err = gm861s_cfg_write_zone(addr, &value, 1);
+    if (err == ESP_OK && changed) *changed = true;
+    return err;
+}
+
+esp_err_t gm861s_cfg_save_flash(void)
+{
+    // 7E 00 09 01 00 00 00 DE C8
+    uint8_t zero = 0x00;
+    send_frame(CMD_TYPE_SAVE, 0x0000, &zero, 1);
+
+    uint8_t ack = 0xFF;
+    int r = recv_response(&ack, 1, SAVE_TIMEOUT_MS);
+    if (r != 1 || ack != 0x00) {
+        ESP_LOGW(TAG, "Guardado en flash del lector sin ACK");
+        return ESP_ERR_TIMEOUT;
+    }
+    ESP_LOGI(TAG, "Config del lector guardada en su flash");
+    return ESP_OK;
+}
+
+// ================== BAUD ==================
+
+static const baud_code_t *find_baud(uint32_t baud)
+{
+    for (size_t i = 0; i < BAUD_CODES_N; i++) {
+        if (s_baud_codes[i].baud == baud) return &s_baud_codes[i];
+    }
+    return NULL;
+}
+
+bool gm861s_cfg_baud_supported(uint32_t baud)
+{
+    return find_baud(baud) != NULL;
+}
+
+bool gm861s_cfg_probe(void)
+{
+    uint8_t v;
+    return gm861s_cfg_read_zone(GM861S_ZONE_SERIAL_OUT, &v, 1) == ESP_OK;
+}
+
+uint32_t gm861s_cfg_detect_baud(uint32_t preferred)
+{
+    if (find_baud(preferred)) {
+        uart_set_baudrate(GM861S_UART_PORT, preferred);
+        if (gm861s_cfg_probe()) return preferred;
+    }
+
+    // De la más rápida a la más lenta: tras un fallo de negociación lo más
+    // probable es que el lector siga en la de fábrica, pero da igual el orden
+    for (int i = (int)BAUD_CODES_N - 1; i >= 0; i--) {
+        uint32_t b = s_baud_codes[i].baud;
+        if (b == preferred) continue;
+        uart_set_baudrate(GM861S_UART_PORT, b);
+        if (gm861s_cfg_probe()) {
+            ESP_LOGI(TAG, "Lector detectado a %lu baud", (unsigned long)b);
+            return b;
+        }
+    }
+
+    ESP_LOGE(TAG, "El lector no responde a ninguna velocidad");
+    return 0;
+}
+
+static bool send_baud_cmd(uint32_t baud)
+{
+    const baud_code_t *bc = find_baud(baud);
+    if (!bc) return false;
+
+    uint8_t v[2] = { (uint8_t)(bc->code & 0xFF), (uint8_t)(bc->code >> 8) };
+    send_frame(CMD_TYPE_WRITE, GM861S_ZONE_BAUD_L, v, sizeof(v));
+
+    // El ACK sale todavía a la velocidad vieja
+    uint8_t ack = 0xFF;
+    return recv_response(&ack, 1, RSP_TIMEOUT_MS) == 1 && ack == 0x00;
+}
+
+esp_err_t gm861s_cfg_switch_baud(uint32_t cur_baud, uint32_t new_baud)
+{
+    if (!find_baud(cur_baud) || !find_baud(new_baud)) return ESP_ERR_INVALID_ARG;
+    if (cur_baud == new_baud) return ESP_OK;
+
+    ESP_LOGI(TAG, "Cambiando enlace %lu -> %lu baud",
+             (unsigned long)cur_baud, (unsigned long)new_baud);
+
+    if (!send_baud_cmd(new_baud)) {
+        ESP_LOGW(TAG, "El lector no confirmo el cambio de baud");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(BAUD_SETTLE_MS));
+    uart_set_baudrate(GM861S_UART_PORT, new_baud);
+
+    if (gm861s_cfg_probe()) {
+        ESP_LOGI(TAG, "Enlace verificado a %lu baud", (unsigned long)new_baud);
+        return ESP_OK;
+    }
+
+    // Rollback: pedimos la velocidad vieja a la nueva (puede que a medias se
+    // entienda) y volvemos la UART. Si aun así no responde, el lector vuelve
+    // solo a la velocidad guardada en su flash en el próximo reset.
+    ESP_LOGW(TAG, "Enlace a %lu baud no verificado, rollback a %lu",
+             (unsigned long)new_baud, (unsigned long)cur_baud);
+    send_baud_cmd(cur_baud);
+    vTaskDelay(pdMS_TO_TICKS(BAUD_SETTLE_MS));
+    uart_set_baudrate(GM861S_UART_PORT, cur_baud);
+
+    if (!gm861s_cfg_probe()) {
+        ESP_LOGE(TAG, "Rollback sin respuesta del lector");
+    }
+    return ESP_FAIL;
+}
@@ -0,0 +1,55 @@
+// gm861s_config.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Protocolo de configuración del GM861S (zonas de configuración).
+//
+//   Comando:   7E 00 <tipo> <len> <addrH> <addrL> <datos...> <crcH> <crcL>
+//   Respuesta: 02 00 <estado> <len> <datos...> <crcH> <crcL>
+//
+// CRC-16/XMODEM (poly 0x1021, init 0) sobre tipo..datos (comando) o
+// estado..datos (respuesta). Los cambios de zona son volátiles hasta que se
+// guardan en la flash del lector con gm861s_cfg_save_flash().
+//
+// Estas funciones hacen E/S síncrona sobre la UART: quien las llame tiene que
+// ser el dueño de la UART en ese momento (la task del lector o su init).
+
+// Zonas con significado para el firmware
+#define GM861S_ZONE_SERIAL_OUT   0x0060   // salida serie: protocolo / CRLF / cola
+#define GM861S_ZONE_BAUD_L       0x002A   // divisor de baud, 2 bytes little endian
+#define GM861S_ZONE_BAUD_H       0x002B
+#define GM861S_SERIAL_CFG_VALUE  0x21     // with protocol + CRLF + tail enabled
+
+#define GM861S_CFG_MAX_ZONE_LEN  8
+
+uint16_t gm861s_cfg_crc16(const uint8_t *data, size_t len);
+
+// Lee/escribe zonas. La escritura espera el ACK y relee para verificar.
+esp_err_t gm861s_cfg_read_zone(uint16_t addr, uint8_t *out, size_t len);
+esp_err_t gm861s_cfg_write_zone(uint16_t addr, const uint8_t *data, size_t len);
+
+// Escribe sólo si el valor actual difiere. *changed indica si se escribió.
+esp_err_t gm861s_cfg_ensure_zone(uint16_t addr, uint8_t value, bool *changed);
+
+// Vuelca las zonas actuales a la flash del lector (persisten tras reset)
+esp_err_t gm861s_cfg_save_flash(void);
+
+// true si baud es uno de los soportados por el lector
+bool gm861s_cfg_baud_supported(uint32_t baud);
+
+// Comprueba que el lector responde a la velocidad actual de la UART
+bool gm861s_cfg_probe(void);
+
+// Busca la velocidad a la que está el lector (prueba la preferida primero).
+// Deja la UART a esa velocidad. 0 si no responde a ninguna.
+uint32_t gm861s_cfg_detect_baud(uint32_t preferred);
+
+// Cambia lector + UART de cur_baud a new_baud y verifica el enlace.
+// Si la verificación falla vuelve a cur_baud (el cambio no se ha guardado
+// en flash, así que un reset del lector también lo deshace).
+esp_err_t gm861s_cfg_switch_baud(uint32_t cur_baud, uint32_t new_baud);
@@ -3,15 +3,21 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "cJSON.h"
 
-#include "core.h"
-#include "mqtt_manager.h"
 #include "config.h"
+#include "app_config.h"
+#include "qr_scanner.h"
+#include "gm861s_config.h"
+#include "access_pipeline.h"
+#include "dlog.h"
+#include "task_manifest.h"
 
 #include <string.h>
 #include <stdbool.h>
@@ -19,24 +25,28 @@
 
 static const char *TAG = "GM861S";
 
-#define UART_BUF_SZ        1024
-#define QR_DEBOUNCE_MS     1200
+// Eventos del driver UART: la task duerme en la cola hasta que llega un fin
+// de línea (pattern detect) o salta el timeout RX tras una ráfaga
+#define GM861S_UART_EVT_QUEUE_LEN  20
+#define GM861S_UART_RX_TOUT_SYM    3
 
-// ===== DEBUG =====
-// 1 -> loguea RX bytes + hexdump
-#define GM861S_LOG_RX_HEX  1
-
-static TaskHandle_t s_task = NULL;
+static TaskHandle_t     s_task = NULL;
+static QueueHandle_t    s_uart_queue = NULL;
+static QueueHandle_t    s_ctl_queue = NULL;    // órdenes a la task (gm861s_ctl_t)
+static QueueSetHandle_t s_evt_set = NULL;      // UART + órdenes: la task duerme en el set
 
 typedef struct {
-    char last[256];
-    int64_t last_ts_us;
-} qr_debounce_t;
+    uint32_t uart_ovf;
+    uint32_t frames;
+} gm861s_stats_t;
+
+static gm861s_stats_t s_stats = {0};
 
-static qr_debounce_t s_db = {0};
+// Estado del parser: vive fuera del stack de la task para conservar tramas
+// parciales entre lecturas
+static qr_ring_t    s_ring;
+static qr_scanner_t s_scan;
 
-#define GM861S_ZONE_SERIAL_OUT   0x0060
-#define GM861S_SERIAL_CFG_VALUE  0x21 // with protocol + CRLF + tail enabled
 
 static bool is_printable_ascii(const char *s) {
     for (; *s; s++) {
@@ -50,267 +60,343 @@ static bool looks_like_url(const char *s) {
     return (strstr(s, "http://") == s) || (strstr(s, "https://") == s);
 }
 
-static void gm861s_send_cmd(const uint8_t *cmd, size_t len)
+// ================== CONFIGURACIÓN DEL LECTOR ==================
+
+// Órdenes a la task por su propia cola, nunca por la del driver UART: así
+// la configuración y la parada corren en el mismo hilo que lee la UART y
+// vaciar los eventos de datos no se las lleva por delante
+typedef enum {
+    GM861S_CTL_CONFIG = 1 << 0,
+    GM861S_CTL_STOP   = 1 << 1,
+} gm861s_ctl_t;
+
+// Una CONFIG que expiró más la STOP que llegue después
+#define GM861S_CTL_QUEUE_LEN  2
+
+// Una configuración en curso puede tener a la task varios segundos ocupada
+#define GM861S_STOP_TIMEOUT_MS  2000
+
+static uint32_t            s_link_baud = 0;
+static SemaphoreHandle_t   s_cfg_lock = NULL;
+static SemaphoreHandle_t   s_cfg_done = NULL;
+static SemaphoreHandle_t   s_task_done = NULL;
+static gm861s_cfg_req_t    s_cfg_req;
+static gm861s_cfg_result_t s_cfg_res;
+
+// Órdenes recogidas del set mientras se vaciaban eventos (sólo la task)
+static uint32_t s_ctl_pending = 0;
+
+// Zonas que gestiona el firmware: cambiarlas a mano rompería el parser o el enlace
+static bool zone_is_reserved(uint16_t addr)
 {
-    int w = uart_write_bytes(GM861S_UART_PORT, (const char *)cmd, len);
-    ESP_LOGI(TAG, "TX cmd %d bytes", w);
-    ESP_LOG_BUFFER_HEXDUMP(TAG, cmd, len, ESP_LOG_INFO);
+    return addr == GM861S_ZONE_SERIAL_OUT ||
+           addr == GM861S_ZONE_BAUD_L ||
+           addr == GM861S_ZONE_BAUD_H;
 }
 
-static void gm861s_write_zone(uint16_t addr, uint8_t value)
+// Saca del set los eventos UART ya encolados (se refieren a bytes que se
+// acaban de tirar). Se lee por el set y no de la cola directamente: si no,
+// el set guardaría avisos de eventos que ya no existen hasta desbordarse.
+// Una orden que aparezca por el camino se guarda en s_ctl_pending.
+static void gm861s_drop_uart_events(void)
 {
-    uint8_t cmd[] = {
-        0x7E, 0x00, 0x08, 0x01,
-        (uint8_t)(addr >> 8), (uint8_t)(addr & 0xFF),
-        value,
-        0xAB, 0xCD
-    };
-    gm861s_send_cmd(cmd, sizeof(cmd));
+    QueueSetMemberHandle_t h;
+    while ((h = xQueueSelectFromSet(s_evt_set, 0)) != NULL) {
+        if (h == s_uart_queue) {
+            uart_event_t ev;
+            xQueueReceive(s_uart_queue, &ev, 0);
+        } else {
+            uint8_t ctl;
+            if (xQueueReceive(s_ctl_queue, &ctl, 0) == pdTRUE) s_ctl_pending |= ctl;
+        }
+    }
 }
 
-static void gm861s_apply_prod_config(void)
+// Tras hablar con el lector quedan ACKs y eventos en la UART que no son QR
+static void gm861s_resync(void)
 {
-    ESP_LOGI(TAG, "Aplicando config salida serie: zone 0x%04X = 0x%02X",
-             GM861S_ZONE_SERIAL_OUT, GM861S_SERIAL_CFG_VALUE);
-
-    gm861s_write_zone(GM861S_ZONE_SERIAL_OUT, GM861S_SERIAL_CFG_VALUE);
-
-    // Dale un pelín de tiempo y limpia lo que haya quedado de respuestas binarias
-    vTaskDelay(pdMS_TO_TICKS(80));
     uart_flush_input(GM861S_UART_PORT);
+    uart_pattern_queue_reset(GM861S_UART_PORT, GM861S_UART_EVT_QUEUE_LEN);
+    gm861s_drop_uart_events();
+    qr_ring_reset(&s_ring);
+    qr_scanner_reset(&s_scan);
 }
 
-static bool should_publish_qr(const char *text)
+static void gm861s_persist_baud(uint32_t baud)
 {
-    int64_t now = esp_timer_get_time();
-    int64_t dt_ms = (now - s_db.last_ts_us) / 1000;
-
-    if (s_db.last[0] != '\0' &&
-        strcmp(s_db.last, text) == 0 &&
-        dt_ms < QR_DEBOUNCE_MS) {
-        return false;
+    if (g_app_config.qr_baud != (int)baud) {
+        g_app_config.qr_baud = (int)baud;
+        app_config_save();
     }
-
-    strncpy(s_db.last, text, sizeof(s_db.last) - 1);
-    s_db.last[sizeof(s_db.last) - 1] = '\0';
-    s_db.last_ts_us = now;
-    return true;
 }
 
-// ===== PARSER: protocolo <0x03><len><data> =====
-static bool try_parse_protocol_frame(uint8_t *buf, int *len, char *out, size_t out_sz)
+// Arranque: localiza al lector, asegura la salida serie y sube la velocidad
+static void gm861s_bring_up(void)
 {
-    if (*len < 2) return false;
-
-    // Buscar 0x03
-    int stx = -1;
-    for (int i = 0; i < *len; i++) {
-        if (buf[i] == 0x03) { stx = i; break; }
-    }
-    if (stx < 0) {
-        // no hay STX -> no tiramos todo el buffer; podría ser binario o parcial
-        // pero si se llena de basura, podríamos recortar. Por ahora, conservador:
-        return false;
+    uint32_t want = gm861s_cfg_baud_supported((uint32_t)g_app_config.qr_baud)
+                        ? (uint32_t)g_app_config.qr_baud : GM861S_BAUD_FAST;
+
+    uint32_t cur = gm861s_cfg_detect_baud(want);
+    if (cur == 0) {
+        // Lector mudo: dejamos la UART a la de fábrica por si aparece luego
+        uart_set_baudrate(GM861S_UART_PORT, GM861S_BAUD);
+        s_link_baud = 0;
+        return;
     }
 
-    // Descartar basura antes de 0x03
-    if (stx > 0) {
-        memmove(buf, buf + stx, *len - stx);
-        *len -= stx;
-        if (*len < 2) return false;
-    }
+    bool dirty = false, changed = false;
 
-    uint8_t pay_len = buf[1];
-    if (pay_len == 0 || pay_len > 250) {
-        // frame raro, descartar 0x03 y seguir
-        memmove(buf, buf + 1, *len - 1);
-        *len -= 1;
-        return false;
+    ESP_LOGI(TAG, "Config salida serie: zone 0x%04X = 0x%02X",
+             GM861S_ZONE_SERIAL_OUT, GM861S_SERIAL_CFG_VALUE);
+    if (gm861s_cfg_ensure_zone(GM861S_ZONE_SERIAL_OUT, GM861S_SERIAL_CFG_VALUE,
+                               &changed) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo fijar la salida serie del lector");
     }
+    dirty |= changed;
 
-    if (*len < (2 + pay_len)) return false; // esperar más
-
-    int copy = (pay_len < (out_sz - 1)) ? pay_len : (out_sz - 1);
-    memcpy(out, &buf[2], copy);
-    out[copy] = '\0';
+    if (cur != want && gm861s_cfg_switch_baud(cur, want) == ESP_OK) {
+        cur = want;
+        dirty = true;
+    }
 
-    // Consumir frame completo
-    int consumed = 2 + pay_len;
-    memmove(buf, buf + consumed, *len - consumed);
-    *len -= consumed;
+    // Sólo se toca la flash del lector cuando algo cambió de verdad
+    if (dirty) gm861s_cfg_save_flash();
 
-    return true;
+    s_link_baud = cur;
+    gm861s_persist_baud(cur);
+    ESP_LOGI(TAG, "Enlace con el lector a %lu baud", (unsigned long)cur);
 }
 
-static bool try_parse_line(uint8_t *buf, int *len, char *out, size_t out_sz)
+static void gm861s_handle_config(void)
 {
-    for (int i = 0; i < *len; i++) {
-        if (buf[i] == '\n' || buf[i] == '\r' || buf[i] == '\t') {
-            int n = i;
-
-            // Trim final
-            while (n > 0 && (buf[n-1] == '\r' || buf[n-1] == '\n' || buf[n-1] == '\t' || buf[n-1] == ' '))
-                n--;
-
-            // **Nuevo**: valida que sea mayormente ASCII imprimible
-            int printable = 0;
-            for (int k = 0; k < n; k++) {
-                if (buf[k] >= 0x20 && buf[k] <= 0x7E) printable++;
-            }
-            // si menos del 80% es imprimible, lo descartamos como "línea binaria"
-            if (n == 0 || printable * 100 / n < 80) {
-                // consumir separadores y descartar
-                int j = i + 1;
-                while (j < *len && (buf[j] == '\n' || buf[j] == '\r' || buf[j] == '\t')) j++;
-                memmove(buf, buf + j, *len - j);
-                *len -= j;
-                return false;
-            }
-
-            int copy = (n < (int)out_sz - 1) ? n : (int)out_sz - 1;
-            memcpy(out, buf, copy);
-            out[copy] = '\0';
-
-            int j = i + 1;
-            while (j < *len && (buf[j] == '\n' || buf[j] == '\r' || buf[j] == '\t')) j++;
-            memmove(buf, buf + j, *len - j);
-            *len -= j;
-
-            return copy > 0;
+    const gm861s_cfg_req_t *rq = &s_cfg_req;
+    gm861s_cfg_result_t *rs = &s_cfg_res;
+    bool dirty = false;
+
+    memset(rs, 0, sizeof(*rs));
+    rs->err = ESP_OK;
+
+    if (s_link_baud == 0) {
+        s_link_baud = gm861s_cfg_detect_baud(GM861S_BAUD);
+        if (s_link_baud == 0) {
+            rs->err = ESP_ERR_NOT_FOUND;
+            goto done;
         }
     }
-    return false;
-}
 
-// Fallback: busca la “mejor” racha ASCII imprimible (>=4 chars)
-static bool extract_printable(uint8_t *buf, int *len, char *out, size_t out_sz)
-{
-    int best_s = -1, best_e = -1;
-    int i = 0;
-
-    while (i < *len) {
-        while (i < *len && (buf[i] < 0x20 || buf[i] > 0x7E)) i++;
-        int s = i;
-        while (i < *len && (buf[i] >= 0x20 && buf[i] <= 0x7E)) i++;
-        int e = i;
-
-        if (e - s >= 4 && (best_s < 0 || (e - s) > (best_e - best_s))) {
-            best_s = s;
-            best_e = e;
+    for (int i = 0; i < rq->n_zones && i < GM861S_CFG_MAX_ZONES; i++) {
+        bool changed = false;
+        uint16_t addr = rq->zones[i].addr;
+
+        if (zone_is_reserved(addr)) {
+            ESP_LOGW(TAG, "Zona 0x%04X reservada, ignorada", addr);
+            if (rs->err == ESP_OK) rs->err = ESP_ERR_INVALID_ARG;
+            continue;
+        }
+        esp_err_t e = gm861s_cfg_ensure_zone(addr, rq->zones[i].value, &changed);
+        if (e == ESP_OK) {
+            rs->zones_ok++;
+            dirty |= changed;
+        } else if (rs->err == ESP_OK) {
+            rs->err = e;
         }
     }
 
-    if (best_s < 0) return false;
-
-    int n = best_e - best_s;
-    if (n > (int)out_sz - 1) n = (int)out_sz - 1;
-    memcpy(out, buf + best_s, n);
-    out[n] = '\0';
+    if (rq->baud && rq->baud != s_link_baud) {
+        esp_err_t e = gm861s_cfg_switch_baud(s_link_baud, rq->baud);
+        if (e == ESP_OK) {
+            s_link_baud = rq->baud;
+            dirty = true;
+        } else if (rs->err == ESP_OK) {
+            rs->err = e;
+        }
+    }
 
-    // Consume hasta best_e para no quedarnos atascados
-    memmove(buf, buf + best_e, *len - best_e);
-    *len -= best_e;
+    if (dirty && gm861s_cfg_save_flash() != ESP_OK && rs->err == ESP_OK) {
+        rs->err = ESP_FAIL;
+    }
+    gm861s_persist_baud(s_link_baud);
 
-    return true;
+done:
+    rs->baud = s_link_baud;
+    gm861s_resync();
+    xSemaphoreGive(s_cfg_done);
 }
 
-static void publish_qr_event(const char *qr_text)
+esp_err_t gm861s_reader_configure(const gm861s_cfg_req_t *req,
+                                  gm861s_cfg_result_t *res,
+                                  uint32_t timeout_ms)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) return;
-
-    cJSON_AddStringToObject(root, "action", "getAccessTorn");
-    cJSON_AddStringToObject(root, "type",   "QR");
-    cJSON_AddStringToObject(root, "cardId", qr_text);
-    cJSON_AddStringToObject(root, "user",   "");
-    cJSON_AddStringToObject(root, "name",   device_id);
-    cJSON_AddStringToObject(root, "idTorno", id_torno);
-
-    char *json = cJSON_PrintUnformatted(root);
-    if (json) {
-        ESP_LOGI(TAG, "QR -> '%s'", qr_text);
-        ESP_LOGI(TAG, "MQTT enqueue -> topic='%s' payload=%s", TOPIC_RESP_FIXED, json);
-
-        mqtt_enqueue(TOPIC_RESP_FIXED, json, 1, 0);
-        cJSON_free(json);
+    if (!req) return ESP_ERR_INVALID_ARG;
+    if (!s_task || !s_uart_queue || !s_ctl_queue) return ESP_ERR_INVALID_STATE;
+    if (req->baud && !gm861s_cfg_baud_supported(req->baud)) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_cfg_lock, portMAX_DELAY);
+
+    // Descarta un "done" de una petición anterior que expiró
+    xSemaphoreTake(s_cfg_done, 0);
+    s_cfg_req = *req;
+
+    esp_err_t err = ESP_ERR_TIMEOUT;
+    uint8_t ctl = GM861S_CTL_CONFIG;
+    if (xQueueSend(s_ctl_queue, &ctl, pdMS_TO_TICKS(100)) == pdTRUE &&
+        xSemaphoreTake(s_cfg_done, pdMS_TO_TICKS(timeout_ms)) == pdTRUE) {
+        if (res) *res = s_cfg_res;
+        err = s_cfg_res.err;
     } else {
-        ESP_LOGW(TAG, "No se pudo serializar JSON");
+        ESP_LOGW(TAG, "Configuracion del lector sin respuesta de la task");
     }
 
-    cJSON_Delete(root);
+    xSemaphoreGive(s_cfg_lock);
+    return err;
 }
 
-static void gm861s_task(void *pv)
+uint32_t gm861s_reader_baud(void)
 {
-    (void)pv;
-
-    uint8_t rx[UART_BUF_SZ];
-    int rx_len = 0;
+    return s_link_baud;
+}
 
-    ESP_LOGI(TAG, "GM861S task (UART=%d TX=%d RX=%d baud=%d)",
-             GM861S_UART_PORT, GM861S_UART_TX, GM861S_UART_RX, GM861S_BAUD);
+// Vacía el buffer del driver al ring. Se llama por evento, nunca en polling:
+// lee exactamente lo que hay, sin timeout
+static void gm861s_drain_uart(uint32_t *dropped_logged)
+{
+    size_t avail = 0;
+    uart_get_buffered_data_len(GM861S_UART_PORT, &avail);
 
-    while (1) {
+    while (avail > 0) {
         uint8_t tmp[128];
-        int n = uart_read_bytes(GM861S_UART_PORT, tmp, sizeof(tmp), pdMS_TO_TICKS(200));
-
-        if (n > 0) {
-            #if GM861S_LOG_RX_HEX
-                ESP_LOGI(TAG, "RX %d bytes", n);
-                ESP_LOG_BUFFER_HEXDUMP(TAG, tmp, n, ESP_LOG_INFO);
-            #endif
-            if (rx_len > 0) ESP_LOGI(TAG, "rx_len=%d", rx_len);
-            int space = UART_BUF_SZ - rx_len;
-            int to_copy = (n < space) ? n : space;
-            if (to_copy > 0) {
-                memcpy(rx + rx_len, tmp, to_copy);
-                rx_len += to_copy;
-            } else {
-                // buffer lleno -> resetea para evitar quedarse colgado
-                rx_len = 0;
-            }
-        }
+        size_t chunk = avail < sizeof(tmp) ? avail : sizeof(tmp);
+        int n = uart_read_bytes(GM861S_UART_PORT, tmp, chunk, 0);
+        if (n <= 0) break;
+
+        // Volcado de lo recibido sólo con gm861s a "verbose" (logLevels)
+        DLOGV(DLOG_GM861S, "RX %d bytes: %s", n, DLOG_HEX(tmp, n));
+        qr_ring_write(&s_ring, tmp, n);
+        avail -= (size_t)n;
+    }
 
-        // Procesa “todos los mensajes posibles” acumulados en rx
-        while (1) {
-            char qr[256] = {0};
-            bool got = false;
-            const char *src = NULL;
+    // Las posiciones de patrón no se usan (el scanner ya busca CR/LF), pero
+    // hay que sacarlas o la cola del driver se llena y deja de avisar
+    while (uart_pattern_pop_pos(GM861S_UART_PORT) != -1) { }
 
-            if (try_parse_protocol_frame(rx, &rx_len, qr, sizeof(qr))) {
-                got = true; src = "PROTO";
-            } else if (try_parse_line(rx, &rx_len, qr, sizeof(qr))) {
-                got = true; src = "LINE";
-            }
+    if (s_ring.dropped != *dropped_logged) {
+        ESP_LOGW(TAG, "Ring RX lleno, %lu bytes perdidos",
+                 (unsigned long)(s_ring.dropped - *dropped_logged));
+        *dropped_logged = s_ring.dropped;
+    }
+}
 
-            // Si quieres mantener extract_printable, ponlo SOLO cuando el buffer crezca mucho
-            // y no haya forma de parsear:
-            // else if (rx_len > 200 && extract_printable(rx, &rx_len, qr, sizeof(qr))) { ... }
+static void gm861s_task(void *pv)
+{
+    (void)pv;
 
-            if (!got) break;
-            if (qr[0] == '\0') continue;
+    uint32_t dropped_logged = 0;
+    bool running = true;
+
+    // La detección de baudios tarda segundos con el lector mudo: se hace
+    // aquí y no en gm861s_reader_init, que también llama setConfig desde la
+    // task de comandos
+    s_ctl_pending = 0;
+    gm861s_bring_up();
+    gm861s_resync();
+
+    ESP_LOGI(TAG, "GM861S task (UART=%d TX=%d RX=%d baud=%lu)",
+             GM861S_UART_PORT, GM861S_UART_TX, GM861S_UART_RX,
+             (unsigned long)s_link_baud);
+
+    while (running) {
+        // Órdenes primero: STOP no espera a los datos pendientes
+        if (s_ctl_pending & GM861S_CTL_STOP) {
+            running = false;
+            continue;
+        }
+        if (s_ctl_pending & GM861S_CTL_CONFIG) {
+            s_ctl_pending &= ~(uint32_t)GM861S_CTL_CONFIG;
+            gm861s_handle_config();
+            continue;
+        }
 
-            ESP_LOGI(TAG, "QR detectado (%s): '%s'", src, qr);
+        QueueSetMemberHandle_t h = xQueueSelectFromSet(s_evt_set, portMAX_DELAY);
+        if (h == s_ctl_queue) {
+            uint8_t ctl;
+            if (xQueueReceive(s_ctl_queue, &ctl, 0) == pdTRUE) s_ctl_pending |= ctl;
+            continue;
+        }
 
-            if (!should_publish_qr(qr)) {
-                ESP_LOGI(TAG, "QR repetido (debounce), ignorado");
+        uart_event_t ev;
+        if (h != s_uart_queue || xQueueReceive(s_uart_queue, &ev, 0) != pdTRUE) continue;
+
+        // Instante en que el driver nos entrega el fin de trama: la latencia
+        // escaneo->cola se mide desde aquí hasta el mqtt_enqueue
+        int64_t t_evt = esp_timer_get_time();
+
+        switch (ev.type) {
+            case UART_DATA:
+            case UART_PATTERN_DET:
+                gm861s_drain_uart(&dropped_logged);
+                break;
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                // Lo que hay en el driver ya está incompleto: descartar y
+                // resincronizar el scanner en el próximo CR/LF o cabecera
+                s_stats.uart_ovf++;
+                ESP_LOGW(TAG, "UART overflow (%s), flush",
+                         ev.type == UART_FIFO_OVF ? "FIFO" : "buffer");
+                uart_flush_input(GM861S_UART_PORT);
+                gm861s_drop_uart_events();
+                qr_scanner_reset(&s_scan);
                 continue;
-            }
 
-            if (s_mqtt_connected) {
-                publish_qr_event(qr);
-            } else {
-                ESP_LOGW(TAG, "MQTT no conectado -> no publico, pero QR detectado");
-            }
+            default:
+                continue;
         }
 
-
-        vTaskDelay(pdMS_TO_TICKS(10));
+        // Procesa todos los mensajes completos que haya en el ring;
+        // lo que quede a medias sigue en s_scan hasta el próximo evento.
+        // Dedup, gating y publicación son cosa del pipeline de credenciales.
+        while (1) {
+            credential_t cred = {
+                .lane        = ACCESS_LANE_QR,
+                .source      = CRED_SRC_QR,
+                .t_detect_us = t_evt,
+            };
+            qr_src_t src = qr_scanner_next(&s_scan, &s_ring, cred.id, sizeof(cred.id));
+
+            if (src == QR_SRC_NONE) break;
+            if (cred.id[0] == '\0') continue;
+
+            DLOGI(DLOG_GM861S, "QR detectado (%s): '%s'",
+                  src == QR_SRC_PROTO ? "PROTO" : "LINE", cred.id);
+            s_stats.frames++;
+            access_pipeline_submit(&cred);
+        }
     }
+
+    // La UART la suelta quien pidió la parada, ya sin nadie leyendo
+    ESP_LOGI(TAG, "GM861S task detenida");
+    xSemaphoreGive(s_task_done);
+    task_manifest_exit(TASK_GM861S);
 }
 
 esp_err_t gm861s_reader_init(void)
 {
+    if (s_uart_queue) return ESP_OK;   // ya inicializado
+
+    // Viven entre paradas y arranques; la cola del driver se añade al set en
+    // cada init y se quita en cada stop
+    if (!s_cfg_lock) {
+        s_cfg_lock  = xSemaphoreCreateMutex();
+        s_cfg_done  = xSemaphoreCreateBinary();
+        s_task_done = xSemaphoreCreateBinary();
+        s_ctl_queue = xQueueCreate(GM861S_CTL_QUEUE_LEN, sizeof(uint8_t));
+        s_evt_set   = xQueueCreateSet(GM861S_UART_EVT_QUEUE_LEN + GM861S_CTL_QUEUE_LEN);
+        if (!s_cfg_lock || !s_cfg_done || !s_task_done || !s_ctl_queue || !s_evt_set ||
+            xQueueAddToSet(s_ctl_queue, s_evt_set) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     uart_config_t cfg = {
         .baud_rate = GM861S_BAUD,
         .data_bits = UART_DATA_8_BITS,
@@ -319,21 +405,115 @@ esp_err_t gm861s_reader_init(void)
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
     };
 
-    ESP_ERROR_CHECK(uart_driver_install(GM861S_UART_PORT, 4096, 0, 0, NULL, 0));
-    ESP_ERROR_CHECK(uart_param_config(GM861S_UART_PORT, &cfg));
-    ESP_ERROR_CHECK(uart_set_pin(GM861S_UART_PORT, GM861S_UART_TX, GM861S_UART_RX,
-                                 UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    // Con arranque en caliente (setConfig) un fallo no puede tumbar el equipo:
+    // se devuelve el error y la UART queda libre
+    esp_err_t err = uart_driver_install(GM861S_UART_PORT, 4096, 0,
+                                        GM861S_UART_EVT_QUEUE_LEN, &s_uart_queue, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "uart_driver_install: %s", esp_err_to_name(err));
+        s_uart_queue = NULL;
+        return err;
+    }
+    err = uart_param_config(GM861S_UART_PORT, &cfg);
+    if (err == ESP_OK) err = uart_set_pin(GM861S_UART_PORT, GM861S_UART_TX, GM861S_UART_RX,
+                                          UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+    // Fin de línea -> evento inmediato (UART_PATTERN_DET) en cuanto llega el LF
+    // de la cola CRLF, sin esperar al umbral de FIFO ni a ningún timeout
+    if (err == ESP_OK) err = uart_enable_pattern_det_baud_intr(GM861S_UART_PORT, '\n', 1, 9, 0, 0);
+    if (err == ESP_OK) err = uart_pattern_queue_reset(GM861S_UART_PORT, GM861S_UART_EVT_QUEUE_LEN);
+
+    // Tramas sin LF (protocolo 03 00 sin cola, o CR solo): el timeout RX del
+    // hardware dispara UART_DATA tras unos pocos símbolos de silencio
+    if (err == ESP_OK) err = uart_set_rx_timeout(GM861S_UART_PORT, GM861S_UART_RX_TOUT_SYM);
+
+    // Un set sólo admite colas vacías: con RX parado se tira lo que haya
+    // dejado la configuración (aún no hay task ni órdenes en esta cola)
+    if (err == ESP_OK) {
+        uart_disable_rx_intr(GM861S_UART_PORT);
+        uart_flush_input(GM861S_UART_PORT);
+        xQueueReset(s_uart_queue);
+        if (xQueueAddToSet(s_uart_queue, s_evt_set) != pdPASS) err = ESP_FAIL;
+        uart_enable_rx_intr(GM861S_UART_PORT);
+    }
 
-    // Importante: flush después de instalar/configurar
-    uart_flush_input(GM861S_UART_PORT);
-    gm861s_apply_prod_config();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Configuracion UART fallida: %s", esp_err_to_name(err));
+        uart_driver_delete(GM861S_UART_PORT);
+        s_uart_queue = NULL;
+        return err;
+    }
 
+    // El enlace con el lector (baudios, salida serie) lo levanta la task
     return ESP_OK;
 }
 
+void gm861s_add_to_json(cJSON *root)
+{
+    cJSON *qr = cJSON_CreateObject();
+    if (!qr) return;
+
+    cJSON_AddNumberToObject(qr, "baud",      s_link_baud);
+    cJSON_AddNumberToObject(qr, "frames",    s_stats.frames);
+    cJSON_AddNumberToObject(qr, "uartOvf",   s_stats.uart_ovf);
+    cJSON_AddNumberToObject(qr, "ringDrop",  s_ring.dropped);
+    cJSON_AddItemToObject(root, "qr", qr);
+}
+
 void gm861s_reader_start_task(void)
 {
-    if (!s_task) {
-        xTaskCreate(gm861s_task, "gm861s_task", 4096, NULL, 8, &s_task);
+    if (s_task || !s_uart_queue) return;
+
+    xSemaphoreTake(s_task_done, 0);
+    if (task_manifest_create(TASK_GM861S, gm861s_task, NULL, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear la task GM861S");
+        s_task = NULL;
     }
 }
+
+esp_err_t gm861s_reader_stop(void)
+{
+    if (!s_uart_queue) return ESP_OK;
+
+    // Con el lock no hay ninguna configuración esperando respuesta
+    xSemaphoreTake(s_cfg_lock, portMAX_DELAY);
+
+    if (s_task) {
+        // Por delante sólo quedan los eventos UART ya encolados, que son
+        // lecturas cortas del buffer del driver
+        uint8_t ctl = GM861S_CTL_STOP;
+        if (xQueueSend(s_ctl_queue, &ctl, pdMS_TO_TICKS(100)) != pdTRUE ||
+            xSemaphoreTake(s_task_done, pdMS_TO_TICKS(GM861S_STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "La task GM861S no se detiene");
+            xSemaphoreGive(s_cfg_lock);
+            return ESP_ERR_TIMEOUT;
+        }
+        s_task = NULL;
+    }
+
+    // El driver borra también la cola de eventos: antes hay que sacarla del
+    // set, y para eso vacía y sin RX que la vuelva a llenar
+    uart_disable_rx_intr(GM861S_UART_PORT);
+    uart_disable_pattern_det_intr(GM861S_UART_PORT);
+    gm861s_drop_uart_events();
+    s_ctl_pending = 0;
+    if (xQueueRemoveFromSet(s_uart_queue, s_evt_set) != pdPASS) {
+        ESP_LOGE(TAG, "Cola UART no se pudo sacar del set");
+    }
+
+    // Los pines quedan como entradas sin función
+    uart_driver_delete(GM861S_UART_PORT);
+    gpio_reset_pin(GM861S_UART_TX);
+    gpio_reset_pin(GM861S_UART_RX);
+    s_uart_queue = NULL;
+    s_link_baud = 0;
+
+    xSemaphoreGive(s_cfg_lock);
+    ESP_LOGI(TAG, "GM861S detenido, UART liberada");
+    return ESP_OK;
+}
+
+bool gm861s_reader_running(void)
+{
+    return s_task != NULL;
+}
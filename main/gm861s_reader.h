@@ -1,6 +1,45 @@
 // gm861s_reader.h
 #pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "esp_err.h"
+#include "cJSON.h"
 
 esp_err_t gm861s_reader_init(void);
-void gm861s_reader_start_task(void);
\ No newline at end of file
+void gm861s_reader_start_task(void);
+// Para la task y libera la UART (uart_driver_delete). Para volver a
+// arrancar: gm861s_reader_init() + gm861s_reader_start_task().
+esp_err_t gm861s_reader_stop(void);
+bool gm861s_reader_running(void);
+// Objeto "qr" para status (latencia escaneo->cola, overflows)
+void gm861s_add_to_json(cJSON *root);
+
+// ===== Configuración en caliente del lector (setConfig) =====
+// La ejecuta la task del lector, que es la dueña de la UART. Los cambios se
+// verifican zona a zona y se guardan en la flash del lector; el baud también
+// en app_config para abrir la UART a la velocidad correcta en el arranque.
+
+#define GM861S_CFG_MAX_ZONES  8
+
+typedef struct {
+    uint32_t baud;                  // 0 = no tocar
+    uint8_t  n_zones;
+    struct {
+        uint16_t addr;
+        uint8_t  value;
+    } zones[GM861S_CFG_MAX_ZONES];
+} gm861s_cfg_req_t;
+
+typedef struct {
+    esp_err_t err;                  // primer error, ESP_OK si todo fue bien
+    uint32_t  baud;                 // velocidad del enlace tras aplicar
+    uint8_t   zones_ok;
+} gm861s_cfg_result_t;
+
+esp_err_t gm861s_reader_configure(const gm861s_cfg_req_t *req,
+                                  gm861s_cfg_result_t *res,
+                                  uint32_t timeout_ms);
+
+// Velocidad actual del enlace con el lector (0 si no responde)
+uint32_t gm861s_reader_baud(void);
@@ -0,0 +1,707 @@
+// journal.c
+
+#include "journal.h"
+#include "config.h"
+#include "core.h"
+#include "mqtt_manager.h"
+#include "conn_supervisor.h"
+#include "allowlist.h"
+#include "task_manifest.h"
+#include "mem_place.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+static const char *TAG = "JOURNAL";
+
+#define JSEG_MAGIC       0x3147534Au   // "JSG1"
+#define JSEAL_MAGIC      0x314C534Au   // "JSL1"
+#define JOURNAL_SEGS     (JOURNAL_SIZE / JOURNAL_SEG_SZ)
+#define SEAL_OFF         64u
+#define RECS_OFF         1024u
+#define RECS_PER_SEG     ((JOURNAL_SEG_SZ - RECS_OFF) / sizeof(journal_rec_t))
+#define BLOOM_BYTES      512u
+#define BLOOM_MASK       (BLOOM_BYTES * 8u - 1u)
+#define READ_BATCH       16u
+#define ID_FREE          0xFFFFFFFFu
+#define STREAM_STALL_MS  10000
+
+_Static_assert(sizeof(journal_rec_t) == 64, "journal_rec_t debe ocupar 64 bytes");
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t first_id;
+    uint32_t reserved[12];
+    uint32_t crc;
+} seg_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t last_id;
+    uint32_t ts_min;
+    uint32_t ts_max;
+    uint8_t  bloom[BLOOM_BYTES];
+    uint32_t crc;
+} seg_seal_t;
+
+_Static_assert(sizeof(seg_hdr_t) == SEAL_OFF, "seg_hdr_t debe ocupar 64 bytes");
+_Static_assert(SEAL_OFF + sizeof(seg_seal_t) <= RECS_OFF, "el sello no cabe");
+
+// ================== ÍNDICE ==================
+
+typedef struct {
+    bool     valid;
+    bool     sealed;      // con sello: su bloom está en flash
+    uint32_t seq;
+    uint32_t first_id;
+    uint32_t last_id;     // first_id - 1 si está vacío
+    uint32_t count;
+    uint32_t ts_min;      // sólo registros con hora; 0/0 = ninguno
+    uint32_t ts_max;
+} seg_index_t;
+
+static seg_index_t s_seg[JOURNAL_SEGS];
+static int         s_cur = -1;
+static uint32_t    s_next_slot = 0;
+static uint32_t    s_next_id = 1;
+static uint8_t     s_bloom[BLOOM_BYTES];   // del segmento activo
+
+static const esp_partition_t *s_part = NULL;
+
+// ================== COLA ==================
+
+typedef struct {
+    uint32_t from_id, to_id;     // 0 = sin límite
+    uint32_t from_ts, to_ts;
+    uint32_t max;
+    uint64_t cred_h56;           // 0 = todas
+    uint8_t  type;               // 0 = todos
+    char     id_peticion[32];
+} journal_query_t;
+
+typedef enum { JMSG_REC = 0, JMSG_QUERY } jmsg_kind_t;
+
+typedef struct {
+    jmsg_kind_t kind;
+    union {
+        journal_rec_t   rec;
+        journal_query_t q;
+    };
+} jmsg_t;
+
+static QueueHandle_t   s_queue = NULL;
+static journal_query_t s_pending_q;
+static bool            s_has_pending_q = false;
+
+typedef struct {
+    uint32_t written;
+    uint32_t drops;        // cola llena
+    uint32_t write_err;
+    uint32_t queries;
+} journal_stats_t;
+
+static journal_stats_t s_stats = {0};
+static portMUX_TYPE    s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t seg_base(int idx)
+{
+    return JOURNAL_OFFSET + (uint32_t)idx * JOURNAL_SEG_SZ;
+}
+
+static inline uint32_t crc_of(const void *p, size_t len)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)p, (uint32_t)len);
+}
+
+static inline bool rec_ok(const journal_rec_t *r)
+{
+    return r->id != ID_FREE && crc_of(r, offsetof(journal_rec_t, crc)) == r->crc;
+}
+
+// 3 bits por credencial (12 bits cada uno del hash)
+static void bloom_add(uint8_t *b, uint64_t h)
+{
+    for (int k = 0; k < 3; k++) {
+        uint32_t bit = (uint32_t)(h >> (12 * k)) & BLOOM_MASK;
+        b[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+    }
+}
+
+static bool bloom_maybe(const uint8_t *b, uint64_t h)
+{
+    for (int k = 0; k < 3; k++) {
+        uint32_t bit = (uint32_t)(h >> (12 * k)) & BLOOM_MASK;
+        if (!(b[bit >> 3] & (1u << (bit & 7)))) return false;
+    }
+    return true;
+}
+
+static void index_add(seg_index_t *s, const journal_rec_t *r)
+{
+    s->count++;
+    s->last_id = r->id;
+    if (r->ts) {
+        if (!s->ts_min || r->ts < s->ts_min) s->ts_min = r->ts;
+        if (r->ts > s->ts_max) s->ts_max = r->ts;
+    }
+}
+
+static uint32_t oldest_id(void)
+{
+    uint32_t oldest = s_next_id;
+    for (int i = 0; i < JOURNAL_SEGS; i++) {
+        if (s_seg[i].valid && s_seg[i].count && s_seg[i].first_id < oldest) {
+            oldest = s_seg[i].first_id;
+        }
+    }
+    return oldest;
+}
+
+// ================== ESCRITURA ==================
+
+static void seal_current(void)
+{
+    seg_index_t *s = &s_seg[s_cur];
+    if (s->sealed) return;
+
+    seg_seal_t seal = {
+        .magic   = JSEAL_MAGIC,
+        .count   = s->count,
+        .last_id = s->last_id,
+        .ts_min  = s->ts_min,
+        .ts_max  = s->ts_max,
+    };
+    memcpy(seal.bloom, s_bloom, sizeof(seal.bloom));
+    seal.crc = crc_of(&seal, offsetof(seg_seal_t, crc));
+
+    if (esp_partition_write(s_part, seg_base(s_cur) + SEAL_OFF, &seal, sizeof(seal)) == ESP_OK) {
+        s->sealed = true;
+    } else {
+        ESP_LOGW(TAG, "No se pudo sellar el segmento %d", s_cur);
+    }
+}
+
+static esp_err_t open_segment(int idx, uint32_t seq)
+{
+    // Se borra el segmento más viejo: sale del índice antes de tocar flash
+    memset(&s_seg[idx], 0, sizeof(s_seg[idx]));
+
+    esp_err_t err = esp_partition_erase_range(s_part, seg_base(idx), JOURNAL_SEG_SZ);
+    if (err != ESP_OK) return err;
+
+    seg_hdr_t h = { .magic = JSEG_MAGIC, .seq = seq, .first_id = s_next_id };
+    h.crc = crc_of(&h, offsetof(seg_hdr_t, crc));
+    err = esp_partition_write(s_part, seg_base(idx), &h, sizeof(h));
+    if (err != ESP_OK) return err;
+
+    s_seg[idx] = (seg_index_t){
+        .valid    = true,
+        .seq      = seq,
+        .first_id = s_next_id,
+        .last_id  = s_next_id - 1,
+    };
+    s_cur       = idx;
+    s_next_slot = 0;
+    memset(s_bloom, 0, sizeof(s_bloom));
+    return ESP_OK;
+}
+
+static void append(journal_rec_t *r)
+{
+    if (s_next_slot >= RECS_PER_SEG) {
+        seal_current();
+        esp_err_t err = open_segment((s_cur + 1) % JOURNAL_SEGS, s_seg[s_cur].seq + 1);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Rotacion de segmento fallida: %s", esp_err_to_name(err));
+            s_stats.write_err++;
+            return;
+        }
+    }
+
+    r->id  = s_next_id;
+    r->crc = crc_of(r, offsetof(journal_rec_t, crc));
+
+    uint32_t off = seg_base(s_cur) + RECS_OFF + s_next_slot * sizeof(journal_rec_t);
+    s_next_slot++;   // un hueco a medio escribir no se reutiliza
+
+    if (esp_partition_write(s_part, off, r, sizeof(*r)) != ESP_OK) {
+        s_stats.write_err++;
+        return;
+    }
+
+    s_next_id++;
+    index_add(&s_seg[s_cur], r);
+    if (r->cred_h56) bloom_add(s_bloom, r->cred_h56);
+
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.written++;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+bool journal_log(journal_type_t type, int lane, uint8_t origin, uint8_t result,
+                 uint32_t aux, const char *cred, const char *ref)
+{
+    if (!s_queue) return false;
+
+    jmsg_t m = { .kind = JMSG_REC };
+    journal_rec_t *r = &m.rec;
+
+    time_t now = time(NULL);
+    r->ts        = now >= QR_TICKET_MIN_EPOCH ? (uint32_t)now : 0;
+    r->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    r->type      = (uint8_t)type;
+    r->lane      = lane < 0 ? JOURNAL_LANE_NONE : (uint8_t)lane;
+    r->origin    = origin;
+    r->result    = result;
+    r->aux       = aux;
+    r->cred_h56  = (cred && cred[0]) ? allowlist_hash56(cred) : 0;
+
+    // Sólo ASCII imprimible sin comillas ni '\': el trozo JSON tiene tamaño acotado
+    const char *src = ref ? ref : cred;
+    if (src) {
+        size_t i = 0;
+        for (; src[i] && i < sizeof(r->ref) - 1; i++) {
+            char c = src[i];
+            r->ref[i] = (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') ? c : '?';
+        }
+        r->ref[i] = '\0';
+    }
+
+    if (xQueueSend(s_queue, &m, 0) != pdTRUE) {
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.drops++;
+        portEXIT_CRITICAL(&s_stats_mux);
+        return false;
+    }
+    return true;
+}
+
+// Vacía la cola sin bloquear (también durante una consulta larga)
+static void drain_events(void)
+{
+    jmsg_t m;
+    while (xQueueReceive(s_queue, &m, 0) == pdTRUE) {
+        if (m.kind == JMSG_REC) {
+            append(&m.rec);
+        } else if (!s_has_pending_q) {
+            s_pending_q = m.q;
+            s_has_pending_q = true;
+        } else {
+            ESP_LOGW(TAG, "Consulta %s descartada: otra en curso", m.q.id_peticion);
+        }
+    }
+}
+
+// ================== ARRANQUE ==================
+
+// Reconstruye el índice de un segmento sin sello recorriendo sus registros.
+// Devuelve el primer hueco libre.
+static uint32_t scan_segment(int idx, uint8_t *bloom)
+{
+    journal_rec_t buf[READ_BATCH];
+    uint32_t slot = 0;
+
+    while (slot < RECS_PER_SEG) {
+        uint32_t n = RECS_PER_SEG - slot;
+        if (n > READ_BATCH) n = READ_BATCH;
+        uint32_t off = seg_base(idx) + RECS_OFF + slot * sizeof(journal_rec_t);
+        if (esp_partition_read(s_part, off, buf, n * sizeof(journal_rec_t)) != ESP_OK) break;
+
+        for (uint32_t i = 0; i < n; i++, slot++) {
+            if (buf[i].id == ID_FREE) return slot;
+            if (!rec_ok(&buf[i])) continue;       // escritura cortada
+            index_add(&s_seg[idx], &buf[i]);
+            if (bloom && buf[i].cred_h56) bloom_add(bloom, buf[i].cred_h56);
+        }
+    }
+    return slot;
+}
+
+static esp_err_t load_index(void)
+{
+    int cur = -1;
+
+    for (int i = 0; i < JOURNAL_SEGS; i++) {
+        seg_hdr_t h;
+        memset(&s_seg[i], 0, sizeof(s_seg[i]));
+        if (esp_partition_read(s_part, seg_base(i), &h, sizeof(h)) != ESP_OK ||
+            h.magic != JSEG_MAGIC || crc_of(&h, offsetof(seg_hdr_t, crc)) != h.crc) {
+            continue;
+        }
+
+        s_seg[i].valid    = true;
+        s_seg[i].seq      = h.seq;
+        s_seg[i].first_id = h.first_id;
+        s_seg[i].last_id  = h.first_id - 1;
+        if (cur < 0 || h.seq > s_seg[cur].seq) cur = i;
+
+        seg_seal_t seal;
+        if (esp_partition_read(s_part, seg_base(i) + SEAL_OFF, &seal, sizeof(seal)) == ESP_OK &&
+            seal.magic == JSEAL_MAGIC && crc_of(&seal, offsetof(seg_seal_t, crc)) == seal.crc) {
+            s_seg[i].sealed  = true;
+            s_seg[i].count   = seal.count;
+            s_seg[i].last_id = seal.last_id;
+            s_seg[i].ts_min  = seal.ts_min;
+            s_seg[i].ts_max  = seal.ts_max;
+        }
+    }
+
+    if (cur < 0) {
+        ESP_LOGI(TAG, "Journal vacio, formateando segmento 0");
+        return open_segment(0, 1);
+    }
+
+    // Segmentos sin sello que no son el activo (corte al sellar): índice por recorrido
+    for (int i = 0; i < JOURNAL_SEGS; i++) {
+        if (i != cur && s_seg[i].valid && !s_seg[i].sealed) scan_segment(i, NULL);
+        if (s_seg[i].valid && s_seg[i].last_id + 1 > s_next_id) s_next_id = s_seg[i].last_id + 1;
+    }
+
+    s_cur = cur;
+    if (s_seg[cur].sealed) {
+        s_next_slot = RECS_PER_SEG;              // rota en la próxima escritura
+    } else {
+        memset(s_bloom, 0, sizeof(s_bloom));
+        s_next_slot = scan_segment(cur, s_bloom);
+        if (s_seg[cur].last_id + 1 > s_next_id) s_next_id = s_seg[cur].last_id + 1;
+    }
+
+    ESP_LOGI(TAG, "Journal: segmento %d (seq %lu), ids %lu..%lu",
+             cur, (unsigned long)s_seg[cur].seq,
+             (unsigned long)oldest_id(), (unsigned long)(s_next_id - 1));
+    return ESP_OK;
+}
+
+// ================== CONSULTAS ==================
+
+typedef struct {
+    const journal_query_t *q;
+    cJSON   *root;
+    cJSON   *recs;
+    int      n;          // registros en el trozo actual
+    uint32_t part;
+    uint32_t sent;
+    uint32_t next;       // id desde el que continuar
+} stream_t;
+
+// Deja sitio en mqtt_out_queue para el tráfico en tiempo real: un backfill
+// no puede retrasar un getAccessTorn
+static bool wait_out_room(void)
+{
+    for (int waited = 0; waited < STREAM_STALL_MS; waited += 100) {
+        if (conn_sup_mqtt_up() &&
+            uxQueueSpacesAvailable(mqtt_out_queue) > JOURNAL_OUTQ_RESERVE &&
+            mqtt_out_bytes() + JOURNAL_OUTQ_RESERVE_B < MQTT_OUT_BUDGET_BYTES) {
+            return true;
+        }
+        drain_events();
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return false;
+}
+
+static bool stream_open(stream_t *st)
+{
+    st->root = cJSON_CreateObject();
+    if (!st->root) return false;
+    cJSON_AddStringToObject(st->root, "action",     "retornoJournal");
+    cJSON_AddStringToObject(st->root, "idPeticion", st->q->id_peticion);
+    cJSON_AddNumberToObject(st->root, "part",       st->part);
+    st->recs = cJSON_AddArrayToObject(st->root, "recs");
+    st->n = 0;
+    return st->recs != NULL;
+}
+
+static bool stream_flush(stream_t *st, bool last, bool more)
+{
+    if (!st->root) return false;
+
+    cJSON_AddBoolToObject  (st->root, "more", more);
+    cJSON_AddNumberToObject(st->root, "next", st->next);
+    if (last) {
+        cJSON_AddNumberToObject(st->root, "head",   s_next_id - 1);
+        cJSON_AddNumberToObject(st->root, "oldest", oldest_id());
+        cJSON_AddStringToObject(st->root, "name",   device_id);
+    }
+
+    bool ok = wait_out_room() && mqtt_enqueue_json(TOPIC_RESP_FIXED, st->root, 1, 0);
+    cJSON_Delete(st->root);
+    st->root = NULL;
+    st->part++;
+    return ok;
+}
+
+static bool stream_add(stream_t *st, const journal_rec_t *r)
+{
+    if (!st->root && !stream_open(st)) return false;
+
+    cJSON *a = cJSON_CreateArray();
+    if (!a) return false;
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->id));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->ts));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->type));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->lane));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->origin));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->result));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(r->aux));
+    cJSON_AddItemToArray(a, cJSON_CreateString(r->ref));
+    cJSON_AddItemToArray(st->recs, a);
+
+    st->n++;
+    st->sent++;
+    st->next = r->id + 1;
+
+    if (st->n >= JOURNAL_CHUNK_RECS) {
+        return stream_flush(st, false, true);
+    }
+    return true;
+}
+
+static bool rec_matches(const journal_query_t *q, const journal_rec_t *r)
+{
+    if (q->from_id && r->id < q->from_id) return false;
+    if (q->to_id   && r->id > q->to_id)   return false;
+    if ((q->from_ts || q->to_ts) && !r->ts) return false;
+    if (q->from_ts && r->ts < q->from_ts) return false;
+    if (q->to_ts   && r->ts > q->to_ts)   return false;
+    if (q->type    && r->type != q->type) return false;
+    if (q->cred_h56 && r->cred_h56 != q->cred_h56) return false;
+    return true;
+}
+
+static bool seg_may_match(int idx, const journal_query_t *q)
+{
+    const seg_index_t *s = &s_seg[idx];
+    if (!s->valid || !s->count) return false;
+    if (q->from_id && s->last_id < q->from_id) return false;
+    if (q->to_id   && s->first_id > q->to_id)  return false;
+    if (q->from_ts || q->to_ts) {
+        if (!s->ts_max) return false;
+        if (q->from_ts && s->ts_max < q->from_ts) return false;
+        if (q->to_ts   && s->ts_min > q->to_ts)   return false;
+    }
+    if (q->cred_h56) {
+        if (idx == s_cur && !s->sealed) return bloom_maybe(s_bloom, q->cred_h56);
+        if (s->sealed) {
+            seg_seal_t seal;
+            if (esp_partition_read(s_part, seg_base(idx) + SEAL_OFF, &seal, sizeof(seal)) == ESP_OK &&
+                seal.magic == JSEAL_MAGIC) {
+                return bloom_maybe(seal.bloom, q->cred_h56);
+            }
+        }
+    }
+    return true;
+}
+
+static void run_query(const journal_query_t *q)
+{
+    stream_t st = { .q = q, .next = q->from_id };
+    bool ok = true;
+    uint32_t scanned_segs = 0;
+    int64_t t0 = esp_timer_get_time();
+
+    s_stats.queries++;
+
+    // Segmentos de más viejo a más nuevo
+    int order[JOURNAL_SEGS];
+    int n_order = 0;
+    for (int i = 0; i < JOURNAL_SEGS; i++) {
+        if (!s_seg[i].valid) continue;
+        int j = n_order++;
+        while (j > 0 && s_seg[order[j - 1]].seq > s_seg[i].seq) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (int k = 0; k < n_order && ok && st.sent < q->max; k++) {
+        int idx = order[k];
+        uint32_t seq = s_seg[idx].seq;
+        if (!seg_may_match(idx, q)) continue;
+        scanned_segs++;
+
+        journal_rec_t buf[READ_BATCH];
+        for (uint32_t slot = 0; slot < RECS_PER_SEG && ok && st.sent < q->max; slot += READ_BATCH) {
+            // Una escritura durante el streaming puede haber rotado este segmento
+            if (!s_seg[idx].valid || s_seg[idx].seq != seq) break;
+
+            uint32_t n = RECS_PER_SEG - slot;
+            if (n > READ_BATCH) n = READ_BATCH;
+            uint32_t off = seg_base(idx) + RECS_OFF + slot * sizeof(journal_rec_t);
+            if (esp_partition_read(s_part, off, buf, n * sizeof(journal_rec_t)) != ESP_OK) break;
+
+            bool end = false;
+            for (uint32_t i = 0; i < n && ok && st.sent < q->max; i++) {
+                if (buf[i].id == ID_FREE) { end = true; break; }
+                if (!rec_ok(&buf[i]) || !rec_matches(q, &buf[i])) continue;
+                ok = stream_add(&st, &buf[i]);
+            }
+            if (end) break;
+        }
+    }
+
+    bool truncated = !ok || st.sent >= q->max;
+    if (ok) {
+        if (!st.root) stream_open(&st);
+        stream_flush(&st, true, truncated);
+    } else {
+        cJSON_Delete(st.root);
+        ESP_LOGW(TAG, "Consulta %s cortada en id %lu (MQTT sin hueco)",
+                 q->id_peticion, (unsigned long)st.next);
+    }
+
+    ESP_LOGI(TAG, "Consulta %s: %lu registros, %lu segmentos, %lld ms",
+             q->id_peticion, (unsigned long)st.sent, (unsigned long)scanned_segs,
+             (long long)((esp_timer_get_time() - t0) / 1000));
+}
+
+bool journal_request_query(const char *json)
+{
+    if (!s_queue || !json) return false;
+
+    cJSON *root = cJSON_Parse(json);
+    if (!root) return false;
+
+    jmsg_t m = { .kind = JMSG_QUERY };
+    journal_query_t *q = &m.q;
+
+    cJSON *it;
+    if (cJSON_IsNumber(it = cJSON_GetObjectItem(root, "fromId"))) q->from_id = (uint32_t)it->valuedouble;
+    if (cJSON_IsNumber(it = cJSON_GetObjectItem(root, "toId")))   q->to_id   = (uint32_t)it->valuedouble;
+    if (cJSON_IsNumber(it = cJSON_GetObjectItem(root, "from")))   q->from_ts = (uint32_t)it->valuedouble;
+    if (cJSON_IsNumber(it = cJSON_GetObjectItem(root, "to")))     q->to_ts   = (uint32_t)it->valuedouble;
+    if (cJSON_IsNumber(it = cJSON_GetObjectItem(root, "type")))   q->type    = (uint8_t)it->valueint;
+    if (cJSON_IsString(it = cJSON_GetObjectItem(root, "cardId")) && it->valuestring[0]) {
+        q->cred_h56 = allowlist_hash56(it->valuestring);
+    }
+
+    q->max = JOURNAL_QUERY_MAX;
+    if (cJSON_IsNumber(it = cJSON_GetObjectItem(root, "max")) &&
+        it->valueint > 0 && it->valueint < JOURNAL_QUERY_MAX) {
+        q->max = (uint32_t)it->valueint;
+    }
+
+    it = cJSON_GetObjectItem(root, "idPeticion");
+    strncpy(q->id_peticion, cJSON_IsString(it) ? it->valuestring : "-",
+            sizeof(q->id_peticion) - 1);
+    cJSON_Delete(root);
+
+    // Con espera: una consulta no debe perderse tras una ráfaga de eventos
+    return xQueueSend(s_queue, &m, pdMS_TO_TICKS(100)) == pdTRUE;
+}
+
+// ================== TASK ==================
+
+// Tras una caída, un único aviso con el último id: el servidor pide lo que
+// le falte con getJournal fromId y el backfill sale a su ritmo
+static void publish_head(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+
+    cJSON_AddStringToObject(root, "action", "journalHead");
+    cJSON_AddNumberToObject(root, "head",   s_next_id - 1);
+    cJSON_AddNumberToObject(root, "oldest", oldest_id());
+    cJSON_AddNumberToObject(root, "drops",  s_stats.drops);
+    cJSON_AddStringToObject(root, "name",   device_id);
+    cJSON_AddStringToObject(root, "idTorno", id_torno);
+
+    mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+    cJSON_Delete(root);
+}
+
+// Cada reconexión al broker deja pendiente un journalHead
+static volatile bool s_head_due = false;
+
+static void on_conn_change(conn_state_t from, conn_state_t to)
+{
+    if (to == CONN_ONLINE) s_head_due = true;
+}
+
+static void journal_task(void *pv)
+{
+    (void)pv;
+    jmsg_t m;
+
+    while (1) {
+        if (xQueueReceive(s_queue, &m, pdMS_TO_TICKS(1000)) == pdTRUE) {
+            if (m.kind == JMSG_REC) {
+                append(&m.rec);
+            } else {
+                run_query(&m.q);
+            }
+            drain_events();
+        }
+
+        while (s_has_pending_q) {
+            journal_query_t q = s_pending_q;
+            s_has_pending_q = false;
+            run_query(&q);
+        }
+
+        if (s_head_due) {
+            s_head_due = false;
+            publish_head();
+        }
+    }
+}
+
+esp_err_t journal_init(void)
+{
+    if (s_queue) return ESP_OK;
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      STORAGE_PARTITION_LABEL);
+    if (!s_part || s_part->size < JOURNAL_OFFSET + JOURNAL_SIZE) {
+        ESP_LOGE(TAG, "Particion '%s' no encontrada o pequeña", STORAGE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = load_index();
+    if (err != ESP_OK) return err;
+
+    s_queue = mem_place_queue("journal", JOURNAL_QUEUE_LEN, sizeof(jmsg_t), MEM_COLD);
+    if (!s_queue) return ESP_ERR_NO_MEM;
+
+    conn_sup_subscribe(on_conn_change);
+    if (conn_sup_mqtt_up()) s_head_due = true;
+    if (task_manifest_create(TASK_JOURNAL, journal_task, NULL, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    journal_log(JR_BOOT, -1, 0, 0, (uint32_t)esp_reset_reason(), NULL, FW_VERSION);
+    return ESP_OK;
+}
+
+void journal_add_to_json(cJSON *root)
+{
+    if (!s_queue) return;
+
+    cJSON *o = cJSON_CreateObject();
+    if (!o) return;
+
+    journal_stats_t st;
+    portENTER_CRITICAL(&s_stats_mux);
+    st = s_stats;
+    portEXIT_CRITICAL(&s_stats_mux);
+
+    cJSON_AddNumberToObject(o, "head",     s_next_id - 1);
+    cJSON_AddNumberToObject(o, "oldest",   oldest_id());
+    cJSON_AddNumberToObject(o, "written",  st.written);
+    cJSON_AddNumberToObject(o, "drops",    st.drops);
+    cJSON_AddNumberToObject(o, "writeErr", st.write_err);
+    cJSON_AddItemToObject(root, "journal", o);
+}
@@ -0,0 +1,71 @@
+// journal.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "cJSON.h"
+#include "access_tracker.h"
+
+// Journal local de accesos en la partición "storage" [JOURNAL_OFFSET, +JOURNAL_SIZE).
+//
+// Append-only en segmentos de JOURNAL_SEG_SZ que rotan en anillo (el más
+// viejo se borra al abrir uno nuevo). Cada segmento:
+//
+//   [0, 64)       cabecera (seq del segmento, primer id) con CRC
+//   [64, 1024)    sello: rango de ids y de hora + bloom de credenciales,
+//                 se escribe al cerrar el segmento (hasta entonces borrado)
+//   [1024, SEG)   registros journal_rec_t de 64 B, cada uno con su CRC
+//
+// Índice en RAM: por segmento rango de ids y de hora; el bloom deja saltar
+// segmentos enteros al buscar una credencial.
+//
+// Los productores sólo encolan (no bloquea); la escritura en flash y las
+// consultas getJournal van en la task "journal" (baja prioridad).
+
+typedef enum {
+    JR_BOOT = 1,       // aux = motivo de reset
+    JR_CRED,           // lectura tras dedup: origin = cred_source_t, ref = cardId
+    JR_REQUEST,        // getAccessTorn enviado: ref = idPeticion
+    JR_DECISION,       // origin = journal_origin_t, result = 1/0, ref = cardId o idPeticion
+    JR_ACTUATION,      // relé: aux = (gpio << 16) | ms, result = nivel activo
+} journal_type_t;
+
+typedef enum {
+    JO_SERVER = 0,     // hasAccess
+    JO_TICKET,         // ticket QR firmado
+    JO_ALLOWLIST,
+    JO_TIMEOUT,        // sin respuesta en ACCESS_REQUEST_TIMEOUT_MS
+} journal_origin_t;
+
+#define JOURNAL_LANE_NONE  0xFF
+#define JOURNAL_REF_LEN    32
+
+typedef struct __attribute__((packed)) {
+    uint32_t id;                    // correlativo; 0xFFFFFFFF = flash libre
+    uint32_t ts;                    // Unix UTC, 0 = sin hora
+    uint32_t uptime_ms;
+    uint8_t  type;                  // journal_type_t
+    uint8_t  lane;                  // access_lane_t o JOURNAL_LANE_NONE
+    uint8_t  origin;
+    uint8_t  result;
+    uint32_t aux;
+    uint64_t cred_h56;              // allowlist_hash56(cardId), 0 si no aplica
+    char     ref[JOURNAL_REF_LEN];  // texto truncado, con '\0'
+    uint32_t crc;                   // de los 60 bytes anteriores
+} journal_rec_t;
+
+esp_err_t journal_init(void);
+
+// Productores (cualquier task o callback de esp_timer). false si la cola
+// estaba llena: se cuenta como drop.
+bool journal_log(journal_type_t type, int lane, uint8_t origin, uint8_t result,
+                 uint32_t aux, const char *cred, const char *ref);
+
+// getJournal: {"fromId","toId","from","to","cardId","type","max","idPeticion"}.
+// La respuesta sale en trozos retornoJournal desde la task del journal.
+bool journal_request_query(const char *json);
+
+// Objeto "journal" (head, oldest, drops) para getConfig
+void journal_add_to_json(cJSON *root);
@@ -2,6 +2,8 @@
 
 #include "led_status.h"
 #include "core.h"
+#include "conn_supervisor.h"
+#include "task_manifest.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -15,6 +17,7 @@
 static const char *TAG = "LED_STATUS";
 
 static led_strip_handle_t s_led_strip = NULL;
+static TaskHandle_t s_task = NULL;
 static uint8_t last_r = 255, last_g = 255, last_b = 255;
 
 // === Era tu set_led_color original ===
@@ -61,14 +64,26 @@ void led_status_init(void)
     rgb_led_init_internal();
 }
 
+// Espera de la task: se corta en cuanto cambia la conectividad
+static void led_wait(uint32_t ms)
+{
+    ulTaskNotifyTake(pdTRUE, ms ? pdMS_TO_TICKS(ms) : portMAX_DELAY);
+}
+
+static void on_conn_change(conn_state_t from, conn_state_t to)
+{
+    if (s_task) xTaskNotifyGive(s_task);
+}
+
 // === Era tu led_status_task original ===
+// Los modos fijos duermen hasta el siguiente cambio de estado
 static void led_status_task(void *pv)
 {
     while (1) {
-        switch (s_led_mode) {
+        switch (conn_sup_led_mode()) {
             case LED_MODE_OFF:
                 set_led_color(0, 0, 0);
-                vTaskDelay(pdMS_TO_TICKS(500));
+                led_wait(0);
                 break;
 
             case LED_MODE_WIFI_CONNECTING:
@@ -76,17 +91,17 @@ static void led_status_task(void *pv)
                 set_led_color(0, 0, 50);
                 vTaskDelay(pdMS_TO_TICKS(200));
                 set_led_color(0, 0, 0);
-                vTaskDelay(pdMS_TO_TICKS(200));
+                led_wait(200);
                 break;
 
             case LED_MODE_WIFI_OK_NO_MQTT:
                 set_led_color(50, 50, 0);
-                vTaskDelay(pdMS_TO_TICKS(1000));
+                led_wait(0);
                 break;
 
             case LED_MODE_MQTT_OK:
                 set_led_color(0, 50, 0);
-                vTaskDelay(pdMS_TO_TICKS(2000));
+                led_wait(0);
                 break;
 
             case LED_MODE_ERROR:
@@ -94,7 +109,7 @@ static void led_status_task(void *pv)
                 set_led_color(50, 0, 0);
                 vTaskDelay(pdMS_TO_TICKS(150));
                 set_led_color(0, 0, 0);
-                vTaskDelay(pdMS_TO_TICKS(150));
+                led_wait(150);
                 break;
 
             default:
@@ -108,5 +123,6 @@ static void led_status_task(void *pv)
 
 void led_status_start_task(void)
 {
-    xTaskCreate(led_status_task, "led_status_task", 2048, NULL, 2, NULL);
+    task_manifest_create(TASK_LED, led_status_task, NULL, &s_task);
+    conn_sup_subscribe(on_conn_change);
 }
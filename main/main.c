@@ -2,6 +2,7 @@
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "esp_log.h"
+#include "esp_netif_sntp.h"
 
 #include "config.h"
 #include "core.h"
@@ -12,6 +13,18 @@
 #include "rc522_reader.h"
 #include "app_config.h"
 #include "gm861s_reader.h"
+#include "access_tracker.h"
+#include "net_metrics.h"
+#include "conn_supervisor.h"
+#include "qr_ticket.h"
+#include "access_pipeline.h"
+#include "allowlist.h"
+#include "journal.h"
+#include "dlog.h"
+#include "params.h"
+#include "ota_health.h"
+#include "sysmon.h"
+#include "mem_place.h"
 
 static const char *TAG = "TOTPADEL";
 
@@ -20,10 +33,6 @@ QueueHandle_t cmd_queue = NULL;
 QueueHandle_t mqtt_out_queue = NULL;
 esp_mqtt_client_handle_t mqtt_client = NULL;
 
-bool s_wifi_connected = false;
-bool s_mqtt_connected = false;
-led_mode_t s_led_mode = LED_MODE_OFF;
-
 char device_id[32] = {0};
 char id_torno[32] = "1";
 char topic_cmd[128] = {0};
@@ -53,6 +62,7 @@ void app_main(void)
     }
 
     ESP_ERROR_CHECK(app_config_load());
+    ESP_ERROR_CHECK(params_init());
 
     make_device_id();
     make_topics();
@@ -62,24 +72,56 @@ void app_main(void)
     ESP_LOGI(TAG, "topic_stat=%s", topic_stat);
     ESP_LOGI(TAG, "topic_resp=%s", TOPIC_RESP_FIXED);
 
-    // Colas
-    cmd_queue      = xQueueCreate(64, sizeof(command_t));
-    mqtt_out_queue = xQueueCreate(64, sizeof(mqtt_out_msg_t));
-    configASSERT(cmd_queue      != NULL);
-    configASSERT(mqtt_out_queue != NULL);
+    // Log diferido de los caminos calientes (lo anterior queda en el ring)
+    ESP_ERROR_CHECK(dlog_init());
 
     // LED estado
     led_status_init();
-    s_led_mode = LED_MODE_WIFI_CONNECTING;
 
-    // WiFi
+    // Supervisor de conexión (antes del WiFi: recibe IP_EVENT_STA_GOT_IP)
+    ESP_ERROR_CHECK(conn_sup_init());
+
+    // WiFi lo antes posible: esp_wifi_start() no bloquea, y la asociación y
+    // el DHCP corren mientras se inicializa todo lo demás
     ESP_ERROR_CHECK(wifi_init_and_start());
 
+    // Colas: los comandos (relés) en interna. La de salida sólo lleva
+    // punteros; cada mensaje va al heap frío con su tamaño real (ver
+    // MQTT_OUT_BUDGET_BYTES)
+    cmd_queue      = mem_place_queue("cmd", 64, sizeof(command_t), MEM_HOT);
+    mqtt_out_queue = mem_place_queue("mqtt_out", MQTT_OUT_QUEUE_LEN, sizeof(mqtt_out_msg_t), MEM_HOT);
+    configASSERT(cmd_queue      != NULL);
+    configASSERT(mqtt_out_queue != NULL);
+
+    // Telemetría de red (sonda loopback, usa topic_cmd)
+    ESP_ERROR_CHECK(net_metrics_init());
+
+    // Allowlist local (registra sus topics antes de que conecte MQTT)
+    if (allowlist_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Allowlist no disponible, acceso sólo online");
+    }
+
+    // Journal de accesos (antes que cualquier productor de eventos)
+    if (journal_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Journal no disponible, eventos sólo por MQTT");
+    }
+
     // MQTT
     mqtt_start();
     mqtt_start_tasks();
 
-    // Lector RC522 (dos lectores por SPI, pero mantenemos nombres pn532_*)
+    // Hora real para la ventana de validez de los tickets QR
+    esp_sntp_config_t sntp_cfg = ESP_NETIF_SNTP_DEFAULT_CONFIG(SNTP_SERVER);
+    sntp_cfg.wait_for_sync = false;
+    esp_netif_sntp_init(&sntp_cfg);
+
+    // Correlación de peticiones getAccessTorn (antes de arrancar lectores)
+    ESP_ERROR_CHECK(access_tracker_init());
+    ESP_ERROR_CHECK(qr_ticket_init());
+    ESP_ERROR_CHECK(access_pipeline_init());
+
+    // Lector RC522 (dos lectores por SPI, pero mantenemos nombres pn532_*).
+    // Los dos lectores se arrancan y paran también en caliente con setConfig.
     if (g_app_config.enable_cards) {
         ESP_ERROR_CHECK(pn532_reader_init());
         pn532_reader_start_task();
@@ -100,5 +142,16 @@ void app_main(void)
     // Task de LED
     led_status_start_task();
 
+    // Qué quedó en interna y qué en PSRAM
+    mem_place_log_map();
+
+    // Introspección: la primera ventana de CPU empieza con todo creado
+    if (sysmon_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Sysmon no disponible, sin sysStats");
+    }
+
     ESP_LOGI(TAG, "Sistema TOTPADEL arrancado");
+
+    // Validación de la imagen si venimos de una OTA (con todo ya arrancado)
+    ota_health_init();
 }
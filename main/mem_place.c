@@ -0,0 +1,117 @@
+// mem_place.c
+
+#include "mem_place.h"
+
+#include "freertos/idf_additions.h"   // xQueueCreateWithCaps
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"         // esp_ptr_external_ram
+
+#include <stdbool.h>
+
+static const char *TAG = "MEM";
+
+#define MEM_MAX_REGIONS  12
+
+#define CAPS_INT    (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define CAPS_PSRAM  (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+typedef struct {
+    const char *name;
+    size_t      size;
+    bool        queue;
+    bool        psram;
+} mem_region_t;
+
+static mem_region_t s_regions[MEM_MAX_REGIONS];
+static int          s_n_regions = 0;
+static portMUX_TYPE s_mem_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ================== ASIGNACIÓN ==================
+
+static void add_region(const char *name, size_t size, bool queue, bool psram)
+{
+    bool full;
+    portENTER_CRITICAL(&s_mem_mux);
+    full = (s_n_regions >= MEM_MAX_REGIONS);
+    if (!full) {
+        s_regions[s_n_regions++] = (mem_region_t){ name, size, queue, psram };
+    }
+    portEXIT_CRITICAL(&s_mem_mux);
+
+    if (full) ESP_LOGW(TAG, "Mapa lleno: %s (%u bytes) no sale", name, (unsigned)size);
+}
+
+void *mem_cold_calloc(size_t n, size_t size)
+{
+    return heap_caps_calloc_prefer(n, size, 2, CAPS_PSRAM, CAPS_INT);
+}
+
+void *mem_place_alloc(const char *name, size_t size, mem_temp_t temp)
+{
+    void *p = (temp == MEM_COLD) ? mem_cold_calloc(1, size)
+                                 : heap_caps_calloc(1, size, CAPS_INT);
+    if (!p) {
+        ESP_LOGE(TAG, "Sin memoria para %s (%u bytes)", name, (unsigned)size);
+        return NULL;
+    }
+    add_region(name, size, false, esp_ptr_external_ram(p));
+    return p;
+}
+
+QueueHandle_t mem_place_queue(const char *name, UBaseType_t len, UBaseType_t item_sz,
+                              mem_temp_t temp)
+{
+    QueueHandle_t q = NULL;
+    bool psram = false;
+
+    // Cola y almacenamiento en PSRAM; si no hay, como siempre
+    if (temp == MEM_COLD && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+        q = xQueueCreateWithCaps(len, item_sz, CAPS_PSRAM);
+        psram = (q != NULL);
+    }
+    if (!q) q = xQueueCreate(len, item_sz);
+    if (!q) {
+        ESP_LOGE(TAG, "Sin memoria para la cola %s (%u x %u)", name,
+                 (unsigned)len, (unsigned)item_sz);
+        return NULL;
+    }
+    add_region(name, (size_t)len * item_sz, true, psram);
+    return q;
+}
+
+// ================== MAPA ==================
+
+static void log_caps(const char *label, uint32_t caps)
+{
+    size_t total = heap_caps_get_total_size(caps);
+    if (total == 0) {
+        ESP_LOGI(TAG, "  %-6s no hay", label);
+        return;
+    }
+    ESP_LOGI(TAG, "  %-6s %7u libres de %7u, mayor bloque %7u", label,
+             (unsigned)heap_caps_get_free_size(caps), (unsigned)total,
+             (unsigned)heap_caps_get_largest_free_block(caps));
+}
+
+void mem_place_log_map(void)
+{
+    size_t in_int = 0, in_psram = 0;
+
+    ESP_LOGI(TAG, "Mapa de memoria:");
+    for (int i = 0; i < s_n_regions; i++) {
+        const mem_region_t *r = &s_regions[i];
+        ESP_LOGI(TAG, "  %-14s %6u %s%s", r->name, (unsigned)r->size,
+                 r->psram ? "psram" : "int", r->queue ? " (cola)" : "");
+        if (r->psram) {
+            in_psram += r->size;
+        } else {
+            in_int += r->size;
+        }
+    }
+    ESP_LOGI(TAG, "  total: %u en interna, %u en psram", (unsigned)in_int, (unsigned)in_psram);
+
+    log_caps("int",   CAPS_INT);
+    log_caps("dma",   MALLOC_CAP_DMA);
+    log_caps("psram", MALLOC_CAP_SPIRAM);
+}
@@ -0,0 +1,33 @@
+// mem_place.h
+#pragma once
+
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Dónde va cada buffer grande (mem_place.c). Caliente = RAM interna: el
+// camino de acceso y lo que queda libre para los drivers con DMA (SPI del
+// RC522, UART del QR, WiFi). Frío = PSRAM si la hay: colas largas, cachés
+// y buffers de la OTA. Sin PSRAM (o llena) lo frío cae a interna.
+//
+// Lo frío no se toca desde ISR: con la caché desactivada (escrituras a
+// flash) la PSRAM tampoco se puede leer.
+
+typedef enum {
+    MEM_HOT = 0,
+    MEM_COLD,
+} mem_temp_t;
+
+// Buffer que vive siempre, a cero; queda en el mapa con su nombre
+void *mem_place_alloc(const char *name, size_t size, mem_temp_t temp);
+
+// calloc frío y temporal (p.ej. OTA), fuera del mapa. Se libera con free()
+void *mem_cold_calloc(size_t n, size_t size);
+
+// xQueueCreate en interna o PSRAM; queda en el mapa. No se borran.
+QueueHandle_t mem_place_queue(const char *name, UBaseType_t len, UBaseType_t item_sz,
+                              mem_temp_t temp);
+
+// Mapa de memoria al log: cada región con su sitio y el heap por capacidad
+void mem_place_log_map(void);
@@ -19,38 +19,150 @@
 
 #include "ota_manager.h"
 #include "app_config.h"
+#include "payload_codec.h"
+#include "mqtt_reasm.h"
+#include "access_tracker.h"
+#include "net_metrics.h"
+#include "conn_supervisor.h"
+#include "wifi_select.h"
+#include "gm861s_reader.h"
+#include "commands.h"
+#include "qr_ticket.h"
+#include "access_pipeline.h"
+#include "allowlist.h"
+#include "dlog.h"
+#include "params.h"
+#include "task_manifest.h"
+#include "sysmon.h"
+#include "mem_place.h"
+#include "cmd_msg.h"
 
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "MQTT";
 
+
 // ================== COLA DE SALIDA ==================
 
-bool mqtt_enqueue(const char *topic,
-                  const char *payload,
-                  int qos,
-                  int retain)
+// Bytes en mensajes encolados o a medio publicar (tope MQTT_OUT_BUDGET_BYTES)
+static uint32_t s_out_bytes = 0;
+
+static void out_msg_free(mqtt_out_msg_t *m, size_t sz)
+{
+    free(m->data);
+    m->data = NULL;
+    __atomic_sub_fetch(&s_out_bytes, (uint32_t)sz, __ATOMIC_RELAXED);
+}
+
+// Copia topic + payload a un bloque propio y lo encola
+static bool out_enqueue(const char *topic, const void *payload, size_t len,
+                        int qos, int retain)
 {
     if (mqtt_out_queue == NULL) {
         ESP_LOGW(TAG, "mqtt_out_queue no inicializada, no se publica");
         return false;
     }
 
-    mqtt_out_msg_t out = {0};
-    strncpy(out.topic,   topic,   sizeof(out.topic)   - 1);
-    strncpy(out.payload, payload, sizeof(out.payload) - 1);
-    out.qos    = qos;
-    out.retain = retain;
+    size_t tlen = strlen(topic);
+    if (tlen >= MQTT_OUT_TOPIC_SZ) {
+        ESP_LOGW(TAG, "topic demasiado largo, descartado: '%s'", topic);
+        return false;
+    }
+
+    size_t sz = tlen + 1 + len;
+    uint32_t used = __atomic_add_fetch(&s_out_bytes, (uint32_t)sz, __ATOMIC_RELAXED);
+    if (used > MQTT_OUT_BUDGET_BYTES) {
+        __atomic_sub_fetch(&s_out_bytes, (uint32_t)sz, __ATOMIC_RELAXED);
+        ESP_LOGW(TAG, "cola de salida sin bytes (%u en cola), se descarta mensaje para '%s'",
+                 (unsigned)(used - sz), topic);
+        return false;
+    }
+
+    mqtt_out_msg_t out = {
+        .data   = mem_cold_calloc(1, sz),
+        .len    = (uint16_t)len,
+        .qos    = (uint8_t)qos,
+        .retain = (uint8_t)retain,
+    };
+    if (!out.data) {
+        __atomic_sub_fetch(&s_out_bytes, (uint32_t)sz, __ATOMIC_RELAXED);
+        ESP_LOGW(TAG, "sin memoria para %u bytes, se descarta mensaje para '%s'",
+                 (unsigned)sz, topic);
+        return false;
+    }
+    memcpy(out.data, topic, tlen + 1);
+    memcpy(out.data + tlen + 1, payload, len);
 
     if (xQueueSend(mqtt_out_queue, &out, pdMS_TO_TICKS(50)) != pdTRUE) {
         ESP_LOGW(TAG, "mqtt_out_queue llena, se descarta mensaje para '%s'", topic);
+        out_msg_free(&out, sz);
         return false;
     }
 
     return true;
 }
 
+uint32_t mqtt_out_bytes(void)
+{
+    return __atomic_load_n(&s_out_bytes, __ATOMIC_RELAXED);
+}
+
+bool mqtt_enqueue(const char *topic,
+                  const char *payload,
+                  int qos,
+                  int retain)
+{
+    size_t plen = strlen(payload);
+    if (plen >= MQTT_OUT_PAYLOAD_SZ) {
+        // Un JSON truncado no lo parsea nadie: mejor no enviarlo
+        ESP_LOGW(TAG, "payload de %u bytes no cabe para '%s', descartado",
+                 (unsigned)plen, topic);
+        return false;
+    }
+    return out_enqueue(topic, payload, plen, qos, retain);
+}
+
+bool mqtt_enqueue_bin(const char *topic,
+                      const void *data,
+                      size_t len,
+                      int qos,
+                      int retain)
+{
+    if (len == 0 || len > MQTT_OUT_PAYLOAD_SZ) {
+        ESP_LOGW(TAG, "payload binario de %u bytes no cabe para '%s'",
+                 (unsigned)len, topic);
+        return false;
+    }
+    return out_enqueue(topic, data, len, qos, retain);
+}
+
+bool mqtt_enqueue_json(const char *topic,
+                       const cJSON *root,
+                       int qos,
+                       int retain)
+{
+    if (g_app_config.payload_enc == PAYLOAD_ENC_CBOR) {
+        uint8_t buf[MQTT_OUT_PAYLOAD_SZ];
+        size_t n = payload_cbor_from_json(root, buf, sizeof(buf));
+        if (n > 0) {
+            char topic_bin[MQTT_OUT_TOPIC_SZ];
+            snprintf(topic_bin, sizeof(topic_bin), "%s" PAYLOAD_CBOR_TOPIC_SUFFIX, topic);
+            return mqtt_enqueue_bin(topic_bin, buf, n, qos, retain);
+        }
+        ESP_LOGW(TAG, "CBOR no cabe para '%s', se envia JSON", topic);
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    if (!json) {
+        ESP_LOGW(TAG, "cJSON_PrintUnformatted fallo para '%s'", topic);
+        return false;
+    }
+    bool ok = mqtt_enqueue(topic, json, qos, retain);
+    cJSON_free(json);
+    return ok;
+}
+
 // ================== TASK DE PUBLICACIÓN ==================
 
 static void mqtt_out_task(void *pv)
@@ -59,43 +171,51 @@ static void mqtt_out_task(void *pv)
 
     while (1) {
         if (xQueueReceive(mqtt_out_queue, &msg, portMAX_DELAY) == pdTRUE) {
+            const char *topic   = msg.data;
+            size_t      tlen    = strlen(topic);
+            const char *payload = msg.data + tlen + 1;
 
-            // Esperar a que MQTT esté conectado antes de publicar
-            while (!s_mqtt_connected) {
+            // Esperar a que MQTT esté conectado antes de publicar: bloqueada
+            // en CONN_BIT_MQTT, se despierta en cuanto conecta
+            if (!conn_sup_mqtt_up()) {
                 ESP_LOGW(TAG,
                          "MQTT no conectado, esperando para publicar '%s'",
-                         msg.topic);
-                vTaskDelay(pdMS_TO_TICKS(200));   // 200 ms para no bloquear el WDT
+                         topic);
+                conn_sup_wait(CONN_BIT_MQTT, portMAX_DELAY);
             }
 
+            int64_t t_pub = esp_timer_get_time();
             int msg_id = esp_mqtt_client_publish(
                              mqtt_client,
-                             msg.topic,
-                             msg.payload,
-                             0,              // null-terminated
+                             topic,
+                             payload,
+                             msg.len,
                              msg.qos,
                              msg.retain);
 
             if (msg_id < 0) {
                 ESP_LOGW(TAG, "Error publicando en '%s' (msg_id=%d)",
-                         msg.topic, msg_id);
+                         topic, msg_id);
                 // Opcional: podrías re-encolar aquí si quisieras reintentar
+            } else {
+                net_metrics_on_publish(msg_id, msg.qos, t_pub);
             }
+
+            // El cliente ya copió el mensaje (outbox o socket)
+            out_msg_free(&msg, tlen + 1 + msg.len);
         }
     }
 }
 
-
 // ================== TASK STATUS PERIÓDICO ==================
 
 static void status_task(void *pv)
 {
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(30000));  // cada 30s
+        vTaskDelay(pdMS_TO_TICKS(params_get(PARAM_STATUS_PERIOD_MS)));
 
-        if (!s_mqtt_connected) {
-            continue;
-        }
+        // Sin broker no hay status: dormida hasta que vuelva
+        conn_sup_wait(CONN_BIT_MQTT, portMAX_DELAY);
 
         // Obtener datos del sistema
         wifi_ap_record_t wifi_info;
@@ -128,20 +248,37 @@ static void status_task(void *pv)
         cJSON_AddNumberToObject(root, "uptime", uptime);
         cJSON_AddNumberToObject(root, "freeHeap", free_heap);
         cJSON_AddStringToObject(root, "fw", FW_VERSION);
+        cJSON_AddNumberToObject(root, "cborSchema", PAYLOAD_CBOR_SCHEMA_VERSION);
 
         cJSON *rc = cJSON_CreateObject();
         cJSON_AddStringToObject(rc, "in", rc522_in_status);
         cJSON_AddStringToObject(rc, "out", rc522_out_status);
         cJSON_AddItemToObject(root, "rc522", rc);
 
-        char *json = cJSON_PrintUnformatted(root);
-
-        if (json) {
-            mqtt_enqueue(topic_stat, json, 1, 1);  // retain=1
-            cJSON_free(json);
+        access_tracker_stats_t trk;
+        access_tracker_get_stats(&trk);
+        cJSON *acc = cJSON_CreateObject();
+        cJSON_AddNumberToObject(acc, "sent",     trk.sent);
+        cJSON_AddNumberToObject(acc, "matched",  trk.matched + trk.fallback);
+        cJSON_AddNumberToObject(acc, "expired",  trk.expired);
+        cJSON_AddNumberToObject(acc, "rejected", trk.rejected);
+        cJSON_AddItemToObject(root, "access", acc);
+
+        net_metrics_add_to_json(root);
+        conn_sup_add_to_json(root);
+        wifi_sel_add_to_json(root);
+        access_pipeline_add_to_json(root);
+        if (g_app_config.enable_qr) {
+            gm861s_add_to_json(root);
+            qr_ticket_add_to_json(root);
         }
 
+        mqtt_enqueue_json(topic_stat, root, 1, 1);  // retain=1
+
         cJSON_Delete(root);
+
+        // CPU, stack y heap no caben en el status: van aparte y más espaciados
+        sysmon_publish_if_due();
     }
 }
 
@@ -153,95 +290,86 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT connected");
-            s_mqtt_connected = true;
-            if (s_wifi_connected) {
-                s_led_mode = LED_MODE_MQTT_OK;   // WiFi + MQTT OK
-            }
+            net_metrics_on_connected();
             esp_mqtt_client_subscribe(mqtt_client, topic_cmd, 1);
+            esp_mqtt_client_subscribe(mqtt_client, net_metrics_probe_topic(), 0);
+            for (int i = 0; mqtt_reasm_sink_topic(i); i++) {
+                esp_mqtt_client_subscribe(mqtt_client, mqtt_reasm_sink_topic(i), 1);
+            }
+            conn_sup_on_mqtt_connected();
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT disconnected");
-            s_mqtt_connected = false;
-            if (s_wifi_connected) {
-                s_led_mode = LED_MODE_WIFI_OK_NO_MQTT;
-            } else {
-                s_led_mode = LED_MODE_WIFI_CONNECTING;
-            }
+            net_metrics_on_disconnected();
+            conn_sup_on_mqtt_disconnected();
             break;
 
         case MQTT_EVENT_DATA: {
-            ESP_LOGI(TAG, "MQTT DATA: topic=%.*s data=%.*s",
-                     event->topic_len, event->topic,
-                     event->data_len, event->data);
-
-            // Parse JSON
-            cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
-            if (!root) {
-                ESP_LOGW(TAG, "JSON parse error");
+            // Fragmentos: se acumulan hasta tener el mensaje completo
+            mqtt_reasm_msg_t msg;
+            if (mqtt_reasm_feed(event, &msg) != MQTT_REASM_READY) {
                 break;
             }
 
-            command_t cmd = (command_t){0};
-
-            cJSON *action    = cJSON_GetObjectItem(root, "action");
-            cJSON *pin       = cJSON_GetObjectItem(root, "pin");
-            cJSON *estat     = cJSON_GetObjectItem(root, "estat");
-            cJSON *idPista   = cJSON_GetObjectItem(root, "idPista");
-            cJSON *idPet     = cJSON_GetObjectItem(root, "idPeticion");
-            cJSON *result    = cJSON_GetObjectItem(root, "result");
-            cJSON *type      = cJSON_GetObjectItem(root, "type");
-            cJSON *url       = cJSON_GetObjectItem(root, "url");
-
-            if (cJSON_IsString(action) && action->valuestring) {
-                strncpy(cmd.action, action->valuestring, sizeof(cmd.action)-1);
+            // Sonda loopback: no pasa por el parser ni por los logs
+            if (net_metrics_handle_probe(msg.topic, msg.topic_len, msg.data, msg.len)) {
+                break;
             }
 
-            if (cJSON_IsString(pin) && pin->valuestring) {
-                cmd.pin = atoi(pin->valuestring);
-            } else if (cJSON_IsNumber(pin)) {
-                cmd.pin = pin->valueint;
+            // Snapshots/deltas de la allowlist (binario, no son comandos)
+            if (allowlist_handle_message(msg.topic, msg.topic_len, msg.data, msg.len)) {
+                break;
             }
 
-            if (cJSON_IsString(estat) && estat->valuestring) {
-                cmd.estat = atoi(estat->valuestring);
-            } else if (cJSON_IsNumber(estat)) {
-                cmd.estat = estat->valueint;
-            }
+            conn_sup_on_command_received();
 
-            if (cJSON_IsString(idPista) && idPista->valuestring) {
-                cmd.id_pista = atoi(idPista->valuestring);
-            } else if (cJSON_IsNumber(idPista)) {
-                cmd.id_pista = idPista->valueint;
-            }
+            // CBOR (esquema de claves enteras): decodificación directa a command_t
+            if (payload_is_cbor(msg.data, msg.len)) {
+                DLOGI(DLOG_MQTT, "MQTT DATA (CBOR): topic=%s len=%d",
+                      DLOG_STRN(msg.topic, msg.topic_len), msg.len);
 
-            if (cJSON_IsString(idPet) && idPet->valuestring) {
-                strncpy(cmd.id_peticion, idPet->valuestring,
-                        sizeof(cmd.id_peticion)-1);
-            } else {
-                strcpy(cmd.id_peticion, "-");
+                command_t cmd;
+                if (!payload_cbor_decode_command((const uint8_t *)msg.data,
+                                                 msg.len, &cmd) ||
+                    strcmp(cmd.action, COMMANDS_LOCAL_ACCESS) == 0) {
+                    break;
+                }
+                if (xQueueSend(cmd_queue, &cmd, portMAX_DELAY) != pdTRUE) {
+                    ESP_LOGW(TAG, "cmd_queue: error inesperado al encolar comando");
+                }
+                break;
             }
 
-            if (cJSON_IsString(result) && result->valuestring) {
-                strncpy(cmd.result, result->valuestring,
-                        sizeof(cmd.result)-1);
-            }
+            // El payload entero sólo en debug, y recortado a lo que cabe
+            // en una entrada del log diferido
+            DLOGI(DLOG_MQTT, "MQTT DATA: topic=%s len=%d",
+                  DLOG_STRN(msg.topic, msg.topic_len), msg.len);
+            DLOGD(DLOG_MQTT, "MQTT DATA: %s", DLOG_STRN(msg.data, msg.len));
 
-            if (cJSON_IsString(type) && type->valuestring) {
-                strncpy(cmd.type, type->valuestring,
-                        sizeof(cmd.type)-1);
+            // Parse JSON
+            cJSON *root = cJSON_ParseWithLength(msg.data, msg.len);
+            if (!root) {
+                ESP_LOGW(TAG, "JSON parse error");
+                break;
             }
 
-            // Guardar payload bruto (para writeCard)
-            size_t len = event->data_len;
-            if (len >= sizeof(cmd.payload)) len = sizeof(cmd.payload) - 1;
-            memcpy(cmd.payload, event->data, len);
-            cmd.payload[len] = '\0';
+            command_t cmd;
+            if (!cmd_msg_from_json(root, msg.data, (size_t)msg.len, &cmd)) {
+                ESP_LOGW(TAG, "Sin memoria para un comando de %d bytes, descartado", msg.len);
+                cJSON_Delete(root);
+                break;
+            }
+            cJSON *action = cJSON_GetObjectItem(root, "action");
+            cJSON *url    = cJSON_GetObjectItem(root, "url");
 
             // 👇 CASO ESPECIAL: otaUpdate (no va a cmd_queue)
             if (cJSON_IsString(action) && action->valuestring &&
                 strcmp(action->valuestring, "otaUpdate") == 0) {
 
+                // El payload no hace falta: todo va en ota_start_async
+                cmd_msg_free(&cmd);
+
                 if (!cJSON_IsString(url) || !url->valuestring) {
                     ESP_LOGW(TAG, "otaUpdate sin campo 'url'");
                     cJSON_Delete(root);
@@ -282,13 +410,24 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
             // Resto de acciones normales → cmd_queue
             cJSON_Delete(root);
 
+            if (strcmp(cmd.action, COMMANDS_LOCAL_ACCESS) == 0) {
+                ESP_LOGW(TAG, "Accion interna '%s' recibida por MQTT, ignorada", cmd.action);
+                cmd_msg_free(&cmd);
+                break;
+            }
+
             if (xQueueSend(cmd_queue, &cmd, portMAX_DELAY) != pdTRUE) {
                 ESP_LOGW(TAG, "cmd_queue: error inesperado al encolar comando");
+                cmd_msg_free(&cmd);
             }
 
             break;
         }
 
+        case MQTT_EVENT_PUBLISHED:
+            net_metrics_on_published(event->msg_id);
+            break;
+
         default:
             break;
     }
@@ -319,6 +458,8 @@ void mqtt_start(void)
     mqtt_cfg.credentials.client_id               = device_id;
     mqtt_cfg.credentials.authentication.password = MQTT_PASS;
     mqtt_cfg.session.disable_clean_session       = true;
+    // Las reconexiones las decide conn_supervisor (IP + backoff con jitter)
+    mqtt_cfg.network.disable_auto_reconnect      = true;
 
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(
@@ -334,8 +475,8 @@ void mqtt_start(void)
 void mqtt_start_tasks(void)
 {
     // Task de salida MQTT
-    xTaskCreate(mqtt_out_task, "mqtt_out_task", 6144, NULL, 4, NULL);
+    task_manifest_create(TASK_MQTT_OUT, mqtt_out_task, NULL, NULL);
 
     // Task status periódico
-    xTaskCreate(status_task, "status_task", 4096, NULL, 3, NULL);
+    task_manifest_create(TASK_STATUS, status_task, NULL, NULL);
 }
@@ -2,13 +2,33 @@
 #pragma once
 
 #include "esp_err.h"
+#include "cJSON.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 bool mqtt_enqueue(const char *topic,
                   const char *payload,
                   int qos,
                   int retain);
 
+// Payload binario (CBOR), como mucho MQTT_OUT_PAYLOAD_SZ bytes.
+bool mqtt_enqueue_bin(const char *topic,
+                      const void *data,
+                      size_t len,
+                      int qos,
+                      int retain);
+
+// Serializa root según la codificación negociada (JSON o CBOR en
+// "<topic>/cbor"). No libera root.
+bool mqtt_enqueue_json(const char *topic,
+                       const cJSON *root,
+                       int qos,
+                       int retain);
+
+// Bytes de payload + topic encolados y aún sin publicar
+uint32_t mqtt_out_bytes(void);
+
 void mqtt_start(void);
 void mqtt_start_tasks(void);
 
@@ -0,0 +1,200 @@
+// mqtt_reasm.c
+
+#include "mqtt_reasm.h"
+#include "config.h"
+#include "mem_place.h"
+
+#include "esp_log.h"
+
+#include <string.h>
+
+static const char *TAG = "MQTT_REASM";
+
+#define MQTT_REASM_MAX_SINKS 4
+
+typedef enum {
+    REASM_IDLE = 0,
+    REASM_BUFFER,
+    REASM_STREAM,
+    REASM_DROP,
+} reasm_mode_t;
+
+typedef struct {
+    char topic[128];
+    const mqtt_stream_sink_t *sink;
+} sink_entry_t;
+
+// Arena acotado: un único mensaje en vuelo, esp-mqtt entrega los fragmentos
+// en orden desde su propia tarea. +1 para dejar el cuerpo terminado en '\0'.
+// Se reserva (en PSRAM si la hay) con el primer mensaje fragmentado.
+static char *s_arena = NULL;
+
+static struct {
+    reasm_mode_t mode;
+    char   topic[128];
+    int    topic_len;
+    size_t total;
+    size_t received;
+    const mqtt_stream_sink_t *sink;
+} s_rx = {0};
+
+static sink_entry_t s_sinks[MQTT_REASM_MAX_SINKS];
+
+bool mqtt_reasm_register_sink(const char *topic, const mqtt_stream_sink_t *sink)
+{
+    if (!topic || !sink || !sink->write) return false;
+
+    for (int i = 0; i < MQTT_REASM_MAX_SINKS; i++) {
+        if (s_sinks[i].sink == NULL || strcmp(s_sinks[i].topic, topic) == 0) {
+            strncpy(s_sinks[i].topic, topic, sizeof(s_sinks[i].topic) - 1);
+            s_sinks[i].sink = sink;
+            ESP_LOGI(TAG, "Sink registrado para '%s'", topic);
+            return true;
+        }
+    }
+
+    ESP_LOGW(TAG, "Sin hueco para sink de '%s'", topic);
+    return false;
+}
+
+const char *mqtt_reasm_sink_topic(int idx)
+{
+    if (idx < 0 || idx >= MQTT_REASM_MAX_SINKS || s_sinks[idx].sink == NULL) {
+        return NULL;
+    }
+    return s_sinks[idx].topic;
+}
+
+static const mqtt_stream_sink_t *find_sink(const char *topic, int topic_len)
+{
+    for (int i = 0; i < MQTT_REASM_MAX_SINKS && s_sinks[i].sink; i++) {
+        if ((int)strlen(s_sinks[i].topic) == topic_len &&
+            memcmp(s_sinks[i].topic, topic, topic_len) == 0) {
+            return s_sinks[i].sink;
+        }
+    }
+    return NULL;
+}
+
+static void abort_current(const char *why)
+{
+    if (s_rx.mode == REASM_IDLE) return;
+
+    ESP_LOGW(TAG, "Descartando mensaje '%.*s' (%u/%u bytes): %s",
+             s_rx.topic_len, s_rx.topic,
+             (unsigned)s_rx.received, (unsigned)s_rx.total, why);
+
+    if (s_rx.mode == REASM_STREAM && s_rx.sink->end) {
+        s_rx.sink->end(false, s_rx.sink->ctx);
+    }
+    s_rx.mode = REASM_IDLE;
+}
+
+static void start_message(const esp_mqtt_event_t *event)
+{
+    abort_current("nuevo mensaje antes de completar el anterior");
+
+    int tl = event->topic_len;
+    if (tl > (int)sizeof(s_rx.topic) - 1) tl = sizeof(s_rx.topic) - 1;
+    memcpy(s_rx.topic, event->topic, tl);
+    s_rx.topic[tl] = '\0';
+    s_rx.topic_len = tl;
+
+    s_rx.total    = (size_t)event->total_data_len;
+    s_rx.received = 0;
+    s_rx.sink     = NULL;
+
+    if (s_rx.total <= MQTT_REASM_ARENA_SZ) {
+        if (!s_arena) s_arena = mem_place_alloc("mqtt_reasm", MQTT_REASM_ARENA_SZ + 1, MEM_COLD);
+        s_rx.mode = s_arena ? REASM_BUFFER : REASM_DROP;
+        return;
+    }
+
+    const mqtt_stream_sink_t *sink = find_sink(s_rx.topic, s_rx.topic_len);
+    if (sink && (!sink->begin || sink->begin(s_rx.total, sink->ctx) == ESP_OK)) {
+        ESP_LOGI(TAG, "Streaming %u bytes de '%s' a sink",
+                 (unsigned)s_rx.total, s_rx.topic);
+        s_rx.sink = sink;
+        s_rx.mode = REASM_STREAM;
+        return;
+    }
+
+    ESP_LOGW(TAG, "Mensaje de %u bytes en '%s' excede arena (%d) y no hay sink",
+             (unsigned)s_rx.total, s_rx.topic, MQTT_REASM_ARENA_SZ);
+    s_rx.mode = REASM_DROP;
+}
+
+mqtt_reasm_result_t mqtt_reasm_feed(const esp_mqtt_event_t *event, mqtt_reasm_msg_t *out)
+{
+    size_t offset = (size_t)event->current_data_offset;
+    size_t len    = (size_t)event->data_len;
+
+    // Camino rápido: mensaje entero en un solo evento -> cero copias
+    if (offset == 0 && event->total_data_len == event->data_len) {
+        abort_current("nuevo mensaje antes de completar el anterior");
+        out->topic     = event->topic;
+        out->topic_len = event->topic_len;
+        out->data      = event->data;
+        out->len       = event->data_len;
+        return MQTT_REASM_READY;
+    }
+
+    if (offset == 0) {
+        start_message(event);
+    } else if (s_rx.mode == REASM_IDLE) {
+        // continuación de algo que ya descartamos
+        return MQTT_REASM_DROPPED;
+    } else if (offset != s_rx.received) {
+        abort_current("fragmento fuera de orden");
+        return MQTT_REASM_DROPPED;
+    }
+
+    switch (s_rx.mode) {
+        case REASM_BUFFER:
+            if (offset + len > MQTT_REASM_ARENA_SZ) {
+                abort_current("fragmento excede total anunciado");
+                return MQTT_REASM_DROPPED;
+            }
+            memcpy(s_arena + offset, event->data, len);
+            break;
+
+        case REASM_STREAM:
+            if (s_rx.sink->write(event->data, len, offset, s_rx.sink->ctx) != ESP_OK) {
+                abort_current("error escribiendo en sink");
+                return MQTT_REASM_DROPPED;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    s_rx.received += len;
+    if (s_rx.received < s_rx.total) {
+        return MQTT_REASM_PENDING;
+    }
+
+    reasm_mode_t mode = s_rx.mode;
+    s_rx.mode = REASM_IDLE;
+
+    if (mode == REASM_BUFFER) {
+        s_arena[s_rx.total] = '\0';
+        out->topic     = s_rx.topic;
+        out->topic_len = s_rx.topic_len;
+        out->data      = s_arena;
+        out->len       = (int)s_rx.total;
+        ESP_LOGI(TAG, "Mensaje reensamblado: '%s' %u bytes",
+                 s_rx.topic, (unsigned)s_rx.total);
+        return MQTT_REASM_READY;
+    }
+
+    if (mode == REASM_STREAM) {
+        if (s_rx.sink->end && s_rx.sink->end(true, s_rx.sink->ctx) != ESP_OK) {
+            ESP_LOGW(TAG, "Sink de '%s' rechazo el cuerpo", s_rx.topic);
+            return MQTT_REASM_DROPPED;
+        }
+        return MQTT_REASM_STREAMED;
+    }
+
+    return MQTT_REASM_DROPPED;
+}
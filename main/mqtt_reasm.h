@@ -0,0 +1,43 @@
+// mqtt_reasm.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+// Mensaje completo listo para decodificar. Los punteros apuntan al evento
+// (mensaje en un solo fragmento) o al arena interno; válidos sólo hasta el
+// siguiente mqtt_reasm_feed().
+typedef struct {
+    const char *topic;
+    int         topic_len;
+    const char *data;
+    int         len;
+} mqtt_reasm_msg_t;
+
+typedef enum {
+    MQTT_REASM_PENDING = 0,   // faltan fragmentos
+    MQTT_REASM_READY,         // mensaje completo en out
+    MQTT_REASM_STREAMED,      // cuerpo entregado entero a un sink
+    MQTT_REASM_DROPPED,       // demasiado grande sin sink, o fragmentos fuera de orden
+} mqtt_reasm_result_t;
+
+// Sink para cuerpos más grandes que el arena (p.ej. escritura directa a flash).
+// write() recibe los fragmentos en orden con su offset dentro del mensaje.
+typedef struct {
+    esp_err_t (*begin)(size_t total_len, void *ctx);
+    esp_err_t (*write)(const void *data, size_t len, size_t offset, void *ctx);
+    esp_err_t (*end)(bool complete, void *ctx);
+    void *ctx;
+} mqtt_stream_sink_t;
+
+// Alimenta un MQTT_EVENT_DATA. Sólo se llama desde el handler MQTT (una tarea).
+mqtt_reasm_result_t mqtt_reasm_feed(const esp_mqtt_event_t *event, mqtt_reasm_msg_t *out);
+
+// Asocia un sink a un topic exacto. El sink se usa para cualquier mensaje de
+// ese topic que no quepa en el arena. El puntero debe seguir vivo.
+bool mqtt_reasm_register_sink(const char *topic, const mqtt_stream_sink_t *sink);
+
+// Topics con sink registrado (para suscribirse al conectar). NULL al acabar.
+const char *mqtt_reasm_sink_topic(int idx);
@@ -0,0 +1,307 @@
+// net_metrics.c
+
+#include "net_metrics.h"
+#include "config.h"
+#include "core.h"
+#include "params.h"
+#include "conn_supervisor.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *TAG = "NET_METRICS";
+
+#define NET_METRICS_WINDOW      64   // muestras por ventana móvil
+#define NET_METRICS_ACK_SLOTS   8    // QoS1 pendientes de PUBACK
+
+typedef struct {
+    uint32_t v[NET_METRICS_WINDOW];  // microsegundos
+    int      n;
+    int      head;
+} sample_ring_t;
+
+typedef struct {
+    int     msg_id;
+    int64_t t_us;
+    bool    acked;      // PUBACK antes que net_metrics_on_publish: t_us es la del ack
+} ack_slot_t;
+
+static portMUX_TYPE s_nm_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static sample_ring_t s_rtt = {0};
+static sample_ring_t s_ack = {0};
+static ack_slot_t    s_ack_pending[NET_METRICS_ACK_SLOTS];
+
+static uint32_t s_probe_seq = 0;
+static int64_t  s_probe_sent_us = 0;
+static bool     s_probe_outstanding = false;
+static uint32_t s_probe_lost = 0;
+
+static uint32_t s_connects = 0;
+static int64_t  s_outage_start_us = 0;
+static uint32_t s_outage_last_ms = 0;
+static uint32_t s_outage_max_ms = 0;
+static uint64_t s_outage_total_ms = 0;
+
+static char s_probe_topic[128] = {0};
+static esp_timer_handle_t s_probe_timer = NULL;
+static int32_t            s_probe_period_ms = 0;   // periodo con el que corre el timer
+
+static void ring_push(sample_ring_t *r, uint32_t v)
+{
+    r->v[r->head] = v;
+    r->head = (r->head + 1) % NET_METRICS_WINDOW;
+    if (r->n < NET_METRICS_WINDOW) r->n++;
+}
+
+// p50/p95/p99 sobre una copia ordenada (64 elementos: inserción basta)
+static void ring_percentiles(const sample_ring_t *src, uint32_t out[3])
+{
+    uint32_t tmp[NET_METRICS_WINDOW];
+    int n;
+
+    portENTER_CRITICAL(&s_nm_mux);
+    n = src->n;
+    memcpy(tmp, src->v, sizeof(tmp));
+    portEXIT_CRITICAL(&s_nm_mux);
+
+    out[0] = out[1] = out[2] = 0;
+    if (n == 0) return;
+
+    for (int i = 1; i < n; i++) {
+        uint32_t x = tmp[i];
+        int j = i - 1;
+        while (j >= 0 && tmp[j] > x) {
+            tmp[j + 1] = tmp[j];
+            j--;
+        }
+        tmp[j + 1] = x;
+    }
+
+    static const int pct[3] = { 50, 95, 99 };
+    for (int k = 0; k < 3; k++) {
+        int idx = (n * pct[k] + 99) / 100 - 1;
+        if (idx < 0) idx = 0;
+        if (idx >= n) idx = n - 1;
+        out[k] = tmp[idx];
+    }
+}
+
+// ================== SONDA LOOPBACK ==================
+
+static void probe_timer_cb(void *arg)
+{
+    (void)arg;
+
+    // probePeriodMs cambiado por setConfig: se aplica desde este disparo
+    int32_t period_ms = params_get(PARAM_PROBE_PERIOD_MS);
+    if (period_ms != s_probe_period_ms &&
+        esp_timer_restart(s_probe_timer, (uint64_t)period_ms * 1000) == ESP_OK) {
+        s_probe_period_ms = period_ms;
+    }
+
+    if (!conn_sup_mqtt_up() || !mqtt_client) return;
+
+    char payload[24];
+    uint32_t seq;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_nm_mux);
+    if (s_probe_outstanding) s_probe_lost++;
+    seq = ++s_probe_seq;
+    s_probe_sent_us = now;
+    s_probe_outstanding = true;
+    portEXIT_CRITICAL(&s_nm_mux);
+
+    int n = snprintf(payload, sizeof(payload), "p%lu", (unsigned long)seq);
+
+    // enqueue: no bloquea la tarea de esp_timer, lo envía la tarea MQTT
+    if (esp_mqtt_client_enqueue(mqtt_client, s_probe_topic, payload, n, 0, 0, true) < 0) {
+        portENTER_CRITICAL(&s_nm_mux);
+        s_probe_outstanding = false;
+        portEXIT_CRITICAL(&s_nm_mux);
+    }
+}
+
+esp_err_t net_metrics_init(void)
+{
+    snprintf(s_probe_topic, sizeof(s_probe_topic), "%s/probe", topic_cmd);
+
+    if (s_probe_timer) return ESP_OK;
+
+    const esp_timer_create_args_t args = {
+        .callback = probe_timer_cb,
+        .name     = "net_probe",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_probe_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_timer_create: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_probe_period_ms = params_get(PARAM_PROBE_PERIOD_MS);
+    return esp_timer_start_periodic(s_probe_timer, (uint64_t)s_probe_period_ms * 1000);
+}
+
+const char *net_metrics_probe_topic(void)
+{
+    return s_probe_topic;
+}
+
+bool net_metrics_handle_probe(const char *topic, int topic_len,
+                              const char *data, int len)
+{
+    if (topic_len != (int)strlen(s_probe_topic) ||
+        memcmp(topic, s_probe_topic, topic_len) != 0) {
+        return false;
+    }
+
+    char tmp[16];
+    if (len <= 1 || len >= (int)sizeof(tmp) || data[0] != 'p') return true;
+    memcpy(tmp, data + 1, len - 1);
+    tmp[len - 1] = '\0';
+    uint32_t seq = (uint32_t)strtoul(tmp, NULL, 10);
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_nm_mux);
+    if (s_probe_outstanding && seq == s_probe_seq) {
+        ring_push(&s_rtt, (uint32_t)(now - s_probe_sent_us));
+        s_probe_outstanding = false;
+    }
+    portEXIT_CRITICAL(&s_nm_mux);
+    return true;
+}
+
+// ================== PUBACK QoS1 ==================
+
+// El msg_id sólo se conoce cuando vuelve esp_mqtt_client_publish, y en ese
+// hueco la task de MQTT puede entregar ya el PUBACK. Los dos lados apuntan
+// lo suyo con el spinlock tomado y el que llega segundo cierra la muestra,
+// en el orden que sea.
+
+// Con s_nm_mux tomado: slot libre, o el más antiguo
+static ack_slot_t *ack_slot_take(void)
+{
+    int oldest = 0;
+    for (int i = 0; i < NET_METRICS_ACK_SLOTS; i++) {
+        if (s_ack_pending[i].msg_id == 0) return &s_ack_pending[i];
+        if (s_ack_pending[i].t_us < s_ack_pending[oldest].t_us) oldest = i;
+    }
+    return &s_ack_pending[oldest];
+}
+
+// Con s_nm_mux tomado
+static ack_slot_t *ack_slot_find(int msg_id, bool acked)
+{
+    for (int i = 0; i < NET_METRICS_ACK_SLOTS; i++) {
+        if (s_ack_pending[i].msg_id == msg_id && s_ack_pending[i].acked == acked) {
+            return &s_ack_pending[i];
+        }
+    }
+    return NULL;
+}
+
+void net_metrics_on_publish(int msg_id, int qos, int64_t t_start_us)
+{
+    if (qos < 1 || msg_id <= 0) return;
+
+    portENTER_CRITICAL(&s_nm_mux);
+    ack_slot_t *s = ack_slot_find(msg_id, true);
+    if (s) {
+        int64_t dt = s->t_us - t_start_us;
+        ring_push(&s_ack, (uint32_t)(dt > 0 ? dt : 0));
+        s->msg_id = 0;
+    } else {
+        s = ack_slot_take();
+        s->msg_id = msg_id;
+        s->t_us   = t_start_us;
+        s->acked  = false;
+    }
+    portEXIT_CRITICAL(&s_nm_mux);
+}
+
+void net_metrics_on_published(int msg_id)
+{
+    if (msg_id <= 0) return;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_nm_mux);
+    ack_slot_t *s = ack_slot_find(msg_id, false);
+    if (s) {
+        ring_push(&s_ack, (uint32_t)(now - s->t_us));
+        s->msg_id = 0;
+    } else {
+        // Todavía no ha vuelto el publish: se guarda la hora del ack
+        s = ack_slot_take();
+        s->msg_id = msg_id;
+        s->t_us   = now;
+        s->acked  = true;
+    }
+    portEXIT_CRITICAL(&s_nm_mux);
+}
+
+// ================== RECONEXIONES / CORTES ==================
+
+void net_metrics_on_connected(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_nm_mux);
+    s_connects++;
+    if (s_outage_start_us) {
+        uint32_t ms = (uint32_t)((now - s_outage_start_us) / 1000);
+        s_outage_last_ms = ms;
+        if (ms > s_outage_max_ms) s_outage_max_ms = ms;
+        s_outage_total_ms += ms;
+        s_outage_start_us = 0;
+    }
+    s_probe_outstanding = false;
+    memset(s_ack_pending, 0, sizeof(s_ack_pending));
+    portEXIT_CRITICAL(&s_nm_mux);
+}
+
+void net_metrics_on_disconnected(void)
+{
+    portENTER_CRITICAL(&s_nm_mux);
+    if (s_outage_start_us == 0) s_outage_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_nm_mux);
+}
+
+void net_metrics_add_to_json(cJSON *root)
+{
+    uint32_t rtt[3], ack[3];
+    ring_percentiles(&s_rtt, rtt);
+    ring_percentiles(&s_ack, ack);
+
+    cJSON *net = cJSON_CreateObject();
+    if (!net) return;
+
+    // en ms con décimas: suficiente para separar WiFi (~ms) de backend (~100 ms)
+    cJSON_AddNumberToObject(net, "rttP50", rtt[0] / 100 / 10.0);
+    cJSON_AddNumberToObject(net, "rttP95", rtt[1] / 100 / 10.0);
+    cJSON_AddNumberToObject(net, "rttP99", rtt[2] / 100 / 10.0);
+    cJSON_AddNumberToObject(net, "ackP50", ack[0] / 100 / 10.0);
+    cJSON_AddNumberToObject(net, "ackP95", ack[1] / 100 / 10.0);
+    cJSON_AddNumberToObject(net, "ackP99", ack[2] / 100 / 10.0);
+
+    portENTER_CRITICAL(&s_nm_mux);
+    uint32_t lost       = s_probe_lost;
+    uint32_t reconnects = s_connects > 0 ? s_connects - 1 : 0;
+    uint32_t last_ms    = s_outage_last_ms;
+    uint32_t max_ms     = s_outage_max_ms;
+    uint64_t total_ms   = s_outage_total_ms;
+    portEXIT_CRITICAL(&s_nm_mux);
+
+    cJSON_AddNumberToObject(net, "probeLost",  lost);
+    cJSON_AddNumberToObject(net, "reconnects", reconnects);
+    cJSON_AddNumberToObject(net, "outLastMs",  last_ms);
+    cJSON_AddNumberToObject(net, "outMaxMs",   max_ms);
+    cJSON_AddNumberToObject(net, "outTotMs",   (double)total_ms);
+
+    cJSON_AddItemToObject(root, "net", net);
+}
@@ -0,0 +1,27 @@
+// net_metrics.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+// Sonda de ida y vuelta al broker + telemetría de calidad de conexión.
+// Sirve para distinguir WiFi lento del club de backend lento.
+
+esp_err_t net_metrics_init(void);
+
+// Ganchos desde mqtt_manager
+void net_metrics_on_connected(void);
+void net_metrics_on_disconnected(void);
+void net_metrics_on_publish(int msg_id, int qos, int64_t t_start_us);
+void net_metrics_on_published(int msg_id);
+
+// true si el mensaje era la sonda loopback (ya consumido)
+bool net_metrics_handle_probe(const char *topic, int topic_len,
+                              const char *data, int len);
+
+const char *net_metrics_probe_topic(void);
+
+// Añade el objeto "net" al payload de status
+void net_metrics_add_to_json(cJSON *root);
@@ -0,0 +1,308 @@
+// ota_health.c
+
+#include "ota_health.h"
+#include "config.h"
+#include "core.h"
+#include "params.h"
+#include "app_config.h"
+#include "mqtt_manager.h"
+#include "conn_supervisor.h"
+#include "rc522_reader.h"
+#include "gm861s_reader.h"
+#include "task_manifest.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include <string.h>
+
+static const char *TAG = "OTA_HEALTH";
+static const char *NVS_NAMESPACE = "ota";
+
+// Claves en NVS: partición a la que fue la última OTA y, si la imagen nueva
+// no pasó la validación, el motivo y su versión
+#define KEY_TRY  "try"
+#define KEY_WHY  "why"
+#define KEY_FW   "fw"
+
+#define WHY_MAX  48
+#define FW_MAX   32
+
+static volatile bool s_pending = false;
+static char          s_try[17] = {0};     // etiqueta de partición (máx. 16)
+
+typedef struct {
+    bool     wifi;
+    bool     mqtt;
+    bool     rfid;
+    bool     qr;
+    bool     heap;
+    uint8_t  rc522_ver[2];
+    uint32_t heap_free;
+} health_t;
+
+// ================== NVS ==================
+
+static void nvs_read_str(nvs_handle_t h, const char *key, char *out, size_t sz)
+{
+    size_t len = sz;
+    if (nvs_get_str(h, key, out, &len) != ESP_OK) out[0] = '\0';
+}
+
+static void health_store(const char *why)
+{
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    if (why) {
+        nvs_set_str(h, KEY_WHY, why);
+        nvs_set_str(h, KEY_FW, FW_VERSION);
+    } else {
+        nvs_erase_all(h);
+    }
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+void ota_health_arm(const esp_partition_t *part)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "nvs_open: %s, la OTA no se podra reportar", esp_err_to_name(err));
+        return;
+    }
+    nvs_erase_all(h);
+    nvs_set_str(h, KEY_TRY, part->label);
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+// ================== COMPROBACIONES ==================
+
+static bool health_check(health_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->wifi = conn_sup_wifi_up();
+    c->mqtt = conn_sup_mqtt_up();
+
+    // Un lector deshabilitado por config no cuenta
+    c->rfid = !g_app_config.enable_cards || pn532_reader_self_test(c->rc522_ver);
+    c->qr   = !g_app_config.enable_qr ||
+              (gm861s_reader_running() && gm861s_reader_baud() != 0);
+
+    c->heap_free = esp_get_free_heap_size();
+    c->heap = c->heap_free >= OTA_HEALTH_MIN_HEAP;
+
+    return c->wifi && c->mqtt && c->rfid && c->qr && c->heap;
+}
+
+// "mqtt,qr": lo que falla, para el log y el motivo del rollback
+static void health_failed(const health_t *c, char *out, size_t sz)
+{
+    const struct { bool ok; const char *name; } f[] = {
+        { c->wifi, "wifi" }, { c->mqtt, "mqtt" }, { c->rfid, "rfid" },
+        { c->qr,   "qr"   }, { c->heap, "heap" },
+    };
+    size_t n = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < sizeof(f) / sizeof(f[0]); i++) {
+        if (f[i].ok) continue;
+        int w = snprintf(out + n, sz - n, "%s%s", n ? "," : "", f[i].name);
+        if (w < 0 || (size_t)w >= sz - n) break;
+        n += (size_t)w;
+    }
+}
+
+// ================== MQTT ==================
+
+static void health_publish(bool ok, const char *fw, bool rollback, const char *err,
+                           int64_t healthy_us, const health_t *c)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+
+    cJSON_AddStringToObject(root, "action",   "otaHealth");
+    cJSON_AddStringToObject(root, "id",       device_id);
+    cJSON_AddBoolToObject  (root, "ok",       ok);
+    cJSON_AddStringToObject(root, "fw",       fw);
+    cJSON_AddStringToObject(root, "running",  FW_VERSION);
+    cJSON_AddBoolToObject  (root, "rollback", rollback);
+    if (err && err[0]) cJSON_AddStringToObject(root, "err", err);
+    if (healthy_us > 0) cJSON_AddNumberToObject(root, "healthyMs", (double)(healthy_us / 1000));
+    cJSON_AddNumberToObject(root, "ms", (double)(esp_timer_get_time() / 1000));
+
+    if (c) {
+        cJSON *ch = cJSON_AddObjectToObject(root, "checks");
+        if (ch) {
+            cJSON_AddBoolToObject  (ch, "wifi", c->wifi);
+            cJSON_AddBoolToObject  (ch, "mqtt", c->mqtt);
+            cJSON_AddBoolToObject  (ch, "rfid", c->rfid);
+            cJSON_AddBoolToObject  (ch, "qr",   c->qr);
+            cJSON_AddNumberToObject(ch, "heap", c->heap_free);
+        }
+    }
+
+    mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+    cJSON_Delete(root);
+}
+
+// ================== VALIDACIÓN ==================
+
+static void health_validate(void)
+{
+    health_t c;
+    int64_t t_ok_us = 0;     // inicio de la racha actual con todo bien (0 = no hay)
+
+    ESP_LOGI(TAG, "Imagen %s pendiente de validar (ventana %ld ms)",
+             FW_VERSION, (long)params_get(PARAM_OTA_HEALTH_MS));
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+
+        if (health_check(&c)) {
+            if (t_ok_us == 0) {
+                t_ok_us = now;
+                ESP_LOGI(TAG, "Todo OK a los %lld ms, esperando %d ms estable",
+                         (long long)(now / 1000), OTA_HEALTH_STABLE_MS);
+            }
+            if (now - t_ok_us >= (int64_t)OTA_HEALTH_STABLE_MS * 1000) break;
+        } else if (t_ok_us != 0) {
+            char why[WHY_MAX];
+            health_failed(&c, why, sizeof(why));
+            ESP_LOGW(TAG, "Se pierde la racha estable: %s", why);
+            t_ok_us = 0;
+        }
+
+        // Se lee en cada vuelta: un setConfig puede alargar la ventana
+        if (now >= (int64_t)params_get(PARAM_OTA_HEALTH_MS) * 1000) {
+            char why[WHY_MAX];
+            health_failed(&c, why, sizeof(why));
+            if (why[0] == '\0') snprintf(why, sizeof(why), "inestable");
+
+            // El aviso lo publica la imagen anterior: aquí puede no haber broker
+            ESP_LOGE(TAG, "Validacion fallida (%s), volviendo a la imagen anterior", why);
+            health_store(why);
+            app_config_flush_now();
+
+            esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+            // Sólo vuelve si no hay imagen anterior válida: se sigue con esta
+            ESP_LOGE(TAG, "Rollback imposible: %s", esp_err_to_name(err));
+            health_store(NULL);
+            s_pending = false;
+            health_publish(false, FW_VERSION, false, why, 0, &c);
+            return;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(OTA_HEALTH_CHECK_MS));
+    }
+
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_mark_app_valid_cancel_rollback: %s", esp_err_to_name(err));
+    } else {
+        app_config_drop_v1();
+    }
+    health_store(NULL);
+    s_pending = false;
+
+    ESP_LOGI(TAG, "Imagen %s validada: sana a los %lld ms del arranque",
+             FW_VERSION, (long long)(t_ok_us / 1000));
+    health_publish(err == ESP_OK, FW_VERSION, false, err == ESP_OK ? NULL : esp_err_to_name(err),
+                   t_ok_us, &c);
+}
+
+// Arranque tras una OTA que no dejó la imagen pendiente: o la imagen nueva
+// volvió atrás (motivo en NVS, o sin motivo si se reinició antes de acabar
+// la ventana) o el bootloader no tiene rollback y arrancó sin validar
+static void health_report_previous(void)
+{
+    char why[WHY_MAX] = {0};
+    char fw[FW_MAX] = {0};
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        nvs_read_str(h, KEY_WHY, why, sizeof(why));
+        nvs_read_str(h, KEY_FW, fw, sizeof(fw));
+        nvs_close(h);
+    }
+
+    const esp_partition_t *run = esp_ota_get_running_partition();
+    bool rollback = strcmp(run->label, s_try) != 0;
+
+    if (rollback && fw[0] == '\0') {
+        const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+                                                            ESP_PARTITION_SUBTYPE_ANY, s_try);
+        esp_app_desc_t desc;
+        if (p && esp_ota_get_partition_description(p, &desc) == ESP_OK) {
+            strncpy(fw, desc.version, sizeof(fw) - 1);
+        }
+    }
+    if (rollback && why[0] == '\0') snprintf(why, sizeof(why), "reinicio antes de validar");
+    if (!rollback) snprintf(fw, sizeof(fw), "%s", FW_VERSION);
+
+    if (rollback) {
+        ESP_LOGW(TAG, "La OTA a '%s' (%s) volvio atras: %s", s_try, fw[0] ? fw : "?", why);
+    } else {
+        ESP_LOGW(TAG, "Imagen nueva sin validar: el bootloader no tiene rollback");
+    }
+
+    conn_sup_wait(CONN_BIT_MQTT, portMAX_DELAY);
+
+    health_publish(!rollback, fw[0] ? fw : "?", rollback,
+                   rollback ? why : "sin rollback", 0, NULL);
+    health_store(NULL);
+}
+
+static void ota_health_task(void *pv)
+{
+    (void)pv;
+    if (s_pending) {
+        health_validate();
+    } else {
+        health_report_previous();
+    }
+    task_manifest_exit(TASK_OTA_HEALTH);
+}
+
+// ================== API ==================
+
+esp_err_t ota_health_init(void)
+{
+#ifndef CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+    ESP_LOGW(TAG, "Bootloader sin rollback: las OTA no se validan");
+#endif
+
+    const esp_partition_t *run = esp_ota_get_running_partition();
+    esp_ota_img_states_t st;
+    s_pending = (esp_ota_get_state_partition(run, &st) == ESP_OK &&
+                 st == ESP_OTA_IMG_PENDING_VERIFY);
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        nvs_read_str(h, KEY_TRY, s_try, sizeof(s_try));
+        nvs_close(h);
+    }
+
+    // Imagen ya validada (o sin rollback): no se vuelve a un firmware v1
+    if (!s_pending) app_config_drop_v1();
+
+    if (!s_pending && s_try[0] == '\0') return ESP_OK;   // arranque normal
+
+    if (task_manifest_create(TASK_OTA_HEALTH, ota_health_task, NULL, NULL) != pdPASS) {
+        // Sin validar, el bootloader volverá atrás en el próximo reinicio
+        ESP_LOGE(TAG, "No se pudo crear la task ota_health");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool ota_health_pending(void)
+{
+    return s_pending;
+}
@@ -0,0 +1,30 @@
+// ota_health.h
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+// Validación de la imagen tras una OTA.
+//
+// Con el rollback del bootloader (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE, ver
+// sdkconfig.defaults) la app nueva arranca en PENDING_VERIFY. Una task
+// comprueba WiFi, MQTT, autotest de los lectores habilitados y heap libre;
+// si todo aguanta OTA_HEALTH_STABLE_MS seguidos dentro de la ventana
+// (param otaHealthMs, desde el arranque) la imagen se marca como válida. Si
+// no, se guarda el motivo en NVS y se vuelve a la imagen anterior, que lo
+// publica al conectar. Si la imagen nueva se cuelga o reinicia antes de
+// validarse, el bootloader vuelve atrás igualmente.
+//
+// Por MQTT, una vez por OTA:
+//   otaHealth {"ok", "fw", "rollback", "healthyMs", "ms", "checks", "err"}
+
+// Al final del arranque: lanza la validación o el aviso de la OTA anterior
+esp_err_t ota_health_init(void);
+
+// Hay una imagen a medio validar: no se acepta otra OTA hasta que acabe
+bool ota_health_pending(void);
+
+// Antes del reinicio tras una OTA correcta: recuerda a qué partición se va
+void ota_health_arm(const esp_partition_t *part);
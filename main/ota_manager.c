@@ -1,48 +1,280 @@
 // ota_manager.c
 
 #include "ota_manager.h"
+#include "ota_stream.h"
+#include "ota_health.h"
 #include "mqtt_manager.h"
 #include "config.h"
 #include "core.h"
+#include "app_config.h"
+#include "task_manifest.h"
+#include "mem_place.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
-#include "esp_https_ota.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
 #include "cJSON.h"
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "OTA";
 
+// Descarga propia sobre esp_http_client + esp_ota_*: esp_https_ota_perform()
+// no deja retomar una conexión cortada sin perder el estado del
+// descompresor, y aquí un corte sólo cuesta reabrir con Range.
+
 typedef struct {
     char url[256];
     char id_peticion[64];
-} ota_request_t;
 
-static void ota_task(void *pv)
+    esp_http_client_handle_t http;
+    esp_ota_handle_t         ota;
+    const esp_partition_t   *part;
+    ota_stream_t             stream;
+    bool                     ota_open;
+    bool                     fatal;      // error que no se arregla reintentando
+
+    int64_t  total;          // bytes del fichero, -1 si el servidor no lo dice
+    int64_t  rx;             // bytes del fichero procesados: offset del próximo Range
+    int64_t  skip;           // a descartar si el servidor ignora el Range
+    uint32_t retries;        // cortes recuperados
+    int64_t  t_start_us;
+    int64_t  t_progress_us;
+
+    uint8_t  buf[OTA_HTTP_BUF_SZ];
+} ota_job_t;
+
+static volatile bool s_busy = false;
+
+// ================== MQTT ==================
+
+static void ota_add_stats(cJSON *root, const ota_job_t *job)
+{
+    int64_t ms = (esp_timer_get_time() - job->t_start_us) / 1000;
+
+    cJSON_AddNumberToObject(root, "rx",      (double)job->rx);
+    cJSON_AddNumberToObject(root, "total",   (double)job->total);
+    if (job->total > 0) {
+        cJSON_AddNumberToObject(root, "pct", (double)(job->rx * 100 / job->total));
+    }
+    cJSON_AddNumberToObject(root, "written", job->stream.out_bytes);
+    cJSON_AddNumberToObject(root, "kbps",    ms > 0 ? (double)(job->rx * 8 / ms) : 0);
+    cJSON_AddNumberToObject(root, "ms",      (double)ms);
+    cJSON_AddNumberToObject(root, "retries", job->retries);
+    cJSON_AddStringToObject(root, "fmt",     ota_stream_fmt_name(job->stream.fmt));
+}
+
+static void ota_publish_progress(ota_job_t *job)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+
+    cJSON_AddStringToObject(root, "action", "progresoOta");
+    cJSON_AddStringToObject(root, "id",     device_id);
+    cJSON_AddStringToObject(root, "idPeticion", job->id_peticion[0] ? job->id_peticion : "-");
+    ota_add_stats(root, job);
+
+    char *json = cJSON_PrintUnformatted(root);
+    if (json) {
+        mqtt_enqueue(TOPIC_RESP_FIXED, json, 0, 0);
+        cJSON_free(json);
+    }
+    cJSON_Delete(root);
+    job->t_progress_us = esp_timer_get_time();
+}
+
+// ================== DESCARGA ==================
+
+static esp_err_t ota_sink_write(void *ctx, const uint8_t *data, size_t len)
 {
-    ota_request_t *req = (ota_request_t *)pv;
-    ESP_LOGI(TAG, "Iniciando OTA desde URL: %s", req->url);
+    ota_job_t *job = (ota_job_t *)ctx;
+    return esp_ota_write(job->ota, data, len);
+}
+
+static esp_err_t ota_begin(ota_job_t *job)
+{
+    job->part = esp_ota_get_next_update_partition(NULL);
+    if (!job->part) {
+        ESP_LOGE(TAG, "Sin particion OTA libre");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Escritura secuencial: el borrado de cada sector se intercala con la
+    // descarga en vez de borrar 2 MB antes del primer byte
+    esp_err_t err = esp_ota_begin(job->part, OTA_WITH_SEQUENTIAL_WRITES, &job->ota);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin: %s", esp_err_to_name(err));
+        return err;
+    }
+    job->ota_open = true;
+    ota_stream_init(&job->stream, ota_sink_write, job);
 
     esp_http_client_config_t http_cfg = {
-        .url = req->url,
+        .url = job->url,
         .crt_bundle_attach = esp_crt_bundle_attach,
-        .timeout_ms = 15000,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+        .buffer_size = OTA_HTTP_BUF_SZ,
+        .keep_alive_enable = true,
     };
+    job->http = esp_http_client_init(&http_cfg);
+    if (!job->http) return ESP_ERR_NO_MEM;
 
-    esp_https_ota_config_t ota_cfg = {
-        .http_config = &http_cfg,
-    };
+    ESP_LOGI(TAG, "Escribiendo en '%s' (0x%" PRIx32 ")", job->part->label, job->part->address);
+    return ESP_OK;
+}
 
-    esp_err_t ret = esp_https_ota(&ota_cfg);
-    bool ok = (ret == ESP_OK);
+// Abre la petición desde job->rx. 4xx y similares no se reintentan.
+static esp_err_t ota_connect(ota_job_t *job)
+{
+    if (job->rx > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%" PRId64 "-", job->rx);
+        esp_http_client_set_header(job->http, "Range", range);
+    }
+
+    esp_err_t err = esp_http_client_open(job->http, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo conectar: %s", esp_err_to_name(err));
+        return err;
+    }
 
-    ESP_LOGI(TAG, "OTA finalizada: %s", ok ? "OK" : "KO");
+    int64_t len = esp_http_client_fetch_headers(job->http);
+    int status = esp_http_client_get_status_code(job->http);
+
+    if (status == 206) {
+        job->skip = 0;
+        if (len > 0) job->total = job->rx + len;
+    } else if (status == 200) {
+        // Sin soporte de Range el fichero vuelve entero: se salta lo que ya hay
+        job->skip = job->rx;
+        job->total = (len > 0) ? len : -1;
+        if (job->rx > 0) {
+            ESP_LOGW(TAG, "El servidor ignora Range, descartando %" PRId64 " bytes", job->rx);
+        }
+    } else {
+        ESP_LOGE(TAG, "HTTP %d al pedir desde el byte %" PRId64, status, job->rx);
+        job->fatal = (status >= 400 && status < 500);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Lee hasta el final del fichero o hasta que la conexión falle
+static esp_err_t ota_perform(ota_job_t *job)
+{
+    while (1) {
+        int n = esp_http_client_read(job->http, (char *)job->buf, sizeof(job->buf));
+        if (n <= 0) {
+            bool complete = esp_http_client_is_complete_data_received(job->http) ||
+                            (job->total >= 0 && job->rx >= job->total);
+            if (n == 0 && complete) return ESP_OK;
+            ESP_LOGW(TAG, "Lectura cortada en el byte %" PRId64 " (%d)", job->rx, n);
+            return ESP_FAIL;
+        }
+
+        const uint8_t *p = job->buf;
+        if (job->skip > 0) {
+            int drop = (job->skip < n) ? (int)job->skip : n;
+            job->skip -= drop;
+            p += drop;
+            n -= drop;
+        }
+        if (n == 0) continue;
+
+        esp_err_t err = ota_stream_feed(&job->stream, p, (size_t)n);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Imagen rechazada en el byte %" PRId64 ": %s",
+                     job->rx, esp_err_to_name(err));
+            job->fatal = true;
+            return err;
+        }
+        job->rx += n;
+
+        if (esp_timer_get_time() - job->t_progress_us >= (int64_t)OTA_PROGRESS_PERIOD_MS * 1000) {
+            ota_publish_progress(job);
+        }
+    }
+}
+
+static esp_err_t ota_finish(ota_job_t *job)
+{
+    esp_err_t err = ota_stream_finish(&job->stream);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // esp_ota_end valida la imagen entera (cabecera, segmentos y hash)
+    job->ota_open = false;
+    err = esp_ota_end(job->ota);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_end: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = esp_ota_set_boot_partition(job->part);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_set_boot_partition: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t ota_run(ota_job_t *job)
+{
+    esp_err_t err = ota_begin(job);
+    if (err != ESP_OK) return err;
+
+    int fails = 0;   // cortes seguidos sin avanzar
+    while (1) {
+        int64_t rx_before = job->rx;
+
+        err = ota_connect(job);
+        if (err == ESP_OK) err = ota_perform(job);
+        esp_http_client_close(job->http);
+
+        if (err == ESP_OK || job->fatal) break;
+        if (job->rx > rx_before) fails = 0;
+        if (++fails > OTA_MAX_RETRIES) {
+            ESP_LOGE(TAG, "Demasiados cortes seguidos, se aborta");
+            break;
+        }
+
+        uint32_t wait_ms = OTA_RETRY_BASE_MS << (fails - 1);
+        if (wait_ms > OTA_RETRY_MAX_MS) wait_ms = OTA_RETRY_MAX_MS;
+        job->retries++;
+        ESP_LOGW(TAG, "Reintento %d/%d en %lu ms desde el byte %" PRId64,
+                 fails, OTA_MAX_RETRIES, (unsigned long)wait_ms, job->rx);
+        ota_publish_progress(job);
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+    }
+
+    if (err == ESP_OK) err = ota_finish(job);
+    return err;
+}
+
+static void ota_task(void *pv)
+{
+    ota_job_t *job = (ota_job_t *)pv;
+    ESP_LOGI(TAG, "Iniciando OTA desde URL: %s", job->url);
+
+    job->total = -1;
+    job->t_start_us = esp_timer_get_time();
+    job->t_progress_us = job->t_start_us;
+
+    esp_err_t err = ota_run(job);
+    bool ok = (err == ESP_OK);
+
+    if (job->ota_open) esp_ota_abort(job->ota);
+    if (job->http) esp_http_client_cleanup(job->http);
+    ota_stream_free(&job->stream);
+
+    ESP_LOGI(TAG, "OTA finalizada: %s (%" PRId64 " bytes, %lu cortes, %s)",
+             ok ? "OK" : "KO", job->rx, (unsigned long)job->retries, esp_err_to_name(err));
 
     // Construir retorno OTA por MQTT
     cJSON *root = cJSON_CreateObject();
@@ -50,8 +282,10 @@ static void ota_task(void *pv)
         cJSON_AddStringToObject(root, "action", "retornoOta");
         cJSON_AddBoolToObject  (root, "ok",     ok);
         cJSON_AddStringToObject(root, "id",     device_id);
-        cJSON_AddStringToObject(root, "idPeticion", req->id_peticion[0] ? req->id_peticion : "-");
-        cJSON_AddStringToObject(root, "url",    req->url);
+        cJSON_AddStringToObject(root, "idPeticion", job->id_peticion[0] ? job->id_peticion : "-");
+        cJSON_AddStringToObject(root, "url",    job->url);
+        if (!ok) cJSON_AddStringToObject(root, "err", esp_err_to_name(err));
+        ota_add_stats(root, job);
 
         char *json = cJSON_PrintUnformatted(root);
         if (json) {
@@ -64,11 +298,14 @@ static void ota_task(void *pv)
     if (ok) {
         ESP_LOGI(TAG, "Reiniciando tras OTA OK...");
         vTaskDelay(pdMS_TO_TICKS(1000));
+        app_config_flush_now();   // setConfig de los últimos segundos
+        ota_health_arm(job->part);
         esp_restart();
     }
 
-    free(req);
-    vTaskDelete(NULL);
+    free(job);
+    s_busy = false;
+    task_manifest_exit(TASK_OTA);
 }
 
 bool ota_start_async(const char *url_firmware, const char *id_peticion)
@@ -77,22 +314,34 @@ bool ota_start_async(const char *url_firmware, const char *id_peticion)
         ESP_LOGW(TAG, "ota_start_async: URL vacia");
         return false;
     }
+    if (s_busy) {
+        ESP_LOGW(TAG, "ota_start_async: ya hay una OTA en curso");
+        return false;
+    }
+    if (ota_health_pending()) {
+        // Otra OTA ahora dejaría sin sitio la imagen a la que volver
+        ESP_LOGW(TAG, "ota_start_async: la imagen actual aun no esta validada");
+        return false;
+    }
 
-    ota_request_t *req = calloc(1, sizeof(ota_request_t));
-    if (!req) {
+    // Fuera de la RAM interna si hay PSRAM: sólo vive lo que dura la OTA
+    ota_job_t *job = mem_cold_calloc(1, sizeof(ota_job_t));
+    if (!job) {
         ESP_LOGE(TAG, "ota_start_async: sin memoria");
         return false;
     }
 
-    strncpy(req->url, url_firmware, sizeof(req->url) - 1);
+    strncpy(job->url, url_firmware, sizeof(job->url) - 1);
     if (id_peticion) {
-        strncpy(req->id_peticion, id_peticion, sizeof(req->id_peticion) - 1);
+        strncpy(job->id_peticion, id_peticion, sizeof(job->id_peticion) - 1);
     }
 
-    BaseType_t r = xTaskCreate(ota_task, "ota_task", 8192, req, 5, NULL);
+    s_busy = true;
+    BaseType_t r = task_manifest_create(TASK_OTA, ota_task, job, NULL);
     if (r != pdPASS) {
         ESP_LOGE(TAG, "ota_start_async: no se pudo crear ota_task");
-        free(req);
+        free(job);
+        s_busy = false;
         return false;
     }
 
@@ -0,0 +1,232 @@
+// ota_stream.c
+
+#include "ota_stream.h"
+#include "mem_place.h"
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "rom/miniz.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "OTA_STREAM";
+
+#define OTA_IMAGE_MAGIC  0xE9   // primer byte de una imagen de app ESP
+#define GZ_ID1           0x1F
+#define GZ_ID2           0x8B
+#define GZ_CM_DEFLATE    8
+
+// Flags de la cabecera gzip (RFC 1952)
+#define GZ_FHCRC     0x02
+#define GZ_FEXTRA    0x04
+#define GZ_FNAME     0x08
+#define GZ_FCOMMENT  0x10
+
+#define DICT_SZ      TINFL_LZ_DICT_SIZE
+
+_Static_assert((DICT_SZ & (DICT_SZ - 1)) == 0, "la ventana de tinfl debe ser potencia de 2");
+
+// ================== GZIP ==================
+
+// Longitud de la cabecera: 0 si faltan bytes, -1 si no es un gzip válido
+static int gzip_header_len(const uint8_t *p, size_t n)
+{
+    if (n < 10) return 0;
+    if (p[0] != GZ_ID1 || p[1] != GZ_ID2 || p[2] != GZ_CM_DEFLATE || (p[3] & 0xE0)) {
+        return -1;
+    }
+
+    uint8_t flg = p[3];
+    size_t i = 10;
+
+    if (flg & GZ_FEXTRA) {
+        if (n < i + 2) return 0;
+        i += 2 + (size_t)(p[i] | (p[i + 1] << 8));
+    }
+    // FNAME y FCOMMENT: cadenas terminadas en '\0'
+    for (uint8_t f = GZ_FNAME; f <= GZ_FCOMMENT; f <<= 1) {
+        if (!(flg & f)) continue;
+        while (i < n && p[i] != 0) i++;
+        if (i >= n) return 0;
+        i++;
+    }
+    if (flg & GZ_FHCRC) i += 2;
+
+    return (n < i) ? 0 : (int)i;
+}
+
+static esp_err_t gzip_start(ota_stream_t *s)
+{
+    // ~43 KB que sólo se usan durante la OTA: en PSRAM si la hay
+    s->inflator = mem_cold_calloc(1, sizeof(tinfl_decompressor));
+    s->dict = mem_cold_calloc(1, DICT_SZ);
+    if (!s->inflator || !s->dict) {
+        ESP_LOGE(TAG, "Sin memoria para descomprimir (%u bytes)",
+                 (unsigned)(sizeof(tinfl_decompressor) + DICT_SZ));
+        return ESP_ERR_NO_MEM;
+    }
+    tinfl_init((tinfl_decompressor *)s->inflator);
+    return ESP_OK;
+}
+
+// Deflate crudo, salida por la ventana circular
+static esp_err_t gzip_inflate(ota_stream_t *s, const uint8_t *data, size_t len)
+{
+    tinfl_decompressor *inf = (tinfl_decompressor *)s->inflator;
+    tinfl_status st = TINFL_STATUS_NEEDS_MORE_INPUT;
+    while (!s->inflate_done && (len > 0 || st == TINFL_STATUS_HAS_MORE_OUTPUT)) {
+        size_t in_sz = len;
+        size_t out_sz = DICT_SZ - s->dict_ofs;
+        st = tinfl_decompress(inf, data, &in_sz, s->dict, s->dict + s->dict_ofs,
+                              &out_sz, TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_sz;
+        len -= in_sz;
+
+        if (out_sz > 0) {
+            const uint8_t *out = s->dict + s->dict_ofs;
+            s->crc = esp_rom_crc32_le(s->crc, out, (uint32_t)out_sz);
+            s->out_bytes += (uint32_t)out_sz;
+            s->dict_ofs = (s->dict_ofs + out_sz) & (DICT_SZ - 1);
+            esp_err_t err = s->write(s->write_ctx, out, out_sz);
+            if (err != ESP_OK) return err;
+        }
+
+        if (st < 0) {
+            ESP_LOGE(TAG, "Deflate corrupto (%d) en el byte %lu",
+                     (int)st, (unsigned long)s->in_bytes);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (st == TINFL_STATUS_DONE) s->inflate_done = true;
+    }
+
+    if (len > 0) {
+        ESP_LOGW(TAG, "%u bytes entre el deflate y la cola, ignorados", (unsigned)len);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t gzip_feed(ota_stream_t *s, const uint8_t *data, size_t len)
+{
+    // 1) Cabecera: se acumula hasta tenerla entera, llegue como llegue
+    if (!s->hdr_done) {
+        size_t room = sizeof(s->hdr) - s->hdr_len;
+        size_t take = len < room ? len : room;
+        memcpy(&s->hdr[s->hdr_len], data, take);
+
+        int h = gzip_header_len(s->hdr, s->hdr_len + take);
+        if (h < 0 || (h == 0 && take == room)) {
+            ESP_LOGE(TAG, "Cabecera gzip no valida");
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (h == 0) {
+            s->hdr_len += take;
+            return ESP_OK;
+        }
+
+        size_t used = (size_t)h - s->hdr_len;
+        data += used;
+        len -= used;
+        s->hdr_done = true;
+    }
+
+    // 2) Los 8 últimos bytes recibidos (CRC32 + ISIZE si el fichero acaba
+    //    aquí) no pasan por tinfl: el de la ROM es miniz 1.x, lee por delante
+    //    y no devuelve lo que le sobra, así que se comería parte de la cola.
+    //    Lo que sale de la reserva al llegar más datos sí es deflate.
+    size_t avail = s->trailer_len + len;
+    if (avail <= sizeof(s->trailer)) {
+        memcpy(&s->trailer[s->trailer_len], data, len);
+        s->trailer_len += (uint8_t)len;
+        return ESP_OK;
+    }
+
+    size_t deflate_len = avail - sizeof(s->trailer);
+    size_t from_tail = deflate_len < s->trailer_len ? deflate_len : s->trailer_len;
+    size_t from_data = deflate_len - from_tail;
+
+    esp_err_t err = gzip_inflate(s, s->trailer, from_tail);
+    if (err == ESP_OK) err = gzip_inflate(s, data, from_data);
+    if (err != ESP_OK) return err;
+
+    memmove(s->trailer, &s->trailer[from_tail], s->trailer_len - from_tail);
+    s->trailer_len -= (uint8_t)from_tail;
+    memcpy(&s->trailer[s->trailer_len], data + from_data, len - from_data);
+    s->trailer_len = sizeof(s->trailer);
+    return ESP_OK;
+}
+
+// ================== API ==================
+
+void ota_stream_init(ota_stream_t *s, ota_stream_write_fn_t write, void *ctx)
+{
+    memset(s, 0, sizeof(*s));
+    s->write = write;
+    s->write_ctx = ctx;
+}
+
+esp_err_t ota_stream_feed(ota_stream_t *s, const uint8_t *data, size_t len)
+{
+    if (len == 0) return ESP_OK;
+    s->in_bytes += (uint32_t)len;
+
+    if (s->fmt == OTA_FMT_UNKNOWN) {
+        if (data[0] == OTA_IMAGE_MAGIC) {
+            s->fmt = OTA_FMT_RAW;
+        } else if (data[0] == GZ_ID1) {
+            s->fmt = OTA_FMT_GZIP;
+            esp_err_t err = gzip_start(s);
+            if (err != ESP_OK) return err;
+        } else {
+            ESP_LOGE(TAG, "Formato de imagen desconocido (primer byte 0x%02X)", data[0]);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        ESP_LOGI(TAG, "Imagen %s", ota_stream_fmt_name(s->fmt));
+    }
+
+    if (s->fmt == OTA_FMT_RAW) {
+        s->out_bytes += (uint32_t)len;
+        return s->write(s->write_ctx, data, len);
+    }
+    return gzip_feed(s, data, len);
+}
+
+esp_err_t ota_stream_finish(ota_stream_t *s)
+{
+    if (s->fmt == OTA_FMT_RAW) return ESP_OK;
+    if (s->fmt == OTA_FMT_UNKNOWN) return ESP_ERR_INVALID_SIZE;
+
+    // La cola son los 8 bytes que gzip_feed dejó sin descomprimir
+    if (!s->inflate_done || s->trailer_len < sizeof(s->trailer)) {
+        ESP_LOGE(TAG, "gzip truncado (%lu bytes de imagen)", (unsigned long)s->out_bytes);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t *t = s->trailer;
+    uint32_t crc   = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    uint32_t isize = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    if (crc != s->crc || isize != s->out_bytes) {
+        ESP_LOGE(TAG, "gzip: CRC %08lX/%08lX, tamano %lu/%lu",
+                 (unsigned long)s->crc, (unsigned long)crc,
+                 (unsigned long)s->out_bytes, (unsigned long)isize);
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+void ota_stream_free(ota_stream_t *s)
+{
+    free(s->inflator);
+    free(s->dict);
+    s->inflator = NULL;
+    s->dict = NULL;
+}
+
+const char *ota_stream_fmt_name(ota_fmt_t fmt)
+{
+    switch (fmt) {
+        case OTA_FMT_RAW:  return "bin";
+        case OTA_FMT_GZIP: return "gzip";
+        default:           return "?";
+    }
+}
@@ -0,0 +1,58 @@
+// ota_stream.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Decodificador en streaming de la imagen OTA. Reconoce la imagen tal cual
+// (.bin, primer byte 0xE9) o comprimida con gzip (1F 8B, "gzip -9 app.bin")
+// y entrega la imagen a trozos a la función de escritura. Todo el estado
+// (cabecera a medias, ventana de deflate) vive aquí: si la descarga se corta,
+// se sigue con Range desde el último byte y se vuelve a alimentar sin perder
+// nada.
+
+#define OTA_GZ_HDR_MAX  256   // cabecera gzip con nombre de fichero incluido
+
+typedef esp_err_t (*ota_stream_write_fn_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef enum {
+    OTA_FMT_UNKNOWN = 0,
+    OTA_FMT_RAW,
+    OTA_FMT_GZIP,
+} ota_fmt_t;
+
+typedef struct {
+    ota_fmt_t             fmt;
+    ota_stream_write_fn_t write;
+    void                 *write_ctx;
+    uint32_t              in_bytes;    // bytes del fichero recibidos
+    uint32_t              out_bytes;   // bytes de imagen entregados
+
+    // gzip
+    uint8_t   hdr[OTA_GZ_HDR_MAX];
+    uint16_t  hdr_len;
+    bool      hdr_done;
+    bool      inflate_done;
+    uint8_t   trailer[8];              // últimos bytes recibidos: CRC32 + ISIZE al final
+    uint8_t   trailer_len;
+    uint32_t  crc;
+    void     *inflator;                // tinfl_decompressor
+    uint8_t  *dict;                    // ventana circular de 32 KB (salida)
+    size_t    dict_ofs;
+} ota_stream_t;
+
+void ota_stream_init(ota_stream_t *s, ota_stream_write_fn_t write, void *ctx);
+
+// Procesa bytes del fichero en orden. Un error aquí no se arregla
+// reintentando (formato desconocido, deflate corrupto o fallo de escritura).
+esp_err_t ota_stream_feed(ota_stream_t *s, const uint8_t *data, size_t len);
+
+// Fin del fichero: comprueba que el gzip esté completo y su CRC32/tamaño
+esp_err_t ota_stream_finish(ota_stream_t *s);
+
+void ota_stream_free(ota_stream_t *s);
+
+const char *ota_stream_fmt_name(ota_fmt_t fmt);
@@ -0,0 +1,211 @@
+// params.c
+
+#include "params.h"
+#include "config.h"
+#include "app_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include <string.h>
+
+static const char *TAG = "PARAMS";
+static const char *NVS_NAMESPACE = "params";
+
+// ================== REGISTRO ==================
+
+#define P_INT(n, lo, hi, d, u)  { .name = n, .type = PARAM_T_INT,  .min = lo, .max = hi, .def = d, .unit = u }
+#define P_BOOL(n, d)            { .name = n, .type = PARAM_T_BOOL, .min = 0,  .max = 1,  .def = (d) ? 1 : 0, .unit = "bool" }
+
+static const param_def_t s_defs[PARAM_COUNT] = {
+    [PARAM_PULSE_MS]           = P_INT("pulseMs",         20,   10000,  TEMPS_PULSADOR_MS,        "ms"),
+    [PARAM_MATERIAL_MS]        = P_INT("materialMs",      100,  60000,  TEMPS_MATERIAL_MS,        "ms"),
+    [PARAM_TURNSTILE_MS]       = P_INT("turnstileMs",     100,  10000,  TEMPS_TORNO_MS,           "ms"),
+    [PARAM_BEEP_MS]            = P_INT("beepMs",          20,   2000,   TEMPS_PITO_MS,            "ms"),
+    [PARAM_DOOR_MS]            = P_INT("doorMs",          20,   10000,  TEMPS_PORTA_MS,           "ms"),
+    [PARAM_INV_SWITCH]         = P_BOOL("invSwitch",   INTERRUPTOR_INVERSO),
+    [PARAM_INV_HORN]           = P_BOOL("invHorn",     BOCINA_INVERSA),
+    [PARAM_INV_MATERIAL]       = P_BOOL("invMaterial", MATERIAL_INVERSO),
+    [PARAM_INV_ENTRY]          = P_BOOL("invEntry",    ENTRADA_INVERSO),
+    [PARAM_DEBOUNCE_RFID_MS]   = P_INT("debRfidMs",       0,    60000,  CRED_DEBOUNCE_RFID_MS,    "ms"),
+    [PARAM_DEBOUNCE_QR_MS]     = P_INT("debQrMs",         0,    60000,  CRED_DEBOUNCE_QR_MS,      "ms"),
+    [PARAM_DEBOUNCE_TICKET_MS] = P_INT("debTicketMs",     0,    600000, CRED_DEBOUNCE_TICKET_MS,  "ms"),
+    [PARAM_ACCESS_TIMEOUT_MS]  = P_INT("accessTimeoutMs", 500,  30000,  ACCESS_REQUEST_TIMEOUT_MS, "ms"),
+    [PARAM_RC522_POLL_MS]      = P_INT("rc522PollMs",     10,   1000,   RC522_POLL_MS,            "ms"),
+    [PARAM_STATUS_PERIOD_MS]   = P_INT("statusPeriodMs",  5000, 600000, STATUS_PERIOD_MS,         "ms"),
+    [PARAM_PROBE_PERIOD_MS]    = P_INT("probePeriodMs",   1000, 600000, NET_PROBE_PERIOD_MS,      "ms"),
+    [PARAM_OTA_HEALTH_MS]      = P_INT("otaHealthMs",     30000, 900000, OTA_HEALTH_WINDOW_MS,    "ms"),
+};
+
+// Un int32 alineado se lee y escribe de una vez: los lectores de otras
+// tasks no necesitan lock. Sólo escribe la task de comandos.
+static volatile int32_t s_values[PARAM_COUNT];
+
+// Cambiados y aún no escritos: los guarda el commit diferido de app_config
+static bool         s_dirty[PARAM_COUNT];
+static portMUX_TYPE s_dirty_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int find_param(const char *name)
+{
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (strcmp(name, s_defs[i].name) == 0) return i;
+    }
+    return -1;
+}
+
+static bool in_range(const param_def_t *d, int32_t v)
+{
+    return v >= d->min && v <= d->max;
+}
+
+// Flush de la escritura diferida (task de commit de app_config). El
+// default no ocupa sitio en NVS: así un cambio de default en una versión
+// nueva llega a los equipos que nunca tocaron el parámetro.
+static esp_err_t params_flush(void)
+{
+    bool dirty[PARAM_COUNT];
+    int n = 0;
+    portENTER_CRITICAL(&s_dirty_mux);
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        dirty[i] = s_dirty[i];
+        s_dirty[i] = false;
+        if (dirty[i]) n++;
+    }
+    portEXIT_CRITICAL(&s_dirty_mux);
+    if (n == 0) return ESP_OK;
+
+    nvs_handle_t h = 0;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    for (int i = 0; i < PARAM_COUNT && err == ESP_OK; i++) {
+        if (!dirty[i]) continue;
+        if (s_values[i] == s_defs[i].def) {
+            err = nvs_erase_key(h, s_defs[i].name);
+            if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+        } else {
+            err = nvs_set_i32(h, s_defs[i].name, s_values[i]);
+        }
+    }
+    if (err == ESP_OK) err = nvs_commit(h);
+    if (h) nvs_close(h);
+
+    if (err != ESP_OK) {
+        // Siguen pendientes para el próximo commit
+        portENTER_CRITICAL(&s_dirty_mux);
+        for (int i = 0; i < PARAM_COUNT; i++) s_dirty[i] |= dirty[i];
+        portEXIT_CRITICAL(&s_dirty_mux);
+    }
+    return err;
+}
+
+// ================== API ==================
+
+esp_err_t params_init(void)
+{
+    for (int i = 0; i < PARAM_COUNT; i++) s_values[i] = s_defs[i].def;
+    app_config_register_flush(params_flush);
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "Sin parametros en NVS, todos por defecto");
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "nvs_open: %s, parametros por defecto", esp_err_to_name(err));
+        return ESP_OK;
+    }
+
+    int loaded = 0;
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        int32_t v;
+        if (nvs_get_i32(h, s_defs[i].name, &v) != ESP_OK) continue;
+        if (!in_range(&s_defs[i], v)) {
+            ESP_LOGW(TAG, "%s=%ld fuera de rango en NVS, default %ld",
+                     s_defs[i].name, (long)v, (long)s_defs[i].def);
+            continue;
+        }
+        s_values[i] = v;
+        loaded++;
+    }
+    nvs_close(h);
+
+    ESP_LOGI(TAG, "%d parametro(s) ajustado(s) cargado(s) de NVS", loaded);
+    return ESP_OK;
+}
+
+int32_t params_get(param_id_t id)
+{
+    return (id < PARAM_COUNT) ? s_values[id] : 0;
+}
+
+const param_def_t *params_def(param_id_t id)
+{
+    return (id < PARAM_COUNT) ? &s_defs[id] : NULL;
+}
+
+bool params_set_json(const cJSON *obj)
+{
+    int32_t next[PARAM_COUNT];
+    bool touched[PARAM_COUNT] = {0};
+    for (int i = 0; i < PARAM_COUNT; i++) next[i] = s_values[i];
+
+    // Primero se valida todo: un setConfig a medias deja el torno en un
+    // estado que nadie ha pedido
+    const cJSON *it = NULL;
+    cJSON_ArrayForEach(it, obj) {
+        int i = it->string ? find_param(it->string) : -1;
+        if (i < 0) {
+            ESP_LOGW(TAG, "Parametro desconocido '%s'", it->string ? it->string : "?");
+            return false;
+        }
+        const param_def_t *d = &s_defs[i];
+        int32_t v;
+        if (d->type == PARAM_T_BOOL && cJSON_IsBool(it)) {
+            v = cJSON_IsTrue(it) ? 1 : 0;
+        } else if (d->type == PARAM_T_INT && cJSON_IsNumber(it) &&
+                   it->valuedouble >= d->min && it->valuedouble <= d->max) {
+            v = (int32_t)it->valuedouble;
+        } else {
+            ESP_LOGW(TAG, "%s: valor invalido (rango %ld..%ld %s)",
+                     d->name, (long)d->min, (long)d->max, d->unit);
+            return false;
+        }
+        next[i] = v;
+        touched[i] = true;
+    }
+
+    int changed = 0;
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (!touched[i] || next[i] == s_values[i]) continue;
+        ESP_LOGI(TAG, "%s: %ld -> %ld %s", s_defs[i].name,
+                 (long)s_values[i], (long)next[i], s_defs[i].unit);
+        s_values[i] = next[i];
+        portENTER_CRITICAL(&s_dirty_mux);
+        s_dirty[i] = true;
+        portEXIT_CRITICAL(&s_dirty_mux);
+        changed++;
+    }
+
+    // Ya aplicado en RAM; a NVS va en el próximo commit diferido
+    if (changed) app_config_schedule_commit();
+    return true;
+}
+
+void params_add_schema_to_json(cJSON *root)
+{
+    cJSON *a = cJSON_AddArrayToObject(root, "params");
+    if (!a) return;
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        const param_def_t *d = &s_defs[i];
+        cJSON *e = cJSON_CreateArray();
+        if (!e) return;
+        cJSON_AddItemToArray(e, cJSON_CreateString(d->name));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(s_values[i]));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(d->min));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(d->max));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(d->def));
+        cJSON_AddItemToArray(e, cJSON_CreateString(d->unit));
+        cJSON_AddItemToArray(a, e);
+    }
+}
@@ -0,0 +1,80 @@
+// params.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "cJSON.h"
+
+// Parámetros de tiempos y comportamiento ajustables en caliente.
+//
+// Cada parámetro tiene tipo, rango, unidad y default (los #define de
+// config.h). Se guardan en NVS (namespace "params", una clave por
+// parámetro, sólo los que se han tocado) con la escritura diferida de
+// app_config, y se leen con params_get() en el momento de usarlos: un
+// setConfig se aplica al siguiente pulso, lectura o vuelta de la task,
+// sin reiniciar.
+//
+// Por MQTT:
+//   setConfig {"config": {"params": {"turnstileMs": 1500, "invEntry": true}}}
+//   getParams -> retornoParams con el esquema [nombre, valor, min, max, def, unidad]
+//   getConfig -> retornoConfig y, detrás, el mismo retornoParams (juntos no
+//                caben en un mensaje de salida)
+
+typedef enum {
+    // Relés
+    PARAM_PULSE_MS = 0,        // pulsador / pulsadorLuz
+    PARAM_MATERIAL_MS,         // puerta de material
+    PARAM_TURNSTILE_MS,        // apertura de torno en acceso concedido
+    PARAM_BEEP_MS,             // cada pitido de acceso denegado
+    PARAM_DOOR_MS,             // obrirPorta, obrirPortaVenta, pulsadorInverso
+    // Lógica inversa de las salidas
+    PARAM_INV_SWITCH,
+    PARAM_INV_HORN,
+    PARAM_INV_MATERIAL,
+    PARAM_INV_ENTRY,
+    // Filtro de lecturas repetidas
+    PARAM_DEBOUNCE_RFID_MS,
+    PARAM_DEBOUNCE_QR_MS,
+    PARAM_DEBOUNCE_TICKET_MS,
+    // Plazos y periodos
+    PARAM_ACCESS_TIMEOUT_MS,   // getAccessTorn sin hasAccess
+    PARAM_RC522_POLL_MS,
+    PARAM_STATUS_PERIOD_MS,
+    PARAM_PROBE_PERIOD_MS,
+    PARAM_OTA_HEALTH_MS,       // ventana de validación tras una OTA
+    PARAM_COUNT
+} param_id_t;
+
+typedef enum {
+    PARAM_T_INT = 0,
+    PARAM_T_BOOL,
+} param_type_t;
+
+typedef struct {
+    const char  *name;     // clave JSON y de NVS (máx. 15 caracteres)
+    param_type_t type;
+    int32_t      min;
+    int32_t      max;
+    int32_t      def;
+    const char  *unit;
+} param_def_t;
+
+// Carga de NVS lo guardado (lo que falte o esté fuera de rango: default)
+esp_err_t params_init(void);
+
+// Valor actual. Barato: se puede llamar en cada uso.
+int32_t params_get(param_id_t id);
+
+static inline bool params_get_bool(param_id_t id) { return params_get(id) != 0; }
+
+const param_def_t *params_def(param_id_t id);
+
+// Aplica {"nombre": valor, ...} y programa el guardado de lo cambiado.
+// Valida todo antes de aplicar nada: con un nombre desconocido, un tipo
+// incorrecto o un valor fuera de rango no se cambia ninguno y devuelve false.
+bool params_set_json(const cJSON *obj);
+
+// Array "params" con el esquema completo para retornoParams
+void params_add_schema_to_json(cJSON *root);
@@ -0,0 +1,533 @@
+// payload_codec.c
+
+#include "payload_codec.h"
+
+#include "esp_log.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static const char *TAG = "CODEC";
+
+// Nombres JSON de cada clave entera (índice = payload_key_t)
+static const char *const s_key_names[PK_COUNT] = {
+    [PK_SCHEMA]      = "v",
+    [PK_ACTION]      = "action",
+    [PK_TYPE]        = "type",
+    [PK_CARD_ID]     = "cardId",
+    [PK_USER]        = "user",
+    [PK_NAME]        = "name",
+    [PK_ID_TORNO]    = "idTorno",
+    [PK_ID_PETICION] = "idPeticion",
+    [PK_RESULT]      = "result",
+    [PK_OK]          = "ok",
+    [PK_ID]          = "id",
+    [PK_ONLINE]      = "online",
+    [PK_PIN]         = "pin",
+    [PK_ESTAT]       = "estat",
+    [PK_ID_PISTA]    = "idPista",
+    [PK_RSSI]        = "rssi",
+    [PK_UPTIME]      = "uptime",
+    [PK_FREE_HEAP]   = "freeHeap",
+    [PK_FW]          = "fw",
+    [PK_RC522]       = "rc522",
+    [PK_IN]          = "in",
+    [PK_OUT]         = "out",
+};
+
+static const char *const s_action_names[PA_COUNT] = {
+    [PA_GET_ACCESS_TORN]     = "getAccessTorn",
+    [PA_HAS_ACCESS]          = "hasAccess",
+    [PA_STATUS]              = "status",
+    [PA_RETORNO_ACCESS_TORN] = "retornoAccessTorn",
+    [PA_STATUS_NOW]          = "status_now",
+};
+
+static int key_id(const char *name)
+{
+    for (int i = 0; i < PK_COUNT; i++) {
+        if (s_key_names[i] && strcmp(s_key_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static int action_id(const char *name)
+{
+    for (int i = 1; i < PA_COUNT; i++) {
+        if (strcmp(s_action_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+// ================== ESCRITOR ==================
+
+#define CBOR_MAJOR_UINT   0
+#define CBOR_MAJOR_NINT   1
+#define CBOR_MAJOR_TEXT   3
+#define CBOR_MAJOR_ARRAY  4
+#define CBOR_MAJOR_MAP    5
+#define CBOR_MAJOR_TAG    6
+#define CBOR_MAJOR_SIMPLE 7
+
+#define CBOR_FALSE   0xF4
+#define CBOR_TRUE    0xF5
+#define CBOR_NULL    0xF6
+#define CBOR_FLOAT64 0xFB
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = false;
+}
+
+static void put_bytes(cbor_writer_t *w, const void *src, size_t n)
+{
+    if (w->overflow || w->len + n > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, src, n);
+    w->len += n;
+}
+
+static void put_head(cbor_writer_t *w, uint8_t major, uint64_t v)
+{
+    uint8_t h[9];
+    size_t n;
+
+    if (v < 24) {
+        h[0] = (uint8_t)((major << 5) | v);
+        n = 1;
+    } else if (v <= 0xFF) {
+        h[0] = (uint8_t)((major << 5) | 24);
+        h[1] = (uint8_t)v;
+        n = 2;
+    } else if (v <= 0xFFFF) {
+        h[0] = (uint8_t)((major << 5) | 25);
+        h[1] = (uint8_t)(v >> 8);
+        h[2] = (uint8_t)v;
+        n = 3;
+    } else if (v <= 0xFFFFFFFFULL) {
+        h[0] = (uint8_t)((major << 5) | 26);
+        for (int i = 0; i < 4; i++) h[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        n = 5;
+    } else {
+        h[0] = (uint8_t)((major << 5) | 27);
+        for (int i = 0; i < 8; i++) h[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+        n = 9;
+    }
+    put_bytes(w, h, n);
+}
+
+void cbor_put_map(cbor_writer_t *w, size_t pairs)  { put_head(w, CBOR_MAJOR_MAP, pairs); }
+void cbor_put_array(cbor_writer_t *w, size_t items) { put_head(w, CBOR_MAJOR_ARRAY, items); }
+void cbor_put_uint(cbor_writer_t *w, uint64_t v)    { put_head(w, CBOR_MAJOR_UINT, v); }
+
+void cbor_put_int(cbor_writer_t *w, int64_t v)
+{
+    if (v >= 0) {
+        put_head(w, CBOR_MAJOR_UINT, (uint64_t)v);
+    } else {
+        put_head(w, CBOR_MAJOR_NINT, (uint64_t)(-1 - v));
+    }
+}
+
+void cbor_put_text_n(cbor_writer_t *w, const char *s, size_t n)
+{
+    put_head(w, CBOR_MAJOR_TEXT, n);
+    put_bytes(w, s, n);
+}
+
+void cbor_put_text(cbor_writer_t *w, const char *s)
+{
+    if (!s) s = "";
+    cbor_put_text_n(w, s, strlen(s));
+}
+
+void cbor_put_bool(cbor_writer_t *w, bool v)
+{
+    uint8_t b = v ? CBOR_TRUE : CBOR_FALSE;
+    put_bytes(w, &b, 1);
+}
+
+void cbor_put_null(cbor_writer_t *w)
+{
+    uint8_t b = CBOR_NULL;
+    put_bytes(w, &b, 1);
+}
+
+void cbor_put_double(cbor_writer_t *w, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint8_t h[9];
+    h[0] = CBOR_FLOAT64;
+    for (int i = 0; i < 8; i++) h[1 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    put_bytes(w, h, sizeof(h));
+}
+
+static void put_key(cbor_writer_t *w, const char *name)
+{
+    int id = key_id(name);
+    if (id >= 0) {
+        cbor_put_uint(w, (uint64_t)id);
+    } else {
+        cbor_put_text(w, name);
+    }
+}
+
+static void put_action(cbor_writer_t *w, const char *action)
+{
+    int id = action_id(action);
+    if (id > 0) {
+        cbor_put_uint(w, (uint64_t)id);
+    } else {
+        cbor_put_text(w, action);
+    }
+}
+
+// ================== MENSAJES ==================
+
+size_t payload_cbor_access_request(uint8_t *out, size_t cap,
+                                   const char *type,
+                                   const char *card_id,
+                                   const char *user,
+                                   const char *name,
+                                   const char *id_torno,
+                                   const char *id_peticion)
+{
+    cbor_writer_t w;
+    cbor_writer_init(&w, out, cap);
+
+    cbor_put_map(&w, 8);
+    cbor_put_uint(&w, PK_SCHEMA);   cbor_put_uint(&w, PAYLOAD_CBOR_SCHEMA_VERSION);
+    cbor_put_uint(&w, PK_ACTION);   cbor_put_uint(&w, PA_GET_ACCESS_TORN);
+    cbor_put_uint(&w, PK_TYPE);     cbor_put_text(&w, type);
+    cbor_put_uint(&w, PK_CARD_ID);  cbor_put_text(&w, card_id);
+    cbor_put_uint(&w, PK_USER);     cbor_put_text(&w, user);
+    cbor_put_uint(&w, PK_NAME);     cbor_put_text(&w, name);
+    cbor_put_uint(&w, PK_ID_TORNO); cbor_put_text(&w, id_torno);
+    cbor_put_uint(&w, PK_ID_PETICION); cbor_put_text(&w, id_peticion);
+
+    return w.overflow ? 0 : w.len;
+}
+
+static void put_json_item(cbor_writer_t *w, const cJSON *item, bool is_action, int depth)
+{
+    if (depth > 8) {
+        cbor_put_null(w);
+        return;
+    }
+
+    if (cJSON_IsString(item)) {
+        if (is_action) {
+            put_action(w, item->valuestring);
+        } else {
+            cbor_put_text(w, item->valuestring);
+        }
+    } else if (cJSON_IsBool(item)) {
+        cbor_put_bool(w, cJSON_IsTrue(item));
+    } else if (cJSON_IsNumber(item)) {
+        double d = item->valuedouble;
+        // El cast a int64_t sólo está definido en [-2^63, 2^63): NaN, inf y
+        // lo que no cabe van como float64
+        if (isfinite(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0 &&
+            d == (double)(int64_t)d) {
+            cbor_put_int(w, (int64_t)d);
+        } else {
+            cbor_put_double(w, d);
+        }
+    } else if (cJSON_IsObject(item)) {
+        size_t n = (size_t)cJSON_GetArraySize(item);
+        cbor_put_map(w, n);
+        for (const cJSON *c = item->child; c; c = c->next) {
+            put_key(w, c->string ? c->string : "");
+            put_json_item(w, c, c->string && strcmp(c->string, "action") == 0, depth + 1);
+        }
+    } else if (cJSON_IsArray(item)) {
+        cbor_put_array(w, (size_t)cJSON_GetArraySize(item));
+        for (const cJSON *c = item->child; c; c = c->next) {
+            put_json_item(w, c, false, depth + 1);
+        }
+    } else {
+        cbor_put_null(w);
+    }
+}
+
+size_t payload_cbor_from_json(const cJSON *root, uint8_t *out, size_t cap)
+{
+    if (!cJSON_IsObject(root)) return 0;
+
+    cbor_writer_t w;
+    cbor_writer_init(&w, out, cap);
+
+    // La versión de esquema va siempre primero
+    cbor_put_map(&w, (size_t)cJSON_GetArraySize(root) + 1);
+    cbor_put_uint(&w, PK_SCHEMA);
+    cbor_put_uint(&w, PAYLOAD_CBOR_SCHEMA_VERSION);
+
+    for (const cJSON *c = root->child; c; c = c->next) {
+        put_key(&w, c->string ? c->string : "");
+        put_json_item(&w, c, c->string && strcmp(c->string, "action") == 0, 1);
+    }
+
+    return w.overflow ? 0 : w.len;
+}
+
+// ================== LECTOR ==================
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool error;
+} cbor_reader_t;
+
+static bool get_head(cbor_reader_t *r, uint8_t *major, uint8_t *ai, uint64_t *val)
+{
+    if (r->error || r->p >= r->end) {
+        r->error = true;
+        return false;
+    }
+
+    uint8_t ib = *r->p++;
+    *major = ib >> 5;
+    *ai = ib & 0x1F;
+
+    size_t extra;
+    if (*ai < 24) {
+        *val = *ai;
+        return true;
+    } else if (*ai == 24) {
+        extra = 1;
+    } else if (*ai == 25) {
+        extra = 2;
+    } else if (*ai == 26) {
+        extra = 4;
+    } else if (*ai == 27) {
+        extra = 8;
+    } else {
+        // indefinidos / reservados: fuera del esquema
+        r->error = true;
+        return false;
+    }
+
+    if ((size_t)(r->end - r->p) < extra) {
+        r->error = true;
+        return false;
+    }
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < extra; i++) v = (v << 8) | *r->p++;
+    *val = v;
+    return true;
+}
+
+static void skip_item(cbor_reader_t *r, int depth)
+{
+    uint8_t major, ai;
+    uint64_t val;
+
+    if (depth > 8 || !get_head(r, &major, &ai, &val)) {
+        r->error = true;
+        return;
+    }
+
+    switch (major) {
+        case 2:
+        case CBOR_MAJOR_TEXT:
+            if ((uint64_t)(r->end - r->p) < val) {
+                r->error = true;
+                return;
+            }
+            r->p += val;
+            break;
+        case CBOR_MAJOR_ARRAY:
+            for (uint64_t i = 0; i < val && !r->error; i++) skip_item(r, depth + 1);
+            break;
+        case CBOR_MAJOR_MAP:
+            for (uint64_t i = 0; i < val * 2 && !r->error; i++) skip_item(r, depth + 1);
+            break;
+        case CBOR_MAJOR_TAG:
+            // La cabecera sólo dice el número de tag: detrás va el valor
+            skip_item(r, depth + 1);
+            break;
+        default:
+            // enteros, simples y floats ya consumidos por get_head
+            break;
+    }
+}
+
+// Lee texto y lo copia acotado a dst (siempre terminado en '\0')
+static bool get_text(cbor_reader_t *r, char *dst, size_t dst_sz)
+{
+    const uint8_t *start = r->p;
+    uint8_t major, ai;
+    uint64_t val;
+
+    if (!get_head(r, &major, &ai, &val)) return false;
+    if (major != CBOR_MAJOR_TEXT) {
+        r->p = start;
+        return false;
+    }
+    if ((uint64_t)(r->end - r->p) < val) {
+        r->error = true;
+        return false;
+    }
+
+    size_t n = (val < dst_sz - 1) ? (size_t)val : dst_sz - 1;
+    memcpy(dst, r->p, n);
+    dst[n] = '\0';
+    r->p += val;
+    return true;
+}
+
+// Entero (uint/nint) o texto numérico, igual que el camino JSON con atoi
+static bool get_int(cbor_reader_t *r, int *out)
+{
+    const uint8_t *start = r->p;
+    uint8_t major, ai;
+    uint64_t val;
+
+    if (!get_head(r, &major, &ai, &val)) return false;
+
+    if (major == CBOR_MAJOR_UINT) {
+        *out = (int)val;
+        return true;
+    }
+    if (major == CBOR_MAJOR_NINT) {
+        *out = (int)(-1 - (int64_t)val);
+        return true;
+    }
+
+    r->p = start;
+    char tmp[16];
+    if (get_text(r, tmp, sizeof(tmp))) {
+        *out = atoi(tmp);
+        return true;
+    }
+    return false;
+}
+
+bool payload_is_cbor(const void *data, size_t len)
+{
+    if (!data || len == 0) return false;
+    uint8_t b = ((const uint8_t *)data)[0];
+    return (b >> 5) == CBOR_MAJOR_MAP;
+}
+
+bool payload_cbor_decode_command(const uint8_t *data, size_t len, command_t *cmd)
+{
+    cbor_reader_t r = { .p = data, .end = data + len, .error = false };
+    uint8_t major, ai;
+    uint64_t pairs;
+
+    memset(cmd, 0, sizeof(*cmd));
+    strcpy(cmd->id_peticion, "-");
+
+    if (!get_head(&r, &major, &ai, &pairs) || major != CBOR_MAJOR_MAP) {
+        ESP_LOGW(TAG, "CBOR: no es un mapa");
+        return false;
+    }
+
+    for (uint64_t i = 0; i < pairs && !r.error; i++) {
+        uint64_t key;
+        if (!get_head(&r, &major, &ai, &key)) break;
+
+        if (major == CBOR_MAJOR_TEXT) {
+            // clave de texto fuera del esquema: saltar clave y valor
+            if ((uint64_t)(r.end - r.p) < key) {
+                r.error = true;
+                break;
+            }
+            r.p += key;
+            skip_item(&r, 1);
+            continue;
+        }
+        if (major != CBOR_MAJOR_UINT) {
+            r.error = true;
+            break;
+        }
+
+        switch ((int)key) {
+            case PK_SCHEMA: {
+                int v = 0;
+                if (get_int(&r, &v) && v > PAYLOAD_CBOR_SCHEMA_VERSION) {
+                    ESP_LOGW(TAG, "CBOR: esquema v%d mas nuevo que v%d",
+                             v, PAYLOAD_CBOR_SCHEMA_VERSION);
+                    return false;
+                }
+                break;
+            }
+
+            case PK_ACTION: {
+                int a = 0;
+                const uint8_t *start = r.p;
+                uint8_t m2, ai2;
+                uint64_t v2;
+                if (get_head(&r, &m2, &ai2, &v2) && m2 == CBOR_MAJOR_UINT) {
+                    a = (int)v2;
+                    if (a > 0 && a < PA_COUNT) {
+                        strncpy(cmd->action, s_action_names[a], sizeof(cmd->action) - 1);
+                    }
+                } else {
+                    r.p = start;
+                    r.error = false;
+                    if (!get_text(&r, cmd->action, sizeof(cmd->action))) skip_item(&r, 1);
+                }
+                break;
+            }
+
+            case PK_RESULT: {
+                const uint8_t *start = r.p;
+                if (r.p < r.end && (*r.p == CBOR_TRUE || *r.p == CBOR_FALSE)) {
+                    strcpy(cmd->result, (*r.p == CBOR_TRUE) ? "true" : "false");
+                    r.p++;
+                } else if (!get_text(&r, cmd->result, sizeof(cmd->result))) {
+                    r.p = start;
+                    skip_item(&r, 1);
+                }
+                break;
+            }
+
+            case PK_TYPE:
+                if (!get_text(&r, cmd->type, sizeof(cmd->type))) skip_item(&r, 1);
+                break;
+
+            case PK_ID_PETICION:
+                if (!get_text(&r, cmd->id_peticion, sizeof(cmd->id_peticion))) skip_item(&r, 1);
+                break;
+
+            case PK_PIN:
+                if (!get_int(&r, &cmd->pin)) skip_item(&r, 1);
+                break;
+
+            case PK_ESTAT:
+                if (!get_int(&r, &cmd->estat)) skip_item(&r, 1);
+                break;
+
+            case PK_ID_PISTA:
+                if (!get_int(&r, &cmd->id_pista)) skip_item(&r, 1);
+                break;
+
+            default:
+                skip_item(&r, 1);
+                break;
+        }
+    }
+
+    if (r.error) {
+        ESP_LOGW(TAG, "CBOR: payload truncado o mal formado");
+        return false;
+    }
+    if (cmd->action[0] == '\0') {
+        ESP_LOGW(TAG, "CBOR: comando sin action");
+        return false;
+    }
+
+    // cmd->payload queda a NULL: los handlers que re-parsean JSON no aplican
+    return true;
+}
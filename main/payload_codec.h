@@ -0,0 +1,101 @@
+// payload_codec.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+#include "core.h"
+
+// Codificación de payloads negociada con el servidor (setConfig "encoding").
+// JSON sigue siendo el formato por defecto para servidores antiguos.
+typedef enum {
+    PAYLOAD_ENC_JSON = 0,
+    PAYLOAD_ENC_CBOR = 1,
+} payload_enc_t;
+
+// Versión del esquema CBOR (claves enteras). Se anuncia en status y viaja
+// en la clave 0 de cada mensaje; subirla si cambia el significado de una clave.
+#define PAYLOAD_CBOR_SCHEMA_VERSION  1
+
+// Los mensajes CBOR van a "<topic>/cbor" para no romper suscriptores JSON.
+#define PAYLOAD_CBOR_TOPIC_SUFFIX    "/cbor"
+
+// Claves enteras del esquema v1 (el índice ES la clave en el cable)
+typedef enum {
+    PK_SCHEMA = 0,
+    PK_ACTION,
+    PK_TYPE,
+    PK_CARD_ID,
+    PK_USER,
+    PK_NAME,
+    PK_ID_TORNO,
+    PK_ID_PETICION,
+    PK_RESULT,
+    PK_OK,
+    PK_ID,
+    PK_ONLINE,
+    PK_PIN,
+    PK_ESTAT,
+    PK_ID_PISTA,
+    PK_RSSI,
+    PK_UPTIME,
+    PK_FREE_HEAP,
+    PK_FW,
+    PK_RC522,
+    PK_IN,
+    PK_OUT,
+    PK_COUNT
+} payload_key_t;
+
+// Acciones frecuentes codificadas como entero (el resto viaja como texto)
+typedef enum {
+    PA_GET_ACCESS_TORN = 1,
+    PA_HAS_ACCESS,
+    PA_STATUS,
+    PA_RETORNO_ACCESS_TORN,
+    PA_STATUS_NOW,
+    PA_COUNT
+} payload_action_t;
+
+// ===== Escritor CBOR mínimo (RFC 8949, sólo longitudes definidas) =====
+typedef struct {
+    uint8_t *buf;
+    size_t   cap;
+    size_t   len;
+    bool     overflow;
+} cbor_writer_t;
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t cap);
+void cbor_put_map(cbor_writer_t *w, size_t pairs);
+void cbor_put_array(cbor_writer_t *w, size_t items);
+void cbor_put_uint(cbor_writer_t *w, uint64_t v);
+void cbor_put_int(cbor_writer_t *w, int64_t v);
+void cbor_put_text(cbor_writer_t *w, const char *s);
+void cbor_put_text_n(cbor_writer_t *w, const char *s, size_t n);
+void cbor_put_bool(cbor_writer_t *w, bool v);
+void cbor_put_null(cbor_writer_t *w);
+void cbor_put_double(cbor_writer_t *w, double v);
+
+// true si el payload parece un mapa CBOR (los JSON empiezan por '{')
+bool payload_is_cbor(const void *data, size_t len);
+
+// getAccessTorn directo a CBOR, sin pasar por cJSON (camino caliente).
+// Devuelve bytes escritos o 0 si no cabe en out.
+size_t payload_cbor_access_request(uint8_t *out, size_t cap,
+                                   const char *type,
+                                   const char *card_id,
+                                   const char *user,
+                                   const char *name,
+                                   const char *id_torno,
+                                   const char *id_peticion);
+
+// Transcodifica un árbol cJSON plano/anidado a CBOR aplicando el diccionario
+// de claves del esquema. Claves desconocidas viajan como texto.
+size_t payload_cbor_from_json(const cJSON *root, uint8_t *out, size_t cap);
+
+// Decodifica un comando CBOR a command_t sin copias intermedias.
+// Sólo comandos planos: los que necesitan cmd->payload JSON (setConfig,
+// writeCard, otaUpdate) se siguen enviando en JSON.
+bool payload_cbor_decode_command(const uint8_t *data, size_t len, command_t *cmd);
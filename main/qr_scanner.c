@@ -0,0 +1,182 @@
+// qr_scanner.c
+
+#include "qr_scanner.h"
+
+#include <string.h>
+
+#define QR_STX          0x03
+#define QR_PROTO_MAX    250
+#define QR_RING_MASK    (QR_RING_SZ - 1)
+
+_Static_assert((QR_RING_SZ & QR_RING_MASK) == 0, "QR_RING_SZ debe ser potencia de 2");
+
+// ================== RING SPSC ==================
+
+void qr_ring_reset(qr_ring_t *r)
+{
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+}
+
+size_t qr_ring_used(const qr_ring_t *r)
+{
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    return (size_t)(head - tail);
+}
+
+size_t qr_ring_write(qr_ring_t *r, const uint8_t *data, size_t len)
+{
+    uint32_t head = r->head;
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    size_t space = QR_RING_SZ - (size_t)(head - tail);
+
+    // Lleno: se pierden los bytes nuevos, nunca la trama en curso
+    size_t n = (len < space) ? len : space;
+    r->dropped += (uint32_t)(len - n);
+
+    size_t idx = head & QR_RING_MASK;
+    size_t first = QR_RING_SZ - idx;
+    if (first > n) first = n;
+    memcpy(&r->buf[idx], data, first);
+    memcpy(&r->buf[0], data + first, n - first);
+
+    __atomic_store_n(&r->head, head + (uint32_t)n, __ATOMIC_RELEASE);
+    return n;
+}
+
+// ================== SCANNER ==================
+
+static inline bool is_printable(uint8_t c)
+{
+    return c >= 0x20 && c <= 0x7E;
+}
+
+static inline bool is_line_sep(uint8_t c)
+{
+    return c == '\n' || c == '\r' || c == '\t';
+}
+
+void qr_scanner_reset(qr_scanner_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->state = QR_ST_LINE;
+}
+
+static void start_line(qr_scanner_t *s)
+{
+    s->state = QR_ST_LINE;
+    s->len = 0;
+    s->printable = 0;
+    s->truncated = false;
+}
+
+static void push_byte(qr_scanner_t *s, uint8_t c)
+{
+    if (s->len < QR_FRAME_MAX - 1) {
+        s->frame[s->len++] = c;
+    } else {
+        s->truncated = true;
+    }
+}
+
+static size_t emit(qr_scanner_t *s, char *out, size_t out_sz)
+{
+    size_t n = s->len;
+    if (n > out_sz - 1) n = out_sz - 1;
+    memcpy(out, s->frame, n);
+    out[n] = '\0';
+    return n;
+}
+
+// Procesa un byte. Devuelve el origen si con él se completa un mensaje.
+static qr_src_t feed(qr_scanner_t *s, uint8_t c, char *out, size_t out_sz)
+{
+    switch (s->state) {
+        case QR_ST_LINE:
+            if (c == QR_STX) {
+                // STX manda: lo acumulado antes es basura
+                if (s->len > 0) s->discarded++;
+                s->len = 0;
+                s->state = QR_ST_PROTO_LEN;
+                return QR_SRC_NONE;
+            }
+            if (is_line_sep(c)) {
+                // Más larga que QR_FRAME_MAX: el prefijo no es la credencial
+                if (s->truncated) {
+                    s->discarded++;
+                    start_line(s);
+                    return QR_SRC_NONE;
+                }
+                // Trim final de espacios
+                while (s->len > 0 && s->frame[s->len - 1] == ' ') {
+                    s->len--;
+                    s->printable--;
+                }
+                if (s->len == 0) {
+                    start_line(s);   // separadores seguidos (CRLF, cola de trama)
+                    return QR_SRC_NONE;
+                }
+                // Menos del 80% imprimible -> línea binaria, se descarta
+                if ((uint32_t)s->printable * 100 / s->len < 80) {
+                    s->discarded++;
+                    start_line(s);
+                    return QR_SRC_NONE;
+                }
+                emit(s, out, out_sz);
+                s->lines++;
+                start_line(s);
+                return QR_SRC_LINE;
+            }
+            if (s->len < QR_FRAME_MAX - 1 && is_printable(c)) s->printable++;
+            push_byte(s, c);
+            return QR_SRC_NONE;
+
+        case QR_ST_PROTO_LEN:
+            if (c == 0 || c > QR_PROTO_MAX) {
+                // trama rara: se descarta el STX y seguimos como texto
+                s->discarded++;
+                start_line(s);
+                return feed(s, c, out, out_sz);
+            }
+            s->need = c;
+            s->len = 0;
+            s->truncated = false;
+            s->state = QR_ST_PROTO_DATA;
+            return QR_SRC_NONE;
+
+        case QR_ST_PROTO_DATA:
+            push_byte(s, c);
+            if (--s->need > 0) return QR_SRC_NONE;
+            if (s->truncated) {
+                s->discarded++;
+                start_line(s);
+                return QR_SRC_NONE;
+            }
+            emit(s, out, out_sz);
+            s->frames++;
+            start_line(s);
+            return QR_SRC_PROTO;
+    }
+
+    start_line(s);
+    return QR_SRC_NONE;
+}
+
+qr_src_t qr_scanner_next(qr_scanner_t *s, qr_ring_t *r, char *out, size_t out_sz)
+{
+    if (!out || out_sz == 0) return QR_SRC_NONE;
+
+    uint32_t tail = r->tail;
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    qr_src_t src = QR_SRC_NONE;
+
+    while (tail != head && src == QR_SRC_NONE) {
+        src = feed(s, r->buf[tail & QR_RING_MASK], out, out_sz);
+        tail++;
+    }
+
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    return src;
+}
@@ -0,0 +1,56 @@
+// qr_scanner.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Parser incremental del flujo serie del GM861S. Reconoce tramas de
+// protocolo <0x03><len><data> y líneas terminadas en CR/LF/TAB sin mover
+// memoria: los bytes entran por un ring SPSC y el estado parcial (trama a
+// medias) se conserva entre lecturas.
+
+#define QR_RING_SZ     1024   // potencia de 2
+#define QR_FRAME_MAX   256    // incluye el '\0' final
+
+// Ring lock-free de un productor y un consumidor
+typedef struct {
+    uint8_t  buf[QR_RING_SZ];
+    uint32_t head;       // sólo lo escribe el productor
+    uint32_t tail;       // sólo lo escribe el consumidor
+    uint32_t dropped;    // bytes descartados por ring lleno
+} qr_ring_t;
+
+typedef enum {
+    QR_SRC_NONE = 0,
+    QR_SRC_PROTO,
+    QR_SRC_LINE,
+} qr_src_t;
+
+typedef enum {
+    QR_ST_LINE = 0,      // acumulando texto hasta CR/LF/TAB
+    QR_ST_PROTO_LEN,     // visto 0x03, falta el byte de longitud
+    QR_ST_PROTO_DATA,    // copiando 'need' bytes de payload
+} qr_scan_state_t;
+
+typedef struct {
+    qr_scan_state_t state;
+    uint8_t  frame[QR_FRAME_MAX];
+    uint16_t len;        // bytes guardados en frame
+    uint16_t need;       // bytes de payload pendientes (PROTO_DATA)
+    uint16_t printable;  // imprimibles en la línea actual
+    bool     truncated;  // el mensaje en curso no cabe: se descartará
+    uint32_t frames;     // tramas de protocolo emitidas
+    uint32_t lines;      // líneas emitidas
+    uint32_t discarded;  // tramas/líneas descartadas (binarias, inválidas o largas)
+} qr_scanner_t;
+
+void   qr_ring_reset(qr_ring_t *r);
+size_t qr_ring_write(qr_ring_t *r, const uint8_t *data, size_t len);
+size_t qr_ring_used(const qr_ring_t *r);
+
+void qr_scanner_reset(qr_scanner_t *s);
+
+// Consume bytes del ring hasta completar un mensaje (lo copia a out,
+// terminado en '\0') o vaciar el ring. Devuelve el origen o QR_SRC_NONE.
+qr_src_t qr_scanner_next(qr_scanner_t *s, qr_ring_t *r, char *out, size_t out_sz);
@@ -0,0 +1,460 @@
+// qr_ticket.c
+
+#include "qr_ticket.h"
+#include "app_config.h"
+#include "config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+
+#include <string.h>
+#include <stdio.h>
+
+static const char *TAG = "QR_TICKET";
+static const char *NVS_NAMESPACE = "qr_ticket";
+
+// ================== CLAVES ==================
+
+typedef struct {
+    bool    set;
+    uint8_t id;
+    uint8_t key[QR_TICKET_KEY_LEN];
+} ticket_key_t;
+
+static ticket_key_t s_keys[QR_TICKET_KEY_SLOTS];
+static portMUX_TYPE s_key_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ================== REPLAY ==================
+//
+// Cada nonce usado ocupa un u64 en NVS: 44 bits de nonce + 20 bits de horas
+// desde QR_TICKET_MIN_EPOCH con el fin de validez (redondeado hacia arriba).
+// Un hueco vuelve a estar libre cuando su ticket ya no puede ser válido.
+// 44 bits bastan: una colisión sólo provoca un falso "replay", no un acceso.
+
+#define NONCE_BITS   44
+#define HOUR_BITS    20
+#define NONCE_MASK   ((1ULL << NONCE_BITS) - 1)
+#define HOUR_MASK    ((1ULL << HOUR_BITS) - 1)
+
+typedef struct {
+    uint64_t nonce;      // 44 bits
+    uint32_t until_h;    // horas desde QR_TICKET_MIN_EPOCH; 0 = hueco libre
+} replay_slot_t;
+
+static replay_slot_t s_replay[QR_TICKET_REPLAY_SLOTS];
+static uint32_t      s_dirty[(QR_TICKET_REPLAY_SLOTS + 31) / 32];
+
+typedef struct {
+    uint32_t offline_ok;
+    uint32_t rejected;
+    uint32_t fallback;
+    uint32_t replay;
+} ticket_stats_t;
+
+static ticket_stats_t s_stats = {0};
+
+// s_replay, s_dirty y s_stats: los toca qr_ticket_check (pipeline) y
+// qr_ticket_flush (task de commit de app_config)
+static portMUX_TYPE s_tk_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t epoch_to_hours_up(uint32_t t)
+{
+    if (t <= QR_TICKET_MIN_EPOCH) return 0;
+    return (t - QR_TICKET_MIN_EPOCH + 3599u) / 3600u;
+}
+
+static uint64_t nonce_key(const uint8_t nonce[8])
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | nonce[i];
+    return v & NONCE_MASK;
+}
+
+// ================== UTIL ==================
+
+static uint32_t rd_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+}
+
+static int b64url_val(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+// base64url sin padding. Devuelve bytes escritos o -1.
+static int b64url_decode(const char *in, uint8_t *out, size_t cap)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t n = 0;
+
+    for (; *in && *in != '=' && *in != '\r' && *in != '\n'; in++) {
+        int v = b64url_val(*in);
+        if (v < 0) return -1;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n >= cap) return -1;
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return (int)n;
+}
+
+// ================== VERIFICACIÓN ==================
+
+bool qr_ticket_is_ticket(const char *text)
+{
+    return text && strncmp(text, QR_TICKET_PREFIX, sizeof(QR_TICKET_PREFIX) - 1) == 0;
+}
+
+const char *qr_ticket_result_name(qr_ticket_result_t r)
+{
+    switch (r) {
+        case QT_OK:          return "ok";
+        case QT_NO_KEY:      return "noKey";
+        case QT_NO_TIME:     return "noTime";
+        case QT_STORE_FULL:  return "storeFull";
+        case QT_BAD_FORMAT:  return "badFormat";
+        case QT_BAD_SIG:     return "badSignature";
+        case QT_NOT_YET:     return "notYetValid";
+        case QT_EXPIRED:     return "expired";
+        case QT_WRONG_COURT: return "wrongCourt";
+        case QT_REPLAY:      return "replay";
+    }
+    return "?";
+}
+
+static bool lookup_key(uint8_t key_id, uint8_t key[QR_TICKET_KEY_LEN])
+{
+    bool found = false;
+    portENTER_CRITICAL(&s_key_mux);
+    const ticket_key_t *k = &s_keys[key_id % QR_TICKET_KEY_SLOTS];
+    if (k->set && k->id == key_id) {
+        memcpy(key, k->key, QR_TICKET_KEY_LEN);
+        found = true;
+    }
+    portEXIT_CRITICAL(&s_key_mux);
+    return found;
+}
+
+// SubjectPublicKeyInfo DER de un punto P-256 sin comprimir, sin el punto:
+// SEQUENCE { SEQUENCE { id-ecPublicKey, prime256v1 }, BIT STRING (66) }
+static const uint8_t s_p256_spki_prefix[] = {
+    0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+    0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03, 0x42, 0x00,
+};
+
+#define P256_SPKI_LEN  (sizeof(s_p256_spki_prefix) + QR_TICKET_KEY_LEN)
+
+// Parsea la clave pública. pk queda inicializado aunque falle.
+static int parse_public_key(mbedtls_pk_context *pk, const uint8_t key[QR_TICKET_KEY_LEN])
+{
+    uint8_t der[P256_SPKI_LEN];
+    memcpy(der, s_p256_spki_prefix, sizeof(s_p256_spki_prefix));
+    memcpy(der + sizeof(s_p256_spki_prefix), key, QR_TICKET_KEY_LEN);
+
+    mbedtls_pk_init(pk);
+    return mbedtls_pk_parse_public_key(pk, der, sizeof(der));
+}
+
+// Un entero de 32 bytes big endian como INTEGER DER (mínimo, positivo)
+static size_t der_put_int(uint8_t *out, const uint8_t v[32])
+{
+    size_t skip = 0;
+    while (skip < 31 && v[skip] == 0) skip++;
+    size_t len = 32 - skip;
+    bool pad = v[skip] & 0x80;
+
+    out[0] = 0x02;
+    out[1] = (uint8_t)(len + pad);
+    if (pad) out[2] = 0x00;
+    memcpy(out + 2 + pad, v + skip, len);
+    return 2 + pad + len;
+}
+
+// r||s (formato del ticket) -> SEQUENCE { r, s } que espera mbedtls_pk_verify
+static size_t ecdsa_sig_to_der(const uint8_t rs[QR_TICKET_SIG_LEN], uint8_t der[72])
+{
+    size_t n = 2;
+    n += der_put_int(der + n, rs);
+    n += der_put_int(der + n, rs + 32);
+    der[0] = 0x30;
+    der[1] = (uint8_t)(n - 2);
+    return n;
+}
+
+static qr_ticket_result_t check_signature(const uint8_t *raw, qr_ticket_t *t)
+{
+    uint8_t key[QR_TICKET_KEY_LEN];
+    if (!lookup_key(t->key_id, key)) return QT_NO_KEY;
+
+    mbedtls_pk_context pk;
+    if (parse_public_key(&pk, key) != 0) {
+        // set_key ya la validó: no debería pasar
+        mbedtls_pk_free(&pk);
+        return QT_NO_KEY;
+    }
+
+    const mbedtls_md_info_t *md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    uint8_t hash[32];
+    uint8_t sig[72];
+    size_t sig_len = ecdsa_sig_to_der(raw + QR_TICKET_PAYLOAD_LEN, sig);
+
+    int rc = mbedtls_md(md, raw, QR_TICKET_PAYLOAD_LEN, hash);
+    if (rc == 0) {
+        rc = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, hash, sizeof(hash), sig, sig_len);
+    }
+    mbedtls_pk_free(&pk);
+
+    return rc == 0 ? QT_OK : QT_BAD_SIG;
+}
+
+// Busca el nonce y, si no está, un hueco libre o caducado. -1 si está lleno.
+static int replay_find(uint64_t key, uint32_t now_h, bool *seen)
+{
+    int free_idx = -1;
+    *seen = false;
+
+    for (int i = 0; i < QR_TICKET_REPLAY_SLOTS; i++) {
+        const replay_slot_t *s = &s_replay[i];
+        if (s->nonce == key && s->until_h >= now_h) {
+            *seen = true;
+            return i;
+        }
+        if (free_idx < 0 && s->until_h < now_h) {
+            free_idx = i;
+        }
+    }
+    return free_idx;
+}
+
+qr_ticket_result_t qr_ticket_check(const char *text, uint32_t now,
+                                   uint16_t court_filter, qr_ticket_t *out)
+{
+    qr_ticket_t t;
+    uint8_t raw[QR_TICKET_PAYLOAD_LEN + QR_TICKET_SIG_LEN + 1];
+    qr_ticket_result_t r;
+
+    if (!qr_ticket_is_ticket(text)) return QT_BAD_FORMAT;
+
+    int n = b64url_decode(text + sizeof(QR_TICKET_PREFIX) - 1, raw, sizeof(raw));
+    if (n != QR_TICKET_PAYLOAD_LEN + QR_TICKET_SIG_LEN || raw[0] != QR_TICKET_VERSION) {
+        r = QT_BAD_FORMAT;
+        goto out;
+    }
+
+    t.key_id     = raw[1];
+    t.booking_id = rd_be32(&raw[2]);
+    t.court      = (uint16_t)((raw[6] << 8) | raw[7]);
+    t.valid_from = rd_be32(&raw[8]);
+    t.valid_to   = rd_be32(&raw[12]);
+    memcpy(t.nonce, &raw[16], sizeof(t.nonce));
+    if (out) *out = t;
+
+    // Primero la firma: nada de lo demás significa algo si no es auténtico
+    r = check_signature(raw, &t);
+    if (r != QT_OK) goto out;
+
+    if (now < QR_TICKET_MIN_EPOCH) { r = QT_NO_TIME; goto out; }
+    if ((int64_t)now + QR_TICKET_CLOCK_SKEW_S < (int64_t)t.valid_from) { r = QT_NOT_YET; goto out; }
+    if ((int64_t)now > (int64_t)t.valid_to + QR_TICKET_CLOCK_SKEW_S)  { r = QT_EXPIRED; goto out; }
+    if (court_filter != 0 && t.court != court_filter) { r = QT_WRONG_COURT; goto out; }
+
+    uint64_t key  = nonce_key(t.nonce);
+    uint32_t now_h = epoch_to_hours_up(now);
+    uint32_t until_h = epoch_to_hours_up(t.valid_to + QR_TICKET_CLOCK_SKEW_S);
+    bool seen;
+
+    portENTER_CRITICAL(&s_tk_mux);
+    int idx = replay_find(key, now_h, &seen);
+    if (seen) {
+        r = QT_REPLAY;
+    } else if (idx < 0) {
+        r = QT_STORE_FULL;
+    } else {
+        s_replay[idx].nonce   = key;
+        s_replay[idx].until_h = until_h;
+        s_dirty[idx / 32] |= 1u << (idx % 32);
+        r = QT_OK;
+    }
+    portEXIT_CRITICAL(&s_tk_mux);
+
+out:
+    portENTER_CRITICAL(&s_tk_mux);
+    if (r == QT_OK)                          s_stats.offline_ok++;
+    else if (r == QT_REPLAY)                 { s_stats.replay++; s_stats.rejected++; }
+    else if (qr_ticket_decided_offline(r))   s_stats.rejected++;
+    else                                     s_stats.fallback++;
+    portEXIT_CRITICAL(&s_tk_mux);
+    return r;
+}
+
+// ================== NVS ==================
+
+// Enganchada a la escritura diferida de app_config: corre en su task, no
+// en la del pipeline
+esp_err_t qr_ticket_flush(void)
+{
+    // Lo pendiente se recoge con el lock y se escribe sin él
+    uint32_t dirty[sizeof(s_dirty) / sizeof(s_dirty[0])];
+    bool any = false;
+
+    portENTER_CRITICAL(&s_tk_mux);
+    memcpy(dirty, s_dirty, sizeof(dirty));
+    memset(s_dirty, 0, sizeof(s_dirty));
+    portEXIT_CRITICAL(&s_tk_mux);
+
+    for (size_t w = 0; w < sizeof(dirty) / sizeof(dirty[0]); w++) {
+        if (dirty[w]) { any = true; break; }
+    }
+    if (!any) return ESP_OK;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        for (int i = 0; i < QR_TICKET_REPLAY_SLOTS && err == ESP_OK; i++) {
+            if (!(dirty[i / 32] & (1u << (i % 32)))) continue;
+
+            portENTER_CRITICAL(&s_tk_mux);
+            uint64_t packed = (s_replay[i].nonce << HOUR_BITS) | (s_replay[i].until_h & HOUR_MASK);
+            portEXIT_CRITICAL(&s_tk_mux);
+
+            char k[8];
+            snprintf(k, sizeof(k), "r%d", i);
+            err = nvs_set_u64(h, k, packed);
+        }
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+
+    if (err != ESP_OK) {
+        // Todo lo recogido vuelve a quedar pendiente para el próximo commit
+        portENTER_CRITICAL(&s_tk_mux);
+        for (size_t w = 0; w < sizeof(dirty) / sizeof(dirty[0]); w++) s_dirty[w] |= dirty[w];
+        portEXIT_CRITICAL(&s_tk_mux);
+        ESP_LOGE(TAG, "Error guardando nonces: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t qr_ticket_set_key(uint8_t key_id, const uint8_t key[QR_TICKET_KEY_LEN])
+{
+    // Mejor rechazarla aquí que descubrirlo con el primer ticket
+    mbedtls_pk_context pk;
+    int rc = parse_public_key(&pk, key);
+    mbedtls_pk_free(&pk);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "Clave %u no es un punto P-256 valido (-0x%04x)", key_id, (unsigned)-rc);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int slot = key_id % QR_TICKET_KEY_SLOTS;
+    ticket_key_t k = { .set = true, .id = key_id };
+    memcpy(k.key, key, QR_TICKET_KEY_LEN);
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        char name[8];
+        snprintf(name, sizeof(name), "key%d", slot);
+        err = nvs_set_blob(h, name, &k, sizeof(k));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error guardando clave %u: %s", key_id, esp_err_to_name(err));
+        memset(&k, 0, sizeof(k));
+        return err;
+    }
+
+    portENTER_CRITICAL(&s_key_mux);
+    s_keys[slot] = k;
+    portEXIT_CRITICAL(&s_key_mux);
+    memset(&k, 0, sizeof(k));
+
+    ESP_LOGI(TAG, "Clave de tickets %u instalada (slot %d)", key_id, slot);
+    return ESP_OK;
+}
+
+esp_err_t qr_ticket_init(void)
+{
+    memset(s_replay, 0, sizeof(s_replay));
+    memset(s_dirty, 0, sizeof(s_dirty));
+    app_config_register_flush(qr_ticket_flush);
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Sin claves de tickets en NVS: sólo validación online");
+        return ESP_OK;
+    }
+
+    int keys = 0;
+    for (int s = 0; s < QR_TICKET_KEY_SLOTS; s++) {
+        char name[8];
+        snprintf(name, sizeof(name), "key%d", s);
+        size_t len = sizeof(s_keys[s]);
+        if (nvs_get_blob(h, name, &s_keys[s], &len) != ESP_OK || len != sizeof(s_keys[s])) {
+            memset(&s_keys[s], 0, sizeof(s_keys[s]));
+        } else if (s_keys[s].set) {
+            keys++;
+        }
+    }
+
+    int used = 0;
+    for (int i = 0; i < QR_TICKET_REPLAY_SLOTS; i++) {
+        char k[8];
+        uint64_t packed;
+        snprintf(k, sizeof(k), "r%d", i);
+        if (nvs_get_u64(h, k, &packed) != ESP_OK) continue;
+        s_replay[i].nonce   = (packed >> HOUR_BITS) & NONCE_MASK;
+        s_replay[i].until_h = (uint32_t)(packed & HOUR_MASK);
+        if (s_replay[i].until_h) used++;
+    }
+    nvs_close(h);
+
+    ESP_LOGI(TAG, "Tickets: %d claves, %d nonces en la tabla de replay", keys, used);
+    return ESP_OK;
+}
+
+void qr_ticket_add_to_json(cJSON *root)
+{
+    cJSON *o = cJSON_CreateObject();
+    if (!o) return;
+
+    cJSON *ids = cJSON_CreateArray();
+    portENTER_CRITICAL(&s_key_mux);
+    uint8_t id[QR_TICKET_KEY_SLOTS];
+    bool set[QR_TICKET_KEY_SLOTS];
+    for (int s = 0; s < QR_TICKET_KEY_SLOTS; s++) {
+        set[s] = s_keys[s].set;
+        id[s]  = s_keys[s].id;
+    }
+    portEXIT_CRITICAL(&s_key_mux);
+    for (int s = 0; s < QR_TICKET_KEY_SLOTS; s++) {
+        if (set[s] && ids) cJSON_AddItemToArray(ids, cJSON_CreateNumber(id[s]));
+    }
+    if (ids) cJSON_AddItemToObject(o, "keyIds", ids);
+
+    portENTER_CRITICAL(&s_tk_mux);
+    ticket_stats_t st = s_stats;
+    portEXIT_CRITICAL(&s_tk_mux);
+
+    cJSON_AddNumberToObject(o, "offlineOk", st.offline_ok);
+    cJSON_AddNumberToObject(o, "rejected",  st.rejected);
+    cJSON_AddNumberToObject(o, "replay",    st.replay);
+    cJSON_AddNumberToObject(o, "fallback",  st.fallback);
+    cJSON_AddItemToObject(root, "tickets", o);
+}
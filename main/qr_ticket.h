@@ -0,0 +1,85 @@
+// qr_ticket.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "cJSON.h"
+
+// Tickets QR firmados: el lector decide sin pasar por el broker.
+//
+//   "TK2:" + base64url( payload(24) || ECDSA-P256-SHA256(payload) r||s (64) )
+//
+//   payload: ver(1)=2 | keyId(1) | bookingId(4) | court(2) |
+//            validFrom(4) | validTo(4) | nonce(8)
+//
+// Enteros big endian, tiempos en segundos Unix (UTC). El backend firma con la
+// clave privada; al torno sólo llega la pública ("ticketKey" de setConfig, punto
+// sin comprimir 04||X||Y), así que un torno comprometido no puede emitir
+// tickets. Verificar es mucho más caro que el HMAC de v1 (ms en un PC, bastante
+// más en el S3, que no tiene acelerador ECC): sólo se hace para textos con el
+// prefijo. Los "TK1:" (HMAC, v1) ya no son tickets y siguen por getAccessTorn.
+
+#define QR_TICKET_PREFIX       "TK2:"
+#define QR_TICKET_VERSION      2
+#define QR_TICKET_KEY_LEN      65     // punto P-256 sin comprimir
+#define QR_TICKET_KEY_SLOTS    2      // clave actual + siguiente (rotación)
+#define QR_TICKET_PAYLOAD_LEN  24
+#define QR_TICKET_SIG_LEN      64     // r || s
+
+typedef enum {
+    QT_OK = 0,
+
+    // No se puede decidir offline: seguir por getAccessTorn
+    QT_NO_KEY,
+    QT_NO_TIME,
+    QT_STORE_FULL,
+
+    // Rechazo definitivo
+    QT_BAD_FORMAT,
+    QT_BAD_SIG,
+    QT_NOT_YET,
+    QT_EXPIRED,
+    QT_WRONG_COURT,
+    QT_REPLAY,
+} qr_ticket_result_t;
+
+typedef struct {
+    uint8_t  key_id;
+    uint32_t booking_id;
+    uint16_t court;
+    uint32_t valid_from;
+    uint32_t valid_to;
+    uint8_t  nonce[8];
+} qr_ticket_t;
+
+esp_err_t qr_ticket_init(void);
+
+bool qr_ticket_is_ticket(const char *text);
+
+// Verifica formato, firma, ventana de validez, pista y replay. Con QT_OK el
+// nonce queda consumido en RAM; app_config_schedule_commit() lo persiste en
+// la próxima escritura diferida.
+// court_filter = 0 acepta cualquier pista. out puede ser NULL.
+qr_ticket_result_t qr_ticket_check(const char *text, uint32_t now,
+                                   uint16_t court_filter, qr_ticket_t *out);
+
+static inline bool qr_ticket_decided_offline(qr_ticket_result_t r)
+{
+    return r == QT_OK || r >= QT_BAD_FORMAT;
+}
+
+const char *qr_ticket_result_name(qr_ticket_result_t r);
+
+// Persiste en NVS los nonces consumidos desde el último flush. qr_ticket_init
+// la engancha a los commits de app_config: no hace falta llamarla a mano.
+esp_err_t qr_ticket_flush(void);
+
+// Provisión de claves públicas (setConfig). El slot es key_id % QR_TICKET_KEY_SLOTS.
+// ESP_ERR_INVALID_ARG si el punto no es de P-256.
+esp_err_t qr_ticket_set_key(uint8_t key_id, const uint8_t key[QR_TICKET_KEY_LEN]);
+
+// Objeto "tickets" para status/getConfig (ids de clave, nunca la clave)
+void qr_ticket_add_to_json(cJSON *root);
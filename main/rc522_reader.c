@@ -4,7 +4,10 @@
 #include "rc522_reader.h"
 #include "config.h"
 #include "core.h"
-#include "mqtt_manager.h"
+#include "access_pipeline.h"
+#include "dlog.h"
+#include "params.h"
+#include "task_manifest.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -13,104 +16,32 @@
 #include "driver/gpio.h"
 
 #include "esp_log.h"
-#include "cJSON.h"
 
 #include <string.h>
 #include <stdio.h>
 #include "freertos/semphr.h"
 
-#define ACCESS_IN_FLIGHT_TIMEOUT_MS 3000
-
-static bool s_access_in_flight = false;
-static int64_t s_access_in_flight_ts_us = 0;
-
-static portMUX_TYPE s_gate_mux = portMUX_INITIALIZER_UNLOCKED;
-
-static bool access_gate_try_acquire(void)
-{
-    bool ok = false;
-    int64_t now = esp_timer_get_time();
-
-    portENTER_CRITICAL(&s_gate_mux);
-
-    int64_t dt_ms = (now - s_access_in_flight_ts_us) / 1000;
-    if (s_access_in_flight && dt_ms > ACCESS_IN_FLIGHT_TIMEOUT_MS) {
-        s_access_in_flight = false;
-    }
-
-    if (!s_access_in_flight) {
-        s_access_in_flight = true;
-        s_access_in_flight_ts_us = now;
-        ok = true;
-    }
-
-    portEXIT_CRITICAL(&s_gate_mux);
-    return ok;
-}
-
-void rc522_access_gate_release(void)
-{
-    portENTER_CRITICAL(&s_gate_mux);
-    s_access_in_flight = false;
-    portEXIT_CRITICAL(&s_gate_mux);
-}
-
-
-#define CARD_DEBOUNCE_MS 900   // ajusta: 500–1500 suele ir bien
-
-typedef struct {
-    char last_uid[16];
-    int64_t last_ts_us;
-    bool card_present;
-} reader_debounce_t;
-
-static reader_debounce_t s_db_in  = {0};
-static reader_debounce_t s_db_out = {0};
-
-static bool should_publish(reader_debounce_t *db, const char *uid_hex)
-{
-    int64_t now = esp_timer_get_time();
-    int64_t dt_ms = (now - db->last_ts_us) / 1000;
-
-    if (db->last_uid[0] != '\0' &&
-        strcmp(db->last_uid, uid_hex) == 0 &&
-        dt_ms < CARD_DEBOUNCE_MS) {
-        return false;
-    }
-
-    // aceptar y actualizar
-    strncpy(db->last_uid, uid_hex, sizeof(db->last_uid) - 1);
-    db->last_uid[sizeof(db->last_uid)-1] = '\0';
-    db->last_ts_us = now;
-    db->card_present = true;
-    return true;
-}
-
-static void mark_no_card(reader_debounce_t *db)
-{
-    db->card_present = false;
-    // opcional: no borres last_uid, así sigue sirviendo para debounce temporal
-}
-
 static bool s_last_in_ok = true;
 static bool s_last_out_ok = true;
 
 bool rc522_last_in_ok()  { return s_last_in_ok; }
 bool rc522_last_out_ok() { return s_last_out_ok; }
 
+// Recursivo: rc522_release lo toma para toda la secuencia de apagado y
+// dentro vuelve a entrar por rc522_write_reg
 static SemaphoreHandle_t s_rc522_mutex = NULL;
 
 static inline void rc522_lock(void)
 {
     if (s_rc522_mutex) {
-        xSemaphoreTake(s_rc522_mutex, portMAX_DELAY);
+        xSemaphoreTakeRecursive(s_rc522_mutex, portMAX_DELAY);
     }
 }
 
 static inline void rc522_unlock(void)
 {
     if (s_rc522_mutex) {
-        xSemaphoreGive(s_rc522_mutex);
+        xSemaphoreGiveRecursive(s_rc522_mutex);
     }
 }
 
@@ -236,14 +167,27 @@ static void rc522_antenna_on(spi_device_handle_t dev)
     }
 }
 
+// Apagar antena
+static void rc522_antenna_off(spi_device_handle_t dev)
+{
+    rc522_clear_bit_mask(dev, RC522_REG_TX_CONTROL, 0x03);
+}
+
 // ================== Inicialización RC522 ==================
 
-static void rc522_init_chip(spi_device_handle_t dev, const char *name)
+// Tiempo que se da al chip tras el reset suave (arranque del oscilador)
+#define RC522_RESET_WAIT_MS  50
+
+// Reset suave de los dos lectores a la vez: una sola espera para ambos
+static void rc522_reset_chips(void)
 {
-    // Reset suave
-    rc522_write_reg(dev, RC522_REG_COMMAND, PCD_SOFTRESET);
-    vTaskDelay(pdMS_TO_TICKS(50));
+    rc522_write_reg(s_rc522_1, RC522_REG_COMMAND, PCD_SOFTRESET);
+    rc522_write_reg(s_rc522_2, RC522_REG_COMMAND, PCD_SOFTRESET);
+    vTaskDelay(pdMS_TO_TICKS(RC522_RESET_WAIT_MS));
+}
 
+static void rc522_init_chip(spi_device_handle_t dev, const char *name)
+{
     // Timer config típica (como en tu Python)
     rc522_write_reg(dev, RC522_REG_T_MODE, 0x8D);
     rc522_write_reg(dev, RC522_REG_T_PRESCALER, 0x3E);
@@ -291,13 +235,13 @@ static esp_err_t rc522_transceive(spi_device_handle_t dev,
     rc522_clear_bit_mask(dev, RC522_REG_BIT_FRAMING, 0x80); // StopSend
 
     if (i == 0) {
-        ESP_LOGW(TAG, "Timeout transceive");
+        DLOGW(DLOG_RC522, "Timeout transceive");
         return ESP_ERR_TIMEOUT;
     }
 
     uint8_t error = rc522_read_reg(dev, RC522_REG_ERROR);
     if (error & 0x1B) {
-        ESP_LOGW(TAG, "ErrorReg=0x%02X en transceive", error);
+        DLOGW(DLOG_RC522, "ErrorReg=0x%02X en transceive", error);
         return ESP_FAIL;
     }
 
@@ -425,13 +369,13 @@ static bool rc522_to_card(spi_device_handle_t dev,
     rc522_clear_bit_mask(dev, RC522_REG_BIT_FRAMING, 0x80);
 
     if (i == 0) {
-        ESP_LOGW(TAG, "rc522_to_card timeout (cmd=0x%02X)", command);
+        DLOGW(DLOG_RC522, "rc522_to_card timeout (cmd=0x%02X)", command);
         return false;
     }
 
     uint8_t error = rc522_read_reg(dev, RC522_REG_ERROR);
     if (error & 0x1B) {
-        ESP_LOGW(TAG, "rc522_to_card ErrorReg=0x%02X (cmd=0x%02X)", error, command);
+        DLOGW(DLOG_RC522, "rc522_to_card ErrorReg=0x%02X (cmd=0x%02X)", error, command);
         return false;
     }
 
@@ -485,16 +429,16 @@ static bool rc522_select(spi_device_handle_t dev, const uint8_t uid4[4])
                             frame, sizeof(frame),
                             back, &back_len, &back_bits);
     if (!ok) {
-        ESP_LOGW(TAG, "SELECT fallo (rc522_to_card)");
+        DLOGW(DLOG_RC522, "SELECT fallo (rc522_to_card)");
         return false;
     }
     if (back_len < 1) {
-        ESP_LOGW(TAG, "SELECT sin respuesta (len=%d)", back_len);
+        DLOGW(DLOG_RC522, "SELECT sin respuesta (len=%d)", back_len);
         return false;
     }
 
     uint8_t sak = back[0];
-    ESP_LOGI(TAG, "SELECT OK, SAK=0x%02X", sak);
+    DLOGI(DLOG_RC522, "SELECT OK, SAK=0x%02X", sak);
     return true;
 }
 
@@ -519,7 +463,7 @@ static bool rc522_auth(spi_device_handle_t dev,
     if (!rc522_to_card(dev, PCD_AUTHENT,
                        buf, sizeof(buf),
                        dummy, &dummy_len, &dummy_bits)) {
-        ESP_LOGW(TAG, "rc522_to_card AUTH fallo (cmd MFAuthent)");
+        DLOGW(DLOG_RC522, "rc522_to_card AUTH fallo (cmd MFAuthent)");
         return false;
     }
 
@@ -528,7 +472,7 @@ static bool rc522_auth(spi_device_handle_t dev,
         // Crypto1 activo -> authenticated
         return true;
     } else {
-        ESP_LOGW(TAG, "Status2Reg=0x%02X, no authenticated", status2);
+        DLOGW(DLOG_RC522, "Status2Reg=0x%02X, no authenticated", status2);
         return false;
     }
 }
@@ -546,15 +490,15 @@ static bool rc522_read_block(spi_device_handle_t dev,
     uint8_t keyA[6];
     memcpy(keyA, KEY_DEFAULT, 6);
 
-    ESP_LOGD(TAG, "Intentando AUTH con KeyA en bloque %d", block_addr);
+    DLOGD(DLOG_RC522, "Intentando AUTH con KeyA en bloque %d", block_addr);
     bool authed = rc522_auth(dev, 0x60 /* Key A */, block_addr, keyA, uid4);
     if (!authed) {
         uint8_t keyB[6];
         memcpy(keyB, KEY_DEFAULT, 6);
-        ESP_LOGD(TAG, "AUTH A fallo, probando KeyB en bloque %d", block_addr);
+        DLOGD(DLOG_RC522, "AUTH A fallo, probando KeyB en bloque %d", block_addr);
         authed = rc522_auth(dev, 0x61 /* Key B */, block_addr, keyB, uid4);
         if (!authed) {
-            ESP_LOGW(TAG, "AUTH fallo en bloque %d (ni A ni B)", block_addr);
+            DLOGW(DLOG_RC522, "AUTH fallo en bloque %d (ni A ni B)", block_addr);
             rc522_stop_crypto(dev);
             return false;
         }
@@ -576,18 +520,18 @@ static bool rc522_read_block(spi_device_handle_t dev,
     rc522_stop_crypto(dev);
 
     if (!ok) {
-        ESP_LOGW(TAG, "rc522_to_card fallo leyendo bloque %d", block_addr);
+        DLOGW(DLOG_RC522, "rc522_to_card fallo leyendo bloque %d", block_addr);
         return false;
     }
 
     if (back_bits != 0x90 || back_bytes < 16) {
-        ESP_LOGW(TAG, "Lectura bloque invalida: bits=%d bytes=%d (bloque %d)",
-                 back_bits, back_bytes, block_addr);
+        DLOGW(DLOG_RC522, "Lectura bloque invalida: bits=%d bytes=%d (bloque %d)",
+              back_bits, back_bytes, block_addr);
         return false;
     }
 
     memcpy(out_data, back, 16);
-    ESP_LOGD(TAG, "Bloque %d leido OK", block_addr);
+    DLOGD(DLOG_RC522, "Bloque %d leido OK", block_addr);
     return true;
 }
 
@@ -746,18 +690,18 @@ static bool rc522_read_card_block8(spi_device_handle_t dev,
     }
     *p = '\0';
 
-    ESP_LOGI(TAG, "Tarjeta detectada UID=%s, intentando leer bloque 8", uid_str);
+    DLOGI(DLOG_RC522, "Tarjeta detectada UID=%s, intentando leer bloque 8", uid_str);
 
     // AQUÍ VIENE LO IMPORTANTE: SELECT antes de AUTH
     if (!rc522_select(dev, uid4)) {
-        ESP_LOGW(TAG, "SELECT fallo para UID=%s, no se puede autenticar", uid_str);
+        DLOGW(DLOG_RC522, "SELECT fallo para UID=%s, no se puede autenticar", uid_str);
         return false;
     }
 
     // Leer bloque 8 usando AUTH + READ
     uint8_t block_data[16] = {0};
     if (!rc522_read_block(dev, 8, uid4, block_data)) {
-        ESP_LOGW(TAG, "No se pudo leer bloque 8 para UID=%s (se enviara user=\"\")", uid_str);
+        DLOGW(DLOG_RC522, "No se pudo leer bloque 8 para UID=%s (se enviara user=\"\")", uid_str);
         user_buf[0] = '\0';
         return true; // UID ok, pero sin user
     }
@@ -765,101 +709,82 @@ static bool rc522_read_card_block8(spi_device_handle_t dev,
     // Limpiar texto del bloque 8 (trim)
     clean_text_block(block_data, 16, user_buf, user_buf_size);
 
-    ESP_LOGI(TAG, "UID=%s  block8='%s'", uid_str, user_buf);
+    DLOGI(DLOG_RC522, "UID=%s  block8='%s'", uid_str, user_buf);
     return true;
 }
 
 
 // ================== MQTT + task ==================
 
-static void publish_access_event(const char *type, const char *uid_hex, const char *user_text)
+// Lee un lector y, si hay tarjeta, la entrega al pipeline de credenciales
+// (dedup, correlación y publicación viven allí)
+static bool rc522_poll_lane(spi_device_handle_t dev, access_lane_t lane)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) return;
-
-    cJSON_AddStringToObject(root, "action", "getAccessTorn");
-    cJSON_AddStringToObject(root, "type",   type);        // "IN" o "OUT"
-    cJSON_AddStringToObject(root, "cardId", uid_hex);
-    cJSON_AddStringToObject(root, "user",   user_text);
-    cJSON_AddStringToObject(root, "name",   device_id);
-    cJSON_AddStringToObject(root, "idTorno",   id_torno);
-
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (!json_str) {
-        cJSON_Delete(root);
-        return;
-    }
-
-    // Usamos el topic de respuesta fijo (similar a lo que hacías en MicroPython con LOG/RESP)
-    const char *topic = TOPIC_RESP_FIXED;
+    credential_t cred = {
+        .lane   = lane,
+        .source = CRED_SRC_RFID,
+    };
 
-    bool ok = mqtt_enqueue(topic, json_str, 1, 0);
-    if (!ok) {
-        ESP_LOGW(TAG, "No se pudo encolar mensaje MQTT getAccessTorn");
+    if (!rc522_read_card_block8(dev, cred.id, sizeof(cred.id),
+                                cred.user, sizeof(cred.user))) {
+        return false;
     }
 
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    cred.t_detect_us = esp_timer_get_time();
+    access_pipeline_submit(&cred);
+    return true;
 }
 
+// ================== Ciclo de vida ==================
+
+// Lo que puede tardar una vuelta de lectura en curso antes de ver el stop
+#define RC522_STOP_TIMEOUT_MS  500
+
+static TaskHandle_t      s_task = NULL;
+static SemaphoreHandle_t s_task_done = NULL;
+static volatile bool     s_stop_req = false;
+static bool              s_bus_owned = false;   // el bus SPI lo inicializamos aquí
+
 static void rc522_task(void *pv)
 {
     (void)pv;
     ESP_LOGI(TAG, "Task RC522 x2 (bloque 8) arrancada");
 
-    char uid_hex[16];
-    char user_text[32];
-
-    while (1) {
-        if (!s_mqtt_connected) {
-            vTaskDelay(pdMS_TO_TICKS(500));
-            continue;
-        }
-
-        // ===== IN =====
-        memset(uid_hex, 0, sizeof(uid_hex));
-        memset(user_text, 0, sizeof(user_text));
-        if (rc522_read_card_block8(s_rc522_1, uid_hex, sizeof(uid_hex),
-                                   user_text, sizeof(user_text))) {
-
-            s_last_in_ok = true;
-
-            if (should_publish(&s_db_in, uid_hex)) {
-                if (access_gate_try_acquire()) {
-                    ESP_LOGI(TAG, "IN -> UID=%s user='%s' (PUBLICANDO)", uid_hex, user_text);
-                    publish_access_event("IN", uid_hex, user_text);
-                } else {
-                    ESP_LOGW(TAG, "IN -> ignorada, esperando respuesta hasAccess");
-                }
-            }
-
-        } else {
-            mark_no_card(&s_db_in);
-        }
+    while (!s_stop_req) {
+        // Se lee aunque no haya MQTT: el pipeline decide qué hacer con la
+        // credencial, igual que con el QR
+        if (rc522_poll_lane(s_rc522_1, ACCESS_LANE_IN))  s_last_in_ok = true;
+        if (rc522_poll_lane(s_rc522_2, ACCESS_LANE_OUT)) s_last_out_ok = true;
 
-        // ===== OUT =====
-        memset(uid_hex, 0, sizeof(uid_hex));
-        memset(user_text, 0, sizeof(user_text));
-        if (rc522_read_card_block8(s_rc522_2, uid_hex, sizeof(uid_hex),
-                                   user_text, sizeof(user_text))) {
-
-            s_last_out_ok = true;
-
-            if (should_publish(&s_db_out, uid_hex)) {
-                if (access_gate_try_acquire()) {
-                    ESP_LOGI(TAG, "OUT -> UID=%s user='%s' (PUBLICANDO)", uid_hex, user_text);
-                    publish_access_event("OUT", uid_hex, user_text);
-                } else {
-                    ESP_LOGW(TAG, "OUT -> ignorada, esperando respuesta hasAccess");
-                }
-            }
+        // Espera entre lecturas; pn532_reader_stop() la corta con un notify
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(params_get(PARAM_RC522_POLL_MS)));
+    }
 
+    ESP_LOGI(TAG, "Task RC522 detenida");
+    xSemaphoreGive(s_task_done);
+    task_manifest_exit(TASK_RC522);
+}
 
-        } else {
-            mark_no_card(&s_db_out);
-        }
+// Deja los chips en power-down con la antena apagada y suelta el SPI
+static void rc522_release(void)
+{
+    spi_device_handle_t *devs[2] = { &s_rc522_1, &s_rc522_2 };
+
+    for (int i = 0; i < 2; i++) {
+        if (*devs[i] == NULL) continue;
+        // Con el lock desde el primer registro: pn532_reader_self_test()
+        // puede estar usando el handle desde otra task
+        rc522_lock();
+        rc522_antenna_off(*devs[i]);
+        rc522_write_reg(*devs[i], RC522_REG_COMMAND, 0x10);   // PowerDown
+        spi_bus_remove_device(*devs[i]);
+        *devs[i] = NULL;
+        rc522_unlock();
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(60));
+    if (s_bus_owned) {
+        spi_bus_free(RC522_SPI_HOST);
+        s_bus_owned = false;
     }
 }
 
@@ -1042,6 +967,19 @@ esp_err_t pn532_reader_init(void)   // reutilizamos nombre
 {
     esp_err_t ret;
 
+    if (s_rc522_1 && s_rc522_2) {
+        return ESP_OK;   // ya inicializado
+    }
+
+    if (s_rc522_mutex == NULL) {
+        s_rc522_mutex = xSemaphoreCreateRecursiveMutex();
+        s_task_done = xSemaphoreCreateBinary();
+        if (s_rc522_mutex == NULL || s_task_done == NULL) {
+            ESP_LOGE(TAG, "No se pudo crear el mutex RC522");
+            return ESP_FAIL;
+        }
+    }
+
     // Bus SPI compartido
     spi_bus_config_t buscfg = {
         .mosi_io_num = RC522_PIN_MOSI,
@@ -1057,6 +995,7 @@ esp_err_t pn532_reader_init(void)   // reutilizamos nombre
         ESP_LOGE(TAG, "Error spi_bus_initialize: %s", esp_err_to_name(ret));
         return ret;
     }
+    s_bus_owned = (ret == ESP_OK);
 
     // Lector 1
     spi_device_interface_config_t devcfg1 = {
@@ -1069,6 +1008,7 @@ esp_err_t pn532_reader_init(void)   // reutilizamos nombre
     ret = spi_bus_add_device(RC522_SPI_HOST, &devcfg1, &s_rc522_1);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error add_device lector1: %s", esp_err_to_name(ret));
+        rc522_release();
         return ret;
     }
 
@@ -1083,6 +1023,7 @@ esp_err_t pn532_reader_init(void)   // reutilizamos nombre
     ret = spi_bus_add_device(RC522_SPI_HOST, &devcfg2, &s_rc522_2);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error add_device lector2: %s", esp_err_to_name(ret));
+        rc522_release();
         return ret;
     }
 
@@ -1100,21 +1041,72 @@ esp_err_t pn532_reader_init(void)   // reutilizamos nombre
 
     ESP_LOGI(TAG, "RC522 x2 inicializados en SPI");
 
+    rc522_reset_chips();
     rc522_init_chip(s_rc522_1, "lector1");
     rc522_init_chip(s_rc522_2, "lector2");
 
-    if (s_rc522_mutex == NULL) {
-        s_rc522_mutex = xSemaphoreCreateMutex();
-        if (s_rc522_mutex == NULL) {
-            ESP_LOGE(TAG, "No se pudo crear el mutex RC522");
-            return ESP_FAIL;
+    return ESP_OK;
+}
+
+void pn532_reader_start_task(void)
+{
+    if (s_task || !s_rc522_1 || !s_rc522_2) return;
+
+    s_stop_req = false;
+    xSemaphoreTake(s_task_done, 0);
+    if (task_manifest_create(TASK_RC522, rc522_task, NULL, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear la task RC522");
+        s_task = NULL;
+    }
+}
+
+esp_err_t pn532_reader_stop(void)
+{
+    if (s_task) {
+        s_stop_req = true;
+        xTaskNotifyGive(s_task);
+        if (xSemaphoreTake(s_task_done, pdMS_TO_TICKS(RC522_STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "La task RC522 no se detiene");
+            return ESP_ERR_TIMEOUT;
         }
+        s_task = NULL;
     }
 
+    rc522_release();
+    ESP_LOGI(TAG, "RC522 x2 detenidos, SPI liberado");
     return ESP_OK;
 }
 
-void pn532_reader_start_task(void)
+bool pn532_reader_running(void)
+{
+    return s_task != NULL;
+}
+
+// VersionReg de cada chip sin pasar por la task. Todo bajo el lock del bus
+// para que pn532_reader_stop() no quite un dispositivo a media lectura.
+bool pn532_reader_self_test(uint8_t ver[2])
 {
-    xTaskCreate(rc522_task, "rc522_task", 4096, NULL, 5, NULL);
+    bool ok = true;
+
+    rc522_lock();
+    spi_device_handle_t devs[2] = { s_rc522_1, s_rc522_2 };
+    for (int i = 0; i < 2; i++) {
+        uint8_t v = 0;
+        if (devs[i]) {
+            uint8_t tx[2] = { 0x80 | ((RC522_REG_VERSION << 1) & 0x7E), 0x00 };
+            uint8_t rx[2] = { 0 };
+            spi_transaction_t t = {
+                .length = 16,
+                .tx_buffer = tx,
+                .rx_buffer = rx,
+            };
+            if (spi_device_transmit(devs[i], &t) == ESP_OK) v = rx[1];
+        }
+        // 0x00 / 0xFF: chip ausente, sin alimentación o MISO al aire
+        if (v == 0x00 || v == 0xFF) ok = false;
+        if (ver) ver[i] = v;
+    }
+    rc522_unlock();
+
+    return ok && s_task != NULL;
 }
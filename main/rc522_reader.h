@@ -1,6 +1,10 @@
 // rc522_reader.h
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include "esp_err.h"
 
 // Inicializa bus SPI + dispositivos RC522 (2 lectores)
@@ -9,7 +13,15 @@ esp_err_t pn532_reader_init(void);
 // Arranca la task que va leyendo los dos lectores RC522
 void pn532_reader_start_task(void);
 
-void rc522_access_gate_release(void);
+// Para la task, apaga antena y chips y libera los dispositivos y el bus SPI.
+// Para volver a arrancar: pn532_reader_init() + pn532_reader_start_task().
+esp_err_t pn532_reader_stop(void);
+
+bool pn532_reader_running(void);
+
+// Autotest (validación tras OTA): los dos chips contestan por SPI y la task
+// está en marcha. ver recibe VersionReg de entrada y salida (puede ser NULL).
+bool pn532_reader_self_test(uint8_t ver[2]);
 
 bool rc522_write_card_out_block8(const char *user_text,
                                  char *uid_hex_out,
@@ -0,0 +1,91 @@
+// recent_set.c
+
+#include "recent_set.h"
+
+#include <string.h>
+
+bool recent_set_init(recent_set_t *rs, recent_entry_t *slots, size_t n_slots)
+{
+    if (!rs || !slots || n_slots < RECENT_SET_PROBE || (n_slots & (n_slots - 1))) {
+        return false;
+    }
+
+    memset(slots, 0, n_slots * sizeof(*slots));
+    memset(rs, 0, sizeof(*rs));
+    rs->slots = slots;
+    rs->mask  = (uint32_t)(n_slots - 1);
+    return true;
+}
+
+// FNV-1a 64: sin tablas, y para textos de QR la dispersión sobra
+uint64_t recent_set_hash(const char *text)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Casilla base tras mezclar: en FNV-1a el último carácter apenas toca los
+// bits 32..39, y códigos que sólo difieren al final (URLs, "c1".."c9")
+// caerían todos en la misma ventana de sondeo
+static uint32_t base_slot(const recent_set_t *rs, uint64_t hash)
+{
+    uint64_t m = hash ^ (hash >> 33);
+    m *= 0xff51afd7ed558ccdULL;
+    m ^= m >> 33;
+    return (uint32_t)m & rs->mask;
+}
+
+bool recent_set_check(recent_set_t *rs, uint64_t hash, int64_t now_us, int64_t ttl_us)
+{
+    uint32_t base = base_slot(rs, hash);
+
+    for (uint32_t i = 0; i < RECENT_SET_PROBE; i++) {
+        recent_entry_t *e = &rs->slots[(base + i) & rs->mask];
+        if (e->expires_us > now_us && e->hash == hash) {
+            e->expires_us = now_us + ttl_us;
+            rs->stats.suppressed++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void recent_set_insert(recent_set_t *rs, uint64_t hash, int64_t now_us, int64_t ttl_us)
+{
+    uint32_t base = base_slot(rs, hash);
+    recent_entry_t *victim = NULL;
+
+    for (uint32_t i = 0; i < RECENT_SET_PROBE; i++) {
+        recent_entry_t *e = &rs->slots[(base + i) & rs->mask];
+        bool alive = e->expires_us > now_us;
+
+        if (alive && e->hash == hash) {
+            e->expires_us = now_us + ttl_us;
+            return;
+        }
+
+        // Hueco para insertar: el primero libre/caducado, si no el que antes caduca
+        if (!alive) {
+            if (!victim || victim->expires_us > now_us) victim = e;
+        } else if (!victim || (victim->expires_us > now_us &&
+                               e->expires_us < victim->expires_us)) {
+            victim = e;
+        }
+    }
+
+    if (victim->expires_us > now_us) rs->stats.evicted++;
+    victim->hash       = hash;
+    victim->expires_us = now_us + ttl_us;
+    rs->stats.inserted++;
+}
+
+bool recent_set_seen(recent_set_t *rs, uint64_t hash, int64_t now_us, int64_t ttl_us)
+{
+    if (recent_set_check(rs, hash, now_us, ttl_us)) return true;
+    recent_set_insert(rs, hash, now_us, ttl_us);
+    return false;
+}
@@ -0,0 +1,50 @@
+// recent_set.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Conjunto de "vistos hace poco" de memoria fija: guarda un hash de 64 bits
+// por código (no el texto) con su propia caducidad.
+//
+// Direccionamiento abierto con ventana de sondeo acotada: cada hash vive en
+// una de las RECENT_SET_PROBE posiciones a partir de su casilla base, así
+// búsqueda e inserción son O(1). Si la ventana está llena se desaloja la
+// entrada que antes caduca.
+
+#define RECENT_SET_PROBE  8
+
+typedef struct {
+    uint64_t hash;
+    int64_t  expires_us;     // 0 = libre
+} recent_entry_t;
+
+typedef struct {
+    uint32_t inserted;
+    uint32_t suppressed;     // duplicados dentro de su TTL
+    uint32_t evicted;        // entradas vivas desalojadas por capacidad
+} recent_set_stats_t;
+
+typedef struct {
+    recent_entry_t    *slots;
+    uint32_t           mask;          // n_slots - 1 (potencia de 2)
+    recent_set_stats_t stats;
+} recent_set_t;
+
+// slots lo pone quien llama (capacidad configurable); n_slots potencia de 2
+// y >= RECENT_SET_PROBE.
+bool recent_set_init(recent_set_t *rs, recent_entry_t *slots, size_t n_slots);
+
+uint64_t recent_set_hash(const char *text);
+
+// true si el código se vio y sigue vivo (duplicado): renueva su caducidad,
+// así un móvil apoyado en el lector sigue suprimido mientras esté ahí.
+// false si es nuevo: se inserta con caducidad now_us + ttl_us.
+bool recent_set_seen(recent_set_t *rs, uint64_t hash, int64_t now_us, int64_t ttl_us);
+
+// Las dos mitades de recent_set_seen, para quien sólo quiere apuntar el
+// código cuando ya ha hecho algo con él. check renueva como seen pero no
+// inserta; insert no cuenta como duplicado si ya estaba (sólo renueva).
+bool recent_set_check(recent_set_t *rs, uint64_t hash, int64_t now_us, int64_t ttl_us);
+void recent_set_insert(recent_set_t *rs, uint64_t hash, int64_t now_us, int64_t ttl_us);
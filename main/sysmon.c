@@ -0,0 +1,311 @@
+// sysmon.c
+
+#include "sysmon.h"
+#include "config.h"
+#include "core.h"
+#include "mqtt_manager.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "cJSON.h"
+
+#include <string.h>
+
+static const char *TAG = "SYSMON";
+
+#if defined(CONFIG_FREERTOS_USE_TRACE_FACILITY) && defined(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+#define SYSMON_HAS_TASKS  1
+#else
+#define SYSMON_HAS_TASKS  0
+#endif
+
+// Filas por retornoSysTasks: ~40 bytes cada una, bajo MQTT_OUT_PAYLOAD_SZ
+#define TASKS_PER_MSG  14
+// En el sysStats periódico: las que más CPU gastan y las de menos stack
+#define COMPACT_TOP    3
+
+typedef struct {
+    char     name[configMAX_TASK_NAME_LEN];
+    int8_t   core;          // -1 = sin afinidad
+    uint8_t  prio;
+    uint16_t cpu_x10;       // décimas de % de un núcleo en la ventana
+    uint32_t stack_free;    // bytes, mínimo desde que arrancó
+} sysmon_task_t;
+
+typedef struct {
+    uint32_t win_ms;        // ventana de la CPU (desde la muestra anterior)
+    int      n;
+    uint16_t load_x10[2];   // por núcleo: 100 % menos su IDLE
+} sysmon_sample_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static int64_t           s_last_pub_us = 0;
+static sysmon_task_t     s_rows[SYSMON_MAX_TASKS];
+
+#if SYSMON_HAS_TASKS
+static TaskStatus_t s_ts[SYSMON_MAX_TASKS];
+static struct {
+    TaskHandle_t                h;
+    configRUN_TIME_COUNTER_TYPE run;
+} s_prev[SYSMON_MAX_TASKS];
+static int                         s_n_prev = 0;
+static configRUN_TIME_COUNTER_TYPE s_prev_total = 0;
+static int64_t                     s_prev_us = 0;
+#endif
+
+// ================== MUESTRA ==================
+
+// Rellena s_rows. Con s_lock.
+static void sample(sysmon_sample_t *smp)
+{
+    memset(smp, 0, sizeof(*smp));
+
+#if SYSMON_HAS_TASKS
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(s_ts, SYSMON_MAX_TASKS, &total);
+    if (n == 0) {
+        ESP_LOGW(TAG, "Mas de %d tasks: sube SYSMON_MAX_TASKS", SYSMON_MAX_TASKS);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    configRUN_TIME_COUNTER_TYPE d_total = total - s_prev_total;
+    smp->win_ms = (uint32_t)((now - s_prev_us) / 1000);
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &s_ts[i];
+        sysmon_task_t *r = &s_rows[i];
+
+        // Una task nueva cuenta desde que nació
+        configRUN_TIME_COUNTER_TYPE d = t->ulRunTimeCounter;
+        for (int k = 0; k < s_n_prev; k++) {
+            if (s_prev[k].h == t->xHandle) {
+                d = t->ulRunTimeCounter - s_prev[k].run;
+                break;
+            }
+        }
+
+        strncpy(r->name, t->pcTaskName, sizeof(r->name) - 1);
+        r->name[sizeof(r->name) - 1] = 0;
+        r->core = (t->xCoreID == 0 || t->xCoreID == 1) ? (int8_t)t->xCoreID : -1;
+        r->prio = (uint8_t)t->uxCurrentPriority;
+        r->cpu_x10 = d_total ? (uint16_t)((uint64_t)d * 1000 / d_total) : 0;
+        r->stack_free = t->usStackHighWaterMark;
+
+        if (strncmp(r->name, "IDLE", 4) == 0 && r->core >= 0) {
+            smp->load_x10[r->core] = r->cpu_x10 < 1000 ? 1000 - r->cpu_x10 : 0;
+        }
+    }
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        s_prev[i].h = s_ts[i].xHandle;
+        s_prev[i].run = s_ts[i].ulRunTimeCounter;
+    }
+    s_n_prev = (int)n;
+    s_prev_total = total;
+    s_prev_us = now;
+    smp->n = (int)n;
+#endif
+}
+
+// Índices de s_rows ordenados: por CPU (desc) o por stack libre (asc)
+static void sort_rows(int *idx, int n, bool by_stack)
+{
+    for (int i = 0; i < n; i++) idx[i] = i;
+    for (int i = 1; i < n; i++) {
+        int v = idx[i], j = i;
+        while (j > 0 && (by_stack ? s_rows[idx[j - 1]].stack_free > s_rows[v].stack_free
+                                  : s_rows[idx[j - 1]].cpu_x10 < s_rows[v].cpu_x10)) {
+            idx[j] = idx[j - 1];
+            j--;
+        }
+        idx[j] = v;
+    }
+}
+
+// ================== JSON ==================
+
+static void add_heap_cap(cJSON *o, const char *key, uint32_t caps)
+{
+    if (heap_caps_get_total_size(caps) == 0) return;   // p.ej. sin PSRAM
+    cJSON *a = cJSON_CreateArray();
+    if (!a) return;
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(heap_caps_get_free_size(caps)));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(heap_caps_get_largest_free_block(caps)));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(heap_caps_get_minimum_free_size(caps)));
+    cJSON_AddItemToObject(o, key, a);
+}
+
+static void add_queue(cJSON *o, const char *key, QueueHandle_t q)
+{
+    if (!q) return;
+    UBaseType_t used = uxQueueMessagesWaiting(q);
+    cJSON *a = cJSON_CreateArray();
+    if (!a) return;
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(used));
+    cJSON_AddItemToArray(a, cJSON_CreateNumber(used + uxQueueSpacesAvailable(q)));
+    cJSON_AddItemToObject(o, key, a);
+}
+
+// Heap [libre, mayor bloque, mínimo libre] por capacidad, colas [en cola,
+// capacidad; "outBytes": bytes de la de salida] y carga de cada núcleo
+static void add_common(cJSON *root, const sysmon_sample_t *smp)
+{
+    cJSON_AddStringToObject(root, "id", device_id);
+    cJSON_AddNumberToObject(root, "uptime", (double)(esp_timer_get_time() / 1000000));
+    cJSON_AddNumberToObject(root, "minFree", esp_get_minimum_free_heap_size());
+
+    cJSON *heap = cJSON_AddObjectToObject(root, "heap");
+    if (heap) {
+        add_heap_cap(heap, "int",   MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        add_heap_cap(heap, "dma",   MALLOC_CAP_DMA);
+        add_heap_cap(heap, "psram", MALLOC_CAP_SPIRAM);
+    }
+
+    cJSON *q = cJSON_AddObjectToObject(root, "q");
+    if (q) {
+        add_queue(q, "cmd", cmd_queue);
+        add_queue(q, "out", mqtt_out_queue);
+        cJSON_AddNumberToObject(q, "outBytes", mqtt_out_bytes());
+    }
+
+    if (smp->n > 0) {
+        cJSON_AddNumberToObject(root, "winMs", smp->win_ms);
+        cJSON *cpu = cJSON_AddArrayToObject(root, "cpu");
+        for (int c = 0; cpu && c < 2; c++) {
+            cJSON_AddItemToArray(cpu, cJSON_CreateNumber(smp->load_x10[c] / 10.0));
+        }
+    }
+}
+
+// [nombre, core, prio, %cpu, stack libre]
+static cJSON *task_row(const sysmon_task_t *r)
+{
+    cJSON *e = cJSON_CreateArray();
+    if (!e) return NULL;
+    cJSON_AddItemToArray(e, cJSON_CreateString(r->name));
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(r->core));
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(r->prio));
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(r->cpu_x10 / 10.0));
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(r->stack_free));
+    return e;
+}
+
+// ================== API ==================
+
+esp_err_t sysmon_init(void)
+{
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+#if SYSMON_HAS_TASKS
+    // Primera ventana de CPU desde aquí
+    sysmon_sample_t smp;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sample(&smp);
+    xSemaphoreGive(s_lock);
+#else
+    ESP_LOGW(TAG, "Sin run-time stats de FreeRTOS: sin CPU ni stack por task");
+#endif
+    s_last_pub_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+void sysmon_publish_if_due(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (!s_lock || now - s_last_pub_us < (int64_t)SYSMON_PERIOD_MS * 1000) return;
+    s_last_pub_us = now;
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+    cJSON_AddStringToObject(root, "action", "sysStats");
+
+    sysmon_sample_t smp;
+    int idx[SYSMON_MAX_TASKS];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sample(&smp);
+    add_common(root, &smp);
+
+    if (smp.n > 0) {
+        // [nombre, %cpu], sin las IDLE (ya van en "cpu")
+        sort_rows(idx, smp.n, false);
+        cJSON *top = cJSON_AddArrayToObject(root, "top");
+        for (int i = 0, k = 0; top && i < smp.n && k < COMPACT_TOP; i++) {
+            const sysmon_task_t *r = &s_rows[idx[i]];
+            if (strncmp(r->name, "IDLE", 4) == 0) continue;
+            cJSON *e = cJSON_CreateArray();
+            if (!e) break;
+            cJSON_AddItemToArray(e, cJSON_CreateString(r->name));
+            cJSON_AddItemToArray(e, cJSON_CreateNumber(r->cpu_x10 / 10.0));
+            cJSON_AddItemToArray(top, e);
+            k++;
+        }
+
+        // [nombre, bytes libres]
+        sort_rows(idx, smp.n, true);
+        cJSON *stk = cJSON_AddArrayToObject(root, "stack");
+        for (int i = 0; stk && i < smp.n && i < COMPACT_TOP; i++) {
+            const sysmon_task_t *r = &s_rows[idx[i]];
+            cJSON *e = cJSON_CreateArray();
+            if (!e) break;
+            cJSON_AddItemToArray(e, cJSON_CreateString(r->name));
+            cJSON_AddItemToArray(e, cJSON_CreateNumber(r->stack_free));
+            cJSON_AddItemToArray(stk, e);
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    // Telemetría periódica: si se pierde una, llega otra en 30 s
+    mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 0, 0);
+    cJSON_Delete(root);
+}
+
+void sysmon_publish_full(const char *id_peticion)
+{
+    if (!s_lock) return;
+
+    sysmon_sample_t smp;
+    int idx[SYSMON_MAX_TASKS];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sample(&smp);
+
+    cJSON *root = cJSON_CreateObject();
+    if (root) {
+        cJSON_AddStringToObject(root, "action", "retornoSysStats");
+        cJSON_AddStringToObject(root, "idPeticion", id_peticion);
+        add_common(root, &smp);
+        cJSON_AddNumberToObject(root, "tasks", smp.n);
+        cJSON_AddNumberToObject(root, "parts", (smp.n + TASKS_PER_MSG - 1) / TASKS_PER_MSG);
+        mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+        cJSON_Delete(root);
+    }
+
+    // De más a menos CPU
+    sort_rows(idx, smp.n, false);
+    for (int part = 0; part * TASKS_PER_MSG < smp.n; part++) {
+        root = cJSON_CreateObject();
+        if (!root) break;
+        cJSON_AddStringToObject(root, "action", "retornoSysTasks");
+        cJSON_AddStringToObject(root, "id", device_id);
+        cJSON_AddStringToObject(root, "idPeticion", id_peticion);
+        cJSON_AddNumberToObject(root, "part", part);
+        cJSON *arr = cJSON_AddArrayToObject(root, "rows");
+        for (int i = part * TASKS_PER_MSG; arr && i < smp.n && i < (part + 1) * TASKS_PER_MSG; i++) {
+            cJSON *e = task_row(&s_rows[idx[i]]);
+            if (e) cJSON_AddItemToArray(arr, e);
+        }
+        mqtt_enqueue_json(TOPIC_RESP_FIXED, root, 1, 0);
+        cJSON_Delete(root);
+    }
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,25 @@
+// sysmon.h
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+// Introspección en marcha: CPU por task (run-time stats de FreeRTOS),
+// stack libre, heap por capacidad y profundidad de las colas.
+//
+// Cada muestra mide la CPU desde la anterior, con buffers estáticos: un
+// uxTaskGetSystemState y unas pocas llamadas a heap_caps, sin malloc salvo
+// el JSON. Necesita CONFIG_FREERTOS_USE_TRACE_FACILITY y
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (sdkconfig.defaults); sin ellas
+// sólo van heap y colas.
+
+esp_err_t sysmon_init(void);
+
+// "sysStats" compacto si han pasado SYSMON_PERIOD_MS desde el último
+// (desde status_task, sólo con MQTT)
+void sysmon_publish_if_due(void);
+
+// getSysStats: retornoSysStats (heap, colas, carga por núcleo) y las tasks
+// en uno o más retornoSysTasks
+void sysmon_publish_full(const char *id_peticion);
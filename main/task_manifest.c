@@ -0,0 +1,180 @@
+// task_manifest.c
+
+#include "task_manifest.h"
+#include "config.h"
+
+#include "esp_log.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "TASKS";
+
+typedef struct {
+    const char *name;
+    uint32_t    stack;      // bytes
+    UBaseType_t prio;
+    BaseType_t  core;
+} task_spec_t;
+
+// Prioridades: en core 1 manda el acceso (la UART del QR la primera, que
+// pierde bytes si se la hace esperar). El pipeline va por encima del sondeo
+// del RC522: cada credencial es poco trabajo y así no espera a un ciclo de
+// SPI entero; lo que encola el propio RC522 se atiende en cuanto lo suelta.
+// En core 0 las nuestras quedan por
+// debajo del cliente MQTT (5), lwIP (18) y WiFi (23), y la OTA por debajo
+// de mqtt_out para que el progreso y el resto del tráfico sigan saliendo.
+// Stacks: los que había; getTasks dice cuánto sobra de cada uno.
+static const task_spec_t s_manifest[TASK_COUNT] = {
+    [TASK_GM861S]     = { "gm861s_task",       6144, 8, TASK_CORE_ACCESS },
+    [TASK_CRED_PIPE]  = { "cred_pipe",         6144, 7, TASK_CORE_ACCESS },
+    [TASK_RC522]      = { "rc522_task",        4096, 6, TASK_CORE_ACCESS },
+    [TASK_GPIO_CMD]   = { "gpio_command_task", 6144, 5, TASK_CORE_ACCESS },
+    [TASK_LED]        = { "led_status_task",   2048, 1, TASK_CORE_ACCESS },
+    [TASK_MQTT_OUT]   = { "mqtt_out_task",     6144, 4, TASK_CORE_NET },
+    [TASK_OTA_HEALTH] = { "ota_health",        4096, 4, TASK_CORE_NET },
+    [TASK_STATUS]     = { "status_task",       6144, 3, TASK_CORE_NET },
+    [TASK_OTA]        = { "ota_task",          8192, 3, TASK_CORE_NET },
+    [TASK_JOURNAL]    = { "journal",           6144, 2, TASK_CORE_NET },
+    [TASK_DLOG]       = { "dlog",              4096, 1, TASK_CORE_NET },
+    [TASK_CFG_COMMIT] = { "cfg_commit",        3072, 1, TASK_CORE_NET },
+};
+
+typedef struct {
+    TaskHandle_t handle;    // NULL = no corre
+    TaskHandle_t gone;      // terminó antes de que create apuntara el handle
+    int32_t      hwm;       // última marca conocida; -1 = nunca corrió
+} task_slot_t;
+
+static portMUX_TYPE s_tm_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Serializa la lectura del stack de otra task con task_manifest_exit: una
+// task no suelta su slot (ni se borra) mientras alguien recorre su stack.
+// Mutex y no spinlock porque el recorrido es largo. Se crea en el primer
+// task_manifest_create, desde app_main, antes de que haya otras tasks.
+static SemaphoreHandle_t s_scan_mutex = NULL;
+
+static task_slot_t  s_slots[TASK_COUNT] = {
+    [0 ... TASK_COUNT - 1] = { NULL, NULL, -1 },
+};
+
+BaseType_t task_manifest_create(task_id_t id, TaskFunction_t fn, void *arg,
+                                TaskHandle_t *out)
+{
+    const task_spec_t *t = &s_manifest[id];
+    TaskHandle_t h = NULL;
+
+    if (!s_scan_mutex) s_scan_mutex = xSemaphoreCreateMutex();
+
+    BaseType_t r = xTaskCreatePinnedToCore(fn, t->name, t->stack, arg, t->prio, &h, t->core);
+    if (r != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear %s (%lu bytes)", t->name, (unsigned long)t->stack);
+        if (out) *out = NULL;
+        return r;
+    }
+
+    // La task ya puede estar corriendo en el otro núcleo (e incluso haber
+    // terminado): el handle se apunta después y task_manifest_exit lo
+    // compara con el suyo
+    portENTER_CRITICAL(&s_tm_mux);
+    if (s_slots[id].gone == h) {
+        s_slots[id].gone = NULL;
+    } else {
+        s_slots[id].handle = h;
+    }
+    portEXIT_CRITICAL(&s_tm_mux);
+
+    if (out) *out = h;
+    ESP_LOGI(TAG, "%s: core %d, prio %u, stack %lu", t->name, (int)t->core,
+             (unsigned)t->prio, (unsigned long)t->stack);
+    return r;
+}
+
+void task_manifest_exit(task_id_t id)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int32_t hwm = (int32_t)uxTaskGetStackHighWaterMark(NULL);
+
+    // Espera a que acabe un slot_hwm en curso. Se suelta antes de
+    // vTaskDelete (una task borrada no puede devolver el mutex): con el
+    // handle ya fuera del slot nadie más va a mirar este stack.
+    if (s_scan_mutex) xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&s_tm_mux);
+    task_slot_t *s = &s_slots[id];
+    if (s->handle == self) {
+        s->handle = NULL;
+        s->hwm = hwm;
+    } else if (s->handle == NULL) {
+        s->gone = self;
+        s->hwm = hwm;
+    }
+    // Si no, ya corre otra instancia (parada y arrancada otra vez): es la suya
+    portEXIT_CRITICAL(&s_tm_mux);
+    if (s_scan_mutex) xSemaphoreGive(s_scan_mutex);
+
+    vTaskDelete(NULL);
+}
+
+// uxTaskGetStackHighWaterMark recorre el stack de la task: con s_scan_mutex
+// tomado, task_manifest_exit no puede quitar el handle del slot a mitad.
+// El spinlock sólo cubre los campos, que task_manifest_create escribe sin
+// el mutex.
+static int32_t slot_hwm(task_id_t id, bool *alive)
+{
+    task_slot_t *s = &s_slots[id];
+
+    if (s_scan_mutex) xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+
+    portENTER_CRITICAL(&s_tm_mux);
+    TaskHandle_t h = s->handle;
+    portEXIT_CRITICAL(&s_tm_mux);
+
+    if (h) {
+        int32_t now = (int32_t)uxTaskGetStackHighWaterMark(h);
+        portENTER_CRITICAL(&s_tm_mux);
+        s->hwm = now;
+        portEXIT_CRITICAL(&s_tm_mux);
+    }
+
+    portENTER_CRITICAL(&s_tm_mux);
+    h = s->handle;
+    int32_t hwm = s->hwm;
+    portEXIT_CRITICAL(&s_tm_mux);
+
+    if (s_scan_mutex) xSemaphoreGive(s_scan_mutex);
+
+    *alive = (h != NULL);
+    return hwm;
+}
+
+int32_t task_manifest_hwm(task_id_t id)
+{
+    bool alive;
+    return slot_hwm(id, &alive);
+}
+
+void task_manifest_add_to_json(cJSON *root)
+{
+    cJSON *arr = cJSON_AddArrayToObject(root, "tasks");
+    if (!arr) return;
+
+    for (int i = 0; i < TASK_COUNT; i++) {
+        const task_spec_t *t = &s_manifest[i];
+        bool alive;
+
+        int32_t hwm = slot_hwm((task_id_t)i, &alive);
+
+        if (hwm >= 0 && hwm < TASK_STACK_MIN_FREE) {
+            ESP_LOGW(TAG, "%s: sólo %ld bytes de stack libres de %lu", t->name,
+                     (long)hwm, (unsigned long)t->stack);
+        }
+
+        cJSON *e = cJSON_CreateArray();
+        if (!e) return;
+        cJSON_AddItemToArray(e, cJSON_CreateString(t->name));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(t->core));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(t->prio));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(t->stack));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(hwm));
+        cJSON_AddItemToArray(e, cJSON_CreateBool(alive));
+        cJSON_AddItemToArray(arr, e);
+    }
+}
@@ -0,0 +1,49 @@
+// task_manifest.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "cJSON.h"
+
+// Todas nuestras tasks en una tabla (task_manifest.c): núcleo, prioridad y
+// stack. Core 0 = red (con WiFi, lwIP, cliente MQTT y esp_timer, ver
+// sdkconfig.defaults); core 1 = camino de acceso (lectores, pipeline,
+// relés), sin la red metiendo jitter.
+
+#define TASK_CORE_NET       0
+#define TASK_CORE_ACCESS    1
+
+typedef enum {
+    // core 1
+    TASK_GM861S = 0,
+    TASK_RC522,
+    TASK_CRED_PIPE,
+    TASK_GPIO_CMD,
+    TASK_LED,
+    // core 0
+    TASK_MQTT_OUT,
+    TASK_OTA_HEALTH,
+    TASK_STATUS,
+    TASK_OTA,
+    TASK_JOURNAL,
+    TASK_DLOG,
+    TASK_CFG_COMMIT,
+    TASK_COUNT
+} task_id_t;
+
+// xTaskCreatePinnedToCore con los valores de la tabla
+BaseType_t task_manifest_create(task_id_t id, TaskFunction_t fn, void *arg,
+                                TaskHandle_t *out);
+
+// En vez de vTaskDelete(NULL) en las tasks que terminan: guarda su marca de
+// stack antes de borrarse. No vuelve.
+void task_manifest_exit(task_id_t id);
+
+// Stack mínimo libre (bytes) de una task que corre o ya corrió; -1 si nunca
+int32_t task_manifest_hwm(task_id_t id);
+
+// "tasks": [[nombre, core, prio, stack, libreMin, viva], ...] (getTasks)
+void task_manifest_add_to_json(cJSON *root);
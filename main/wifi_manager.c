@@ -3,6 +3,9 @@
 #include "wifi_manager.h"
 #include "config.h"
 #include "core.h"
+#include "conn_supervisor.h"
+#include "app_config.h"
+#include "wifi_select.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -10,15 +13,228 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <string.h>
 
 static const char *TAG = "WIFI";
+static const char *NVS_NAMESPACE = "wifi";
 
 static esp_netif_t *s_sta_netif = NULL;
 static int s_current_wifi_index = 0;
-static int s_retry_count = 0;
+
+// ================== CONEXIÓN RÁPIDA ==================
+
+// Último AP con el que se obtuvo IP. Al arrancar se asocia directamente a
+// ese canal y BSSID, sin barrer todos los canales; si falla, escaneo
+// normal. El lease DHCP lo recuerda lwIP (CONFIG_LWIP_DHCP_RESTORE_LAST_IP,
+// ver sdkconfig.defaults): pide la IP anterior sin DISCOVER/OFFER.
+typedef struct {
+    char    ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;       // 0 = sin AP guardado
+} wifi_fast_t;
+
+#define FAST_KEY  "fast"
+
+static wifi_fast_t  s_fast;                // último AP bueno (NVS)
+static wifi_fast_t  s_assoc;               // AP de la asociación en curso
+static bool         s_fast_dirty = false;
+static bool         s_fast_try = false;    // la asociación en curso usa la pista
+static portMUX_TYPE s_fast_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static wifi_boot_times_t s_boot;
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void fast_load(void)
+{
+    memset(&s_fast, 0, sizeof(s_fast));
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return;
+    size_t len = sizeof(s_fast);
+    if (nvs_get_blob(h, FAST_KEY, &s_fast, &len) != ESP_OK || len != sizeof(s_fast)) {
+        memset(&s_fast, 0, sizeof(s_fast));
+    }
+    nvs_close(h);
+    s_fast.ssid[sizeof(s_fast.ssid) - 1] = '\0';
+}
+
+// Flush de la escritura diferida de app_config: sólo cuando cambió el AP
+static esp_err_t fast_flush(void)
+{
+    wifi_fast_t f;
+    portENTER_CRITICAL(&s_fast_mux);
+    bool dirty = s_fast_dirty;
+    s_fast_dirty = false;
+    f = s_fast;
+    portEXIT_CRITICAL(&s_fast_mux);
+    if (!dirty) return ESP_OK;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, FAST_KEY, &f, sizeof(f));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        portENTER_CRITICAL(&s_fast_mux);
+        s_fast_dirty = true;
+        portEXIT_CRITICAL(&s_fast_mux);
+    }
+    return err;
+}
+
+// Con IP: el AP de esta asociación pasa a ser la pista del próximo arranque
+static void fast_remember(void)
+{
+    if (s_assoc.channel == 0) return;
+
+    portENTER_CRITICAL(&s_fast_mux);
+    bool changed = memcmp(&s_fast, &s_assoc, sizeof(s_fast)) != 0;
+    if (changed) {
+        s_fast = s_assoc;
+        s_fast_dirty = true;
+    }
+    portEXIT_CRITICAL(&s_fast_mux);
+
+    if (changed) app_config_schedule_commit();
+}
+
+// ================== IP FIJA ==================
+
+// Se pone al asociar (como el ejemplo static_ip de IDF): antes no hay enlace
+// y esp_netif daría GOT_IP sin WiFi
+static void wifi_apply_ip_mode(void)
+{
+    if (g_app_config.static_ip == 0) {
+        esp_err_t err = esp_netif_dhcpc_start(s_sta_netif);
+        if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED) {
+            ESP_LOGE(TAG, "esp_netif_dhcpc_start: %s", esp_err_to_name(err));
+        }
+        return;
+    }
+
+    esp_err_t err = esp_netif_dhcpc_stop(s_sta_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        ESP_LOGE(TAG, "esp_netif_dhcpc_stop: %s", esp_err_to_name(err));
+        return;
+    }
+
+    esp_netif_ip_info_t ip = {0};
+    ip.ip.addr      = g_app_config.static_ip;
+    ip.netmask.addr = g_app_config.static_mask;
+    ip.gw.addr      = g_app_config.static_gw;
+    err = esp_netif_set_ip_info(s_sta_netif, &ip);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_netif_set_ip_info: %s", esp_err_to_name(err));
+        return;
+    }
+
+    // MQTT_HOST es un nombre: sin DNS explícito se usa la puerta de enlace
+    esp_netif_dns_info_t dns = {0};
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4.addr = g_app_config.static_dns ? g_app_config.static_dns
+                                                     : g_app_config.static_gw;
+    esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+
+static bool parse_ip(const cJSON *obj, const char *key, bool required, uint32_t *out)
+{
+    const cJSON *it = cJSON_GetObjectItem(obj, key);
+    if (!it && !required) {
+        *out = 0;
+        return true;
+    }
+    esp_ip4_addr_t a;
+    if (!cJSON_IsString(it) || esp_netif_str_to_ip4(it->valuestring, &a) != ESP_OK) {
+        ESP_LOGW(TAG, "staticIp: '%s' no valido", key);
+        return false;
+    }
+    *out = a.addr;
+    return true;
+}
+
+bool wifi_static_ip_from_json(const cJSON *item)
+{
+    if (cJSON_IsFalse(item) || cJSON_IsNull(item)) {
+        g_app_config.static_ip = 0;
+        g_app_config.static_mask = 0;
+        g_app_config.static_gw = 0;
+        g_app_config.static_dns = 0;
+        ESP_LOGI(TAG, "IP por DHCP desde la proxima asociacion");
+        return true;
+    }
+    if (!cJSON_IsObject(item)) return false;
+
+    uint32_t ip, mask, gw, dns;
+    if (!parse_ip(item, "ip", true, &ip) || !parse_ip(item, "mask", true, &mask) ||
+        !parse_ip(item, "gw", true, &gw) || !parse_ip(item, "dns", false, &dns) || ip == 0) {
+        return false;
+    }
+
+    g_app_config.static_ip = ip;
+    g_app_config.static_mask = mask;
+    g_app_config.static_gw = gw;
+    g_app_config.static_dns = dns;
+    ESP_LOGI(TAG, "IP fija desde la proxima asociacion");
+    return true;
+}
+
+static void add_ip(cJSON *o, const char *key, uint32_t addr)
+{
+    esp_ip4_addr_t a = { .addr = addr };
+    char s[16];
+    snprintf(s, sizeof(s), IPSTR, IP2STR(&a));
+    cJSON_AddStringToObject(o, key, s);
+}
+
+void wifi_add_to_json(cJSON *root)
+{
+    if (g_app_config.static_ip == 0) {
+        cJSON_AddBoolToObject(root, "staticIp", false);
+        return;
+    }
+    cJSON *o = cJSON_AddObjectToObject(root, "staticIp");
+    if (!o) return;
+    add_ip(o, "ip",   g_app_config.static_ip);
+    add_ip(o, "mask", g_app_config.static_mask);
+    add_ip(o, "gw",   g_app_config.static_gw);
+    if (g_app_config.static_dns) add_ip(o, "dns", g_app_config.static_dns);
+}
+
+// ================== ASOCIACIÓN ==================
+
+// Quién pidió el barrido en curso
+typedef enum {
+    SCAN_NONE = 0,
+    SCAN_CONNECT,       // desconectado: elegir AP
+    SCAN_ROAM,          // conectado con señal baja: ¿hay uno mejor?
+} scan_reason_t;
+
+// El timer corre en la task de esp_timer: sólo manda un evento y todo lo
+// demás pasa en el event loop, como los de WIFI_EVENT
+ESP_EVENT_DEFINE_BASE(WIFI_SEL_EVENT);
+enum { WIFI_SEL_EVENT_TIMER = 0 };
+
+static wifi_ap_record_t   s_scan_recs[WIFI_SCAN_MAX_RECORDS];
+static scan_reason_t      s_scan_reason = SCAN_NONE;
+static int64_t            s_last_scan_us = 0;
+static int64_t            s_last_roam_scan_us = 0;
+static wifi_ap_t          s_target;              // AP pedido en la asociación en curso
+static bool               s_target_set = false;  // false: por SSID, sin BSSID
+static wifi_ap_t          s_roam_target;
+static bool               s_roaming = false;     // desconexión pedida para cambiar de AP
+static esp_timer_handle_t s_timer = NULL;
 
 // === MISMA FUNCIÓN QUE TENÍAS EN EL MAIN ORIGINAL ===
-static esp_err_t wifi_apply_current_config(void)
+// bssid != NULL: asociarse sólo a ese AP, en ese canal, sin barrer
+static esp_err_t wifi_apply_current_config(const uint8_t *bssid, uint8_t channel)
 {
     if (s_current_wifi_index < 0 || s_current_wifi_index >= WIFI_NETS_COUNT) {
         ESP_LOGE(TAG, "wifi_apply_current_config: índice fuera de rango");
@@ -31,11 +247,164 @@ static esp_err_t wifi_apply_current_config(void)
     snprintf((char *)wifi_config.sta.ssid, sizeof(wifi_config.sta.ssid), "%s", net->ssid);
     snprintf((char *)wifi_config.sta.password, sizeof(wifi_config.sta.password), "%s", net->pass);
     wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    // 802.11k/v: el AP puede mandarnos a otro mejor (BTM) sin esperar a
+    // que nuestro roaming por RSSI lo detecte
+    wifi_config.sta.rm_enabled = 1;
+    wifi_config.sta.btm_enabled = 1;
 
-    ESP_LOGI(TAG, "Usando SSID=%s (idx=%d)", net->ssid, s_current_wifi_index);
+    if (bssid) {
+        wifi_config.sta.channel = channel;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, bssid, sizeof(wifi_config.sta.bssid));
+        ESP_LOGI(TAG, "Usando SSID=%s (idx=%d) canal %d, BSSID " MACSTR,
+                 net->ssid, s_current_wifi_index, channel, MAC2STR(bssid));
+    } else {
+        ESP_LOGI(TAG, "Usando SSID=%s (idx=%d)", net->ssid, s_current_wifi_index);
+    }
     return esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
 }
 
+static void timer_arm(uint32_t ms)
+{
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, (uint64_t)(ms ? ms : 1) * 1000);
+}
+
+static void timer_cb(void *arg)
+{
+    esp_event_post(WIFI_SEL_EVENT, WIFI_SEL_EVENT_TIMER, NULL, 0, 0);
+}
+
+static void connect_apply(esp_err_t err)
+{
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error aplicando config WiFi para idx=%d", s_current_wifi_index);
+        conn_sup_on_wifi_error();
+        timer_arm(WIFI_SCAN_RETRY_MS);
+        return;
+    }
+    esp_wifi_connect();
+}
+
+static void connect_ap(const wifi_ap_t *ap)
+{
+    s_target = *ap;
+    s_target_set = true;
+    s_current_wifi_index = ap->net;
+    connect_apply(wifi_apply_current_config(ap->bssid, ap->channel));
+}
+
+static void start_scan(scan_reason_t reason)
+{
+    // Todos los canales, activo; los resultados llegan en WIFI_EVENT_SCAN_DONE
+    esp_err_t err = esp_wifi_scan_start(NULL, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_scan_start: %s", esp_err_to_name(err));
+        s_scan_reason = SCAN_NONE;
+        timer_arm(reason == SCAN_ROAM ? WIFI_ROAM_SCAN_MIN_MS : WIFI_SCAN_RETRY_MS);
+        return;
+    }
+    s_scan_reason = reason;
+    s_last_scan_us = esp_timer_get_time();
+}
+
+// Ningún AP conocido en el barrido: por SSID, una red cada vez (puede ser
+// oculta o el barrido se la ha saltado)
+static void connect_blind(void)
+{
+    s_target_set = false;
+    wifi_sel_record(WSEL_BLIND, NULL, 0, 0, s_current_wifi_index);
+    connect_apply(wifi_apply_current_config(NULL, 0));
+}
+
+// Mejor AP elegible; si están todos en backoff se espera al primero que
+// salga, y si la tabla está vieja se barre otra vez
+static void connect_next(void)
+{
+    int64_t now = esp_timer_get_time();
+    wifi_ap_t ap;
+
+    // Con un barrido en marcha (de roaming) se decide al acabar
+    if (s_scan_reason != SCAN_NONE) {
+        s_scan_reason = SCAN_CONNECT;
+        return;
+    }
+    if (wifi_sel_pick(now, NULL, &ap)) {
+        wifi_sel_record(WSEL_PICK, ap.bssid, ap.rssi, ap.channel, wifi_sel_score(&ap));
+        connect_ap(&ap);
+        return;
+    }
+    if (now - s_last_scan_us >= (int64_t)WIFI_SCAN_RETRY_MS * 1000) {
+        start_scan(SCAN_CONNECT);
+        return;
+    }
+    uint32_t wait = wifi_sel_wait_ms(now);
+    wifi_sel_record(WSEL_WAIT, NULL, 0, 0, (int16_t)((wait + 999) / 1000));
+    timer_arm(wait);
+}
+
+static void on_scan_done(void)
+{
+    scan_reason_t reason = s_scan_reason;
+    s_scan_reason = SCAN_NONE;
+
+    uint16_t n = WIFI_SCAN_MAX_RECORDS;
+    if (esp_wifi_scan_get_ap_records(&n, s_scan_recs) != ESP_OK) n = 0;
+    int64_t now = esp_timer_get_time();
+    int known = wifi_sel_update_scan(s_scan_recs, n, now);
+    wifi_sel_record(WSEL_SCAN, NULL, 0, 0, known);
+
+    if (reason == SCAN_CONNECT) {
+        if (known > 0) {
+            connect_next();
+        } else {
+            connect_blind();
+        }
+        return;
+    }
+    if (reason != SCAN_ROAM || !conn_sup_wifi_up()) return;
+
+    wifi_ap_record_t cur;
+    if (esp_wifi_sta_get_ap_info(&cur) != ESP_OK) return;
+
+    wifi_ap_t best;
+    bool have = wifi_sel_pick(now, cur.bssid, &best);
+    int gain = have ? best.rssi - cur.rssi : 0;
+    if (have && gain >= WIFI_ROAM_DELTA_DB) {
+        wifi_sel_record(WSEL_ROAM, best.bssid, best.rssi, best.channel, gain);
+        s_roam_target = best;
+        s_roaming = true;
+        esp_wifi_disconnect();      // sigue en WIFI_EVENT_STA_DISCONNECTED
+        return;
+    }
+    wifi_sel_record(WSEL_STAY, cur.bssid, cur.rssi, cur.primary, gain);
+    esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI);
+    timer_arm(WIFI_ROAM_SCAN_MIN_MS);
+}
+
+// Conectado: con la señal por debajo de WIFI_ROAM_RSSI, barrido de roaming
+// (como mucho uno cada WIFI_ROAM_SCAN_MIN_MS)
+static void roam_check(void)
+{
+    wifi_ap_record_t cur;
+    if (s_scan_reason != SCAN_NONE || esp_wifi_sta_get_ap_info(&cur) != ESP_OK) return;
+
+    int64_t since = esp_timer_get_time() - s_last_roam_scan_us;
+    if (cur.rssi >= WIFI_ROAM_RSSI) {
+        // El evento de umbral sólo salta una vez: se vuelve a poner
+        esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI);
+        timer_arm(WIFI_ROAM_SCAN_MIN_MS);
+        return;
+    }
+    if (s_last_roam_scan_us && since < (int64_t)WIFI_ROAM_SCAN_MIN_MS * 1000) {
+        timer_arm(WIFI_ROAM_SCAN_MIN_MS - (uint32_t)(since / 1000));
+        return;
+    }
+    ESP_LOGI(TAG, "RSSI %d < %d, buscando otro AP", cur.rssi, WIFI_ROAM_RSSI);
+    s_last_roam_scan_us = esp_timer_get_time();
+    start_scan(SCAN_ROAM);
+}
+
 // === MISMO HANDLER QUE TENÍAS EN EL MAIN ORIGINAL ===
 static void wifi_event_handler(void *arg,
                                esp_event_base_t event_base,
@@ -45,51 +414,128 @@ static void wifi_event_handler(void *arg,
     if (event_base == WIFI_EVENT) {
         switch (event_id) {
             case WIFI_EVENT_STA_START:
-                ESP_LOGI(TAG, "WIFI_EVENT_STA_START -> esp_wifi_connect()");
-                s_led_mode = LED_MODE_WIFI_CONNECTING;
-                esp_wifi_connect();
+                if (s_fast_try) {
+                    ESP_LOGI(TAG, "WIFI_EVENT_STA_START -> esp_wifi_connect() al AP guardado");
+                    s_target_set = false;
+                    esp_wifi_connect();
+                } else {
+                    ESP_LOGI(TAG, "WIFI_EVENT_STA_START -> barrido");
+                    start_scan(SCAN_CONNECT);
+                }
                 break;
 
+            case WIFI_EVENT_SCAN_DONE:
+                on_scan_done();
+                break;
+
+            case WIFI_EVENT_STA_BSS_RSSI_LOW:
+                roam_check();
+                break;
+
+            case WIFI_EVENT_STA_CONNECTED: {
+                wifi_event_sta_connected_t *e = (wifi_event_sta_connected_t *)event_data;
+                memset(&s_assoc, 0, sizeof(s_assoc));
+                memcpy(s_assoc.ssid, e->ssid, e->ssid_len < 32 ? e->ssid_len : 32);
+                memcpy(s_assoc.bssid, e->bssid, sizeof(s_assoc.bssid));
+                s_assoc.channel = e->channel;
+
+                // El AP nos ha llevado a otro BSSID (BTM): los fallos, al nuevo
+                if (s_target_set && memcmp(s_target.bssid, e->bssid, 6) != 0) {
+                    wifi_sel_record(WSEL_STEER, e->bssid, 0, e->channel, 0);
+                    memcpy(s_target.bssid, e->bssid, 6);
+                    s_target.channel = e->channel;
+                }
+
+                if (s_boot.assoc_ms == 0) {
+                    s_boot.assoc_ms = now_ms();
+                    s_boot.fast = s_fast_try;
+                    s_boot.channel = e->channel;
+                }
+                ESP_LOGI(TAG, "Asociado a " MACSTR " canal %d%s", MAC2STR(e->bssid),
+                         e->channel, s_fast_try ? " (rapido)" : "");
+                wifi_apply_ip_mode();
+                break;
+            }
+
             case WIFI_EVENT_STA_DISCONNECTED: {
-                s_wifi_connected = false;
-                s_mqtt_connected = false;          // si no hay wifi, tampoco mqtt
-                s_led_mode = LED_MODE_WIFI_CONNECTING;
+                conn_sup_on_wifi_lost();
+                esp_timer_stop(s_timer);
 
                 wifi_event_sta_disconnected_t *disc =
                     (wifi_event_sta_disconnected_t *)event_data;
-                ESP_LOGW(TAG, "DISCONNECTED, reason=%d (retry=%d)", disc->reason, s_retry_count);
+                ESP_LOGW(TAG, "DISCONNECTED, reason=%d", disc->reason);
 
-                s_retry_count++;
+                if (s_roaming) {
+                    // Desconexión nuestra para cambiar de AP: no es un fallo
+                    s_roaming = false;
+                    connect_ap(&s_roam_target);
+                    break;
+                }
+
+                if (s_fast_try) {
+                    // AP guardado apagado o movido de canal: barrido normal
+                    ESP_LOGW(TAG, "Conexion rapida fallida, barrido completo");
+                    s_fast_try = false;
+                    wifi_sel_record(WSEL_FAIL, s_fast.bssid, 0, s_fast.channel, disc->reason);
+                    start_scan(SCAN_CONNECT);
+                    break;
+                }
 
-                if (s_retry_count >= MAX_RETRY_PER_AP) {
-                    s_retry_count = 0;
-                    s_current_wifi_index = (s_current_wifi_index + 1) % WIFI_NETS_COUNT;
-                    ESP_LOGW(TAG, "Cambiando a siguiente SSID (idx=%d)", s_current_wifi_index);
-                    if (wifi_apply_current_config() != ESP_OK) {
-                        ESP_LOGE(TAG, "Error aplicando config WiFi para idx=%d", s_current_wifi_index);
-                        s_led_mode = LED_MODE_ERROR;
+                if (s_target_set) {
+                    uint32_t bar = wifi_sel_fail(s_target.bssid, disc->reason,
+                                                 esp_timer_get_time());
+                    if (bar) {
+                        ESP_LOGW(TAG, "AP " MACSTR " en backoff %lu ms",
+                                 MAC2STR(s_target.bssid), (unsigned long)bar);
                     }
+                    s_target_set = false;
+                    connect_next();
+                    break;
                 }
 
-                esp_wifi_connect();
+                // Por SSID sin suerte: siguiente red y otro barrido luego
+                wifi_sel_record(WSEL_FAIL, NULL, 0, 0, disc->reason);
+                s_current_wifi_index = (s_current_wifi_index + 1) % WIFI_NETS_COUNT;
+                wifi_sel_record(WSEL_WAIT, NULL, 0, 0, WIFI_SCAN_RETRY_MS / 1000);
+                timer_arm(WIFI_SCAN_RETRY_MS);
                 break;
             }
 
             default:
                 break;
         }
+    } else if (event_base == WIFI_SEL_EVENT) {
+        if (conn_sup_wifi_up()) {
+            roam_check();
+        } else if (s_scan_reason == SCAN_NONE) {
+            connect_next();
+        }
     } else if (event_base == IP_EVENT) {
         switch (event_id) {
             case IP_EVENT_STA_GOT_IP: {
-                s_wifi_connected = true;
-                s_retry_count = 0;
                 ip_event_got_ip_t *e = (ip_event_got_ip_t *)event_data;
                 ESP_LOGI(TAG, "IP_EVENT_STA_GOT_IP: " IPSTR, IP2STR(&e->ip_info.ip));
 
-                // Si aún no tenemos MQTT, indicamos "WiFi OK pero sin MQTT"
-                if (!s_mqtt_connected) {
-                    s_led_mode = LED_MODE_WIFI_OK_NO_MQTT;
+                if (s_boot.ip_ms == 0) {
+                    s_boot.ip_ms = now_ms();
+                    ESP_LOGI(TAG, "IP a los %lu ms del arranque (asociado a los %lu ms)",
+                             (unsigned long)s_boot.ip_ms, (unsigned long)s_boot.assoc_ms);
                 }
+                s_fast_try = false;
+                fast_remember();
+
+                // El AP actual pasa a ser el pedido (también tras la rápida o
+                // por SSID) y se vigila su señal para el roaming
+                memcpy(s_target.bssid, s_assoc.bssid, 6);
+                s_target.channel = s_assoc.channel;
+                s_target_set = true;
+                wifi_sel_ok(s_assoc.bssid, s_assoc.channel);
+                esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI);
+                timer_arm(WIFI_ROAM_SCAN_MIN_MS);
+
+                // Pasa a "WiFi OK pero sin MQTT" y reconecta MQTT al momento,
+                // sin esperar al timeout del cliente
+                conn_sup_on_wifi_got_ip();
                 break;
             }
             default:
@@ -131,12 +577,45 @@ esp_err_t wifi_init_and_start(void)
             NULL,
             NULL));
 
-    // Configuramos el primer SSID y arrancamos WiFi
+    ESP_ERROR_CHECK(
+        esp_event_handler_instance_register(
+            WIFI_SEL_EVENT,
+            WIFI_SEL_EVENT_TIMER,
+            &wifi_event_handler,
+            NULL,
+            NULL));
+
+    const esp_timer_create_args_t targs = {
+        .callback = timer_cb,
+        .name = "wifi_sel",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&targs, &s_timer));
+
+    // Con AP guardado (y su red sigue en WIFI_NETS) se va directo a él;
+    // si no, STA_START barre y elige
+    fast_load();
+    app_config_register_flush(fast_flush);
     s_current_wifi_index = 0;
-    s_retry_count = 0;
-    s_wifi_connected = false;
-    ESP_ERROR_CHECK(wifi_apply_current_config());
-    ESP_ERROR_CHECK(esp_wifi_start());   // WIFI_EVENT_STA_START hará esp_wifi_connect()
+    s_fast_try = false;
+    for (int i = 0; i < WIFI_NETS_COUNT; i++) {
+        if (s_fast.channel && strcmp(WIFI_NETS[i].ssid, s_fast.ssid) == 0) {
+            s_current_wifi_index = i;
+            s_fast_try = true;
+            break;
+        }
+    }
+
+    s_boot.static_ip = (g_app_config.static_ip != 0);
+    if (s_fast_try) {
+        ESP_ERROR_CHECK(wifi_apply_current_config(s_fast.bssid, s_fast.channel));
+    }
+    ESP_ERROR_CHECK(esp_wifi_start());   // WIFI_EVENT_STA_START conecta o barre
+    s_boot.start_ms = now_ms();
 
     return ESP_OK;
 }
+
+void wifi_get_boot_times(wifi_boot_times_t *out)
+{
+    *out = s_boot;
+}
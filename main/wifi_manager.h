@@ -1,5 +1,30 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "esp_err.h"
+#include "cJSON.h"
 
 esp_err_t wifi_init_and_start(void);
+
+// Tiempos del primer arranque de la red, en ms desde el reset
+typedef struct {
+    uint32_t start_ms;      // esp_wifi_start()
+    uint32_t assoc_ms;      // primera asociación (0 = aún no)
+    uint32_t ip_ms;         // primera IP
+    bool     fast;          // la primera asociación fue directa al AP guardado
+    bool     static_ip;
+    uint8_t  channel;
+} wifi_boot_times_t;
+
+void wifi_get_boot_times(wifi_boot_times_t *out);
+
+// setConfig "staticIp": {"ip": "192.168.1.50", "mask": "255.255.255.0",
+// "gw": "192.168.1.1", "dns": "192.168.1.1"} ("dns" opcional, por defecto
+// gw) o false para DHCP. Deja el cambio en g_app_config; se aplica en la
+// próxima asociación.
+bool wifi_static_ip_from_json(const cJSON *item);
+
+// "staticIp" para getConfig
+void wifi_add_to_json(cJSON *root);
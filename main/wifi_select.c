@@ -0,0 +1,325 @@
+// wifi_select.c
+
+#include "wifi_select.h"
+#include "config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "WIFI_SEL";
+
+// Lo que cabe en un retornoWifi (MQTT_OUT_PAYLOAD_SZ)
+#define REPORT_APS   8
+#define REPORT_HIST  10
+
+// Puntuación: RSSI en dBm, menos lo que ha fallado, con un pequeño premio
+// al AP que ya dio IP alguna vez
+#define SCORE_FAIL_DB   6
+#define SCORE_OK_DB     3
+
+typedef struct {
+    uint32_t t_s;           // uptime
+    uint8_t  ev;            // wifi_sel_event_t
+    uint8_t  bssid[6];
+    int8_t   rssi;
+    uint8_t  channel;
+    int16_t  arg;
+} wifi_sel_hist_t;
+
+static const char *const s_ev_names[] = {
+    "scan", "pick", "blind", "fail", "ok", "roam", "stay", "steer", "wait",
+};
+
+static portMUX_TYPE s_sel_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static wifi_ap_t       s_aps[WIFI_SEL_MAX_APS];
+static int             s_n_aps = 0;
+static wifi_sel_hist_t s_hist[WIFI_SEL_HISTORY];
+static int             s_hist_head = 0;
+static int             s_hist_n = 0;
+
+static uint8_t  s_cur_bssid[6];
+static uint8_t  s_cur_channel = 0;      // 0 = sin AP
+static uint32_t s_roams = 0;
+static uint32_t s_fails = 0;
+
+static int net_index(const uint8_t *ssid)
+{
+    for (int i = 0; i < WIFI_NETS_COUNT; i++) {
+        if (strcmp((const char *)ssid, WIFI_NETS[i].ssid) == 0) return i;
+    }
+    return -1;
+}
+
+static wifi_ap_t *find_ap(const uint8_t bssid[6])
+{
+    for (int i = 0; i < s_n_aps; i++) {
+        if (memcmp(s_aps[i].bssid, bssid, 6) == 0) return &s_aps[i];
+    }
+    return NULL;
+}
+
+int wifi_sel_score(const wifi_ap_t *ap)
+{
+    return ap->rssi - SCORE_FAIL_DB * ap->fails + (ap->ok ? SCORE_OK_DB : 0);
+}
+
+static void bssid_hex(const uint8_t b[6], char out[13])
+{
+    snprintf(out, 13, "%02x%02x%02x%02x%02x%02x", b[0], b[1], b[2], b[3], b[4], b[5]);
+}
+
+// ================== TABLA ==================
+
+int wifi_sel_update_scan(const wifi_ap_record_t *recs, int n, int64_t now_us)
+{
+    int known = 0;
+
+    portENTER_CRITICAL(&s_sel_mux);
+    for (int i = 0; i < n; i++) {
+        int net = net_index(recs[i].ssid);
+        if (net < 0) continue;
+        known++;
+
+        wifi_ap_t *ap = find_ap(recs[i].bssid);
+        if (!ap) {
+            if (s_n_aps < WIFI_SEL_MAX_APS) {
+                ap = &s_aps[s_n_aps++];
+            } else {
+                // Tabla llena: fuera el que hace más que no se ve
+                ap = &s_aps[0];
+                for (int k = 1; k < s_n_aps; k++) {
+                    if (s_aps[k].seen_us < ap->seen_us) ap = &s_aps[k];
+                }
+            }
+            memset(ap, 0, sizeof(*ap));
+            memcpy(ap->bssid, recs[i].bssid, 6);
+        }
+        ap->net = (uint8_t)net;
+        ap->channel = recs[i].primary;
+        ap->rssi = recs[i].rssi;
+        ap->seen_us = now_us;
+    }
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    return known;
+}
+
+bool wifi_sel_pick(int64_t now_us, const uint8_t *exclude, wifi_ap_t *out)
+{
+    const wifi_ap_t *best = NULL;
+
+    portENTER_CRITICAL(&s_sel_mux);
+    for (int i = 0; i < s_n_aps; i++) {
+        const wifi_ap_t *ap = &s_aps[i];
+        if (now_us - ap->seen_us > (int64_t)WIFI_SEL_STALE_MS * 1000) continue;
+        if (ap->barred_until_us > now_us) continue;
+        if (exclude && memcmp(ap->bssid, exclude, 6) == 0) continue;
+        if (!best || wifi_sel_score(ap) > wifi_sel_score(best)) best = ap;
+    }
+    if (best) *out = *best;
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    return best != NULL;
+}
+
+uint32_t wifi_sel_fail(const uint8_t bssid[6], uint8_t reason, int64_t now_us)
+{
+    uint32_t bar_ms = 0;
+    int8_t rssi = 0;
+    uint8_t ch = 0;
+
+    portENTER_CRITICAL(&s_sel_mux);
+    s_fails++;
+    if (memcmp(s_cur_bssid, bssid, 6) == 0) s_cur_channel = 0;
+
+    wifi_ap_t *ap = find_ap(bssid);
+    if (ap) {
+        if (ap->fails < UINT8_MAX) ap->fails++;
+        // Un corte suelto se reintenta al momento; los seguidos esperan
+        if (ap->fails > 1) {
+            uint32_t exp = ap->fails - 2;
+            bar_ms = (exp > 10) ? WIFI_AP_BACKOFF_MAX_MS : (WIFI_AP_BACKOFF_BASE_MS << exp);
+            if (bar_ms > WIFI_AP_BACKOFF_MAX_MS) bar_ms = WIFI_AP_BACKOFF_MAX_MS;
+        }
+        ap->barred_until_us = now_us + (int64_t)bar_ms * 1000;
+        rssi = ap->rssi;
+        ch = ap->channel;
+    }
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    wifi_sel_record(WSEL_FAIL, bssid, rssi, ch, reason);
+    return bar_ms;
+}
+
+void wifi_sel_ok(const uint8_t bssid[6], uint8_t channel)
+{
+    int8_t rssi = 0;
+
+    portENTER_CRITICAL(&s_sel_mux);
+    wifi_ap_t *ap = find_ap(bssid);
+    if (ap) {
+        ap->fails = 0;
+        ap->barred_until_us = 0;
+        if (ap->ok < UINT16_MAX) ap->ok++;
+        rssi = ap->rssi;
+    }
+    memcpy(s_cur_bssid, bssid, 6);
+    s_cur_channel = channel;
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    wifi_sel_record(WSEL_OK, bssid, rssi, channel, 0);
+}
+
+uint32_t wifi_sel_wait_ms(int64_t now_us)
+{
+    int64_t next = 0;
+    bool ready = false;
+
+    // barred_until_us == 0 es "nunca vetado": un AP así (o con el veto ya
+    // vencido) se puede probar ya, no es "sin dato"
+    portENTER_CRITICAL(&s_sel_mux);
+    for (int i = 0; i < s_n_aps && !ready; i++) {
+        const wifi_ap_t *ap = &s_aps[i];
+        if (now_us - ap->seen_us > (int64_t)WIFI_SEL_STALE_MS * 1000) continue;
+        if (ap->barred_until_us <= now_us) ready = true;
+        else if (next == 0 || ap->barred_until_us < next) next = ap->barred_until_us;
+    }
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    if (ready) return 0;
+    if (next == 0) return WIFI_SCAN_RETRY_MS;
+    return (uint32_t)((next - now_us) / 1000) + 1;
+}
+
+// ================== HISTÓRICO ==================
+
+void wifi_sel_record(wifi_sel_event_t ev, const uint8_t *bssid, int8_t rssi,
+                     uint8_t channel, int16_t arg)
+{
+    wifi_sel_hist_t h = {
+        .t_s = (uint32_t)(esp_timer_get_time() / 1000000),
+        .ev = (uint8_t)ev,
+        .rssi = rssi,
+        .channel = channel,
+        .arg = arg,
+    };
+    if (bssid) memcpy(h.bssid, bssid, 6);
+
+    portENTER_CRITICAL(&s_sel_mux);
+    if (ev == WSEL_ROAM) s_roams++;
+    s_hist[s_hist_head] = h;
+    s_hist_head = (s_hist_head + 1) % WIFI_SEL_HISTORY;
+    if (s_hist_n < WIFI_SEL_HISTORY) s_hist_n++;
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    char b[13];
+    bssid_hex(h.bssid, b);
+    ESP_LOGI(TAG, "%s %s ch=%u rssi=%d arg=%d", s_ev_names[ev], b, channel, rssi, arg);
+}
+
+static bool hist_last(int back, wifi_sel_hist_t *out)
+{
+    if (back >= s_hist_n) return false;
+    int i = (s_hist_head - 1 - back + WIFI_SEL_HISTORY) % WIFI_SEL_HISTORY;
+    *out = s_hist[i];
+    return true;
+}
+
+static cJSON *hist_to_json(const wifi_sel_hist_t *h, bool with_ap)
+{
+    cJSON *e = cJSON_CreateArray();
+    if (!e) return NULL;
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(h->t_s));
+    cJSON_AddItemToArray(e, cJSON_CreateString(s_ev_names[h->ev]));
+    if (with_ap) {
+        char b[13];
+        bssid_hex(h->bssid, b);
+        cJSON_AddItemToArray(e, cJSON_CreateString(b));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(h->channel));
+    }
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(h->rssi));
+    cJSON_AddItemToArray(e, cJSON_CreateNumber(h->arg));
+    return e;
+}
+
+// ================== JSON ==================
+
+void wifi_sel_add_to_json(cJSON *root)
+{
+    uint8_t bssid[6];
+    wifi_sel_hist_t last;
+
+    portENTER_CRITICAL(&s_sel_mux);
+    memcpy(bssid, s_cur_bssid, 6);
+    uint8_t ch = s_cur_channel;
+    uint32_t roams = s_roams;
+    uint32_t fails = s_fails;
+    bool has_last = hist_last(0, &last);
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    cJSON *o = cJSON_AddObjectToObject(root, "wifi");
+    if (!o) return;
+    if (ch) {
+        char b[13];
+        bssid_hex(bssid, b);
+        cJSON_AddStringToObject(o, "ap", b);
+        cJSON_AddNumberToObject(o, "ch", ch);
+    }
+    cJSON_AddNumberToObject(o, "roams", roams);
+    cJSON_AddNumberToObject(o, "fails", fails);
+    // Última decisión: [t, evento, rssi, arg]; el resto con getWifi
+    if (has_last) cJSON_AddItemToObject(o, "last", hist_to_json(&last, false));
+}
+
+void wifi_sel_add_detail_to_json(cJSON *root)
+{
+    wifi_ap_t aps[WIFI_SEL_MAX_APS];
+    wifi_sel_hist_t hist[REPORT_HIST];
+    int n_aps, n_hist = 0;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_sel_mux);
+    n_aps = s_n_aps;
+    memcpy(aps, s_aps, sizeof(wifi_ap_t) * n_aps);
+    while (n_hist < REPORT_HIST && hist_last(n_hist, &hist[n_hist])) n_hist++;
+    portEXIT_CRITICAL(&s_sel_mux);
+
+    // Los REPORT_APS mejor puntuados: [bssid, red, canal, rssi, fallos, msBackoff, segVisto]
+    cJSON *a = cJSON_AddArrayToObject(root, "aps");
+    bool used[WIFI_SEL_MAX_APS] = {0};
+    for (int k = 0; a && k < REPORT_APS; k++) {
+        int best = -1;
+        for (int i = 0; i < n_aps; i++) {
+            if (!used[i] && (best < 0 || wifi_sel_score(&aps[i]) > wifi_sel_score(&aps[best]))) best = i;
+        }
+        if (best < 0) break;
+        used[best] = true;
+
+        const wifi_ap_t *ap = &aps[best];
+        char b[13];
+        bssid_hex(ap->bssid, b);
+        int64_t bar = ap->barred_until_us > now ? (ap->barred_until_us - now) / 1000 : 0;
+        cJSON *e = cJSON_CreateArray();
+        if (!e) break;
+        cJSON_AddItemToArray(e, cJSON_CreateString(b));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(ap->net));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(ap->channel));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(ap->rssi));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber(ap->fails));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber((double)bar));
+        cJSON_AddItemToArray(e, cJSON_CreateNumber((double)((now - ap->seen_us) / 1000000)));
+        cJSON_AddItemToArray(a, e);
+    }
+
+    // Últimas decisiones, la más reciente primero: [t, evento, bssid, canal, rssi, arg]
+    cJSON *h = cJSON_AddArrayToObject(root, "hist");
+    for (int i = 0; h && i < n_hist; i++) {
+        cJSON *e = hist_to_json(&hist[i], true);
+        if (e) cJSON_AddItemToArray(h, e);
+    }
+}
@@ -0,0 +1,62 @@
+// wifi_select.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_wifi.h"
+#include "cJSON.h"
+
+// Selector de AP: tabla de los APs de WIFI_NETS vistos en los barridos,
+// con RSSI, fallos y backoff por BSSID, e histórico de decisiones. No toca
+// el driver: wifi_manager barre, conecta y le cuenta lo que pasa (todo
+// desde el event loop; el JSON se puede pedir desde cualquier task).
+
+typedef struct {
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    int8_t   rssi;
+    uint8_t  net;               // índice en WIFI_NETS
+    uint8_t  fails;             // fallos seguidos
+    uint16_t ok;                // asociaciones con IP
+    int64_t  seen_us;           // último barrido en que apareció
+    int64_t  barred_until_us;
+} wifi_ap_t;
+
+typedef enum {
+    WSEL_SCAN = 0,   // arg: APs conocidos a la vista
+    WSEL_PICK,       // se conecta a este AP; arg: puntuación
+    WSEL_BLIND,      // ninguno a la vista: por SSID (red oculta o barrido vacío)
+    WSEL_FAIL,       // arg: reason del driver
+    WSEL_OK,         // IP obtenida
+    WSEL_ROAM,       // se cambia a este AP; arg: dB de mejora
+    WSEL_STAY,       // roaming descartado; arg: dB del mejor alternativo
+    WSEL_STEER,      // asociado a otro BSSID que el pedido (BTM del AP)
+    WSEL_WAIT,       // todos en backoff; arg: segundos de espera
+} wifi_sel_event_t;
+
+// Mete un barrido en la tabla. Devuelve cuántos APs conocidos había.
+int wifi_sel_update_scan(const wifi_ap_record_t *recs, int n, int64_t now_us);
+
+// Mejor AP elegible (visto hace poco, fuera de backoff, != exclude)
+bool wifi_sel_pick(int64_t now_us, const uint8_t *exclude, wifi_ap_t *out);
+
+// RSSI, menos por cada fallo seguido, más si ya dio IP alguna vez
+int wifi_sel_score(const wifi_ap_t *ap);
+
+// Fallo de conexión con ese AP. Devuelve el backoff aplicado en ms.
+uint32_t wifi_sel_fail(const uint8_t bssid[6], uint8_t reason, int64_t now_us);
+
+void wifi_sel_ok(const uint8_t bssid[6], uint8_t channel);
+
+// Hasta que algún AP conocido salga del backoff (WIFI_SCAN_RETRY_MS si no hay)
+uint32_t wifi_sel_wait_ms(int64_t now_us);
+
+void wifi_sel_record(wifi_sel_event_t ev, const uint8_t *bssid, int8_t rssi,
+                     uint8_t channel, int16_t arg);
+
+// Objeto "wifi" resumido para status
+void wifi_sel_add_to_json(cJSON *root);
+
+// Tabla de APs y últimas decisiones para retornoWifi (getWifi)
+void wifi_sel_add_detail_to_json(cJSON *root);
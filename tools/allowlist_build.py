@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+# allowlist_build.py
+#
+# Genera los binarios de la allowlist local (ver main/allowlist.h).
+#
+#   snapshot:  allowlist_build.py snapshot --seq 42 lista.csv snap.bin
+#   delta:     allowlist_build.py delta --base 42 --seq 43 [--put altas.csv] [--delete bajas.txt] delta.bin
+#   lookup:    allowlist_build.py lookup snap.bin R:04A1B2C3
+#
+# CSV: id,lanes,valid_from,valid_to
+#   id          origen + cardId tal cual lo envía el torno: "R:" + UID hex en
+#               mayúsculas para tarjetas, "Q:" + texto del QR. El origen entra
+#               en el hash: un QR con el UID de una tarjeta no abre como ella.
+#   lanes       IN|OUT|QR, o * para todos
+#   valid_from  Unix UTC o vacío (sin inicio)
+#   valid_to    Unix UTC o vacío (sin fin)
+#
+# Publicar en <topic_cmd>/allow/snap o <topic_cmd>/allow/delta (QoS 1, binario).
+
+import argparse
+import csv
+import struct
+import sys
+import zlib
+
+ALLOW_MAGIC = 0x31574C41        # "ALW1"
+ALLOW_DELTA_MAGIC = 0x31444C41  # "ALD1"
+ALLOW_VERSION = 2               # 2: origen dentro del hash
+REC_FMT = "<QII"                # key, valid_from, valid_to
+HDR_FMT = "<IHHIIIIII"          # magic, version, rec_size, count, seq, crc32, gen, reserved[2]
+DELTA_HDR_FMT = "<IIII"         # magic, base_seq, new_seq, count
+OP_PUT, OP_DEL = 1, 2
+
+# Igual que ALLOWLIST_BANK_SZ - 4K - ALLOWLIST_DELTA_SZ en config.h
+MAX_RECORDS = (0x300000 - 0x1000 - 0x10000) // 16
+LANES = {"IN": 1 << 0, "OUT": 1 << 1, "QR": 1 << 2}
+
+
+SOURCES = ("R:", "Q:")           # allow_src_t: tarjeta, QR
+
+
+def hash56(text):
+    """FNV-1a 64 del texto UTF-8, sin los 8 bits bajos (recent_set_hash >> 8)."""
+    h = 0xCBF29CE484222325
+    for b in text.encode("utf-8"):
+        h ^= b
+        h = (h * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h >> 8
+
+
+def key56(ident):
+    """Clave del registro (allowlist_key56): hash56 del id con su prefijo de origen."""
+    if not ident.startswith(SOURCES) or len(ident) == 2:
+        raise ValueError("id sin origen R:/Q:: %r" % ident)
+    return hash56(ident)
+
+
+def parse_lanes(s):
+    s = (s or "").strip().upper()
+    if s in ("", "*"):
+        return LANES["IN"] | LANES["OUT"] | LANES["QR"]
+    mask = 0
+    for part in s.replace(",", "|").split("|"):
+        part = part.strip()
+        if part not in LANES:
+            raise ValueError("carril desconocido: %r" % part)
+        mask |= LANES[part]
+    return mask
+
+
+def read_csv(path):
+    """Devuelve {hash56: (key, valid_from, valid_to)}; aborta si dos ids colisionan."""
+    recs, ids = {}, {}
+    with open(path, newline="", encoding="utf-8") as f:
+        for n, row in enumerate(csv.reader(f), 1):
+            if not row or row[0].startswith("#") or row[0] == "id":
+                continue
+            ident = row[0].strip()
+            mask = parse_lanes(row[1] if len(row) > 1 else "")
+            vf = int(row[2]) if len(row) > 2 and row[2].strip() else 0
+            vt = int(row[3]) if len(row) > 3 and row[3].strip() else 0
+            try:
+                h = key56(ident)
+            except ValueError as e:
+                sys.exit("linea %d: %s" % (n, e))
+            if h in ids and ids[h] != ident:
+                sys.exit("colision de hash56 entre %r y %r (linea %d)" % (ids[h], ident, n))
+            ids[h] = ident
+            recs[h] = ((h << 8) | mask, vf, vt)
+    return recs
+
+
+def pack_records(recs):
+    return b"".join(struct.pack(REC_FMT, *recs[h]) for h in sorted(recs))
+
+
+def build_snapshot(recs, seq):
+    if len(recs) > MAX_RECORDS:
+        sys.exit("demasiados registros: %d (max %d)" % (len(recs), MAX_RECORDS))
+    body = pack_records(recs)
+    crc = zlib.crc32(body) & 0xFFFFFFFF
+    hdr = struct.pack(HDR_FMT, ALLOW_MAGIC, ALLOW_VERSION, 16, len(recs), seq, crc, 0, 0, 0)
+    return hdr + body
+
+
+def build_delta(base, seq, puts, deletes):
+    ops = []
+    for h in sorted(puts):
+        ops.append(struct.pack("<B7x", OP_PUT) + struct.pack(REC_FMT, *puts[h]))
+    for ident in deletes:
+        ops.append(struct.pack("<B7x", OP_DEL) + struct.pack(REC_FMT, key56(ident) << 8, 0, 0))
+    return struct.pack(DELTA_HDR_FMT, ALLOW_DELTA_MAGIC, base, seq, len(ops)) + b"".join(ops)
+
+
+def lookup(snap, ident):
+    magic, _, rec_size, count, seq, crc, _, _, _ = struct.unpack_from(HDR_FMT, snap)
+    if magic != ALLOW_MAGIC or rec_size != 16:
+        sys.exit("no es un snapshot")
+    if zlib.crc32(snap[32:32 + count * 16]) & 0xFFFFFFFF != crc:
+        sys.exit("CRC incorrecto")
+    h = key56(ident)
+    lo, hi = 0, count
+    while lo < hi:
+        mid = (lo + hi) // 2
+        key, vf, vt = struct.unpack_from(REC_FMT, snap, 32 + mid * 16)
+        if key >> 8 == h:
+            lanes = [n for n, b in LANES.items() if key & b]
+            return "seq=%d %s lanes=%s from=%d to=%d" % (seq, ident, "|".join(lanes), vf, vt)
+        if key >> 8 < h:
+            lo = mid + 1
+        else:
+            hi = mid
+    return "seq=%d %s no esta" % (seq, ident)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Allowlist local del torno")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    s = sub.add_parser("snapshot")
+    s.add_argument("--seq", type=int, required=True)
+    s.add_argument("csv")
+    s.add_argument("out")
+
+    d = sub.add_parser("delta")
+    d.add_argument("--base", type=int, required=True)
+    d.add_argument("--seq", type=int, required=True)
+    d.add_argument("--put", help="CSV con altas/cambios")
+    d.add_argument("--delete", help="fichero con un id (con R:/Q:) por linea")
+    d.add_argument("out")
+
+    l = sub.add_parser("lookup")
+    l.add_argument("snapshot")
+    l.add_argument("id")
+
+    a = ap.parse_args()
+
+    if a.cmd == "snapshot":
+        data = build_snapshot(read_csv(a.csv), a.seq)
+    elif a.cmd == "delta":
+        puts = read_csv(a.put) if a.put else {}
+        dels = []
+        if a.delete:
+            with open(a.delete, encoding="utf-8") as f:
+                dels = [x.strip() for x in f if x.strip()]
+        data = build_delta(a.base, a.seq, puts, dels)
+    else:
+        with open(a.snapshot, "rb") as f:
+            print(lookup(f.read(), a.id))
+        return
+
+    with open(a.out, "wb") as f:
+        f.write(data)
+    print("%s: %d bytes" % (a.out, len(data)))
+
+
+if __name__ == "__main__":
+    main()
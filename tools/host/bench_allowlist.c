@@ -0,0 +1,233 @@
+// bench_allowlist.c
+//
+// Allowlist local (allowlist.c) en el host con 100k credenciales: genera el
+// CSV, construye el snapshot con ../allowlist_build.py (así se comprueba que
+// las claves de Python y de C coinciden), lo carga por el sink MQTT en una
+// partición en RAM y mide allowlist_check.
+//
+//   make -C tools/host bench_allowlist && (cd tools/host && ./bench_allowlist [N])
+//
+// N = búsquedas del benchmark (0 = sólo comprobaciones).
+
+#include "allowlist.h"
+#include "app_config.h"
+#include "config.h"
+#include "core.h"
+#include "mem_place.h"
+#include "mqtt_manager.h"
+#include "mqtt_reasm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+#define COUNT_IDS   100000
+#define NOW         1760000000u
+#define CSV_PATH    "allow100k.csv"
+#define SNAP_PATH   "allow100k.bin"
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// ================== Lo que allowlist.c pide al resto del firmware ==================
+
+char         device_id[32] = "host";
+char         topic_cmd[128] = "t/cmd";
+char         id_torno[32]  = "1";
+app_config_t g_app_config;
+
+static const mqtt_stream_sink_t *s_snap_sink;
+static int s_results;
+
+void *mem_place_alloc(const char *name, size_t size, mem_temp_t temp)
+{
+    return calloc(1, size);
+}
+
+bool mqtt_reasm_register_sink(const char *topic, const mqtt_stream_sink_t *sink)
+{
+    if (strcmp(topic, "t/cmd/allow/snap") == 0) s_snap_sink = sink;
+    return true;
+}
+
+bool mqtt_enqueue_json(const char *topic, const cJSON *root, int qos, int retain)
+{
+    s_results++;
+    return true;
+}
+
+// ================== Snapshot ==================
+
+// Tarjetas pares, QR impares; uno de cada mil con ventana ya cerrada
+static void card_id(int i, char *out, size_t sz)
+{
+    snprintf(out, sz, "%08X", (unsigned)(i * 2654435761u));
+}
+
+static void qr_id(int i, char *out, size_t sz)
+{
+    snprintf(out, sz, "https://t.example/p/%06d", i);
+}
+
+static bool build_snapshot(void)
+{
+    FILE *f = fopen(CSV_PATH, "w");
+    if (!f) return false;
+
+    char id[64];
+    for (int i = 0; i < COUNT_IDS; i++) {
+        const char *win = (i % 1000 == 0) ? "1750000000,1750003600" : ",";
+        if (i & 1) {
+            qr_id(i, id, sizeof(id));
+            fprintf(f, "Q:%s,QR,%s\n", id, win);
+        } else {
+            card_id(i, id, sizeof(id));
+            fprintf(f, "R:%s,IN|OUT,%s\n", id, win);
+        }
+    }
+    fclose(f);
+    return system("python3 ../allowlist_build.py snapshot --seq 7 " CSV_PATH " " SNAP_PATH
+                  " > /dev/null") == 0;
+}
+
+// Como llegaría por MQTT: en trozos del tamaño de un fragmento
+static bool stream_snapshot(void)
+{
+    FILE *f = fopen(SNAP_PATH, "rb");
+    if (!f || !s_snap_sink) return false;
+
+    fseek(f, 0, SEEK_END);
+    size_t len = (size_t)ftell(f);
+    rewind(f);
+    uint8_t *buf = malloc(len);
+    bool ok = buf && fread(buf, 1, len, f) == len;
+    fclose(f);
+
+    ok = ok && s_snap_sink->begin(len, s_snap_sink->ctx) == ESP_OK;
+    for (size_t off = 0; ok && off < len; off += 4096) {
+        size_t n = len - off < 4096 ? len - off : 4096;
+        ok = s_snap_sink->write(buf + off, n, off, s_snap_sink->ctx) == ESP_OK;
+    }
+    if (s_snap_sink->end(ok, s_snap_sink->ctx) != ESP_OK) ok = false;
+    free(buf);
+    return ok;
+}
+
+// ================== Comprobaciones ==================
+
+static void check_lookups(void)
+{
+    char id[64];
+    int granted = 0;
+
+    CHECK(allowlist_check(ALLOW_SRC_RFID, "00000000", ACCESS_LANE_IN, NOW, NULL) == ALLOW_UNAVAILABLE);
+    CHECK(stream_snapshot());
+    CHECK(s_results == 1 && part_host_mapped() == 1);
+
+    for (int i = 1; i < COUNT_IDS; i++) {
+        if (i % 1000 == 0) continue;
+        if (i & 1) {
+            qr_id(i, id, sizeof(id));
+            granted += allowlist_check(ALLOW_SRC_QR, id, ACCESS_LANE_QR, NOW, NULL) == ALLOW_GRANTED;
+        } else {
+            card_id(i, id, sizeof(id));
+            granted += allowlist_check(ALLOW_SRC_RFID, id, ACCESS_LANE_OUT, NOW, NULL) == ALLOW_GRANTED;
+        }
+    }
+    CHECK(granted == COUNT_IDS - 100);
+
+    // El mismo texto por el otro origen no hereda el permiso
+    card_id(2, id, sizeof(id));
+    CHECK(allowlist_check(ALLOW_SRC_RFID, id, ACCESS_LANE_IN, NOW, NULL) == ALLOW_GRANTED);
+    CHECK(allowlist_check(ALLOW_SRC_QR, id, ACCESS_LANE_QR, NOW, NULL) == ALLOW_NOT_FOUND);
+    CHECK(allowlist_check(ALLOW_SRC_QR, id, ACCESS_LANE_IN, NOW, NULL) == ALLOW_NOT_FOUND);
+    qr_id(3, id, sizeof(id));
+    CHECK(allowlist_check(ALLOW_SRC_RFID, id, ACCESS_LANE_QR, NOW, NULL) == ALLOW_NOT_FOUND);
+
+    // Carril, ventana y hora
+    CHECK(allowlist_check(ALLOW_SRC_QR, id, ACCESS_LANE_IN, NOW, NULL) == ALLOW_DENIED_LANE);
+    card_id(1000, id, sizeof(id));
+    CHECK(allowlist_check(ALLOW_SRC_RFID, id, ACCESS_LANE_IN, NOW, NULL) == ALLOW_DENIED_WINDOW);
+    CHECK(allowlist_check(ALLOW_SRC_RFID, id, ACCESS_LANE_IN, 1750000100, NULL) == ALLOW_GRANTED);
+    CHECK(allowlist_check(ALLOW_SRC_RFID, id, ACCESS_LANE_IN, 100, NULL) == ALLOW_UNAVAILABLE);
+    CHECK(allowlist_check(ALLOW_SRC_RFID, "NOESTA", ACCESS_LANE_IN, NOW, NULL) == ALLOW_NOT_FOUND);
+}
+
+// ================== Benchmark ==================
+
+static void bench(long n)
+{
+    enum { IDS = 4096 };
+    static char ids[IDS][48];
+    static allow_src_t src[IDS];
+
+    // Mitad en la lista, mitad fuera; tarjetas y QR mezclados
+    for (int i = 0; i < IDS; i++) {
+        int k = (int)((i * 7919u) % COUNT_IDS) | 1;
+        if (i & 1) {
+            src[i] = ALLOW_SRC_QR;
+            qr_id(k, ids[i], sizeof(ids[i]));
+        } else {
+            src[i] = ALLOW_SRC_RFID;
+            card_id(k, ids[i], sizeof(ids[i]));     // impares: tarjeta que no está
+        }
+    }
+
+    int granted = 0;
+    double t0 = now_ns();
+    for (long i = 0; i < n; i++) {
+        granted += allowlist_check(src[i & (IDS - 1)], ids[i & (IDS - 1)],
+                                   ACCESS_LANE_QR, NOW, NULL) == ALLOW_GRANTED;
+    }
+    double t1 = now_ns();
+    printf("allowlist_check, %d registros: %.0f ns (%d de %ld en lista)\n",
+           COUNT_IDS, (t1 - t0) / n, granted, n);
+
+    static uint64_t keys[IDS];
+    for (int i = 0; i < IDS; i++) keys[i] = allowlist_key56(src[i], ids[i]);
+    const allow_rec_t *recs = NULL;
+    esp_partition_mmap_handle_t map;
+    esp_partition_mmap(esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                STORAGE_PARTITION_LABEL),
+                       ALLOW_HDR_SECTOR, COUNT_IDS * sizeof(allow_rec_t),
+                       ESP_PARTITION_MMAP_DATA, (const void **)&recs, &map);
+
+    int found = 0;
+    t0 = now_ns();
+    for (long i = 0; i < n; i++) {
+        found += allowlist_bsearch(recs, COUNT_IDS, keys[i & (IDS - 1)]) != NULL;
+    }
+    t1 = now_ns();
+    esp_partition_munmap(map);
+    printf("sólo búsqueda binaria:          %.0f ns (%d)\n", (t1 - t0) / n, found);
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 2000000;
+
+    if (!part_host_init(STORAGE_PARTITION_LABEL, 2 * ALLOWLIST_BANK_SZ) ||
+        allowlist_init() != ESP_OK || !build_snapshot()) {
+        printf("FALLO: no se pudo preparar la partición o el snapshot\n");
+        return 1;
+    }
+
+    check_lookups();
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    if (n > 0) bench(n);
+    return 0;
+}
@@ -0,0 +1,260 @@
+// bench_payload_codec.c
+//
+// JSON (cJSON) frente a CBOR (payload_codec.c) en el host, con los mensajes
+// del día a día del torno: getAccessTorn (encode), hasAccess (decode) y
+// status (print / transcode). Enlaza el payload_codec.c real de main/.
+//
+//   make -C tools/host bench_payload_codec && tools/host/bench_payload_codec [N]
+//
+// Antes de medir comprueba el round-trip y que NaN/inf/2^63 salen como
+// float64 y no como entero.
+
+#include "payload_codec.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static cJSON *make_access_request_json(void)
+{
+    cJSON *r = cJSON_CreateObject();
+    cJSON_AddStringToObject(r, "action", "getAccessTorn");
+    cJSON_AddStringToObject(r, "type", "IN");
+    cJSON_AddStringToObject(r, "cardId", "A1B2C3D4");
+    cJSON_AddStringToObject(r, "user", "USER0001");
+    cJSON_AddStringToObject(r, "name", "SFTCLUB_DEVICE");
+    cJSON_AddStringToObject(r, "idTorno", "1");
+    cJSON_AddStringToObject(r, "idPeticion", "123456789");
+    return r;
+}
+
+static cJSON *make_status_json(void)
+{
+    cJSON *r = cJSON_CreateObject();
+    cJSON_AddStringToObject(r, "action", "status");
+    cJSON_AddBoolToObject(r, "online", 1);
+    cJSON_AddStringToObject(r, "id", "SFTCLUB_DEVICE");
+    cJSON_AddNumberToObject(r, "rssi", -67);
+    cJSON_AddNumberToObject(r, "uptime", 123456);
+    cJSON_AddNumberToObject(r, "freeHeap", 201234);
+    cJSON_AddStringToObject(r, "fw", "1.0.0");
+    cJSON_AddNumberToObject(r, "cborSchema", PAYLOAD_CBOR_SCHEMA_VERSION);
+    cJSON *rc = cJSON_CreateObject();
+    cJSON_AddStringToObject(rc, "in", "OK");
+    cJSON_AddStringToObject(rc, "out", "OK");
+    cJSON_AddItemToObject(r, "rc522", rc);
+    return r;
+}
+
+static size_t make_has_access_cbor(uint8_t *buf, size_t cap)
+{
+    cbor_writer_t w;
+    cbor_writer_init(&w, buf, cap);
+    cbor_put_map(&w, 5);
+    cbor_put_uint(&w, PK_SCHEMA);
+    cbor_put_uint(&w, PAYLOAD_CBOR_SCHEMA_VERSION);
+    cbor_put_uint(&w, PK_ACTION);
+    cbor_put_uint(&w, PA_HAS_ACCESS);
+    cbor_put_uint(&w, PK_RESULT);
+    cbor_put_bool(&w, true);
+    cbor_put_uint(&w, PK_TYPE);
+    cbor_put_text(&w, "IN");
+    cbor_put_uint(&w, PK_ID_PETICION);
+    cbor_put_text(&w, "123456789");
+    return w.overflow ? 0 : w.len;
+}
+
+static void put_raw(cbor_writer_t *w, const uint8_t *b, size_t n)
+{
+    if (w->len + n > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, b, n);
+    w->len += n;
+}
+
+// hasAccess con campos desconocidos etiquetados delante de los que cuentan
+static size_t make_tagged_cbor(uint8_t *buf, size_t cap)
+{
+    static const uint8_t tag_epoch[]  = { 0xc1 };               // tag 1
+    static const uint8_t tag_self[]   = { 0xd9, 0xd9, 0xf7 };   // tag 55799
+    static const uint8_t tag_bignum[] = { 0xc2 };               // tag 2
+
+    cbor_writer_t w;
+    cbor_writer_init(&w, buf, cap);
+    cbor_put_map(&w, 7);
+    cbor_put_uint(&w, PK_SCHEMA);
+    cbor_put_uint(&w, PAYLOAD_CBOR_SCHEMA_VERSION);
+    cbor_put_uint(&w, PK_ACTION);
+    cbor_put_uint(&w, PA_HAS_ACCESS);
+    cbor_put_uint(&w, 90);                                  // fuera del esquema
+    put_raw(&w, tag_epoch, sizeof(tag_epoch));
+    cbor_put_uint(&w, 1760000000);
+    cbor_put_text(&w, "meta");                              // clave de texto, tag anidado
+    put_raw(&w, tag_self, sizeof(tag_self));
+    cbor_put_array(&w, 2);
+    cbor_put_text(&w, "a");
+    put_raw(&w, tag_bignum, sizeof(tag_bignum));
+    cbor_put_text(&w, "b");
+    cbor_put_uint(&w, PK_RESULT);
+    cbor_put_bool(&w, true);
+    cbor_put_uint(&w, PK_TYPE);
+    cbor_put_text(&w, "IN");
+    cbor_put_uint(&w, PK_ID_PETICION);
+    cbor_put_text(&w, "123456789");
+    return w.overflow ? 0 : w.len;
+}
+
+// ================== Comprobaciones ==================
+static void check_decode(void)
+{
+    uint8_t buf[128];
+    command_t c;
+    size_t n = make_has_access_cbor(buf, sizeof(buf));
+
+    CHECK(n > 0);
+    CHECK(payload_is_cbor(buf, n));
+    CHECK(payload_cbor_decode_command(buf, n, &c));
+    CHECK(strcmp(c.action, "hasAccess") == 0);
+    CHECK(strcmp(c.result, "true") == 0);
+    CHECK(strcmp(c.type, "IN") == 0);
+    CHECK(strcmp(c.id_peticion, "123456789") == 0);
+
+    // Truncado en cualquier punto: nunca acepta
+    for (size_t cut = 0; cut < n; cut++) {
+        CHECK(!payload_cbor_decode_command(buf, cut, &c));
+    }
+    CHECK(!payload_is_cbor("{\"a\":1}", 7));
+
+    // Un tag se salta con su valor, no sólo la cabecera
+    n = make_tagged_cbor(buf, sizeof(buf));
+    CHECK(n > 0);
+    CHECK(payload_cbor_decode_command(buf, n, &c));
+    CHECK(strcmp(c.action, "hasAccess") == 0);
+    CHECK(strcmp(c.result, "true") == 0);
+    CHECK(strcmp(c.type, "IN") == 0);
+    CHECK(strcmp(c.id_peticion, "123456789") == 0);
+    for (size_t cut = 0; cut < n; cut++) {
+        CHECK(!payload_cbor_decode_command(buf, cut, &c));
+    }
+}
+
+// d como JSON -> CBOR; devuelve el byte de cabecera del valor
+static uint8_t number_head(double d)
+{
+    uint8_t buf[64];
+    cJSON *r = cJSON_CreateObject();
+    cJSON_AddItemToObject(r, "x", cJSON_CreateNumber(d));
+    size_t n = payload_cbor_from_json(r, buf, sizeof(buf));
+    cJSON_Delete(r);
+    // a2 (mapa de 2) 00 01 (esquema) 61 78 ("x", fuera del esquema) <valor>
+    return n > 5 ? buf[5] : 0;
+}
+
+static void check_numbers(void)
+{
+    CHECK(number_head(5) == 0x05);                       // uint inmediato
+    CHECK(number_head(-1) == 0x20);                      // negativo inmediato
+    CHECK(number_head(0.5) == 0xfb);                     // float64
+    CHECK(number_head(NAN) == 0xfb);
+    CHECK(number_head(INFINITY) == 0xfb);
+    CHECK(number_head(-INFINITY) == 0xfb);
+    CHECK(number_head(9223372036854775808.0) == 0xfb);   // 2^63: no cabe
+    CHECK(number_head(-9223372036854775808.0) == 0x3b);  // -2^63: sí cabe
+    CHECK(number_head(1e300) == 0xfb);
+}
+
+// ================== Benchmark ==================
+static void bench(int n)
+{
+    uint8_t buf[256];
+    size_t len = 0;
+    double t0, t1;
+    command_t c;
+
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) {
+        cJSON *r = make_access_request_json();
+        char *js = cJSON_PrintUnformatted(r);
+        len = strlen(js);
+        cJSON_free(js);
+        cJSON_Delete(r);
+    }
+    t1 = now_ns();
+    printf("getAccessTorn JSON: %4zu B  %6.0f ns/encode\n", len, (t1 - t0) / n);
+
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) {
+        len = payload_cbor_access_request(buf, sizeof(buf), "IN", "A1B2C3D4",
+                                          "USER0001", "SFTCLUB_DEVICE", "1", "123456789");
+    }
+    t1 = now_ns();
+    printf("getAccessTorn CBOR: %4zu B  %6.0f ns/encode\n", len, (t1 - t0) / n);
+
+    const char *ha = "{\"action\":\"hasAccess\",\"result\":\"true\",\"type\":\"IN\","
+                     "\"idPeticion\":\"123456789\"}";
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) {
+        cJSON *r = cJSON_Parse(ha);
+        memset(&c, 0, sizeof(c));
+        strncpy(c.action, cJSON_GetObjectItem(r, "action")->valuestring, sizeof(c.action) - 1);
+        strncpy(c.result, cJSON_GetObjectItem(r, "result")->valuestring, sizeof(c.result) - 1);
+        strncpy(c.type, cJSON_GetObjectItem(r, "type")->valuestring, sizeof(c.type) - 1);
+        strncpy(c.id_peticion, cJSON_GetObjectItem(r, "idPeticion")->valuestring,
+                sizeof(c.id_peticion) - 1);
+        cJSON_Delete(r);
+    }
+    t1 = now_ns();
+    printf("hasAccess     JSON: %4zu B  %6.0f ns/decode\n", strlen(ha), (t1 - t0) / n);
+
+    len = make_has_access_cbor(buf, sizeof(buf));
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) payload_cbor_decode_command(buf, len, &c);
+    t1 = now_ns();
+    printf("hasAccess     CBOR: %4zu B  %6.0f ns/decode\n", len, (t1 - t0) / n);
+
+    cJSON *st = make_status_json();
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) {
+        char *js = cJSON_PrintUnformatted(st);
+        len = strlen(js);
+        cJSON_free(js);
+    }
+    t1 = now_ns();
+    printf("status        JSON: %4zu B  %6.0f ns/print\n", len, (t1 - t0) / n);
+
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) len = payload_cbor_from_json(st, buf, sizeof(buf));
+    t1 = now_ns();
+    printf("status        CBOR: %4zu B  %6.0f ns/transcode\n", len, (t1 - t0) / n);
+    cJSON_Delete(st);
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+
+    check_decode();
+    check_numbers();
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    if (n > 0) bench(n);
+    return 0;
+}
@@ -0,0 +1,201 @@
+// bench_qr_scanner.c
+//
+// Fuzz y throughput del parser del GM861S (qr_scanner.c) en el host.
+//
+//   make -C tools/host bench_qr_scanner && tools/host/bench_qr_scanner [N]
+//
+// Casos fijos (trama, línea, CRLF, binario, STX a media línea, línea larga),
+// luego N trozos de bytes aleatorios (nunca debe desbordar out) y un flujo
+// de URLs válidas troceado al azar: se deben recuperar todas.
+
+#include "qr_scanner.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+static qr_ring_t    s_ring;
+static qr_scanner_t s_scan;
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static uint32_t s_rnd = 12345;
+
+static uint32_t rnd(void)
+{
+    s_rnd ^= s_rnd << 13;
+    s_rnd ^= s_rnd >> 17;
+    s_rnd ^= s_rnd << 5;
+    return s_rnd;
+}
+
+static void restart(void)
+{
+    qr_ring_reset(&s_ring);
+    qr_scanner_reset(&s_scan);
+}
+
+// Mete len bytes y devuelve el primer mensaje completo (o QR_SRC_NONE)
+static qr_src_t scan(const void *data, size_t len, char *out)
+{
+    qr_ring_write(&s_ring, data, len);
+    return qr_scanner_next(&s_scan, &s_ring, out, QR_FRAME_MAX);
+}
+
+// ================== Casos fijos ==================
+static void check_cases(void)
+{
+    char out[QR_FRAME_MAX];
+    uint8_t buf[600];
+
+    restart();
+    CHECK(scan("\x03\x05" "ABCDE", 7, out) == QR_SRC_PROTO && strcmp(out, "ABCDE") == 0);
+    CHECK(scan("https://x.es/t  \r\n", 18, out) == QR_SRC_LINE && strcmp(out, "https://x.es/t") == 0);
+    CHECK(qr_scanner_next(&s_scan, &s_ring, out, sizeof(out)) == QR_SRC_NONE);   // el LF suelto
+
+    // Línea binaria: descartada
+    restart();
+    CHECK(scan("\x01\x02\x04\x05Z\n", 6, out) == QR_SRC_NONE && s_scan.discarded == 1);
+
+    // STX a media línea: lo de antes es basura, la trama sale entera
+    restart();
+    CHECK(scan("basura\x03\x03" "XYZ", 11, out) == QR_SRC_PROTO && strcmp(out, "XYZ") == 0);
+    CHECK(s_scan.discarded == 1);
+
+    // Longitud de trama inválida: el STX se descarta y sigue como texto
+    restart();
+    CHECK(scan("\x03\xfbHOLA\r", 7, out) == QR_SRC_LINE && strcmp(out, "\xfbHOLA") == 0);
+    CHECK(s_scan.discarded == 1);
+
+    // Trozos de un byte
+    restart();
+    const char *frag = "\x03\x04" "1234";
+    qr_src_t src = QR_SRC_NONE;
+    for (size_t i = 0; i < 6; i++) src = scan(&frag[i], 1, out);
+    CHECK(src == QR_SRC_PROTO && strcmp(out, "1234") == 0);
+
+    // Línea más larga que QR_FRAME_MAX: se descarta entera, sin prefijo
+    restart();
+    memset(buf, 'A', sizeof(buf));
+    buf[QR_FRAME_MAX + 10] = '\n';
+    CHECK(scan(buf, QR_FRAME_MAX + 11, out) == QR_SRC_NONE);
+    CHECK(s_scan.discarded == 1 && s_scan.lines == 0);
+    CHECK(scan("OK\n", 3, out) == QR_SRC_LINE && strcmp(out, "OK") == 0);
+
+    // Justo QR_FRAME_MAX - 1 sí cabe
+    restart();
+    buf[QR_FRAME_MAX - 1] = '\n';
+    CHECK(scan(buf, QR_FRAME_MAX, out) == QR_SRC_LINE && strlen(out) == QR_FRAME_MAX - 1);
+
+    // Ring lleno: se cuentan los bytes perdidos
+    restart();
+    uint8_t big[QR_RING_SZ + 100];
+    memset(big, 'B', sizeof(big));
+    CHECK(qr_ring_write(&s_ring, big, sizeof(big)) == QR_RING_SZ && s_ring.dropped == 100);
+}
+
+// ================== Fuzz ==================
+static void fuzz(long chunks)
+{
+    char out[QR_FRAME_MAX + 16];
+    long emitted = 0;
+
+    restart();
+    for (long it = 0; it < chunks; it++) {
+        uint8_t tmp[128];
+        int n = (int)(rnd() % sizeof(tmp));
+        for (int i = 0; i < n; i++) {
+            tmp[i] = (rnd() % 4 == 0) ? (uint8_t)"\x03\r\n\t"[rnd() % 4] : (uint8_t)rnd();
+        }
+        qr_ring_write(&s_ring, tmp, (size_t)n);
+
+        // Guarda al final de out: si el scanner escribe de más, se pisa
+        memset(out + QR_FRAME_MAX, 0x5A, 16);
+        while (qr_scanner_next(&s_scan, &s_ring, out, QR_FRAME_MAX) != QR_SRC_NONE) {
+            CHECK(strlen(out) < QR_FRAME_MAX);
+            emitted++;
+        }
+        for (int i = 0; i < 16; i++) CHECK(out[QR_FRAME_MAX + i] == 0x5A);
+        if (s_fail) return;
+    }
+    printf("fuzz: %ld trozos, %ld mensajes, %u descartados\n",
+           chunks, emitted, (unsigned)s_scan.discarded);
+}
+
+// ================== Flujo válido ==================
+static void valid_stream(size_t bytes, bool report)
+{
+    uint8_t *stream = malloc(bytes + 600);
+    char out[QR_FRAME_MAX];
+    char last[QR_FRAME_MAX] = "";
+    size_t len = 0;
+    int expect = 0;
+
+    while (len < bytes) {
+        char url[QR_FRAME_MAX];
+        int n = 20 + (int)(rnd() % 200);
+        memcpy(url, "https://t.example/", 18);
+        for (int i = 18; i < n; i++) url[i] = (char)('a' + rnd() % 26);
+        url[n] = '\0';
+
+        if (rnd() & 1) {
+            stream[len++] = 0x03;
+            stream[len++] = (uint8_t)n;
+        }
+        memcpy(stream + len, url, (size_t)n);
+        len += (size_t)n;
+        stream[len++] = '\r';
+        stream[len++] = '\n';
+        expect++;
+        strcpy(last, url);
+    }
+
+    restart();
+    int got = 0;
+    size_t p = 0;
+    double t0 = now_ns();
+    while (p < len) {
+        size_t n = 1 + rnd() % 128;
+        if (p + n > len) n = len - p;
+        qr_ring_write(&s_ring, stream + p, n);
+        p += n;
+        while (qr_scanner_next(&s_scan, &s_ring, out, sizeof(out)) != QR_SRC_NONE) got++;
+    }
+    double t1 = now_ns();
+
+    CHECK(got == expect);
+    CHECK(strcmp(out, last) == 0);
+    CHECK(s_scan.discarded == 0 && s_ring.dropped == 0);
+    if (report) {
+        printf("flujo válido: %d/%d mensajes, %.1f MB/s\n",
+               got, expect, len / ((t1 - t0) / 1e3));
+    }
+    free(stream);
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 2000000;
+
+    check_cases();
+    fuzz(n > 0 ? n : 100000);
+    valid_stream(n > 0 ? (4u << 20) : (256u << 10), n > 0);
+
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// qr_ticket_vectors.h
+// Generado por gen_ticket_vectors.py: no editar a mano.
+#pragma once
+
+#include "qr_ticket.h"
+
+#define TV_NOW 1760003600u
+#define TV_VALID_TO 1760007200u
+
+static const uint8_t TV_KEY1[QR_TICKET_KEY_LEN] = { 0x04, 0xe5, 0xf6, 0xa1, 0xa5, 0x58, 0x53, 0xd4, 0x05, 0x3a, 0x65, 0x54, 0x83, 0x9f, 0x8e, 0x15, 0x58, 0x8b, 0xf5, 0x81, 0xbd, 0xd1, 0xdb, 0x36, 0x9f, 0x9d, 0x8a, 0x76, 0x83, 0xe6, 0x49, 0x13, 0x14, 0xba, 0x70, 0x6e, 0x52, 0x08, 0x55, 0x08, 0x42, 0x6d, 0x6d, 0x73, 0x9e, 0x76, 0x24, 0xf2, 0x05, 0x60, 0xe9, 0xc6, 0x58, 0xc4, 0xff, 0x07, 0x7b, 0x18, 0xfc, 0x26, 0x12, 0x9b, 0x26, 0xa4, 0xe0 };
+static const uint8_t TV_KEY2[QR_TICKET_KEY_LEN] = { 0x04, 0x20, 0xdf, 0xfa, 0x45, 0x23, 0x9a, 0x8e, 0x28, 0xcc, 0x4a, 0x90, 0x8b, 0xd9, 0xcc, 0x37, 0xdf, 0xb3, 0xd7, 0xd3, 0x0c, 0x85, 0x1a, 0x0d, 0xb6, 0xbb, 0xa8, 0x1e, 0x6b, 0xf7, 0xeb, 0xbc, 0xab, 0x10, 0x15, 0x01, 0x27, 0x31, 0xd2, 0x05, 0xc9, 0xc5, 0x6d, 0xca, 0xd3, 0xa8, 0x8a, 0xc0, 0x41, 0xcc, 0xea, 0xe6, 0x58, 0xa3, 0xe0, 0xb8, 0xaa, 0xbc, 0xfb, 0x60, 0x60, 0x60, 0x36, 0x43, 0x91 };
+
+static const struct {
+    const char *name, *text;
+    uint32_t now;
+    uint16_t court;
+    qr_ticket_result_t exp;
+} TV[] = {
+    {"valid", "TK2:AgEAABCSAANo53gAaOeUIAECAwQFBgcIN04ev_uw4Os74OMJmEyMkAzFvnJZ5e6Ms4lc5M8umeVLzqaKoRCgpLlZ3SgST7W4LuOm0stKHjbvkvjRceYD9Q", 1760003600u, 0, QT_OK},
+    {"replay", "TK2:AgEAABCSAANo53gAaOeUIAECAwQFBgcIs4kV3mwQzED_pfVmX_pBiZu0x9VMqJhplMKsWRgyqikGZeNxrvzFhljU_sMkxSEOpijDztT63zHN5ubtWaFdYQ", 1760003600u, 0, QT_REPLAY},
+    {"valid_court_match", "TK2:AgEAABCSAANo53gAaOeUIEJCQkJCQkJCR__I2UZcTKdLt1RjcYrzJC3qlgEYHeSvmTxoMU6BVaSwllLTrZUeqHoRf6qmVbhyhJRH_GtbcwL5Q_v7sYOnVw", 1760003600u, 3, QT_OK},
+    {"wrong_court", "TK2:AgEAABCSAANo53gAaOeUIENDQ0NDQ0NDLIjEvNGJd90L1oisMnFMw0HlTJN24MEhSMWb4oPWTnuFgzqRqhs0Jiro6SNS7UUHti-XmD5pFfTkrbQm9ivH5A", 1760003600u, 4, QT_WRONG_COURT},
+    {"bad_sig", "TK2:AgEAABCSAANo53gAaOeUIEREREREREREdeROmLSO-wyshUC1clNxX7me6tWIImnD6hwS2Ut_m-9eZg1WGGrqxzZ1bp5KhdEXPRIVcpTmhP_H-a17KW5LRg", 1760003600u, 0, QT_BAD_SIG},
+    {"tampered_payload", "TK2:AgEAARCSAANo53gAaOeUIEVFRUVFRUVFpBGw62VIj3FjCYUzDeBVva0dQ7aXKMlDesAdprNODaPo7VOCd9tP0YK3p6-Bmlsk9hHaogdRKGL_dqHgl230qA", 1760003600u, 0, QT_BAD_SIG},
+    {"wrong_key", "TK2:AgEAABCSAANo53gAaOeUIEZGRkZGRkZGRYmSB-wOjeiu2-lKj7P3p08e0l0yl-VDBhFS8_xJozuywZyGJKAdDwFnh1KEqOlm7bb6FR0KvzfkZ2QPEaVGEQ", 1760003600u, 0, QT_BAD_SIG},
+    {"unknown_key_id", "TK2:AgcAABCSAANo53gAaOeUIEdHR0dHR0dHswkUbBtDc_sWjD40J4ndWU400i6t59Ga9GPaFb-d1ITK2Tx4xMnf-PgNc80GTZovdW-HDSs_1pATdzVdELs2qg", 1760003600u, 0, QT_NO_KEY},
+    {"expired", "TK2:AgEAABCSAANo53gAaOeUIEhISEhISEhIBtIDqdJdacH76YGY7sdmZWtxxT4uh1UGrR7n8d3LiRJ2bFYYFrjN_YE8u-6nRXloS3rkvk-6mDp0scKolSa6bg", 1760007321u, 0, QT_EXPIRED},
+    {"expired_within_skew", "TK2:AgEAABCSAANo53gAaOeUIElJSUlJSUlJNGI3-ahSonVHYfNyuo1Vgm-5e80h8SZsXCqohfATLiYjLBLyYtgfEhbRFopgQdc7E-pIse6o8wuo3OdRvZCcVA", 1760007320u, 0, QT_OK},
+    {"not_yet", "TK2:AgEAABCSAANo53gAaOeUIEpKSkpKSkpKDbtePGLdrwOQZQq5oBbJNr2KyhQSpxobd_WD1cOyzP4c6-gVKWcfS2dJwf2-TKbJLGTgrWW35RE4iIz_rLu6VA", 1759999879u, 0, QT_NOT_YET},
+    {"not_yet_within_skew", "TK2:AgEAABCSAANo53gAaOeUIEtLS0tLS0tLa4QDG5BR-ErRP01Wq7gANdO8TEFL9xx977sFEtM5bm5JDU8UC9LJKXm8IfzBZzPV9JkFbU8-pX3X1WIF9uT0-g", 1759999880u, 0, QT_OK},
+    {"no_time", "TK2:AgEAABCSAANo53gAaOeUIExMTExMTExMvOYvzICsanE4hLqTcX7ZbuERkMgDeNSYcZbWoKeubj_AwZW_JJLCieIJu8y7pOVnghfJDhgaErtVL6ZnMuTjbw", 1000u, 0, QT_NO_TIME},
+    {"short", "TK2:AgEAABCSAANo53gAaOeUIE1NTU1NTU1NO0bBrNJelIHgeuhkfvIfthW7LxzzAHOFD4TF8GmGiNjZatquHcUdHGJqwljKZBdn68158iWYS4Eoi5svQJTu", 1760003600u, 0, QT_BAD_FORMAT},
+    {"bad_version", "TK2:AQEAABCSAANo53gAaOeUIE5OTk5OTk5OFwXbSiKg991x_vgsHrVIrTrwpAU4DZdz6taxnKENuWFzfBB_zrSza7LsiWOuxBWQ_tQsjiiXz0DrUzi9A7obnA", 1760003600u, 0, QT_BAD_FORMAT},
+    {"bad_b64", "TK2:!!!!", 1760003600u, 0, QT_BAD_FORMAT},
+    {"key2_slot0", "TK2:AgIAABCSAANo53gAaOeUIE9PT09PT09PQ6h40PpzW4ektDWJEACM-VeBQiBKHNcA-FAyr9-kcnya3Q6Kl9GsPi-6L6ZVoSYzYAFNLOXPcKCRHLC7hQD2Gw", 1760003600u, 0, QT_OK},
+    {"tk1_hmac_legacy", "TK1:AQEAABCSAANo53gAaOeUIFpaWlpaWlpauq3e6y7_sXfgq4HCqhfASQ", 1760003600u, 0, QT_BAD_FORMAT},
+};
+
+// Tickets válidos con nonce distinto para llenar la tabla de replay
+static const char *const TV_FILL[] = {
+    "TK2:AgEAACcQAANo53gAaOeUIHd3d3d3dwAALEnYH2IBxO57bSZKHUn5Aum-vH8FKX5LHkjETA6ex1EbEHla0sW_QrN54MFShnGzf_psYSxAE6Lfapeh-L6B0Q",
+    "TK2:AgEAACcRAANo53gAaOeUIHd3d3d3dwAB4X8figKzelG9Hlt0AU51lpPoAJuRdjUh_WAT9HW6hYadLZdQi_e0pu2hrtFDGaScd5CsAdRgpRCywqaSAPEvKA",
+    "TK2:AgEAACcSAANo53gAaOeUIHd3d3d3dwAC_STdSwCWbgwivJPeJEpl3Vy0p2Ie9cl1_QbH7LzbTsmNiisrnAMSFAdkanaXFYJl4KByJY38YxVcgptWi752jQ",
+    "TK2:AgEAACcTAANo53gAaOeUIHd3d3d3dwADLEwzYHA76g_pwlsPdYK5htceWUV5ohvHm9B3jHq-FSUm5FWDWoMTSTG3CT3U0UdKs-4ncgIzVlQS3uh6CHpbQQ",
+    "TK2:AgEAACcUAANo53gAaOeUIHd3d3d3dwAEJ0Iruy-trP8VEAVc65mV98ZedjPaSCsYsWGZL7m7IJHKvSdLkMwyokRkfH3roW2VjgIXS4pr79htnTvsMnn7pw",
+    "TK2:AgEAACcVAANo53gAaOeUIHd3d3d3dwAFPW5QBOwypz4Omtw7cO3dYDF898G1EOinN-WlmMO9xCgxrDoSaPdwGifpxSaibtqbLGIrHc4ZOncwqZPUjXUTSQ",
+    "TK2:AgEAACcWAANo53gAaOeUIHd3d3d3dwAGBLHewBGuNudAu5-FG880Kvhdhhjl4ivvM65D9oBwyqwPeoP_rZ9NIVSbfK8ZxWvLWHHKItFkA7ln3N4aBeasxA",
+    "TK2:AgEAACcXAANo53gAaOeUIHd3d3d3dwAH8h7qLeqcH4PylsDO0aZG2wzZTfKIC1BOoSkYdIT91VMHcb7F2zMOypB-cTzfqKBAXwvN0rQs1zjZF3f1VcG_Dg",
+    "TK2:AgEAACcYAANo53gAaOeUIHd3d3d3dwAIlSGYwfXkh4zfuzrxMrdrh1t6TVvN7VWFeCJoUfSTfRxWYMaSGqo51KMg4A4FLPswLi6aQkJSqEeXTfWxaDW1iw",
+    "TK2:AgEAACcZAANo53gAaOeUIHd3d3d3dwAJRNJk4TMw_E_mgRXQE_oBePIjjO-MnERp9ytpcW_qjm458hbiL3TxNitrDkHPN5wf6hViwtCNNRLjHLDoeXVd_g",
+    "TK2:AgEAACcaAANo53gAaOeUIHd3d3d3dwAKaaoJBig5WDOGNf4alrVmy79I3e3LiMyfu9riho8ozbq3GZMoMA-2EAtiQHgx2fhI644fUpqqrguaOnEmOlWrvA",
+    "TK2:AgEAACcbAANo53gAaOeUIHd3d3d3dwALR82SMJ8emWIFTtumqXitx6TiTRdhV-481YpLlTRx8a0eaacJbmC7xa7AB8CTayIDvUz-0zi_xO9MSHe1xj74lg",
+    "TK2:AgEAACccAANo53gAaOeUIHd3d3d3dwAMeYf64fT8iFc1mM4A5EKZbZ_giCdpXtzEQpA6sPVfqdEweGqcQyDzvl1B_FSNY3UpdfmvpMSolnpQjt2VXuJQJA",
+    "TK2:AgEAACcdAANo53gAaOeUIHd3d3d3dwANRYZPf2DF2zhTW94_BJ2wcqhlL3UrvcuP5zXnfg5nEH1Qit4MMYNWzzfWResxdH10zPpVI4tjxsBz9UGbYVDwfg",
+    "TK2:AgEAACceAANo53gAaOeUIHd3d3d3dwAOuZInpt0zwM4Am7OJouncLL7j-Fnrkvnc5oUGtUSLkUMlClGBB1MNFT4d-7i7opGnu5qMjgHEOqZdLldXa88eSg",
+    "TK2:AgEAACcfAANo53gAaOeUIHd3d3d3dwAPq8_5vQtAntfKW00hxiHXWTHCqI4-zMH0uPXS8oy13x2OvX9Vl2GOTruGYJe1ZctPy_cMFjDufa12aDYl5_2vCw",
+    "TK2:AgEAACcgAANo53gAaOeUIHd3d3d3dwAQZzSDixY1ZGtRwfLQeY2o5QaNdltQ3j93U7erYjyDcn1MqX6MtWzwIrH9K2qeRrOspWxqDYm4W8faReVh5Hp0iQ",
+    "TK2:AgEAACchAANo53gAaOeUIHd3d3d3dwARQC1ZgS1tNnA-zyiAUyetuPCY3ta1lr_UWftBUHprSEQ0TZNO4KO7FfZRZ_KDMWJbieSY3Yxi6rVv7oYIiRDfLA",
+    "TK2:AgEAACciAANo53gAaOeUIHd3d3d3dwASva9vPlTXrN68bYhrWd59Pmr8OfcYaFAb2xcKrlivkiWcoTvms8_7uA9R6Q4VKnP9moQb0p4UHP2DF9Reh8U2_w",
+    "TK2:AgEAACcjAANo53gAaOeUIHd3d3d3dwATpqdlAGZz1RPsaeufIt9PuBFHzvV747p0tmDNuYrZpGjPeKp_aLq8npv9Ys7UM5poWSmFaCSmagiPN5SZSfv0bA",
+    "TK2:AgEAACckAANo53gAaOeUIHd3d3d3dwAUUT-rvh07DgpvnnRs8kGdcnjENj7dMmnlXf3-VCK981PckaIr0uGaEoiCK2nM60gXaS8Tlijg8G_UYt1fajKrXA",
+    "TK2:AgEAACclAANo53gAaOeUIHd3d3d3dwAVcjSG5cZ6Teo7e0BBwupMJ-hOIFLIJ7-q30sAtLrZ7_-2URc6fXkyGcHozPpCG8U400NqrvztarD0ZFk3ag74PQ",
+    "TK2:AgEAACcmAANo53gAaOeUIHd3d3d3dwAW60s18cir1iJbwojZaLyr8gyHzNhg8VK-RirngVv4Ml0HZfK60bUZkKbjlTf7lvLKIoOLlp2lwypEDfXZwO4LvQ",
+    "TK2:AgEAACcnAANo53gAaOeUIHd3d3d3dwAXFT9-A67JCmCCVhywQUMHOie2xER4bKXXqqXiSg2sImcB6dXfV_23QZ7jlyEeRJjjfogHfZcxECl1420U4BT_eg",
+    "TK2:AgEAACcoAANo53gAaOeUIHd3d3d3dwAY7htDt-AbXKvD3T8BecuXj64s-8Fx3gU7NNcuh8V2MygOWYrydQVC8ftVtUYnOHocKif1H3Ix2KC6NV8NrX95dw",
+    "TK2:AgEAACcpAANo53gAaOeUIHd3d3d3dwAZECB-EW_FGh-wZCqVHsd1Jq0GwSPBiaU1RL0I3tozO5Sw506x4uAjx1HEGiyMn6g93SVLtVDbN9RNppFKdSjw_g",
+    "TK2:AgEAACcqAANo53gAaOeUIHd3d3d3dwAaj6bEq8hwEHHt6uV-li8-SXVEgRClDWPCUAD8gcCIRLOjT7VTACpHKeqUO8rJyd9lwtE10Zw7qZ-o-jOmTWYeLA",
+    "TK2:AgEAACcrAANo53gAaOeUIHd3d3d3dwAbFlI3njsTSfWpM5r-sNAI0NPS1RpzWDd4UOlYq58ZgPrSpqHTs2UrUnbchPqo7m8LS_ccBCugR-RhIv-rSMFv0A",
+    "TK2:AgEAACcsAANo53gAaOeUIHd3d3d3dwAcLS60wRIYCqkljoby6Bh-lnhGDOK-8_EOo2Iyd-Ot0LLZd8lxOM9AOZnvApzNDPbjqrjjxkRMyftdMHtPWtPpgA",
+    "TK2:AgEAACctAANo53gAaOeUIHd3d3d3dwAdHTzDd_qx5vO5y5kg3uNdwN190Dvhji3rmFGp8iJinLQmH5IIhVffl8T1Asz1M9I8ucx87xMaMpPrmKdTxFpsJg",
+    "TK2:AgEAACcuAANo53gAaOeUIHd3d3d3dwAefPPU2lAkr-w6CZgg-RU7i7yRcjZCacQS6kj_NyzLOIwxsq_hftVabgI2J8FuK4ILvZu7_t-n_LmJMz1XDeR0sQ",
+    "TK2:AgEAACcvAANo53gAaOeUIHd3d3d3dwAffiMVwyJJJv7ddFN3jkm0e4Ot7KHMwVOfT6UDGrmqitIkuuy4OlY3G9jKvWTcUMO15QNMfMAsHxxPG1q2sUpdCA",
+    "TK2:AgEAACcwAANo53gAaOeUIHd3d3d3dwAgnIQnVTuiw8AEzXTxbZLt4EOtlqN10jZUH7sHwBksQ6ub923H39KN-hJRrP9qFfYIAr98ZRw_FSO1JEJaD98ZxQ",
+    "TK2:AgEAACcxAANo53gAaOeUIHd3d3d3dwAhmgAu5QqgJm5tSEWzNd6QnT5Qjb61VNsKaGINr7nBMPOOsS91QtmWZmhQ6jK8Y4WnSQD5rNxDnELsG4X8EdAF5A",
+    "TK2:AgEAACcyAANo53gAaOeUIHd3d3d3dwAieIVQ0t6lkcCVvUDwFRt7dkacFNqTFY8CDp_HeDsNbJsrfsex3atxKCKP3i-Q185GlBGrCkuuXFgoIlN-PggvCA",
+    "TK2:AgEAACczAANo53gAaOeUIHd3d3d3dwAjFtPlObBaTipagULQ1wc7FPbneDgcN7pPZpEtYGD9OueWrUrqD6fERBVC_AHHN788PpSwBPH5xL-5WMqRfIv6bA",
+    "TK2:AgEAACc0AANo53gAaOeUIHd3d3d3dwAk4sISax_n-f8x-WdQtKP2T9iPLMdCZDIv8jMOyRVmiCxO_SCmLz_At-m6ASlHgJmU1mlq7KEwMh7RW8tQ3gRlJQ",
+    "TK2:AgEAACc1AANo53gAaOeUIHd3d3d3dwAlEkT0hpfYtYYkktH1idis58iX3bh0kMZSo8HDqwFzsmwst-PO1FT5ivRRfTVyFT_j6B01smrw5kDgbh-Isa_4vg",
+    "TK2:AgEAACc2AANo53gAaOeUIHd3d3d3dwAm5BJcEeFjuT-JrflCyB2zFEhTr8yjV5EV670CuADzokLc7zH84Jw7BauiC260IGCnctefKSrPQF8W1sQAX8_9Zg",
+    "TK2:AgEAACc3AANo53gAaOeUIHd3d3d3dwAnh0I_5C5e6ugCJYrjArau3m0X_xsfaw9ACNMkr0PXPG5HHjVQ0cjK6wTU3iuLGg3n6fuioPK-WcgQOAJlwnxPUw",
+    "TK2:AgEAACc4AANo53gAaOeUIHd3d3d3dwAov5Cni-0iU1g41Xz-IU8mgGVnGkR6Hkxhp0a3SN_EUd9Sp3jMoHL-0zWQnz0tzufZZXQG7rbDwmb9GeNXSjT5Rw",
+    "TK2:AgEAACc5AANo53gAaOeUIHd3d3d3dwApLFOoNDjYMMRArsBfQP99oov_fH1wYFKao0BWL1MVrS42_Weo4-3AC9yLHOfA3d5aKLZMR8LRZ67f49JVudwKtA",
+    "TK2:AgEAACc6AANo53gAaOeUIHd3d3d3dwAqi-FxepSEPOFmW569OpuM4CQcGWMIdO4EQDuL0dtwEdMt0ne7w1fYiyBKyjDANEdfsfgPUpfVpbIzjNqMMb5nBw",
+    "TK2:AgEAACc7AANo53gAaOeUIHd3d3d3dwAriDJDUfvvFkT0ctIUOk_pTEEYBgsRF-zpzfVaxlUCLN36AVV_SA5ixp8x3qeYutYYWkyxnn5mG6h2TSjdtgCSig",
+    "TK2:AgEAACc8AANo53gAaOeUIHd3d3d3dwAsp0ot3cxU6WBbQ3DU3aw48PgdC1lywnkunovN5273PJdtbr6LX3IicQuTa2XLihNYIGOBLnGGp_2fKdu6AgR2Ww",
+    "TK2:AgEAACc9AANo53gAaOeUIHd3d3d3dwAtvaoUheiiegcr3e0c-9FdG7q5QurXiCWqSQYKutxd-bCfj64g_jXiOaV3wqJGJ2O9qDybF8o7pHIbcLGrxjHkAg",
+    "TK2:AgEAACc-AANo53gAaOeUIHd3d3d3dwAuT_UieNA6NyhXVec-udbpfdQuQWa0fUWpM8fc6qzw2e6Xb3SGRTvJMqc3VzJLFiT7LyeKbM8ikLpF1SfV8-wuZQ",
+    "TK2:AgEAACc_AANo53gAaOeUIHd3d3d3dwAvJrNXSpRUXb8N0YyeDyhA0-gwazXMys_c7k14iIkYw6uDOGYoqJAFvp6pzDlzPmOVeAYpkVVJ2RovJNwn3QNLnA",
+    "TK2:AgEAACdAAANo53gAaOeUIHd3d3d3dwAwfWJ5r7btQK2aTj5vlGWcoj9AzwIfMoUnPfWRGdq7_5Xh7ht2qatep_TnPze7KhMLr9EtG5XpEXF_JEsq35JZUg",
+    "TK2:AgEAACdBAANo53gAaOeUIHd3d3d3dwAxI9PFRbqdHlYFKM8s8gqnesNyLetcBcZlAlEIXFlUaJQKD9aqtDClZ1f5em2HLjIdSam3wnF5V5J86Wtfec0zYg",
+    "TK2:AgEAACdCAANo53gAaOeUIHd3d3d3dwAyaBpi3WffcXGaFmbq5_iZOz3uhBJHnbPyBpvnXXml43l8prMeEt__Mv1YOCwJF7M62mImWge88u1db3wXcZ8Iqw",
+    "TK2:AgEAACdDAANo53gAaOeUIHd3d3d3dwAzoJwsdL6za7-RqYLIn_RvDC6y-hf4_imNnKYANEvaM_oIR541w2AIaE96DWcZWPT2fNi1nIY4njdijf5L-ghpEQ",
+    "TK2:AgEAACdEAANo53gAaOeUIHd3d3d3dwA0sKnDtBSu_lc6dNwLi7ORz14S6b2P0kdH_DdWqSWnzINemVOxS91O4ETzaxa4Q4KyNJTCOnpMomhW4rwzO1gc9A",
+    "TK2:AgEAACdFAANo53gAaOeUIHd3d3d3dwA1OBolLS8m62SKKJ31bibRn6MhtsWU-9CTUYtwOwkyHVzmUwaCyS1Q7aC3cNX47wGxDmekmc8MAVAttLyBqsabYw",
+    "TK2:AgEAACdGAANo53gAaOeUIHd3d3d3dwA2XzFTDA73mRrNkJQ6Q7-sjZJuzaw8-mlNBwqDeplS4VROlq55JSs6ABahFrxY23pVyXIL2TDMKdU_ObtC7ll4hQ",
+    "TK2:AgEAACdHAANo53gAaOeUIHd3d3d3dwA3Hg-54HJOS0MwTWEzyXduW2TVS3IFnTxKgvJShJML7ntAlk83I0pnaM3nKKGZr2LOnN5j0C3qOUUcdVJGVLkQpQ",
+    "TK2:AgEAACdIAANo53gAaOeUIHd3d3d3dwA4YErtuHPw0ywKhq0wiKPo3qgGkkgyhGEUOCMsW1Vw1tnxh3NAMS0OvcVBeUlAyiiLy9nIqshrx741IwLeBjTPHQ",
+    "TK2:AgEAACdJAANo53gAaOeUIHd3d3d3dwA5uGlGMXuoqsx4oIAowrf_kXb-XKfOV_7k-VJ1l7TnlxqNu041rOArksDNeOzGJSx6KQsERCleabA_p2Hbgc3Djg",
+    "TK2:AgEAACdKAANo53gAaOeUIHd3d3d3dwA6lRxIe_kLLA8Kr2tyE4RApzaugBeIJBXkurAfJ8IJhI6ufkS0w5kyU-Gkr1XFH5M8usGUIq2YIyFt0WEAXhqzGw",
+    "TK2:AgEAACdLAANo53gAaOeUIHd3d3d3dwA7bWu2cd09cbaVu2THCVdFDNY4lcvd7Ct0FgDuhybUJMW6gy__KuUFsbAy2yuZPBO-Jl2CrL3DZ2eeoP1hKjcPRQ",
+    "TK2:AgEAACdMAANo53gAaOeUIHd3d3d3dwA8x7EH2dh1yfwFCNkjuAskxuDIHMQXiXKq0bine36UbZQzppguOSO9zritkdyFxhkbaRooH1xan54epX1Pzt16_Q",
+    "TK2:AgEAACdNAANo53gAaOeUIHd3d3d3dwA9dBaAZrQAdsJZI6bhxJ3h6O1c13Ahr-64aPj012pMTMU4iucQLRl13zGP1po_Qe5ZtbjlMLMq8YWh-0WQfbOIBQ",
+    "TK2:AgEAACdOAANo53gAaOeUIHd3d3d3dwA-uHHuN-TrCDxfYGSngKHbsXC6GPkvwdG1_lnGH1PGjN41vAiNs3klD6-pbYIbspnAMUdDPWliQGm3LYsf34qtcA",
+    "TK2:AgEAACdPAANo53gAaOeUIHd3d3d3dwA_F0LK_EymvvFPfFozGsqEBqYVcKxUiwy4ci2RHNryzFnyiH0n4MqhTLx8JYY2-ilMAkKQcqAOz7B8dUmNjJwRAw",
+    "TK2:AgEAACdQAANo53gAaOeUIHd3d3d3dwBAjggd59fKcbhv8bTov4q-nWi8xTC_8gzNe8XqbQz9hK4lQ9ikqoj793uHpcsXXm1BMsoG2c3G6oZN2uTtLQkKIQ",
+    "TK2:AgEAACdRAANo53gAaOeUIHd3d3d3dwBB7OUWQK79Jh03vT1J50v4n1AAV6-ID0-0GPJnt6oKG4_UBsCKh3N9elTB2XRWxWJBsg0u_k_uf__UjVgljJwwug",
+    "TK2:AgEAACdSAANo53gAaOeUIHd3d3d3dwBCQmdMoIYurZmzxvERV7UltNJEoH3o8VSoa_eM-qMQlCChznpShp7sirBUoVb432QvYc_bmKfgf_nyeT_vIJDVEg",
+    "TK2:AgEAACdTAANo53gAaOeUIHd3d3d3dwBD4hi8dVZQqa4ABrzo68Bec5C8yj05TRJvteT-g_FUBs-6-DmNTU7P6xGTIzJCxwTF0TzYcwEPWKWWsyS5AKfNeg",
+    "TK2:AgEAACdUAANo53gAaOeUIHd3d3d3dwBEd9C5UrBveDFadGn-2OfaoIiYbvKd1j1Kv4EFW5YsbNe6ZlwQt9n8vW0F0fiJQS3VASOYGkrAz5maka15jHpxEA",
+    "TK2:AgEAACdVAANo53gAaOeUIHd3d3d3dwBFSSY0LPEvDs5CFLAXBYnXqDO0pFqU6t8BGAMzF249CayRADiq73iGr5kMcxW1GtOI5xviq5ZQAWtv_DEWHLBLLA",
+    "TK2:AgEAACdWAANo53gAaOeUIHd3d3d3dwBGEYIR6uo_ZAZfMcpAhCch81Y6hpvFnxY5oFSqhHFFTBwR3v3MXUnFxgLUq4lHsj-JhIPOzFGDSKKectti1-eiMQ",
+    "TK2:AgEAACdXAANo53gAaOeUIHd3d3d3dwBHfEZLGwVJiwFa0YFaVRt9Q8-MNJ4jKOuPvI-qauM9l-kt7RqpmPktVhIhRsTh0MfklS63o8Dda6IvVnY4hHF9QA",
+    "TK2:AgEAACdYAANo53gAaOeUIHd3d3d3dwBIqk0cbsCXXaNE1LGm4cxtochTiMlFwfYBQnqWsRibQIJnpfexMbVjB8MRY_VJpucL0x6kIH-0pel7J59Rf4onyQ",
+    "TK2:AgEAACdZAANo53gAaOeUIHd3d3d3dwBJfBBAra_ilfo40_QMWLgj2wAVLbEHbzwGP7N3Ga_r7yLortteqwH8cxkCUUpJsmamzlh32HqDwpbRGc2C0Fxv1Q",
+    "TK2:AgEAACdaAANo53gAaOeUIHd3d3d3dwBKmatM_pRc44U6UAUscrBNcxITPmYtq-AfDbMP11hJpceQqcJ5KjqEqKZ_8mzf-TwWkIZWNH9zlVbpw9KriDbSoA",
+    "TK2:AgEAACdbAANo53gAaOeUIHd3d3d3dwBLZefQRQ1jWaIehDeB70SB74r8yjUyCaqaKWvvNz3OuWxgOROGVZVI9BKgCvRlYF-eSJ6oTbr5GjUew8wfOcTUow",
+    "TK2:AgEAACdcAANo53gAaOeUIHd3d3d3dwBMWfZv__W9FAkJh4-I0h7Te1KRXNDFs7HnMkQWqO3k8gig8yDkZ_NXrZ93Y0DfeETU419V_37kHjoHQR5bws9wzg",
+    "TK2:AgEAACddAANo53gAaOeUIHd3d3d3dwBN4dvg6bzJjkIxyTeOGe1c-MPlj77IUwIJAEzTbXFJvM8cMCqSXn-cL5RFdk1kHZixRqvBsfCdAYW-upSEQ3kAww",
+    "TK2:AgEAACdeAANo53gAaOeUIHd3d3d3dwBOXSfW83KaU4Lbn2YIa2kxTDlMRgC3_Zpfjb-3-yrxPBD8fG5OZE1WD5M-l-Xu1L9wmwLtXZP8YClbAeXKb1aECA",
+    "TK2:AgEAACdfAANo53gAaOeUIHd3d3d3dwBP7lM-8qI3xOkEKjL2vh-wzDvj2h54Rk-VLtpRTCz-gy6EEj6MDDYs3tOpI6cpn8AMWr67HDoGYhSx_cYFXJDDBA",
+    "TK2:AgEAACdgAANo53gAaOeUIHd3d3d3dwBQTjgRM6cyhcqIeTaHSaRhqdx6t908NNbl2ha5lAO0WWgnie1NrHcM0rurV7-xIMJqv6jA59P08e8HdmvpzcVXcw",
+    "TK2:AgEAACdhAANo53gAaOeUIHd3d3d3dwBRWGzWLMeH1UoASF9HGT2FuCA-K9l3HrwYDbz6LlsKGzD5P71Ovp6GTh0zeBQDdSuAU6mdWlTfQ70H-cQ9kH5Dfw",
+    "TK2:AgEAACdiAANo53gAaOeUIHd3d3d3dwBSyOQN1gr9bLTrAnnk_feMCY9gnIxw8z94N7uZy7aZlm7lbpaQgRbszoQtzFyJGoDa5Y2IaDsSRqoepUJryOKZ-A",
+    "TK2:AgEAACdjAANo53gAaOeUIHd3d3d3dwBTa2cb4q1D9IF02PDKVge8CiQC4KjcKLj0vRX9ZnnNfuydGpExSI06yUTWeyvK-t4sGyhGM5QgKGwMPF106nKIDg",
+    "TK2:AgEAACdkAANo53gAaOeUIHd3d3d3dwBUkq8T8M-OVTHwwFy298Vo2RUtnT5j1Kv4CnuyvGqcGu3L-sEdxFBl841kNaq1OlpRrN7PFRC0YjtcSxJVE2jr4w",
+    "TK2:AgEAACdlAANo53gAaOeUIHd3d3d3dwBVAEoaS4GQlr7ITmbeCuPvwM5gf926m5Q4pd0feSYshduRRXQTnG1qYToGzVcTFAcNbFFD0BQf-g4PK8zkEUDatg",
+    "TK2:AgEAACdmAANo53gAaOeUIHd3d3d3dwBWBH_AjxZPhHwvd3IFP9JWr9txQxpj-lMX6Hmvfgmi1lwnJQtjQ1wPGCo5VZZVG-gIUg06Pmqsdd3-Qrmiou7gIQ",
+    "TK2:AgEAACdnAANo53gAaOeUIHd3d3d3dwBXzoaVe44K-K_yKxAE5QtnqJhmQlNirX6W2pAcNFE72GQrNmCuQ5p3dhEsZ_hfyPFbTEDDD1a5__oR77dzdceNQg",
+    "TK2:AgEAACdoAANo53gAaOeUIHd3d3d3dwBYdlhw-LnH-GHwNHOjQ-Xc5zQligCdA8ih8PZlLtNw5kdk2rV3MZwkJw6581XSdGsOSYb0XZLZoWrIsea2SLJjCA",
+    "TK2:AgEAACdpAANo53gAaOeUIHd3d3d3dwBZqtNZSpHFJal_yKm14ksSGXoHpTMoEiWjbiJOotsV9VT5N64uzoq4HqQg0qVCo7_7raPFHvyIUhcGGVaQ1Izvsg",
+    "TK2:AgEAACdqAANo53gAaOeUIHd3d3d3dwBaYg4cNpsN2bixcYrnvlU6bPc_Oz-YoP8Ldmn3B8sUjPIkulkVMd6dNr3g2BRIiah4hEqQgq2-fBu8Fu2qktkS5g",
+    "TK2:AgEAACdrAANo53gAaOeUIHd3d3d3dwBbWO9GTyePdMpYO_XosRR80OnDj_xVTXkKlyufPe-SfzjwDgELZMj4yUSCZfVEdQ0nbo2iWOxhdzReivNUNJuMMw",
+    "TK2:AgEAACdsAANo53gAaOeUIHd3d3d3dwBcvuyghQMjaTc3HzJC2HDCrWQ_jS9gBQJuLV34m182E-gWY--HB-RSgLt5awI4PG3pQtBXfurC_-Pb6o1QkXgi5g",
+    "TK2:AgEAACdtAANo53gAaOeUIHd3d3d3dwBd5Jn4-C_kPkjS1mWzxKzPTP-T5iQOTfSpe1i7Z01II9JX1Dg3zbL2QxxvlDQTitr-AUV-RiGu2U1yfZ8Ww0gqHg",
+    "TK2:AgEAACduAANo53gAaOeUIHd3d3d3dwBeJy05QJptLXWc8Dg7_6DCvfqEHTQE6JBadS6Rxuzrjh1t9tbvVZFPuNM9ag1KhcA2QOms-ziim330b0MIUuM19g",
+    "TK2:AgEAACdvAANo53gAaOeUIHd3d3d3dwBforUNeNySBZKqcwfxXxFypXB6jiQZzkE7PXZdnX6O9GoeSfVEpziK9Hvao1DM2-p8HVfXXA8c33IvLyiQ-sUB6w",
+    "TK2:AgEAACdwAANo53gAaOeUIHd3d3d3dwBg4JMb8RHG-LN7TkeGhAQUoLN6FLmVt2yt0-fdVcj3yxoS98YwGko0lJguFtK63n5JM-L1nNByksY8XaldjXlhWg",
+    "TK2:AgEAACdxAANo53gAaOeUIHd3d3d3dwBh8ktuKmb75F4aPPsFI2uCkIVkyp2TY-qsqQDsE-r6ctRs2RzSC7a6iCd-rKknbhDKr_ObSG-_fRHCHuMFc5U1Ww",
+    "TK2:AgEAACdyAANo53gAaOeUIHd3d3d3dwBiE3lZkYh1Gi0YbQNOF5d2wQYI4N-tOkgLODB9pAPfWib0UazoKC_ZSatmufrVzHXvSAulw1Pr3vlsS8Fcnt7uRw",
+    "TK2:AgEAACdzAANo53gAaOeUIHd3d3d3dwBj3M19J3lj2OoMEF2TdJ-R_UKfgcvw1e2jM2nApIT5Wi3gHwUs0Ap3HCioQ7dvG0WCKGNnl0WyuI67neTO9EQUcQ",
+    "TK2:AgEAACd0AANo53gAaOeUIHd3d3d3dwBk6kmsTmx_cxM3F2N36auP81XLY1btYuDCAJuglrycxgvYZA-PLviW-w7pLafURhjl7n3cmPbg6ABtTxsufJBtiQ",
+    "TK2:AgEAACd1AANo53gAaOeUIHd3d3d3dwBlwGDNVrk083S5_GZhTKwWKVNJEA89N_-yBpEa6NDUQO0X_aKyYCoHlRtSAke212y1R3Zjei2-3fQWNqJoYhqGlw",
+    "TK2:AgEAACd2AANo53gAaOeUIHd3d3d3dwBm9_PJaoouN4LY4RSBVq-wggYQtX6vY6gYbDgol7aqBGnnpQb-ph7RB54xViOo4zCXKq2u6NKfdqBRxcvMSZHnGg",
+    "TK2:AgEAACd3AANo53gAaOeUIHd3d3d3dwBnQuw5BHdRVGNLy55mxP6pw-hJYPA5U5LD7IyhOGAJKmj1xaH7jEn4NiKwa8HGxMXJ8GE2Vj59iJRsxNSWIh9UDw",
+    "TK2:AgEAACd4AANo53gAaOeUIHd3d3d3dwBo0ZSYmdi28rfn9bXjU5CKTV6B7H09cHtAS90UNrybEL1wjPrx1NSiRNEHhutlqODnKLCdK1BNF_yJsBOJXpe4qQ",
+    "TK2:AgEAACd5AANo53gAaOeUIHd3d3d3dwBpAkJ7PaaCOxQAQoDE9erIteKBW1uwfeQRs7u7Q88-STfhE0aNJoUaOgqq8vwOky_9Zqga2bGgmvhWgMyJnj-k7A",
+    "TK2:AgEAACd6AANo53gAaOeUIHd3d3d3dwBqKbBZqWAutLQHfzXyoDesO93F1Siwb27tLII442FkhfwX2Nb97NH71azswUu7cIUbO7URZ6REGGAJxVOKSvY6VA",
+    "TK2:AgEAACd7AANo53gAaOeUIHd3d3d3dwBrwtbC3sAAWh9FOfBPF8fMSF6p24bkkUFNVxPmyHujHRRjYRcFSH6n8JUYiYgOmmCcEsrYB06OR2R6dwyVJri8mA",
+    "TK2:AgEAACd8AANo53gAaOeUIHd3d3d3dwBsVhtzv-Tch43IUMerLVT5tZSGfJKQC8pVB8_cTV7ZPy78QQgzZvs9bGl4tDuYVQnA8YuMejM_BQRaC7CF3dN8Mw",
+    "TK2:AgEAACd9AANo53gAaOeUIHd3d3d3dwBtrl-WUHFzPY1hjF9OFkbDBivAWi6WOwT-How5J8S9-TaiLArVRYTORV6TNHBy7rkS4GVlc4vS4XCieygVoDKjTA",
+    "TK2:AgEAACd-AANo53gAaOeUIHd3d3d3dwBu_aMwNRaGziH2bzAKKXCzvIwgFTpbnN_xQlo5H_hY9pJ_LoRdqTfWtW8-Md5Dp7wm3r2BES4wMXuHzYYc_W7bTQ",
+    "TK2:AgEAACd_AANo53gAaOeUIHd3d3d3dwBvkmXMQJe1uvvg2BNOVn3gpmC291CaadXEdub6lVzkMHEV7ZuYTMZfqPXUZJiH9i4TRs4pVOHDyru68tzL8kK-Hw",
+    "TK2:AgEAACeAAANo53gAaOeUIHd3d3d3dwBwIuwX8YddiT83W64f7YRhlpHztlvO6TGn8qkBNEwoH6gh1ZfqXN-vHdtJ6f_8SssPw2dtsZJLwF4wvNDsheSE4w",
+    "TK2:AgEAACeBAANo53gAaOeUIHd3d3d3dwBxN3Rm-bpXJek9aWitqTsLHDbkI58tQ_B0z0FUsyeMAbpJb7jebIScwknSNrA27JvcUbO_A41yCpD6-bUxLi19Sg",
+    "TK2:AgEAACeCAANo53gAaOeUIHd3d3d3dwBy8J_Kei1TRW7U6CQq7xYeGMpTQqlx9Mnii1kVS80Yyr8ojsJyMfq3jC_OYIHRSNZqbmrL0vWrOIRuAFOrEXrNWQ",
+    "TK2:AgEAACeDAANo53gAaOeUIHd3d3d3dwBzhaFntx53IY-lsGwpzTu0ZOeyKmMHSyH3_ApbNhD1Lu5277sIg_QOH90jNBnxDIyx-D_BwJFT7tWaxkVqbxt2Hg",
+    "TK2:AgEAACeEAANo53gAaOeUIHd3d3d3dwB0ee2B1caVAyfnZzL9KK40WRZOC0whionrryPmK_oVAWVMMXRF2MbD9VEqbZQX9pqeCpFmOJsLFg3RgHZJQnGpyA",
+    "TK2:AgEAACeFAANo53gAaOeUIHd3d3d3dwB12Ho0QC2nDZTONtPvhsNh1ieFFgJozqyjd_LbVZeyn7zUB2pBEKFrJFTY-hkVp9xP7fkC0mGj5BAnkciREZKLiw",
+    "TK2:AgEAACeGAANo53gAaOeUIHd3d3d3dwB2jTk1xt1vHEYH5qAOwHQuDeU44zpNdB-ivkTiwAAw_94lwPHSEuDPPW-zEAfmky640IV2aLFHZ97ivlLfFSxs2w",
+    "TK2:AgEAACeHAANo53gAaOeUIHd3d3d3dwB3c0A26rYnsIg5UUrDg0rEj5Iwg_eG-bsl1B65X6fHMYHlxuUyZY9JU8kMBGltAjXAGASW4rGsWaXt7EXqJrX1oQ",
+    "TK2:AgEAACeIAANo53gAaOeUIHd3d3d3dwB4B1HysKfAnrh249SVcqTD_2PlCfTZo5sW9EumwmprdYJ3O0v_wHTw3b2ubohxafIDlI8lL-0SRn9J4q4XCEtt-A",
+    "TK2:AgEAACeJAANo53gAaOeUIHd3d3d3dwB59d57_RfVaDRDukWOEmGPWRs5KslHr84XEyB1jvFBfHd4ICH3hkWPbiWtTvs-Qh0EHVn_BMPqbwCwwvq0eC8MJA",
+    "TK2:AgEAACeKAANo53gAaOeUIHd3d3d3dwB67AAj6cY-TMCKnQ2kCU0S-vvaSgXmYqBJz6LXr340dzu-KWtApJV9aXgU0OeDkAyflmVl3AsArhvOcYIcXSgobQ",
+    "TK2:AgEAACeLAANo53gAaOeUIHd3d3d3dwB7QhJxj6N1xugzvXyiNNG9BlvTqw3c696SpM9RCGsrHU1YwsM2ePntX4As72Mjy6D3B0usV9k1rCgGN7yQ0IiceA",
+    "TK2:AgEAACeMAANo53gAaOeUIHd3d3d3dwB8zomSj3IgkgSrwaEpzOVrzHQ2ddBIqGFwSs1pier0W1ffI8ZSMovkJVb4fGAO0S-BPWlX9vA_DizyAc7Cf9UexQ",
+    "TK2:AgEAACeNAANo53gAaOeUIHd3d3d3dwB9a-lBWg3DmllmqI2ZGEwMhou3jk9fbEmI24ZsmihiQW2tR3d8B28MdSeZXPpea1O39N9bChUaVQ4GXKPkvLyvgg",
+    "TK2:AgEAACeOAANo53gAaOeUIHd3d3d3dwB-4N_ZzJi-Y9EWOR_cggO34n5BF1GsABITaWn5KUqgKIffUpqu3CXcdeGaqhHEnX9Wf8ugPCsna_GadEBBlWWVyQ",
+    "TK2:AgEAACePAANo53gAaOeUIHd3d3d3dwB_b-sxOH6UfPDf2TP5ErOSf5UNo2Nf2ahKHZTCB3jKgBEQ3oFvxpQSxlts561dM_p1NY1hyr3itdnKkNC3rvPqjw",
+    "TK2:AgEAACeQAANo53gAaOeUIHd3d3d3dwCAxeScCbSfC4s8531J9JjJ9VitR8wO4q3pjkqjWHNKmAv9Fmq4sDNNA4IYohY3gpY_phydJ4kKPdDF8RskstewbQ",
+    "TK2:AgEAACeRAANo53gAaOeUIHd3d3d3dwCBQ4elM6MVz_Cn9Vtt-5dfyzjKx4sbnjgtTd-m8rpJm_ALCpcb7kh0qr_Axnl24X1rHDvWLplC8axqc_6z4svoqg",
+    "TK2:AgEAACeSAANo53gAaOeUIHd3d3d3dwCCblAus4YTVi_wxXIV-KBgP_OoEyhWRAhHXnRYqS53qdjUNGHcYleVOl-ULeDQf6nevDxwf6JZfzGvsF_2-UBYPQ",
+    "TK2:AgEAACeTAANo53gAaOeUIHd3d3d3dwCDrVA-MG_TWa5W8kMF4DmqAgApFsw7gy8F_AVY0z_dPvv5Chbx90aTXKMv-_xPlGWeUFHWqaRzIwjWnaFq7Zib6Q",
+    "TK2:AgEAACeUAANo53gAaOeUIHd3d3d3dwCEOaKrX_R9kpaHDE_G3u46GZ53IyflqzPbCGsAWgmqdDrziGwaY5NiEQFiVidvCkyIoEgegkX7xAumhaSaU3DWzQ",
+    "TK2:AgEAACeVAANo53gAaOeUIHd3d3d3dwCFdHLka7qMJcjb_KAojR_jzTftmrCX_FuVUF29XnANezQI1XvTFWin0VDGwUL9Wjw_tRDcZBvmg2-nNk583S2d9g",
+    "TK2:AgEAACeWAANo53gAaOeUIHd3d3d3dwCG9BDe_UqIe2dF5NTYw0VMj5AgX6gtmZFkBJThoJ_WWu9BQZk4-BAiipgVQdTXjxD6hY_4QZUtHImaOmRITf6xhg",
+    "TK2:AgEAACeXAANo53gAaOeUIHd3d3d3dwCHLAgjLTDuZsSz1Pi1ONwQAWBH1wAEuW7R30bexkTq2PcWu_wjPgJohQETO9dP8RLsD8XZPZem7VZUzlt21qTLXQ",
+};
+
+// Un día después: la tabla llena ya ha caducado y se recicla
+#define TV_LATER_NOW 1760087000u
+static const char *const TV_LATER = "TK2:AgEAABCSAANo6MmAaOjloJmZmZmZmZmZU883LOiEaQe-D_RjsACSe2aWjLs55EsLqAKTc3I55iO_stPcwQOQ9i_AYpysIjTFZQRWjjDK2cumcUOQ5DtGEg";
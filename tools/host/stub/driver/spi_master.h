@@ -0,0 +1,3 @@
+// spi_master.h (host)
+#pragma once
+#include "../idf_host.h"
@@ -0,0 +1,3 @@
+// uart.h (host)
+#pragma once
+#include "../idf_host.h"
@@ -0,0 +1,3 @@
+// esp_err.h (host)
+#pragma once
+#include "idf_host.h"
@@ -0,0 +1,3 @@
+// esp_partition.h (host)
+#pragma once
+#include "idf_host.h"
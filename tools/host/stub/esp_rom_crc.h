@@ -0,0 +1,3 @@
+// esp_rom_crc.h (host)
+#pragma once
+#include "idf_host.h"
@@ -0,0 +1,3 @@
+// FreeRTOS.h (host)
+#pragma once
+#include "../idf_host.h"
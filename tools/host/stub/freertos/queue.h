@@ -0,0 +1,3 @@
+// queue.h (host)
+#pragma once
+#include "../idf_host.h"
@@ -0,0 +1,3 @@
+// semphr.h (host)
+#pragma once
+#include "../idf_host.h"
@@ -0,0 +1,3 @@
+// gpio_types.h (host)
+#pragma once
+#include "../idf_host.h"
@@ -0,0 +1,248 @@
+// idf_host.c
+//
+// Implementación de host de lo que declara idf_host.h y no es una macro:
+// nombres de error, una NVS en RAM (namespace + clave -> blob), una
+// partición en RAM y el CRC-32 de la ROM.
+
+#include "idf_host.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC:   return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    }
+    return "ESP_ERR_?";
+}
+
+// ================== NVS en RAM ==================
+
+#define NVS_HOST_ENTRIES  512
+#define NVS_HOST_NS_MAX   16
+#define NVS_HOST_VAL_MAX  128
+
+typedef struct {
+    bool    used;
+    char    ns[NVS_HOST_NS_MAX];
+    char    key[16];
+    size_t  len;
+    uint8_t val[NVS_HOST_VAL_MAX];
+} nvs_host_entry_t;
+
+static nvs_host_entry_t s_nvs[NVS_HOST_ENTRIES];
+static char             s_open_ns[8][NVS_HOST_NS_MAX];
+static uint32_t         s_writes;
+
+void nvs_host_reset(void)
+{
+    memset(s_nvs, 0, sizeof(s_nvs));
+    s_writes = 0;
+}
+
+uint32_t nvs_host_writes(void)
+{
+    return s_writes;
+}
+
+static nvs_host_entry_t *find(nvs_handle_t h, const char *key, bool create)
+{
+    const char *ns = s_open_ns[h % 8];
+    nvs_host_entry_t *free_e = NULL;
+
+    for (int i = 0; i < NVS_HOST_ENTRIES; i++) {
+        nvs_host_entry_t *e = &s_nvs[i];
+        if (!e->used) {
+            if (!free_e) free_e = e;
+            continue;
+        }
+        if (strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0) return e;
+    }
+    if (!create || !free_e) return NULL;
+
+    free_e->used = true;
+    strncpy(free_e->ns, ns, sizeof(free_e->ns) - 1);
+    strncpy(free_e->key, key, sizeof(free_e->key) - 1);
+    return free_e;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    // Un handle por namespace distinto (basta para los harnesses)
+    for (nvs_handle_t h = 0; h < 8; h++) {
+        if (s_open_ns[h][0] == '\0') strncpy(s_open_ns[h], ns, NVS_HOST_NS_MAX - 1);
+        if (strcmp(s_open_ns[h], ns) == 0) {
+            *out = h;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    (void)h;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    (void)h;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    nvs_host_entry_t *e = find(h, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (out) {
+        if (*len < e->len) return ESP_ERR_INVALID_SIZE;
+        memcpy(out, e->val, e->len);
+    }
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len)
+{
+    if (len > NVS_HOST_VAL_MAX) return ESP_ERR_INVALID_SIZE;
+    nvs_host_entry_t *e = find(h, key, true);
+    if (!e) return ESP_ERR_NO_MEM;
+    memcpy(e->val, val, len);
+    e->len = len;
+    s_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u64(nvs_handle_t h, const char *key, uint64_t *out)
+{
+    size_t len = sizeof(*out);
+    esp_err_t err = nvs_get_blob(h, key, out, &len);
+    return (err == ESP_OK && len != sizeof(*out)) ? ESP_ERR_NVS_NOT_FOUND : err;
+}
+
+esp_err_t nvs_set_u64(nvs_handle_t h, const char *key, uint64_t val)
+{
+    return nvs_set_blob(h, key, &val, sizeof(val));
+}
+
+// ================== Semáforos ==================
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static int dummy;
+    return &dummy;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait)
+{
+    (void)s;
+    (void)wait;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    (void)s;
+    return pdTRUE;
+}
+
+// ================== Partición en RAM ==================
+
+#define PART_SECTOR 4096u
+
+static esp_partition_t s_part;
+static uint8_t        *s_flash;
+static int             s_mapped;
+
+uint8_t *part_host_init(const char *label, size_t size)
+{
+    free(s_flash);
+    s_flash = malloc(size);
+    if (!s_flash) return NULL;
+    memset(s_flash, 0xff, size);
+    s_part.label = label;
+    s_part.size  = size;
+    s_mapped     = 0;
+    return s_flash;
+}
+
+int part_host_mapped(void)
+{
+    return s_mapped;
+}
+
+const esp_partition_t *esp_partition_find_first(int type, int subtype, const char *label)
+{
+    (void)type;
+    (void)subtype;
+    return (s_flash && strcmp(label, s_part.label) == 0) ? &s_part : NULL;
+}
+
+static bool in_range(const esp_partition_t *p, size_t off, size_t len)
+{
+    return p == &s_part && off <= p->size && len <= p->size - off;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t len)
+{
+    if (!in_range(p, off, len)) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, s_flash + off, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t len)
+{
+    if (!in_range(p, off, len)) return ESP_ERR_INVALID_SIZE;
+    // NOR: sin borrar sólo se pueden bajar bits
+    const uint8_t *b = src;
+    for (size_t i = 0; i < len; i++) s_flash[off + i] &= b[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t len)
+{
+    if (!in_range(p, off, len) || off % PART_SECTOR || len % PART_SECTOR) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(s_flash + off, 0xff, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t off, size_t len,
+                             esp_partition_mmap_memory_t mem, const void **out,
+                             esp_partition_mmap_handle_t *handle)
+{
+    (void)mem;
+    if (!in_range(p, off, len) || len == 0) return ESP_ERR_INVALID_ARG;
+    *out    = s_flash + off;
+    *handle = ++s_mapped;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+    (void)handle;
+    s_mapped--;
+}
+
+// ================== CRC ==================
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
@@ -0,0 +1,122 @@
+// idf_host.h
+#pragma once
+
+// Lo mínimo de ESP-IDF para compilar módulos de main/ en el host (ver
+// ../Makefile). Sólo declara lo que usan los módulos que se enlazan aquí;
+// si un harness nuevo necesita más, añadirlo en este fichero.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// ================== esp_err ==================
+typedef int esp_err_t;
+
+#define ESP_OK                   0
+#define ESP_FAIL                 -1
+#define ESP_ERR_NO_MEM           0x101
+#define ESP_ERR_INVALID_ARG      0x102
+#define ESP_ERR_INVALID_STATE    0x103
+#define ESP_ERR_INVALID_SIZE     0x104
+#define ESP_ERR_NOT_FOUND        0x105
+#define ESP_ERR_NOT_SUPPORTED    0x106
+#define ESP_ERR_TIMEOUT          0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC      0x109
+#define ESP_ERR_INVALID_VERSION  0x10A
+
+const char *esp_err_to_name(esp_err_t err);
+
+// ================== esp_log ==================
+// Silencioso salvo con HOST_LOG=1 (make HOST_LOG=1 ...)
+#if HOST_LOG
+#define HOST_LOGX(lvl, tag, fmt, ...) fprintf(stderr, lvl " (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define HOST_LOGX(lvl, tag, fmt, ...) do { if (0) fprintf(stderr, "%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#endif
+#define ESP_LOGE(tag, fmt, ...) HOST_LOGX("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOGX("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOGX("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOGX("D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOGX("V", tag, fmt, ##__VA_ARGS__)
+
+// ================== FreeRTOS ==================
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void    *QueueHandle_t;
+
+typedef struct { int owner; } portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux)      ((void)(mux))
+#define portEXIT_CRITICAL(mux)       ((void)(mux))
+
+#define pdTRUE            1
+#define pdFALSE           0
+#define portMAX_DELAY     0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// ================== nvs ==================
+// En RAM, ver idf_host.c
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+#define ESP_ERR_NVS_BASE         0x1100
+#define ESP_ERR_NVS_NOT_FOUND    (ESP_ERR_NVS_BASE + 0x02)
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out);
+void      nvs_close(nvs_handle_t h);
+esp_err_t nvs_commit(nvs_handle_t h);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len);
+esp_err_t nvs_get_u64(nvs_handle_t h, const char *key, uint64_t *out);
+esp_err_t nvs_set_u64(nvs_handle_t h, const char *key, uint64_t val);
+
+// Borra la NVS en RAM y cuenta escrituras (para los tests)
+void     nvs_host_reset(void);
+uint32_t nvs_host_writes(void);
+
+// Semáforos: los harnesses son de un solo hilo
+typedef void *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t s);
+
+// ================== esp_partition ==================
+// Una partición en RAM con la semántica de la flash: escribir sólo baja
+// bits y borrar es por sectores de 4 KB (ver idf_host.c)
+typedef struct {
+    const char *label;
+    size_t      size;
+} esp_partition_t;
+
+typedef int esp_partition_mmap_handle_t;
+typedef enum { ESP_PARTITION_MMAP_DATA, ESP_PARTITION_MMAP_INST } esp_partition_mmap_memory_t;
+
+#define ESP_PARTITION_TYPE_DATA     1
+#define ESP_PARTITION_SUBTYPE_ANY   0xff
+
+const esp_partition_t *esp_partition_find_first(int type, int subtype, const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t len);
+esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t off, size_t len,
+                             esp_partition_mmap_memory_t mem, const void **out,
+                             esp_partition_mmap_handle_t *handle);
+void      esp_partition_munmap(esp_partition_mmap_handle_t handle);
+
+// Crea (o recrea borrada) la partición en RAM; NULL antes de llamarla.
+// part_host_mapped() = mmap sin munmap todavía
+uint8_t *part_host_init(const char *label, size_t size);
+int      part_host_mapped(void);
+
+// ================== esp_rom ==================
+// CRC-32 de zlib, como el de la ROM
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+// ================== esp-mqtt ==================
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+typedef struct esp_mqtt_event esp_mqtt_event_t;
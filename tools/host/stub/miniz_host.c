@@ -0,0 +1,7 @@
+// miniz_host.c
+//
+// tinfl de miniz 1.x, el mismo que lleva la ROM del ESP32-S3 (lee por
+// delante y no devuelve la entrada que le sobra). Se compila del miniz.c
+// que indique MINIZ=<dir>, p.ej. el de la release 1.15.
+
+#include "miniz.c"
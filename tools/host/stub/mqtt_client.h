@@ -0,0 +1,3 @@
+// mqtt_client.h (host)
+#pragma once
+#include "idf_host.h"
@@ -0,0 +1,3 @@
+// nvs.h (host)
+#pragma once
+#include "idf_host.h"
@@ -0,0 +1,4 @@
+// rom/miniz.h (host): sólo las declaraciones del miniz.c de $(MINIZ)
+#pragma once
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz.c"
@@ -0,0 +1,160 @@
+// test_cmd_msg.c
+//
+// Camino de un comando JSON de MQTT a gpio_command_task (cmd_msg.c) en el
+// host: se parsea como en MQTT_EVENT_DATA, pasa por una cola de command_t
+// copiados por valor (lo que hace xQueueSend) y el consumidor lo re-parsea
+// y lo libera como handle_command. Los mensajes pasan de 255 bytes, que era
+// lo que cabía antes en command_t.
+//
+//   make -C tools/host test_cmd_msg && tools/host/test_cmd_msg
+
+#include "cmd_msg.h"
+#include "mem_place.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+// ================== Lo que cmd_msg.c pide al resto del firmware ==================
+
+void *mem_cold_calloc(size_t n, size_t size)
+{
+    return calloc(n, size);
+}
+
+// ================== Cola ==================
+
+#define QLEN 4
+
+static command_t s_queue[QLEN];
+static int       s_head, s_tail;
+
+static void queue_send(const command_t *cmd)
+{
+    memcpy(&s_queue[s_head++ % QLEN], cmd, sizeof(*cmd));
+}
+
+static void queue_receive(command_t *cmd)
+{
+    memcpy(cmd, &s_queue[s_tail++ % QLEN], sizeof(*cmd));
+}
+
+// Lo que hace MQTT_EVENT_DATA con un mensaje JSON
+static bool mqtt_data(const char *data, size_t len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) return false;
+
+    command_t cmd;
+    bool ok = cmd_msg_from_json(root, data, len, &cmd);
+    cJSON_Delete(root);
+    if (ok) queue_send(&cmd);
+    return ok;
+}
+
+// ================== Comprobaciones ==================
+
+static void check_write_card(void)
+{
+    char msg[2048];
+    int n = snprintf(msg, sizeof(msg),
+                     "{\"action\":\"writeCard\",\"idPeticion\":\"wc-1\",\"idUser\":\"4711\",\"cards\":[");
+    for (int i = 0; i < 40; i++) {
+        n += snprintf(msg + n, sizeof(msg) - n, "%s\"%08X\"", i ? "," : "", 0xC0DE0000u + i);
+    }
+    n += snprintf(msg + n, sizeof(msg) - n, "]}");
+    CHECK(n > 255);
+
+    CHECK(mqtt_data(msg, (size_t)n));
+
+    command_t cmd;
+    queue_receive(&cmd);
+    CHECK(strcmp(cmd.action, "writeCard") == 0);
+    CHECK(strcmp(cmd.id_peticion, "wc-1") == 0);
+    CHECK(cmd.payload_len == (size_t)n);
+
+    cJSON *root = cmd_msg_parse(&cmd);
+    CHECK(root != NULL);
+    cJSON *cards = cJSON_GetObjectItem(root, "cards");
+    CHECK(cJSON_GetArraySize(cards) == 40);
+    cJSON *last = cJSON_GetArrayItem(cards, 39);
+    CHECK(cJSON_IsString(last) && strcmp(last->valuestring, "C0DE0027") == 0);
+    cJSON *user = cJSON_GetObjectItem(root, "idUser");
+    CHECK(cJSON_IsString(user) && strcmp(user->valuestring, "4711") == 0);
+    cJSON_Delete(root);
+
+    cmd_msg_free(&cmd);
+    CHECK(cmd.payload == NULL && cmd.payload_len == 0);
+}
+
+static void check_set_config(void)
+{
+    // idPeticion más largo que el campo fijo: se recorta ahí, no en el payload
+    char id[64];
+    memset(id, 'x', sizeof(id) - 1);
+    id[sizeof(id) - 1] = '\0';
+
+    char msg[2048];
+    int n = snprintf(msg, sizeof(msg),
+                     "{\"action\":\"setConfig\",\"idPeticion\":\"%s\",\"pin\":\"12\",\"idPista\":3,"
+                     "\"qrZones\":[", id);
+    for (int i = 0; i < 24; i++) {
+        n += snprintf(msg + n, sizeof(msg) - n, "%s{\"zone\":%d,\"lane\":\"IN\"}", i ? "," : "", i);
+    }
+    n += snprintf(msg + n, sizeof(msg) - n, "],\"payloadEnc\":\"cbor\"}");
+    CHECK(n > 255);
+
+    CHECK(mqtt_data(msg, (size_t)n));
+
+    command_t cmd;
+    queue_receive(&cmd);
+    CHECK(strcmp(cmd.action, "setConfig") == 0);
+    CHECK(cmd.pin == 12 && cmd.id_pista == 3);
+    CHECK(strlen(cmd.id_peticion) == sizeof(cmd.id_peticion) - 1);
+
+    cJSON *root = cmd_msg_parse(&cmd);
+    CHECK(root != NULL);
+    cJSON *pid = cJSON_GetObjectItem(root, "idPeticion");
+    CHECK(cJSON_IsString(pid) && strcmp(pid->valuestring, id) == 0);
+    CHECK(cJSON_GetArraySize(cJSON_GetObjectItem(root, "qrZones")) == 24);
+    cJSON *enc = cJSON_GetObjectItem(root, "payloadEnc");
+    CHECK(cJSON_IsString(enc) && strcmp(enc->valuestring, "cbor") == 0);
+    cJSON_Delete(root);
+    cmd_msg_free(&cmd);
+}
+
+static void check_no_payload(void)
+{
+    // Comandos locales y CBOR: sin payload, el consumidor no tiene nada que parsear
+    command_t cmd = {0};
+    strcpy(cmd.action, "openDoor");
+    queue_send(&cmd);
+    queue_receive(&cmd);
+    CHECK(cmd_msg_parse(&cmd) == NULL);
+    cmd_msg_free(&cmd);
+
+    // Sin idPeticion queda "-"
+    const char *msg = "{\"action\":\"status_now\"}";
+    CHECK(mqtt_data(msg, strlen(msg)));
+    queue_receive(&cmd);
+    CHECK(strcmp(cmd.id_peticion, "-") == 0);
+    cmd_msg_free(&cmd);
+}
+
+int main(int argc, char **argv)
+{
+    check_write_card();
+    check_set_config();
+    check_no_payload();
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    return 0;
+}
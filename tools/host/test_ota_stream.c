@@ -0,0 +1,152 @@
+// test_ota_stream.c
+//
+// Decodificador de la imagen OTA (ota_stream.c) en el host contra el tinfl
+// de miniz 1.x, el de la ROM: lee por delante y no devuelve lo que le sobra,
+// así que la cola CRC32/ISIZE del gzip sólo llega entera si no pasa por él.
+// La imagen se comprime con el gzip del sistema, como en el servidor.
+//
+//   make -C tools/host test_ota_stream MINIZ=<dir con miniz.c 1.x>
+//   (cd tools/host && ./test_ota_stream)
+
+#include "ota_stream.h"
+#include "mem_place.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+#define IMG_SZ    (300 * 1024)
+#define IMG_PATH  "ota_img.bin"
+
+static uint8_t *s_img;
+static uint8_t *s_gz;
+static size_t   s_gz_len;
+
+// ================== Lo que ota_stream.c pide al resto del firmware ==================
+
+void *mem_cold_calloc(size_t n, size_t size)
+{
+    return calloc(n, size);
+}
+
+// ================== Imagen ==================
+
+static uint8_t *s_out;
+static size_t   s_out_len;
+
+static esp_err_t sink_write(void *ctx, const uint8_t *data, size_t len)
+{
+    if (s_out_len + len > IMG_SZ) return ESP_ERR_INVALID_SIZE;
+    memcpy(s_out + s_out_len, data, len);
+    s_out_len += len;
+    return ESP_OK;
+}
+
+// Mitad texto repetido, mitad ruido: bloques fijos, dinámicos y referencias lejanas
+static bool build_image(void)
+{
+    s_img = malloc(IMG_SZ);
+    s_out = malloc(IMG_SZ);
+    if (!s_img || !s_out) return false;
+
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < IMG_SZ; i++) {
+        x = x * 1103515245u + 12345u;
+        s_img[i] = (i & 0x4000) ? (uint8_t)(x >> 24) : (uint8_t)"acceso torno QR "[i & 15];
+    }
+    s_img[0] = 0xE9;
+
+    FILE *f = fopen(IMG_PATH, "wb");
+    if (!f || fwrite(s_img, 1, IMG_SZ, f) != IMG_SZ) return false;
+    fclose(f);
+    if (system("gzip -9 -n -f " IMG_PATH) != 0) return false;
+
+    f = fopen(IMG_PATH ".gz", "rb");
+    if (!f) return false;
+    s_gz = malloc(IMG_SZ + 1024);
+    s_gz_len = fread(s_gz, 1, IMG_SZ + 1024, f);
+    fclose(f);
+    remove(IMG_PATH ".gz");
+    return s_gz_len > 18;
+}
+
+// Alimenta data en trozos de chunk bytes (0 = de una vez)
+static esp_err_t run(const uint8_t *data, size_t len, size_t chunk)
+{
+    ota_stream_t s;
+    ota_stream_init(&s, sink_write, NULL);
+    s_out_len = 0;
+
+    esp_err_t err = ESP_OK;
+    for (size_t off = 0; err == ESP_OK && off < len; ) {
+        size_t n = (chunk == 0 || len - off < chunk) ? len - off : chunk;
+        err = ota_stream_feed(&s, data + off, n);
+        off += n;
+    }
+    if (err == ESP_OK) err = ota_stream_finish(&s);
+    ota_stream_free(&s);
+    return err;
+}
+
+// ================== Comprobaciones ==================
+
+static void check_chunks(void)
+{
+    // 1 y 7: la cola llega a trozos; 8 y 9: justo en el borde de la reserva;
+    // 1460 y 4096: lo que entrega esp_http_client
+    static const size_t chunks[] = { 0, 1, 7, 8, 9, 1460, 4096 };
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        esp_err_t err = run(s_gz, s_gz_len, chunks[i]);
+        if (err != ESP_OK) printf("trozos de %zu: %s\n", chunks[i], esp_err_to_name(err));
+        CHECK(err == ESP_OK);
+        CHECK(s_out_len == IMG_SZ && memcmp(s_out, s_img, IMG_SZ) == 0);
+    }
+
+    // Corte justo antes de la cola y en medio de ella
+    CHECK(run(s_gz, s_gz_len - 8, 4096) == ESP_ERR_INVALID_SIZE);
+    CHECK(run(s_gz, s_gz_len - 3, 4096) == ESP_ERR_INVALID_SIZE);
+}
+
+static void check_trailer(void)
+{
+    uint8_t *bad = malloc(s_gz_len);
+    if (!bad) return;
+
+    memcpy(bad, s_gz, s_gz_len);
+    bad[s_gz_len - 8] ^= 1;                 // CRC32
+    CHECK(run(bad, s_gz_len, 1460) == ESP_ERR_INVALID_CRC);
+
+    memcpy(bad, s_gz, s_gz_len);
+    bad[s_gz_len - 1] ^= 1;                 // ISIZE
+    CHECK(run(bad, s_gz_len, 1) == ESP_ERR_INVALID_CRC);
+    free(bad);
+}
+
+static void check_raw(void)
+{
+    CHECK(run(s_img, IMG_SZ, 4096) == ESP_OK);
+    CHECK(s_out_len == IMG_SZ && memcmp(s_out, s_img, IMG_SZ) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (!build_image()) {
+        printf("FALLO: no se pudo generar la imagen comprimida\n");
+        return 1;
+    }
+
+    check_chunks();
+    check_trailer();
+    check_raw();
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    return 0;
+}
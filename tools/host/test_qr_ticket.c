@@ -0,0 +1,184 @@
+// test_qr_ticket.c
+//
+// Vectores de qr_ticket.c (tickets TK2, ECDSA P-256) en el host contra el
+// mbedtls del sistema, más persistencia de nonces y claves en la NVS de RAM
+// y un benchmark de la verificación.
+//
+//   make -C tools/host test_qr_ticket && tools/host/test_qr_ticket [N]
+//
+// Los vectores salen de gen_ticket_vectors.py. N = iteraciones del
+// benchmark (0 = sólo comprobaciones).
+
+#include "qr_ticket.h"
+#include "qr_ticket_vectors.h"
+#include "app_config.h"
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+// ================== Lo que qr_ticket.c pide al resto del firmware ==================
+
+// El commit diferido de app_config: aquí se llama a mano
+static app_config_flush_fn_t s_flush_fn;
+
+void app_config_register_flush(app_config_flush_fn_t fn)
+{
+    s_flush_fn = fn;
+}
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Texto del vector por nombre
+static const char *tv(const char *name)
+{
+    for (size_t i = 0; i < COUNT(TV); i++) {
+        if (strcmp(TV[i].name, name) == 0) return TV[i].text;
+    }
+    printf("FALLO: no hay vector %s\n", name);
+    exit(1);
+}
+
+static void boot(bool keep_nvs)
+{
+    if (!keep_nvs) nvs_host_reset();
+    CHECK(qr_ticket_init() == ESP_OK);
+}
+
+// ================== Vectores ==================
+static void check_vectors(void)
+{
+    boot(false);
+    CHECK(qr_ticket_set_key(1, TV_KEY1) == ESP_OK);
+    CHECK(qr_ticket_set_key(2, TV_KEY2) == ESP_OK);
+
+    int ok = 0;
+    for (size_t i = 0; i < COUNT(TV); i++) {
+        qr_ticket_t t;
+        qr_ticket_result_t r = qr_ticket_check(TV[i].text, TV[i].now, TV[i].court, &t);
+        if (r != TV[i].exp) {
+            printf("FALLO %s: %s, esperado %s\n", TV[i].name,
+                   qr_ticket_result_name(r), qr_ticket_result_name(TV[i].exp));
+            s_fail++;
+            continue;
+        }
+        if (r == QT_OK) CHECK(t.court == 3 && t.valid_to >= t.valid_from);
+        ok++;
+    }
+    printf("vectores: %d/%zu\n", ok, COUNT(TV));
+}
+
+// ================== Claves ==================
+static void check_keys(void)
+{
+    uint8_t bad[QR_TICKET_KEY_LEN];
+
+    boot(false);
+    memcpy(bad, TV_KEY1, sizeof(bad));
+    bad[64] ^= 1;                                   // fuera de la curva
+    CHECK(qr_ticket_set_key(1, bad) == ESP_ERR_INVALID_ARG);
+    memset(bad, 0, sizeof(bad));
+    CHECK(qr_ticket_set_key(1, bad) == ESP_ERR_INVALID_ARG);
+    CHECK(qr_ticket_check(tv("valid"), TV_NOW, 0, NULL) == QT_NO_KEY);
+
+    // La clave sobrevive al reinicio
+    CHECK(qr_ticket_set_key(1, TV_KEY1) == ESP_OK);
+    boot(true);
+    CHECK(qr_ticket_check(tv("valid"), TV_NOW, 0, NULL) == QT_OK);
+
+    // Rotación: id 3 cae en el slot de id 1 y la sustituye
+    CHECK(qr_ticket_set_key(3, TV_KEY2) == ESP_OK);
+    CHECK(qr_ticket_check(tv("valid_court_match"), TV_NOW, 0, NULL) == QT_NO_KEY);
+}
+
+// ================== Replay ==================
+static void check_replay(void)
+{
+    boot(false);
+    CHECK(qr_ticket_set_key(1, TV_KEY1) == ESP_OK);
+    CHECK(qr_ticket_check(tv("valid"), TV_NOW, 0, NULL) == QT_OK);
+
+    // Sin flush el nonce se pierde al reiniciar; con el commit diferido, no
+    uint32_t w0 = nvs_host_writes();
+    CHECK(s_flush_fn == qr_ticket_flush);
+    CHECK(s_flush_fn && s_flush_fn() == ESP_OK);
+    CHECK(nvs_host_writes() == w0 + 1);
+    CHECK(qr_ticket_flush() == ESP_OK && nvs_host_writes() == w0 + 1);
+    boot(true);
+    CHECK(qr_ticket_check(tv("valid"), TV_NOW, 0, NULL) == QT_REPLAY);
+
+    // Tabla llena de nonces vigentes: no se decide offline
+    int accepted = 1;
+    qr_ticket_result_t r = QT_OK;
+    for (size_t i = 0; i < COUNT(TV_FILL) && r == QT_OK; i++) {
+        r = qr_ticket_check(TV_FILL[i], TV_NOW, 0, NULL);
+        if (r == QT_OK) accepted++;
+    }
+    CHECK(accepted == QR_TICKET_REPLAY_SLOTS && r == QT_STORE_FULL);
+    CHECK(!qr_ticket_decided_offline(r));
+
+    // Un día después han caducado todos y los huecos se reciclan
+    CHECK(qr_ticket_check(TV_LATER, TV_LATER_NOW, 0, NULL) == QT_OK);
+    printf("replay: %d nonces hasta llenar la tabla\n", accepted);
+}
+
+// ================== Benchmark ==================
+_Static_assert(sizeof(TV_FILL) / sizeof(TV_FILL[0]) > QR_TICKET_REPLAY_SLOTS,
+               "regenerar qr_ticket_vectors.h con más tickets de relleno");
+
+static void bench(int n)
+{
+    const char *used = tv("valid");
+    const char *bad_sig = tv("bad_sig");
+    const char *bad_b64 = tv("bad_b64");
+
+    boot(false);
+    qr_ticket_set_key(1, TV_KEY1);
+    qr_ticket_check(used, TV_NOW, 0, NULL);
+
+    // Ticket ya usado: firma completa + recorrido de la tabla de replay
+    double t0 = now_ns();
+    for (int i = 0; i < n; i++) qr_ticket_check(used, TV_NOW, 0, NULL);
+    double t1 = now_ns();
+    printf("check replay (firma ok):  %8.1f us\n", (t1 - t0) / n / 1e3);
+
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) qr_ticket_check(bad_sig, TV_NOW, 0, NULL);
+    t1 = now_ns();
+    printf("check firma mala:         %8.1f us\n", (t1 - t0) / n / 1e3);
+
+    t0 = now_ns();
+    for (int i = 0; i < n; i++) qr_ticket_check(bad_b64, TV_NOW, 0, NULL);
+    t1 = now_ns();
+    printf("check base64 mal:         %8.1f us\n", (t1 - t0) / n / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 2000;
+
+    check_vectors();
+    check_keys();
+    check_replay();
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    if (n > 0) bench(n);
+    return 0;
+}
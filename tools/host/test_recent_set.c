@@ -0,0 +1,168 @@
+// test_recent_set.c
+//
+// Filtro de repetidos del pipeline de credenciales (recent_set.c) en el host,
+// con los casos del lector: dos usuarios alternando, un móvil apoyado que
+// reenvía el QR, pausa más larga que el TTL, una credencial descartada que
+// no debe quedar apuntada y presión de códigos distintos.
+//
+//   make -C tools/host test_recent_set && tools/host/test_recent_set [N]
+//
+// N = operaciones del benchmark de recent_set_seen (0 = sólo comprobaciones).
+
+#include "recent_set.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int s_fail;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail++; } \
+} while (0)
+
+#define SLOTS   32                  // CRED_RECENT_SLOTS
+#define TTL_US  (1200 * 1000LL)     // CRED_DEBOUNCE_QR_MS
+
+static recent_entry_t s_slots[SLOTS];
+static recent_set_t   s_rs;
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void check_init(void)
+{
+    recent_entry_t few[RECENT_SET_PROBE / 2];
+    recent_entry_t odd[24];
+
+    CHECK(!recent_set_init(&s_rs, few, sizeof(few) / sizeof(few[0])));
+    CHECK(!recent_set_init(&s_rs, odd, sizeof(odd) / sizeof(odd[0])));
+    CHECK(!recent_set_init(&s_rs, NULL, SLOTS));
+    CHECK(recent_set_init(&s_rs, s_slots, SLOTS));
+}
+
+static void check_reader(void)
+{
+    uint64_t a = recent_set_hash("https://x/a");
+    uint64_t b = recent_set_hash("https://x/b");
+    int64_t t = 1;
+    int pub = 0;
+
+    CHECK(a != b && a == recent_set_hash("https://x/a"));
+
+    // Dos usuarios alternando cada 300 ms: cada uno se publica una vez
+    recent_set_init(&s_rs, s_slots, SLOTS);
+    for (int i = 0; i < 4; i++) {
+        pub += !recent_set_seen(&s_rs, (i & 1) ? b : a, t, TTL_US);
+        t += 300 * 1000;
+    }
+    CHECK(pub == 2);
+
+    // Móvil apoyado 5 s reenviando cada 200 ms: renueva y no se vuelve a publicar
+    pub = 0;
+    for (int i = 0; i < 25; i++) {
+        pub += !recent_set_seen(&s_rs, a, t, TTL_US);
+        t += 200 * 1000;
+    }
+    CHECK(pub == 0);
+
+    // Se retira más que el TTL y vuelve: nuevo
+    t += TTL_US + 1;
+    CHECK(!recent_set_seen(&s_rs, a, t, TTL_US));
+    // Justo en la caducidad ya no cuenta como vivo
+    uint64_t c = recent_set_hash("https://x/c");
+    CHECK(!recent_set_seen(&s_rs, c, t, TTL_US));
+    CHECK(recent_set_seen(&s_rs, c, t + TTL_US - 1, TTL_US));
+    CHECK(!recent_set_seen(&s_rs, c, t + 2 * TTL_US - 1, TTL_US));
+}
+
+// Como el pipeline: se mira antes y se apunta sólo si la credencial dio algo
+static void check_split(void)
+{
+    uint64_t a = recent_set_hash("04A1B2C3");
+    int64_t t = 1;
+
+    recent_set_init(&s_rs, s_slots, SLOTS);
+
+    // Descartada (sin broker): no se apunta y la repetición vuelve a pasar
+    CHECK(!recent_set_check(&s_rs, a, t, TTL_US));
+    CHECK(!recent_set_check(&s_rs, a, t + 1000, TTL_US));
+    CHECK(s_rs.stats.inserted == 0);
+
+    // Encolada: ahora sí es repetida dentro del TTL
+    recent_set_insert(&s_rs, a, t + 1000, TTL_US);
+    CHECK(recent_set_check(&s_rs, a, t + 2000, TTL_US));
+    CHECK(recent_set_seen(&s_rs, a, t + 3000, TTL_US));
+
+    // Apuntarla otra vez sólo renueva
+    recent_set_insert(&s_rs, a, t + 4000, TTL_US);
+    CHECK(s_rs.stats.inserted == 1 && s_rs.stats.suppressed == 2);
+    CHECK(!recent_set_check(&s_rs, a, t + 4000 + TTL_US, TTL_US));
+}
+
+static void check_pressure(void)
+{
+    char text[16];
+    int64_t t = 1;
+
+    recent_set_init(&s_rs, s_slots, SLOTS);
+
+    // Media tabla de códigos distintos: todos caben y se reconocen
+    for (int i = 0; i < SLOTS / 2; i++) {
+        snprintf(text, sizeof(text), "c%d", i);
+        CHECK(!recent_set_seen(&s_rs, recent_set_hash(text), t, TTL_US));
+    }
+    for (int i = 0; i < SLOTS / 2; i++) {
+        snprintf(text, sizeof(text), "c%d", i);
+        CHECK(recent_set_seen(&s_rs, recent_set_hash(text), t + 1000, TTL_US));
+    }
+    CHECK(s_rs.stats.evicted == 0);
+
+    // 1000 códigos dentro del TTL: se desaloja, nunca se pierde el nuevo
+    for (int i = 0; i < 1000; i++) {
+        snprintf(text, sizeof(text), "p%d", i);
+        uint64_t h = recent_set_hash(text);
+        CHECK(!recent_set_seen(&s_rs, h, t + 2000 + i, TTL_US));
+        CHECK(recent_set_seen(&s_rs, h, t + 2000 + i, TTL_US));
+    }
+    CHECK(s_rs.stats.evicted > 0);
+    printf("presión: inserted=%u suppressed=%u evicted=%u\n",
+           (unsigned)s_rs.stats.inserted, (unsigned)s_rs.stats.suppressed,
+           (unsigned)s_rs.stats.evicted);
+}
+
+static void bench(long n)
+{
+    volatile int sink = 0;
+    uint64_t h = 1;
+
+    recent_set_init(&s_rs, s_slots, SLOTS);
+    double t0 = now_ns();
+    for (long i = 0; i < n; i++) {
+        h = h * 6364136223846793005ULL + 1;
+        sink += recent_set_seen(&s_rs, h, i, TTL_US);
+    }
+    double t1 = now_ns();
+    printf("recent_set_seen: %.1f ns/op, tabla de %zu bytes\n",
+           (t1 - t0) / n, sizeof(s_slots));
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 10000000;
+
+    check_init();
+    check_reader();
+    check_split();
+    check_pressure();
+    if (s_fail) {
+        printf("%d comprobaciones fallidas\n", s_fail);
+        return 1;
+    }
+    if (n > 0) bench(n);
+    return 0;
+}
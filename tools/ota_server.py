@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# ota_server.py
+#
+# Servidor HTTP local para probar la OTA (ver main/ota_manager.c) sin el
+# servidor real: sirve un .bin, con Range, y puede simular un enlace malo.
+#
+#   normal:    ota_server.py build/totpadel.bin
+#   gzip:      ota_server.py --gzip build/totpadel.bin          (sirve app.bin.gz)
+#   cortes:    ota_server.py --drop-at 0.3,0.9 --rate 40 build/totpadel.bin
+#   sin Range: ota_server.py --no-range build/totpadel.bin
+#
+# Después, por MQTT: {"action": "otaUpdate", "url": "http://<ip>:8070/app.bin"}
+# Cualquier ruta sirve el mismo fichero.
+
+import argparse
+import gzip
+import http.server
+import re
+import sys
+import threading
+import time
+
+CHUNK = 1024
+
+
+class OtaHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write("[ota] %s\n" % (fmt % args))
+
+    def do_GET(self):
+        srv = self.server
+        data = srv.payload
+        size = len(data)
+        start = 0
+
+        rng = self.headers.get("Range")
+        m = re.match(r"bytes=(\d+)-$", rng or "")
+        if m and not srv.no_range:
+            start = int(m.group(1))
+            if start >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            self.send_response(206)
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, size - 1, size))
+        else:
+            self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(size - start))
+        self.send_header("Accept-Ranges", "none" if srv.no_range else "bytes")
+        self.end_headers()
+
+        pos = start
+        t0 = time.monotonic()
+        while pos < size:
+            # Cada punto de corte se usa una vez: el reintento ya pasa
+            with srv.lock:
+                cut = next((d for d in srv.drops if pos < d <= pos + CHUNK), None)
+                if cut is not None:
+                    srv.drops.remove(cut)
+            end = min(size, pos + CHUNK if cut is None else cut)
+            self.wfile.write(data[pos:end])
+            pos = end
+            if cut is not None:
+                self.log_message("corte simulado en el byte %d", cut)
+                self.close_connection = True
+                return
+            if srv.rate:
+                ahead = (pos - start) / (srv.rate * 1024 / 8) - (time.monotonic() - t0)
+                if ahead > 0:
+                    time.sleep(ahead)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Servidor OTA local del torno")
+    ap.add_argument("image", help="imagen de la app (.bin)")
+    ap.add_argument("--port", type=int, default=8070)
+    ap.add_argument("--gzip", action="store_true", help="servir la imagen comprimida")
+    ap.add_argument("--no-range", action="store_true", help="ignorar Range (siempre 200)")
+    ap.add_argument("--drop-at", default="",
+                    help="cortar la conexión en estas fracciones del fichero, p. ej. 0.3,0.9")
+    ap.add_argument("--rate", type=float, default=0, help="límite en kbit/s (0 = sin límite)")
+    args = ap.parse_args()
+
+    with open(args.image, "rb") as f:
+        payload = f.read()
+    if args.gzip:
+        raw = len(payload)
+        payload = gzip.compress(payload, compresslevel=9)
+        print("gzip: %d -> %d bytes (%.0f%%)" % (raw, len(payload), 100.0 * len(payload) / raw))
+
+    srv = http.server.ThreadingHTTPServer(("", args.port), OtaHandler)
+    srv.payload = payload
+    srv.no_range = args.no_range
+    srv.rate = args.rate
+    srv.lock = threading.Lock()
+    srv.drops = sorted({max(1, int(float(x) * len(payload)))
+                        for x in args.drop_at.split(",") if x.strip()})
+
+    print("Sirviendo %d bytes en :%d (cortes en %s)" % (len(payload), args.port, srv.drops or "-"))
+    try:
+        srv.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()